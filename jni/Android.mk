@@ -29,6 +29,11 @@ SRTP_C_INCLUDE= \
 	$(me-root-dir)/submodules/externals/srtp \
 	$(me-root-dir)/submodules/externals/srtp/include \
 	$(me-root-dir)/submodules/externals/srtp/crypto/include
+ifeq ($(BUILD_SRTP_OPENSSL), 1)
+SRTP_C_INCLUDE += \
+	$(me-root-dir)/submodules/externals/openssl \
+	$(me-root-dir)/submodules/externals/openssl/include
+endif
 endif
 #endif
 
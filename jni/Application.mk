@@ -22,6 +22,10 @@ ifeq ($(BUILD_SRTP),)
 #Lin Ren default no build srtp
 BUILD_SRTP=0
 endif
+ifeq ($(BUILD_SRTP_OPENSSL),)
+#SRTP uses OpenSSL's AES and SHA1 (assembly) instead of libsrtp's C code
+BUILD_SRTP_OPENSSL=1
+endif
 
 ifeq ($(BUILD_VIDEO),1)
 APP_MODULES += libavutil libavcore libavcodec libswscale
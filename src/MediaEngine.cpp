@@ -9,6 +9,7 @@
 #include <mediastreamer2/dtmfgen.h>
 
 #include <math.h>
+#include <ctype.h>
 
 
 #include <ortp/rtp.h>
@@ -65,10 +66,37 @@
 
 #define DEFAULT_AUDIO_DSCP		 	(0x2e)  // 48, default for voice (realtime)
 
+/* Wav recording */
+#define RECORDER_BUFFER_SIZE		(32000)	// Recorded audio is written to disk by a background thread in batches of this size, 0 to write from the ticker
+#define RECORDER_MAX_PENDING		(16)	// Batches waiting for the disk before recorded audio is dropped
+
 #define ENABLE_AUDIO_ADAPTIVE_JITT_COMP 	(1)		// Adative Jitter compensation for audio
 #define ENABLE_AUDIO_NO_XMIT_ON_MUTE		(0)		// When audio is muted, no transmission
 #define AUDIO_RTP_JITTER_TIME 	 			(100) 	// Nominal audio jitter buffer size in milliseconds
+#define AUDIO_RTP_JITTER_MIN_TIME 	 		(20) 	// Adaptive jitter buffer can shrink down to this size in milliseconds
+#define AUDIO_RTP_JITTER_MAX_TIME 	 		(300) 	// Adaptive jitter buffer can grow up to this size in milliseconds
+#define AUDIO_RTP_JITTER_PERCENTILE 	 	(95) 	// Percentage of packets the adaptive jitter buffer shall deliver in time
 #define NO_RTP_TIMEOUT						(30) 	// RTP timeout in seconds: when no RTP or RTCP
+#define AUDIO_RTP_MIN_PORT					(10000)	// Local RTP/RTCP port pairs are taken in this range
+#define AUDIO_RTP_MAX_PORT					(20000)
+#define RTP_WARM_BIND_FAILURES				(8)		// A top up of the warm sessions, or a call taking any pair, gives up after this many ports that cannot be bound
+#define RTP_WARM_AT_INIT					(1)		// Sessions bound by Initialize() for the first calls, the others are bound in the background
+#define ENABLE_RTCP_EMITTED_EVENTS			(0)		// Each RTCP report sent is copied to the application queue (MediaStats::sent_rtcp)
+#define ENABLE_RTCP_XR_VOIP_METRICS			(1)		// The RTCP reports sent include the extended report VoIP metrics block (RFC 3611)
+
+/* Audio conference */
+#define CONF_MAX_SPEAKERS					(3) 	// Number of loudest participants mixed together
+#define CONF_NOISE_FLOOR					(-50.0f) // Participants below this level (dBFS) are not mixed
+
+/* Per call memory */
+#define STREAM_ARENA_SIZE					(256*1024) // Each call's audio graph is built in one region of this size, the excess goes to the heap
+
+/* Logging */
+#define ENABLE_ASYNC_LOGGING				(0)		// Log messages are output by a background thread, media threads never block on the log output (see SetAsyncLogging)
+#define LOG_RATE_LIMIT						(0)		// Maximum number of messages per second from a given call site in asynchronous mode, 0 for no limit
+
+/* Shutdown */
+#define TEARDOWN_THREADS					(8)		// Uninitialize() stops up to this many audio streams at the same time
 
 #ifdef HAVE_ILBC
 extern "C" void libmsilbc_init();
@@ -127,9 +155,18 @@ void MediaEngine::Enable_Trace(FILE *file) {
 }
 
 
+// states of the pairs of the RTP port pool
+enum { RTP_PORT_FREE, RTP_PORT_BINDING, RTP_PORT_WARM, RTP_PORT_USED };
+
+static float elapsed_ms(const ortpTimeSpec *begin, const ortpTimeSpec *end) {
+	return (end->tv_sec - begin->tv_sec) * 1000.0f + (end->tv_nsec - begin->tv_nsec) / 1000000.0f;
+}
+
 // Public functions
 void MediaEngine::Initialize()
 {
+	ortpTimeSpec begin, step, now;
+
 #ifdef DEBUG
 	ms_message("**** Enable Debug ******\n");
 	ortp_set_log_handler((OrtpLogFunc)ME_Android_Log_Handler);
@@ -139,8 +176,12 @@ void MediaEngine::Initialize()
 	ms_message("Initializing MediaEngine %d.%d", ME_MAJAR_VER, ME_MINOR_VER);
 
 	memset(mData, 0, sizeof (ME_PrivData));
+	ortp_get_cur_time(&begin);
+	step = begin;
 
 	ms_mutex_init(&mData->mutex,NULL);
+	mData->max_calls = ME_MAX_NB_SESSIONS;
+	init_session_registry();
 
 #ifdef HAVE_ILBC
 #if defined(ANDROID)
@@ -172,9 +213,18 @@ void MediaEngine::Initialize()
 #endif
 	libmsbcg729_init();
 #endif
+	ortp_get_cur_time(&now);
+	mData->init_timings.codecs = elapsed_ms(&step, &now);
+	step = now;
 
 	//Initialize oRTP stack
 	ortp_init();
+	if (ENABLE_ASYNC_LOGGING != 0) {
+		ortp_set_log_rate_limit(LOG_RATE_LIMIT);
+		ortp_async_logging_start();
+	}
+	// up to one arena per session CreateSession() accepts, allocated as the calls need them
+	ortp_arena_pool_init(mData->max_calls, STREAM_ARENA_SIZE);
 	mData->dyn_pt=DYNAMIC_PAYLOAD_TYPE_MIN;
 	mData->default_profile=rtp_profile_new("default profile");
 
@@ -212,6 +262,10 @@ void MediaEngine::Initialize()
 
 	//Assign static payloads
 	handle_static_payloads();
+	build_codec_registry();
+	ortp_get_cur_time(&now);
+	mData->init_timings.ortp = elapsed_ms(&step, &now);
+	step = now;
 
 #if defined(ANDROID)
 	__android_log_write(ANDROID_LOG_DEBUG, "*ME_N*", "Init MS ...");
@@ -222,10 +276,19 @@ void MediaEngine::Initialize()
 	// This allows event's callback
 	mData->msevq=ms_event_queue_new();
 	ms_set_global_event_queue(mData->msevq);
+	ortp_get_cur_time(&now);
+	mData->init_timings.mediastreamer = elapsed_ms(&step, &now);
+	step = now;
 
-    mData->rtp_conf.audio_rtp_min_port = 1024;  // Not used yet, take IANA the lowest unofficial port
-	mData->rtp_conf.audio_rtp_max_port = 65535; //
+	mData->rtp_conf.audio_rtp_min_port = AUDIO_RTP_MIN_PORT;
+	mData->rtp_conf.audio_rtp_max_port = AUDIO_RTP_MAX_PORT;
 	mData->rtp_conf.audio_jitt_comp = AUDIO_RTP_JITTER_TIME;
+	mData->recorder_async.buffer_size = RECORDER_BUFFER_SIZE;
+	mData->recorder_async.max_pending = RECORDER_MAX_PENDING;
+	mData->recorder_async.fsync_policy = MSFileRecFsyncOnClose;
+	mData->rtp_conf.audio_jitt_comp_min = AUDIO_RTP_JITTER_MIN_TIME;
+	mData->rtp_conf.audio_jitt_comp_max = AUDIO_RTP_JITTER_MAX_TIME;
+	mData->rtp_conf.audio_jitt_percentile = AUDIO_RTP_JITTER_PERCENTILE;
 	mData->rtp_conf.nortp_timeout = NO_RTP_TIMEOUT;
 	if (ENABLE_AUDIO_NO_XMIT_ON_MUTE == 0) {
 		mData->rtp_conf.rtp_no_xmit_on_audio_mute = FALSE;
@@ -249,8 +312,23 @@ void MediaEngine::Initialize()
 #endif
 	//init sound device properties
 	init_sound();
+	ortp_get_cur_time(&now);
+	mData->init_timings.sound = elapsed_ms(&step, &now);
+	step = now;
+
+	// bind ahead the RTP sessions of the first calls, the next ones are bound in the background
+	init_port_pool();
+	warm_rtp_sessions(RTP_WARM_AT_INIT);
+	start_warm_thread();
+	schedule_warm_rtp_sessions();
+	ortp_get_cur_time(&now);
+	mData->init_timings.rtp_sessions = elapsed_ms(&step, &now);
+	mData->init_timings.total = elapsed_ms(&begin, &now);
 
 	mData->state=ME_INITIALIZED;
+	ms_message("MediaEngine initialized in %.1f ms: codecs %.1f, oRTP %.1f, mediastreamer %.1f, sound %.1f, RTP sessions %.1f",
+		mData->init_timings.total, mData->init_timings.codecs, mData->init_timings.ortp, mData->init_timings.mediastreamer,
+		mData->init_timings.sound, mData->init_timings.rtp_sessions);
 
 	// Done, inform the observer
 	//if (iObserver)
@@ -267,18 +345,26 @@ bool_t MediaEngine::isInitialized() {
 		return FALSE;
 }
 
+/**
+ * Time spent in each step of the last Initialize(), for profiling the engine startup.
+**/
+const MediaEngine::ME_InitTimings* MediaEngine::GetInitTimings() const {
+	return &mData->init_timings;
+}
+
 void MediaEngine::Uninitialize()
 {
-	if (!mData) return;
+	// the destructor uninitializes too, once is enough
+	if (!mData || mData->state == ME_IDLE) return;
 
 	mData->state = ME_TERMINATING;
 
-	while (mData->sessions)
-	{
-		MediaSession *theSession = (MediaSession *)mData->sessions->data;
-		DeleteSession(theSession);
+	stop_warm_thread();
+	delete_all_sessions();
 
-		usleep(50000);
+	while (mData->conferences)
+	{
+		DeleteConference((MediaConference *)mData->conferences->data);
 	}
 
 	ms_event_queue_destroy(mData->msevq);
@@ -287,8 +373,12 @@ void MediaEngine::Uninitialize()
 	uninit_sound();
 
 	free_payload_types();
+	uninit_port_pool();
+	ortp_arena_pool_uninit();
+	ortp_async_logging_stop();
 	ortp_exit();
 
+	uninit_session_registry();
 	ms_mutex_destroy(&mData->mutex);
 
 	mData->state = ME_IDLE;
@@ -316,26 +406,27 @@ ME_List* MediaEngine::GetAvaliableVideoCodecs() const {
 }
 
 ME_Codec* MediaEngine::GetCodec(int pt_number, int clk_rate, const char * name) const {
-	MSList *elem;
-	bool_t isDynamicPt = (pt_number>= DYNAMIC_PAYLOAD_TYPE_MIN && pt_number>= DYNAMIC_PAYLOAD_TYPE_MAX);
+	const codec_registry_t *reg = &mData->codec_registry;
+	bool_t isDynamicPt = (pt_number>= DYNAMIC_PAYLOAD_TYPE_MIN && pt_number<= DYNAMIC_PAYLOAD_TYPE_MAX);
+	int i;
 
-	ms_mutex_lock(&mData->mutex);
-	for (elem=mData->payload_types;elem!=NULL;elem=elem->next) {
-		PayloadType *it=(PayloadType*)elem->data;
-		if (!isDynamicPt) {
-			if (payload_type_get_number(it)==pt_number) {
-				ms_mutex_unlock(&mData->mutex);
-				return it;
-			}
-		}
-		else {//TODO dynamic payload, find it by name
-			if (payload_type_get_number(it)==pt_number && it && it->clock_rate == clk_rate) {
-				ms_mutex_unlock(&mData->mutex);
-				return it;
-			}
-		}
+	// The registry does not change while the engine is initialized, no locking
+	if (reg->count == 0 || pt_number < 0 || pt_number >= RTP_PROFILE_MAX_PAYLOADS)
+		return NULL;
+	if (!isDynamicPt) {
+		i = reg->by_number[pt_number];
+		return i != -1 ? reg->codecs[i] : NULL;
+	}
+	// Dynamic numbers are negotiated, the name and clock rate identify the codec
+	if (name != NULL) {
+		PayloadType *pt = find_codec(name, clk_rate, -1);
+		if (pt != NULL)
+			return pt;
+	}
+	for (i = reg->by_number[pt_number]; i != -1; i = reg->next_same_number[i]) {
+		if (reg->codecs[i]->clock_rate == clk_rate)
+			return reg->codecs[i];
 	}
-	ms_mutex_unlock(&mData->mutex);
 	return NULL;
 }
 
@@ -348,10 +439,18 @@ const char* MediaEngine::GetAudioStreamSessionKey(MediaSession* session)
 	return key;
 }
 
+static MediaEngine::MediaSession* registry_find(const MediaEngine::session_registry_t *reg, MediaEngine::ME_SessionHandle handle) {
+	unsigned int slot = handle & ME_SESSION_SLOT_MASK;
+
+	if (slot >= (unsigned int)reg->capacity || reg->generations[slot] != (handle >> ME_SESSION_SLOT_BITS))
+		return NULL;
+	return reg->slots[slot];
+}
+
 MediaEngine::MediaSession* MediaEngine::CreateSession()
 {
 	ms_mutex_lock(&mData->mutex);
-	if (ms_list_size(mData->sessions) > ME_MAX_NB_SESSIONS) {
+	if (mData->session_registry.count >= mData->max_calls) {
 		ms_message("Too many open media sessions!!!");
 #if defined(ANDROID)
 		__android_log_write(ANDROID_LOG_DEBUG, "*ME_N*", "Too many open media sessions!!!");
@@ -380,7 +479,7 @@ MediaEngine::MediaSession* MediaEngine::CreateSession()
 	session->state = ME_SESSION_IDLE;
 	session->media_start_time = 0;
 	session->stats[MEDIA_TYPE_AUDIO].type = MEDIA_TYPE_AUDIO;
-	session->stats[MEDIA_TYPE_AUDIO].received_rtcp = NULL;
+	memset(&session->stats[MEDIA_TYPE_AUDIO].rtcp, 0, sizeof(rtcp_summary_t));
 	session->stats[MEDIA_TYPE_AUDIO].sent_rtcp = NULL;
 	//generate session key, we support currently only one crypto algo
 	session->as->crypto[0].tag = 1;
@@ -394,8 +493,8 @@ MediaEngine::MediaSession* MediaEngine::CreateSession()
 #if defined(ANDROID)
 		__android_log_write(ANDROID_LOG_DEBUG, "*ME_N*", "Not possible at failing of add_session ... weird!!!");
 #endif
-		ms_free(session);
 		ms_free(session->as);
+		ms_free(session);
 		ms_mutex_unlock(&mData->mutex);
 		return NULL;
 	}
@@ -407,56 +506,65 @@ MediaEngine::MediaSession* MediaEngine::CreateSession()
 	return session;
 }
 
+// The handle of a session that is still open, ME_INVALID_SESSION_HANDLE otherwise. The session is not read: it
+// may have been deleted.
+static MediaEngine::ME_SessionHandle registry_find_handle(const MediaEngine::session_registry_t *reg, const MediaEngine::MediaSession *session) {
+	int slot;
+
+	for (slot = 0; slot < reg->capacity; slot++) {
+		if (reg->slots[slot] == session && session != NULL)
+			return ((MediaEngine::ME_SessionHandle)reg->generations[slot] << ME_SESSION_SLOT_BITS) | slot;
+	}
+	return ME_INVALID_SESSION_HANDLE;
+}
+
 int MediaEngine::DeleteSession(MediaSession* session)
 {
-#if defined(ANDROID)
-	__android_log_write(ANDROID_LOG_INFO, "*ME", "--->MediaEngine::DeleteSession");
-#endif
+	ME_SessionHandle handle;
 
-	//stop streaming
-	if (session->state != ME_SESSION_IDLE) {
-		StopStreams(session);
+	ms_mutex_lock(&mData->mutex);
+	handle = registry_find_handle(&mData->session_registry, session);
+	ms_mutex_unlock(&mData->mutex);
+	if (handle == ME_INVALID_SESSION_HANDLE) {
+		ms_warning("could not find the session %p in the registry\n", session);
+		return -1;
 	}
+	return DeleteSession(handle);
+}
 
-	ms_mutex_lock(&mData->mutex);
+int MediaEngine::DeleteSession(ME_SessionHandle handle)
+{
+	MediaSession *session;
 
-	MSList *it;
-	MSList *theSessions = mData->sessions;
+#if defined(ANDROID)
+	__android_log_write(ANDROID_LOG_INFO, "*ME", "--->MediaEngine::DeleteSession");
+#endif
 
-	if (session == mData->curSession) {
-		mData->curSession = NULL;
-	}
+	ms_mutex_lock(&mData->mutex);
 
-	it=ms_list_find(theSessions, session);
-	if (it)
-	{
-		theSessions = ms_list_remove_link(theSessions,it);
-	}
-	else
-	{
-		ms_warning("could not find the call in the list\n");
+	session = registry_find(&mData->session_registry, handle);
+	if (session == NULL) {
+		ms_warning("could not find the session of handle %#x in the registry\n", handle);
 #if defined(ANDROID)
-		__android_log_write(ANDROID_LOG_DEBUG, "*ME_N*", "Warning, could not find the session in the list!");
+		__android_log_write(ANDROID_LOG_DEBUG, "*ME_N*", "Warning, could not find the session in the registry!");
 #endif
-
-		if (session->audioRecvCodecs) {
-			ms_free(session->audioRecvCodecs);
-			session->audioRecvCodecs = NULL;
-		}
-		ms_free(session->as);
-	    ms_free(session);
 		ms_mutex_unlock(&mData->mutex);
 		return -1;
 	}
-	mData->sessions = theSessions;
 
-	if (session->audioRecvCodecs) {
-		ms_free(session->audioRecvCodecs);
-		session->audioRecvCodecs = NULL;
+	//stop streaming
+	if (session->state != ME_SESSION_IDLE) {
+		stop_media_streams(session);
 	}
-	ms_free(session->as);
-    ms_free(session);
+	// the stream may have been initialized but never started
+	if (session->as->audiostream != NULL) {
+		stop_audio_stream(session);
+	}
+	free_session(session);
 	ms_mutex_unlock(&mData->mutex);
+
+	// bind a session in place of the one just used, for the next call
+	schedule_warm_rtp_sessions();
 #if defined(ANDROID)
 	__android_log_write(ANDROID_LOG_INFO, "*ME", "<---MediaEngine::DeleteSession");
 #endif
@@ -464,14 +572,22 @@ int MediaEngine::DeleteSession(MediaSession* session)
 }
 
 void MediaEngine::InitStreams(MediaSession* session, int local_audio_port, int local_video_port) {
+	int audio_port = local_audio_port;
+	// the ports are bound before locking the engine, binding may take a while
+	RtpSession *rtps = take_rtp_session(&audio_port);
+	bool_t pooled = rtps != NULL;
+
+	if (rtps == NULL) {
+		// out of the pool's range, or no pair of it could be taken: bind the requested port, or any
+		rtps = ms_create_duplex_rtp_session(audio_port > 0 ? audio_port : -1, audio_port > 0 ? audio_port+1 : -1, FALSE); //no IPv6 support
+		if (audio_port <= 0) audio_port = rtp_session_get_local_port(rtps);
+	}
 
 	ms_mutex_lock(&mData->mutex);
 
-	//save the port
-	session->audio_port = local_audio_port;
-
-    init_audio_stream(session, local_audio_port);
+    init_audio_stream(session, audio_port, rtps, pooled);
 
+    select_sound_cards();
     audio_stream_prepare_sound(session->as->audiostream, mData->sound_conf.play_sndcard, mData->sound_conf.capt_sndcard);
 
 	ms_mutex_unlock(&mData->mutex);
@@ -507,7 +623,7 @@ void MediaEngine::StartStreams(MediaSession* session, PayloadType* sendAudioCode
 		return;
 	}
 
-	if (session != mData->curSession) {
+	if (session != mData->curSession && session->conference == NULL && session->relay_peer == NULL) {
 		preempt_sound_resources();
 	}
 
@@ -636,19 +752,203 @@ void MediaEngine::SetPlaybackGain(float gain) {
 	ms_mutex_unlock(&mData->mutex);
 }
 
+/**
+ * Sets how the wav recorders of the sessions created from now on write to disk.
+ */
+void MediaEngine::SetRecorderAsyncParams(const MSFileRecAsyncParams* params) {
+	ms_mutex_lock(&mData->mutex);
+	mData->recorder_async = *params;
+	ms_mutex_unlock(&mData->mutex);
+}
+
+/**
+ * Has the log messages output by a background thread, so that media threads never block on the log output,
+ * or goes back to synchronous logging. In asynchronous mode, rate_limit is the maximum number of messages
+ * per second from a given call site, 0 for no limit. Logging is synchronous unless this is called.
+ */
+void MediaEngine::SetAsyncLogging(bool_t enable, int rate_limit) {
+	ms_mutex_lock(&mData->mutex);
+	if (enable) {
+		ortp_set_log_rate_limit(rate_limit);
+		if (ortp_async_logging_start() != 0) ortp_set_log_rate_limit(0);
+	} else {
+		ortp_async_logging_stop();
+		ortp_set_log_rate_limit(0);
+	}
+	ms_mutex_unlock(&mData->mutex);
+}
+
+void MediaEngine::SetMaxSessions(int max_sessions) {
+	int old_max_calls;
+
+	ms_mutex_lock(&mData->mutex);
+	if (max_sessions > ME_SESSION_SLOT_MASK) {
+		ms_warning("SetMaxSessions: %i sessions at most", ME_SESSION_SLOT_MASK);
+		max_sessions = ME_SESSION_SLOT_MASK;
+	}
+	if (resize_session_registry(max_sessions) != 0) {
+		ms_error("SetMaxSessions: cannot allocate %i sessions, keeping %i", max_sessions, mData->max_calls);
+		ms_mutex_unlock(&mData->mutex);
+		return;
+	}
+	old_max_calls = mData->max_calls;
+	mData->max_calls = max_sessions;
+	// the arena pool can only be resized while no stream uses it, otherwise extra calls are built on the heap
+	if (mData->session_registry.count == 0 && max_sessions != old_max_calls) {
+		ortp_arena_pool_uninit();
+		ortp_arena_pool_init(mData->max_calls, STREAM_ARENA_SIZE);
+	}
+	ms_mutex_unlock(&mData->mutex);
+	schedule_warm_rtp_sessions();
+}
+
+MediaEngine::MediaConference* MediaEngine::CreateConference(int samplerate) {
+	MSAudioConferenceParams params;
+	MediaConference *conf = ms_new0(MediaConference, 1);
+
+	memset(&params, 0, sizeof(params));
+	params.samplerate = samplerate;
+	params.max_speakers = CONF_MAX_SPEAKERS;
+	params.noise_floor = CONF_NOISE_FLOOR;
+	conf->samplerate = samplerate;
+	conf->conf = ms_audio_conference_new(&params);
+
+	ms_mutex_lock(&mData->mutex);
+	mData->conferences = ms_list_append(mData->conferences, conf);
+	ms_mutex_unlock(&mData->mutex);
+	return conf;
+}
+
+int MediaEngine::DeleteConference(MediaConference* conf) {
+	ms_mutex_lock(&mData->mutex);
+	if (ms_list_find(mData->conferences, conf) == NULL) {
+		ms_warning("DeleteConference: unknown conference %p", conf);
+		ms_mutex_unlock(&mData->mutex);
+		return -1;
+	}
+	while (conf->members) {
+		MediaSession *session = (MediaSession *)conf->members->data;
+		unplug_from_conference(session);
+		session->conference = NULL;
+		conf->members = ms_list_remove_link(conf->members, conf->members);
+	}
+	mData->conferences = ms_list_remove(mData->conferences, conf);
+	ms_mutex_unlock(&mData->mutex);
+
+	ms_audio_conference_destroy(conf->conf);
+	ms_free(conf);
+	return 0;
+}
+
+int MediaEngine::AddToConference(MediaConference* conf, MediaSession* session) {
+	ms_mutex_lock(&mData->mutex);
+	if (session->conference != NULL) {
+		ms_warning("AddToConference: session %p is already part of a conference", session);
+		ms_mutex_unlock(&mData->mutex);
+		return -1;
+	}
+	if (session->relay_peer != NULL) {
+		/* a relayed stream has no encoder nor decoder to plug into the mixer */
+		ms_warning("AddToConference: session %p is relayed", session);
+		ms_mutex_unlock(&mData->mutex);
+		return -1;
+	}
+	if (session->state == ME_SESSION_AUDIO_STREAMING && session->as->audiostream && session->as->audiostream->soundread
+		&& ms_filter_get_id(session->as->audiostream->soundread) != MS_FILE_PLAYER_ID) {
+		/* the stream holds the sound card, it has to be restarted to join the conference */
+		ms_warning("AddToConference: session %p is streaming with the sound card", session);
+		ms_mutex_unlock(&mData->mutex);
+		return -1;
+	}
+
+	session->conference = conf;
+	conf->members = ms_list_append(conf->members, session);
+	if (session == mData->curSession) {
+		/* conference members never use the sound card, let other calls have it */
+		mData->curSession = NULL;
+	}
+	if (session->state == ME_SESSION_AUDIO_STREAMING) {
+		plug_to_conference(session);
+	}
+	ms_mutex_unlock(&mData->mutex);
+	return 0;
+}
+
+int MediaEngine::RemoveFromConference(MediaSession* session) {
+	MediaConference *conf;
+
+	ms_mutex_lock(&mData->mutex);
+	conf = session->conference;
+	if (conf == NULL) {
+		ms_mutex_unlock(&mData->mutex);
+		return -1;
+	}
+	unplug_from_conference(session);
+	conf->members = ms_list_remove(conf->members, session);
+	session->conference = NULL;
+	ms_mutex_unlock(&mData->mutex);
+	return 0;
+}
+
+int MediaEngine::RelaySessions(MediaSession* session, MediaSession* peer) {
+	ms_mutex_lock(&mData->mutex);
+	if (session == peer || session->relay_peer || peer->relay_peer || session->conference || peer->conference) {
+		ms_warning("RelaySessions: sessions %p and %p cannot be relayed", session, peer);
+		ms_mutex_unlock(&mData->mutex);
+		return -1;
+	}
+	if (session->state == ME_SESSION_AUDIO_STREAMING || peer->state == ME_SESSION_AUDIO_STREAMING) {
+		ms_warning("RelaySessions: must be called before starting the streams");
+		ms_mutex_unlock(&mData->mutex);
+		return -1;
+	}
+	session->relay_peer = peer;
+	peer->relay_peer = session;
+	/* relayed sessions never use the sound card */
+	if (mData->curSession == session || mData->curSession == peer) {
+		mData->curSession = NULL;
+	}
+	ms_mutex_unlock(&mData->mutex);
+	return 0;
+}
+
+/**
+ * Sets the filter receiving the decoded audio of a relayed session, for recording or tone detection, or NULL to stop
+ * decoding. The session must be streaming. The tap is run by the session's ticker and stays owned by the caller.
+**/
+int MediaEngine::SetRelayTap(MediaSession* session, MSFilter* tap) {
+	int err = -1;
+
+	ms_mutex_lock(&mData->mutex);
+	if (session->relay_peer == NULL || session->state != ME_SESSION_AUDIO_STREAMING || session->as->audiostream == NULL) {
+		ms_warning("SetRelayTap: session %p is not relaying", session);
+	} else {
+		err = audio_stream_relay_set_tap(session->as->audiostream, tap);
+	}
+	ms_mutex_unlock(&mData->mutex);
+	return err;
+}
+
 // Private functions
-void MediaEngine::init_audio_stream(MediaSession *session, int local_port) {
+// Builds the audio stream on rtps, bound to local_port. pooled tells that the pair was taken from the port pool.
+void MediaEngine::init_audio_stream(MediaSession *session, int local_port, RtpSession *rtps, bool_t pooled) {
 	AudioStream *audiostream;
 	int dscp; //what shall we do with DSCP?
 
-	if (session->as->audiostream != NULL) return;
+	if (session->as->audiostream != NULL) {
+		if (pooled) return_rtp_session(local_port, rtps);
+		else rtp_session_destroy(rtps);
+		return;
+	}
 
 	//save the port
 	session->audio_port = local_port;
+	session->audio_port_pooled = pooled;
 
-	session->as->audiostream=audiostream=audio_stream_new(session->audio_port,session->audio_port+1, FALSE); //no IPv6 support
+	session->as->audiostream=audiostream=audio_stream_new_with_session(rtps);
 	//set default DSCP
 	audio_stream_set_dscp(audiostream, DEFAULT_AUDIO_DSCP);
+	audio_stream_set_recorder_async_params(audiostream, &mData->recorder_async);
 
 	if (is_echo_limiter_enabled()){
 		if (mData->ecs == ME_ECS_HIGH) {
@@ -675,11 +975,26 @@ void MediaEngine::init_audio_stream(MediaSession *session, int local_port) {
 		audio_stream_enable_noise_gate(audiostream, TRUE);
 	}
 
+	if (is_audio_adaptive_jittcomp_enabled()) {
+		// let the jitter buffer follow the measured delay percentile, changes are applied by time stretching
+		JBParameters jbp;
+		rtp_session_get_jitter_buffer_params(audiostream->ms.session, &jbp);
+		jbp.nom_size = mData->rtp_conf.audio_jitt_comp;
+		jbp.min_size = mData->rtp_conf.audio_jitt_comp_min;
+		jbp.max_size = mData->rtp_conf.audio_jitt_comp_max;
+		rtp_session_set_jitter_buffer_params(audiostream->ms.session, &jbp);
+		rtp_session_set_jitter_buffer_target_percentile(audiostream->ms.session, mData->rtp_conf.audio_jitt_percentile);
+	}
+
 	//TODO check whether we need this
 	rtp_session_set_pktinfo(audiostream->ms.session, TRUE);
 
 	session->audiostream_app_evq = ortp_ev_queue_new();
 	rtp_session_register_event_queue(audiostream->ms.session, session->audiostream_app_evq);
+	rtp_session_enable_rtcp_emitted_events(audiostream->ms.session, ENABLE_RTCP_EMITTED_EVENTS);
+	rtp_session_enable_rtcp_xr_voip_metrics(audiostream->ms.session, ENABLE_RTCP_XR_VOIP_METRICS);
+	// The received reports are read from the session's RTCP summary, the packets are not needed
+	ortp_ev_queue_ignore_type(session->audiostream_app_evq, ORTP_EVENT_RTCP_PACKET_RECEIVED, TRUE);
 }
 
 void MediaEngine::start_audio_stream(MediaSession* session, const char *cname, const char *remIp, const int remport, bool_t muted, bool_t use_arc,
@@ -691,6 +1006,7 @@ void MediaEngine::start_audio_stream(MediaSession* session, const char *cname, c
 	int used_pt=-1;
 	char rtcp_tool[128]={0};
 
+	select_sound_cards();
 	MSSndCard *playcard=mData->sound_conf.play_sndcard;
 	MSSndCard *captcard=mData->sound_conf.capt_sndcard;
 
@@ -713,7 +1029,13 @@ void MediaEngine::start_audio_stream(MediaSession* session, const char *cname, c
 #endif
 		}
 
-		if (session != mData->curSession) {
+		if (session->conference) {
+			ms_message("Session is part of a conference, not using soundcard.");
+			captcard=playcard=NULL;
+		} else if (session->relay_peer) {
+			ms_message("Session is relayed, not using soundcard.");
+			captcard=playcard=NULL;
+		} else if (session != mData->curSession) {
 			ms_message("Sound resources are used by another call, not using soundcard.");
 #if defined(ANDROID)
 			__android_log_write(ANDROID_LOG_DEBUG, "*ME_N*", "Sound resources are used by another call, not using soundcards!");
@@ -726,7 +1048,15 @@ void MediaEngine::start_audio_stream(MediaSession* session, const char *cname, c
 
 		audio_stream_enable_adaptive_bitrate_control(session->as->audiostream, use_arc);
 		audio_stream_enable_adaptive_jittcomp(session->as->audiostream, is_audio_adaptive_jittcomp_enabled());
-		int result = audio_stream_start_now(
+		int result;
+		if (session->relay_peer) {
+			// payloads are forwarded to the peer leg without being decoded
+			result = audio_stream_start_relay(
+				session->as->audiostream,
+				session->audio_profile, remIp, remport, remIp, remport+1,
+				used_pt);
+		} else {
+			result = audio_stream_start_now(
 				session->as->audiostream,
 				session->audio_profile, remIp, remport, remport+1,
 				used_pt,
@@ -734,6 +1064,7 @@ void MediaEngine::start_audio_stream(MediaSession* session, const char *cname, c
 				playcard,
 				captcard,
 				use_ec);
+		}
 
 #if defined(ANDROID)
 		char buf[256];
@@ -762,6 +1093,13 @@ void MediaEngine::start_audio_stream(MediaSession* session, const char *cname, c
 		}
 
 		session->state = ME_SESSION_AUDIO_STREAMING;
+
+		if (session->conference) {
+			plug_to_conference(session);
+		}
+		if (session->relay_peer) {
+			link_relay_peer(session);
+		}
 	} else if (!session->audio_profile){
 #if defined(ANDROID)
 		__android_log_write(ANDROID_LOG_DEBUG, "*ME_N*", "*** No RTP profile ***");
@@ -774,7 +1112,17 @@ void MediaEngine::start_audio_stream(MediaSession* session, const char *cname, c
 }
 
 void MediaEngine::stop_audio_stream(MediaSession *session) {
-	if (session->as->audiostream != NULL) {
+	AudioStream *stream = detach_audio_stream(session);
+	if (stream != NULL) {
+		audio_stream_stop(stream);
+	}
+}
+
+// Takes the audio stream out of the session, out of its conference and away from its relay peer, and returns it
+// still running, for audio_stream_stop().
+AudioStream* MediaEngine::detach_audio_stream(MediaSession *session) {
+	AudioStream *stream = session->as->audiostream;
+	if (stream != NULL) {
 		rtp_session_unregister_event_queue(session->as->audiostream->ms.session, session->audiostream_app_evq);
 		ortp_ev_queue_flush(session->audiostream_app_evq);
 		ortp_ev_queue_destroy(session->audiostream_app_evq);
@@ -791,10 +1139,13 @@ void MediaEngine::stop_audio_stream(MediaSession *session) {
 			}
 		}
 
-		audio_stream_stop(session->as->audiostream);
+		unplug_from_conference(session);
+		unlink_relay_peer(session);
+
 		session->as->audiostream=NULL;
 		//TODO clean up as
 	}
+	return stream;
 }
 
 void MediaEngine::pause_audio_stream(MediaSession* session) {
@@ -809,6 +1160,45 @@ void MediaEngine::resume_audio_stream(MediaSession* session) {
 	}
 }
 
+void MediaEngine::plug_to_conference(MediaSession* session) {
+	if (session->conf_endpoint != NULL || session->as->audiostream == NULL) return;
+	/* the stream's graph is cut and its rtp side moved onto the conference ticker */
+	session->conf_endpoint = ms_audio_endpoint_get_from_stream(session->as->audiostream, TRUE);
+	ms_audio_conference_add_member(session->conference->conf, session->conf_endpoint);
+	ms_message("Session %p joined conference %p, now %i members", session, session->conference,
+		ms_audio_conference_get_size(session->conference->conf));
+}
+
+void MediaEngine::unplug_from_conference(MediaSession* session) {
+	if (session->conf_endpoint == NULL) return;
+	ms_audio_conference_remove_member(session->conference->conf, session->conf_endpoint);
+	ms_audio_endpoint_release_from_stream(session->conf_endpoint);
+	session->conf_endpoint = NULL;
+}
+
+void MediaEngine::link_relay_peer(MediaSession* session) {
+	MediaSession *peer = session->relay_peer;
+
+	if (peer->state != ME_SESSION_AUDIO_STREAMING || peer->as->audiostream == NULL) return; // linked when the peer starts
+	if (strcasecmp(session->audioSendCodec->mime_type, peer->audioSendCodec->mime_type) != 0
+		|| session->audioSendCodec->clock_rate != peer->audioSendCodec->clock_rate) {
+		ms_error("Cannot relay %s/%i to %s/%i, both legs must use the same codec",
+			session->audioSendCodec->mime_type, session->audioSendCodec->clock_rate,
+			peer->audioSendCodec->mime_type, peer->audioSendCodec->clock_rate);
+		return;
+	}
+	audio_stream_relay_link(session->as->audiostream, peer->as->audiostream);
+	ms_message("Relaying sessions %p and %p", session, peer);
+}
+
+void MediaEngine::unlink_relay_peer(MediaSession* session) {
+	MediaSession *peer = session->relay_peer;
+
+	if (peer == NULL || peer->as->audiostream == NULL || session->as->audiostream == NULL) return;
+	if (peer->as->audiostream->relay_sink == NULL || session->as->audiostream->relay_sink == NULL) return;
+	audio_stream_relay_unlink(session->as->audiostream, peer->as->audiostream);
+}
+
 void MediaEngine::stop_media_streams(MediaSession *session)
 {
 	if (session->state == ME_SESSION_AUDIO_STREAMING) {
@@ -965,8 +1355,77 @@ void MediaEngine::handle_static_payloads() {
 	}
 }
 
+static unsigned int codec_hash(const char *mime, int clock_rate) {
+	unsigned int h = 2166136261u;	// FNV-1a, mime types compare case insensitively
+	for (; *mime != '\0'; mime++)
+		h = (h ^ (unsigned char)tolower(*mime)) * 16777619u;
+	return (h ^ (unsigned int)clock_rate) * 16777619u;
+}
+
+void MediaEngine::build_codec_registry() {
+	codec_registry_t *reg = &mData->codec_registry;
+	MSList *elem;
+	int i, size;
+
+	memset(reg, 0, sizeof(*reg));
+	for (i = 0; i < RTP_PROFILE_MAX_PAYLOADS; i++)
+		reg->by_number[i] = -1;
+	reg->count = ms_list_size(mData->payload_types);
+	if (reg->count == 0)
+		return;
+	// at most half full
+	for (size = 16; size < 2 * reg->count; size *= 2);
+	reg->by_name_mask = size - 1;
+	reg->codecs = ms_new(PayloadType*, reg->count);
+	reg->next_same_number = ms_new(int, reg->count);
+	reg->by_name = ms_new(int, size);
+	memset(reg->by_name, -1, size * sizeof(int));
+
+	for (i = 0, elem = mData->payload_types; elem != NULL; elem = elem->next, i++) {
+		PayloadType *pt = (PayloadType*)elem->data;
+		int number = payload_type_get_number(pt);
+		int *last = (number >= 0 && number < RTP_PROFILE_MAX_PAYLOADS) ? &reg->by_number[number] : NULL;
+		unsigned int h;
+
+		reg->codecs[i] = pt;
+		reg->next_same_number[i] = -1;
+		// keep the assignment order among the codecs sharing a number, the first one wins lookups by number
+		while (last != NULL && *last != -1)
+			last = &reg->next_same_number[*last];
+		if (last != NULL)
+			*last = i;
+		// codecs with the same mime type and clock rate are probed in assignment order too
+		for (h = codec_hash(pt->mime_type, pt->clock_rate) & reg->by_name_mask; reg->by_name[h] != -1;
+			h = (h + 1) & reg->by_name_mask);
+		reg->by_name[h] = i;
+	}
+}
+
+// Finds a codec by mime type and clock rate, and by number of channels when both are known, like rtp_profile_find_payload()
+PayloadType* MediaEngine::find_codec(const char *mime, int clock_rate, int channels) const {
+	const codec_registry_t *reg = &mData->codec_registry;
+	unsigned int h;
+
+	if (reg->count == 0)
+		return NULL;
+	for (h = codec_hash(mime, clock_rate) & reg->by_name_mask; reg->by_name[h] != -1; h = (h + 1) & reg->by_name_mask) {
+		PayloadType *pt = reg->codecs[reg->by_name[h]];
+		if (pt->clock_rate == clock_rate && strcasecmp(pt->mime_type, mime) == 0
+			&& (pt->channels == channels || channels <= 0 || pt->channels <= 0))
+			return pt;
+	}
+	return NULL;
+}
+
 void MediaEngine::free_payload_types() {
 	if (mData) {
+		codec_registry_t *reg = &mData->codec_registry;
+		if (reg->count > 0) {
+			ms_free(reg->codecs);
+			ms_free(reg->next_same_number);
+			ms_free(reg->by_name);
+		}
+		memset(reg, 0, sizeof(*reg));
 		rtp_profile_clear_all(mData->default_profile);
 		rtp_profile_destroy(mData->default_profile);
 		ms_list_for_each(mData->payload_types,(void (*)(void*))payload_type_destroy);
@@ -981,6 +1440,49 @@ void MediaEngine::init_sound()
 	const char *tmpbuf;
 	const char *devid;
 
+	// the sound cards are detected and selected when the first call needs them, see select_sound_cards()
+	mData->sound_conf.cards_selected = FALSE;
+
+	if (ENABLE_ECHO_CANCELLATION == 0) {
+		mData->sound_conf.ec = FALSE;
+	} else {
+#if defined(ANDROID)
+		__android_log_write(ANDROID_LOG_INFO, "*ME_N*", "*** Echo Cancellation  is ON ***");
+#endif
+		mData->sound_conf.ec = TRUE;
+	}
+
+	if (ENABLE_ECHO_LIMITER == 0) {
+		mData->sound_conf.ea = FALSE;
+	} else {
+		mData->sound_conf.ea = TRUE;
+	}
+
+	mData->sound_conf.latency=0;
+
+	if (ENABLE_AGC == 0) {
+		mData->sound_conf.agc = FALSE;
+	} else {
+		mData->sound_conf.agc = TRUE;
+	}
+
+	if (ENABLE_NOISE_GATE == 0) {
+		mData->sound_conf.ng = FALSE;
+	} else {
+		mData->sound_conf.ng = TRUE;
+	}
+
+	mData->sound_conf.soft_mic_lev = DEFAULT_MIC_GAIN; //
+	mData->sound_conf.soft_play_lev = DEFAULT_PLAYBACK_GAIN; //
+}
+
+// Looks up the sound cards, which detects them: slow on some devices, it is left out of Initialize()
+void MediaEngine::select_sound_cards()
+{
+	if (mData->sound_conf.cards_selected)
+		return;
+	mData->sound_conf.cards_selected = TRUE;
+
 	// retrieve all sound devices
 	build_sound_devices_table();
 
@@ -1021,43 +1523,14 @@ void MediaEngine::init_sound()
 #endif
         ms_message("Card '%s' selected for playout", mData->sound_conf.play_sndcard->name);
     }
-
-	if (ENABLE_ECHO_CANCELLATION == 0) {
-		mData->sound_conf.ec = FALSE;
-	} else {
-#if defined(ANDROID)
-		__android_log_write(ANDROID_LOG_INFO, "*ME_N*", "*** Echo Cancellation  is ON ***");
-#endif
-		mData->sound_conf.ec = TRUE;
-	}
-
-	if (ENABLE_ECHO_LIMITER == 0) {
-		mData->sound_conf.ea = FALSE;
-	} else {
-		mData->sound_conf.ea = TRUE;
-	}
-
-	mData->sound_conf.latency=0;
-
-	if (ENABLE_AGC == 0) {
-		mData->sound_conf.agc = FALSE;
-	} else {
-		mData->sound_conf.agc = TRUE;
-	}
-
-	if (ENABLE_NOISE_GATE == 0) {
-		mData->sound_conf.ng = FALSE;
-	} else {
-		mData->sound_conf.ng = TRUE;
-	}
-
-	mData->sound_conf.soft_mic_lev = DEFAULT_MIC_GAIN; //
-	mData->sound_conf.soft_play_lev = DEFAULT_PLAYBACK_GAIN; //
 }
 
 void MediaEngine::uninit_sound()
 {
-	ms_free(mData->sound_conf.cards);
+	if (mData->sound_conf.cards != NULL)
+		ms_free(mData->sound_conf.cards);
+	mData->sound_conf.cards = NULL;
+	mData->sound_conf.cards_selected = FALSE;
 
 	ms_snd_card_manager_destroy();
 }
@@ -1108,6 +1581,7 @@ void MediaEngine::set_play_level(int level) {
 	if (mData) {
 		MSSndCard *sndcard;
 		mData->sound_conf.play_lev = level;
+		select_sound_cards();
 		sndcard=mData->sound_conf.play_sndcard;
 		if (sndcard)
 			ms_snd_card_set_level(sndcard,MS_SND_CARD_PLAYBACK,level);
@@ -1122,39 +1596,495 @@ void MediaEngine::set_rec_level(int level) {
 	if (mData) {
 		MSSndCard *sndcard;
 		mData->sound_conf.rec_lev=level;
+		select_sound_cards();
 		sndcard=mData->sound_conf.capt_sndcard;
 		if (sndcard)
 			ms_snd_card_set_level(sndcard, MS_SND_CARD_CAPTURE,level);
 	}
 }
 
+void MediaEngine::init_session_registry() {
+	session_registry_t *reg = &mData->session_registry;
+
+	memset(reg, 0, sizeof(*reg));
+	reg->first_free = -1;
+	resize_session_registry(mData->max_calls);
+}
+
+void MediaEngine::uninit_session_registry() {
+	session_registry_t *reg = &mData->session_registry;
+
+	if (reg->slots) ms_free(reg->slots);
+	if (reg->generations) ms_free(reg->generations);
+	if (reg->next_free) ms_free(reg->next_free);
+	memset(reg, 0, sizeof(*reg));
+	reg->first_free = -1;
+}
+
+// Grows the registry to capacity slots, the sessions keep theirs. It never shrinks, max_calls limits the sessions.
+int MediaEngine::resize_session_registry(int capacity) {
+	session_registry_t *reg = &mData->session_registry;
+	MediaSession **slots;
+	unsigned short *generations;
+	int *next_free;
+	int i;
+
+	if (capacity <= reg->capacity) return 0;
+	slots = (MediaSession **)ms_realloc(reg->slots, capacity * sizeof(MediaSession*));
+	if (slots == NULL) return -1;
+	reg->slots = slots;
+	generations = (unsigned short *)ms_realloc(reg->generations, capacity * sizeof(unsigned short));
+	if (generations == NULL) return -1;
+	reg->generations = generations;
+	next_free = (int *)ms_realloc(reg->next_free, capacity * sizeof(int));
+	if (next_free == NULL) return -1;
+	reg->next_free = next_free;
+	// the new slots are taken in order, after the free ones
+	for (i = capacity - 1; i >= reg->capacity; i--) {
+		reg->slots[i] = NULL;
+		reg->generations[i] = 1;
+		reg->next_free[i] = (i == capacity - 1) ? -1 : i + 1;
+	}
+	if (reg->capacity == 0 || reg->first_free == -1) {
+		reg->first_free = reg->capacity;
+	} else {
+		for (i = reg->first_free; reg->next_free[i] != -1; i = reg->next_free[i]);
+		reg->next_free[i] = reg->capacity;
+	}
+	reg->capacity = capacity;
+	return 0;
+}
+
+MediaEngine::MediaSession* MediaEngine::FindSession(ME_SessionHandle handle) {
+	MediaSession *session;
+
+	ms_mutex_lock(&mData->mutex);
+	session = registry_find(&mData->session_registry, handle);
+	ms_mutex_unlock(&mData->mutex);
+	return session;
+}
+
+int MediaEngine::GetSessionCount() {
+	int count;
+
+	ms_mutex_lock(&mData->mutex);
+	count = mData->session_registry.count;
+	ms_mutex_unlock(&mData->mutex);
+	return count;
+}
+
+void MediaEngine::GetRtpPortStats(ME_RtpPortStats *stats) {
+	rtp_port_pool_t *pool = &mData->port_pool;
+	int slot;
+
+	memset(stats, 0, sizeof(*stats));
+	ms_mutex_lock(&mData->mutex);
+	for (slot = 0; slot < pool->nslots; slot++) {
+		switch (pool->state[slot]) {
+			case RTP_PORT_FREE:		stats->free++;		break;
+			case RTP_PORT_BINDING:	stats->binding++;	break;
+			case RTP_PORT_WARM:		stats->warm++;		break;
+			case RTP_PORT_USED:		stats->used++;		break;
+		}
+	}
+	ms_mutex_unlock(&mData->mutex);
+}
+
+// Called with the engine locked
 int MediaEngine::add_session(MediaSession* session)
 {
-	//TODO lock engine
-	mData->sessions = ms_list_append(mData->sessions, session);
+	session_registry_t *reg = &mData->session_registry;
+	int slot = reg->first_free;
+
+	if (slot == -1) return -1;
+	reg->first_free = reg->next_free[slot];
+	reg->slots[slot] = session;
+	reg->count++;
+	session->handle = ((ME_SessionHandle)reg->generations[slot] << ME_SESSION_SLOT_BITS) | slot;
 	return 0;
 }
 
+// Called with the engine locked
 int MediaEngine::delete_session(MediaSession* session)
 {
-	//TODO lock engine
-	MSList* it;
-	MSList* sessions = mData->sessions;
+	session_registry_t *reg = &mData->session_registry;
+	int slot = session->handle & ME_SESSION_SLOT_MASK;
 
-	it = ms_list_find(mData->sessions, session);
-	if (it)
-	{
-		sessions = ms_list_remove_link(mData->sessions, it);
-	}
-	else
+	if (registry_find(reg, session->handle) != session)
 	{
-		ms_warning("could not find the media session into the list\n");
+		ms_warning("could not find the media session into the registry\n");
 		return -1;
 	}
-	mData->sessions = sessions;
+	reg->slots[slot] = NULL;
+	// the handle of this session no longer matches, generation 0 is never used so that no handle is 0
+	if (++reg->generations[slot] == 0) reg->generations[slot] = 1;
+	reg->next_free[slot] = reg->first_free;
+	reg->first_free = slot;
+	reg->count--;
+	session->handle = ME_INVALID_SESSION_HANDLE;
 	return 0;
 }
 
+// Removes a session whose audio stream is stopped from the engine and frees it. Called with the engine locked.
+void MediaEngine::free_session(MediaSession* session)
+{
+	// its sockets are closed now, the port pair can go back to the pool
+	if (session->audio_port_pooled) release_rtp_port(session->audio_port);
+	session->audio_port = 0;
+	session->audio_port_pooled = FALSE;
+
+	if (session == mData->curSession) {
+		mData->curSession = NULL;
+	}
+
+	if (session->conference) {
+		session->conference->members = ms_list_remove(session->conference->members, session);
+		session->conference = NULL;
+	}
+
+	if (session->relay_peer) {
+		session->relay_peer->relay_peer = NULL;
+		session->relay_peer = NULL;
+	}
+
+	delete_session(session);
+
+	if (session->audio_profile) {
+		rtp_profile_clear_all(session->audio_profile);
+		rtp_profile_destroy(session->audio_profile);
+		session->audio_profile = NULL;
+	}
+	if (session->audioRecvCodecs) {
+		ms_free(session->audioRecvCodecs);
+		session->audioRecvCodecs = NULL;
+	}
+	ms_free(session->as);
+	ms_free(session);
+}
+
+typedef struct _ME_Teardown {
+	AudioStream **streams;
+	int count;
+	int next;	// next stream to stop
+	ms_mutex_t lock;
+} ME_Teardown;
+
+static void* stop_audio_streams(void *data) {
+	ME_Teardown *teardown = (ME_Teardown *)data;
+
+	for (;;) {
+		int i;
+		ms_mutex_lock(&teardown->lock);
+		i = teardown->next++;
+		ms_mutex_unlock(&teardown->lock);
+		if (i >= teardown->count) break;
+		audio_stream_stop(teardown->streams[i]);
+	}
+	return NULL;
+}
+
+// Deletes all the sessions at once. Their streams are detached under the lock, then stopped by
+// TEARDOWN_THREADS threads at the same time since each stop waits for the stream's ticker to exit.
+void MediaEngine::delete_all_sessions() {
+	session_registry_t *reg = &mData->session_registry;
+	ms_thread_t threads[TEARDOWN_THREADS];
+	ME_Teardown teardown;
+	int nthreads = 0;
+	int i;
+
+	ms_mutex_lock(&mData->mutex);
+	if (reg->count == 0) {
+		ms_mutex_unlock(&mData->mutex);
+		return;
+	}
+	memset(&teardown, 0, sizeof(teardown));
+	teardown.streams = ms_new0(AudioStream*, reg->count);
+	for (i = 0; i < reg->capacity; i++) {
+		MediaSession *session = reg->slots[i];
+		if (session == NULL) continue;
+		session->state = ME_SESSION_TERMINATING;
+		if (session->as->audiostream != NULL)
+			teardown.streams[teardown.count++] = detach_audio_stream(session);
+	}
+	ms_mutex_unlock(&mData->mutex);
+
+	ms_mutex_init(&teardown.lock, NULL);
+	// the calling thread takes its share too
+	while (nthreads < TEARDOWN_THREADS && nthreads + 1 < teardown.count) {
+		if (ms_thread_create(&threads[nthreads], NULL, stop_audio_streams, &teardown) != 0) break;
+		nthreads++;
+	}
+	stop_audio_streams(&teardown);
+	for (i = 0; i < nthreads; i++) {
+		ms_thread_join(threads[i], NULL);
+	}
+	ms_mutex_destroy(&teardown.lock);
+	ms_message("Stopped %i audio streams with %i threads", teardown.count, nthreads + 1);
+	ms_free(teardown.streams);
+
+	ms_mutex_lock(&mData->mutex);
+	ms_event_queue_skip(mData->msevq);
+	for (i = 0; i < reg->capacity; i++) {
+		if (reg->slots[i] != NULL) free_session(reg->slots[i]);
+	}
+	ms_mutex_unlock(&mData->mutex);
+}
+
+static void port_list_append(MediaEngine::rtp_port_pool_t *pool, MediaEngine::rtp_port_list_t *list, int slot) {
+	pool->prev[slot] = list->tail;
+	pool->next[slot] = -1;
+	if (list->tail != -1) pool->next[list->tail] = slot;
+	else list->head = slot;
+	list->tail = slot;
+	list->count++;
+}
+
+static void port_list_remove(MediaEngine::rtp_port_pool_t *pool, MediaEngine::rtp_port_list_t *list, int slot) {
+	if (pool->prev[slot] != -1) pool->next[pool->prev[slot]] = pool->next[slot];
+	else list->head = pool->next[slot];
+	if (pool->next[slot] != -1) pool->prev[pool->next[slot]] = pool->prev[slot];
+	else list->tail = pool->prev[slot];
+	list->count--;
+}
+
+static int port_list_pop(MediaEngine::rtp_port_pool_t *pool, MediaEngine::rtp_port_list_t *list) {
+	int slot = list->head;
+	if (slot != -1) port_list_remove(pool, list, slot);
+	return slot;
+}
+
+static RtpSession* bind_rtp_session(int port) {
+	RtpSession *rtps = ms_create_duplex_rtp_session(port, port+1, FALSE); //no IPv6 support
+	if (rtp_session_get_rtp_socket(rtps) == (ortp_socket_t)-1 || rtp_session_get_rtcp_socket(rtps) == (ortp_socket_t)-1) {
+		ms_warning("Could not bind RTP port pair %i/%i", port, port+1);
+		rtp_session_destroy(rtps);
+		return NULL;
+	}
+	return rtps;
+}
+
+void MediaEngine::init_port_pool() {
+	rtp_port_pool_t *pool = &mData->port_pool;
+	int i;
+
+	memset(pool, 0, sizeof(*pool));
+	pool->free_slots.head = pool->free_slots.tail = -1;
+	pool->warm_slots.head = pool->warm_slots.tail = -1;
+	// RTP on the even port, RTCP on the next one
+	pool->first_port = (mData->rtp_conf.audio_rtp_min_port + 1) & ~1;
+	pool->nslots = (mData->rtp_conf.audio_rtp_max_port - pool->first_port + 1) / 2;
+	if (pool->nslots <= 0) {
+		ms_warning("Empty RTP port range [%i-%i], ports are bound on demand", mData->rtp_conf.audio_rtp_min_port,
+			mData->rtp_conf.audio_rtp_max_port);
+		pool->nslots = 0;
+		return;
+	}
+	ms_cond_init(&pool->bound_cond, NULL);
+	pool->state = (char *)ms_new0(char, pool->nslots);
+	pool->prev = ms_new(int, pool->nslots);
+	pool->next = ms_new(int, pool->nslots);
+	pool->warm = ms_new0(RtpSession*, pool->nslots);
+	for (i = 0; i < pool->nslots; i++) {
+		port_list_append(pool, &pool->free_slots, i);
+	}
+}
+
+void MediaEngine::uninit_port_pool() {
+	rtp_port_pool_t *pool = &mData->port_pool;
+	int slot;
+
+	if (pool->nslots == 0) return;
+	while ((slot = port_list_pop(pool, &pool->warm_slots)) != -1) {
+		rtp_session_destroy(pool->warm[slot]);
+	}
+	ms_free(pool->state);
+	ms_free(pool->prev);
+	ms_free(pool->next);
+	ms_free(pool->warm);
+	ms_cond_destroy(&pool->bound_cond);
+	memset(pool, 0, sizeof(*pool));
+}
+
+// Binds sessions on free pairs until count of them are warm. Called out of call setup, binding is done unlocked.
+void MediaEngine::warm_rtp_sessions(int count) {
+	rtp_port_pool_t *pool = &mData->port_pool;
+	int attempts;
+	int failures = 0;
+
+	ms_mutex_lock(&mData->mutex);
+	attempts = pool->free_slots.count;
+	while (pool->nslots > 0 && attempts-- > 0 && failures < RTP_WARM_BIND_FAILURES && pool->warm_slots.count < count) {
+		int slot = port_list_pop(pool, &pool->free_slots);
+		RtpSession *rtps;
+
+		if (slot == -1) break;
+		pool->state[slot] = RTP_PORT_BINDING;
+		ms_mutex_unlock(&mData->mutex);
+		rtps = bind_rtp_session(pool->first_port + 2*slot);
+		ms_mutex_lock(&mData->mutex);
+		if (pool->nslots == 0) {
+			// the pool went away meanwhile
+			if (rtps) rtp_session_destroy(rtps);
+			break;
+		}
+		// a call may be waiting for this very pair
+		ms_cond_broadcast(&pool->bound_cond);
+		if (rtps) {
+			pool->state[slot] = RTP_PORT_WARM;
+			pool->warm[slot] = rtps;
+			port_list_append(pool, &pool->warm_slots, slot);
+		} else {
+			// probably used by another process, try again later
+			failures++;
+			pool->state[slot] = RTP_PORT_FREE;
+			port_list_append(pool, &pool->free_slots, slot);
+		}
+	}
+	ms_mutex_unlock(&mData->mutex);
+}
+
+void* MediaEngine::warm_rtp_thread(void *data) {
+	MediaEngine *engine = (MediaEngine *)data;
+	ME_PrivData *d = engine->mData;
+
+	ms_mutex_lock(&d->mutex);
+	while (d->warm_running) {
+		if (!d->warm_pending) {
+			ms_cond_wait(&d->warm_cond, &d->mutex);
+			continue;
+		}
+		d->warm_pending = FALSE;
+		ms_mutex_unlock(&d->mutex);
+		engine->warm_rtp_sessions(d->max_calls);
+		ms_mutex_lock(&d->mutex);
+	}
+	ms_mutex_unlock(&d->mutex);
+	return NULL;
+}
+
+void MediaEngine::start_warm_thread() {
+	ms_cond_init(&mData->warm_cond, NULL);
+	mData->warm_pending = FALSE;
+	mData->warm_running = TRUE;
+	if (ms_thread_create(&mData->warm_thread, NULL, warm_rtp_thread, this) != 0) {
+		ms_warning("Cannot start the RTP sessions thread, sessions are bound by the calls");
+		mData->warm_running = FALSE;
+		ms_cond_destroy(&mData->warm_cond);
+	}
+}
+
+void MediaEngine::stop_warm_thread() {
+	ms_mutex_lock(&mData->mutex);
+	if (!mData->warm_running) {
+		ms_mutex_unlock(&mData->mutex);
+		return;
+	}
+	mData->warm_running = FALSE;
+	ms_cond_signal(&mData->warm_cond);
+	ms_mutex_unlock(&mData->mutex);
+	ms_thread_join(mData->warm_thread, NULL);
+	ms_cond_destroy(&mData->warm_cond);
+}
+
+// Has the warm sessions topped up in the background, the caller does not wait for the ports to be bound.
+void MediaEngine::schedule_warm_rtp_sessions() {
+	ms_mutex_lock(&mData->mutex);
+	if (mData->warm_running) {
+		mData->warm_pending = TRUE;
+		ms_cond_signal(&mData->warm_cond);
+	}
+	ms_mutex_unlock(&mData->mutex);
+}
+
+// Returns a session of the pool bound to the requested port pair, or to any pair if *port is not positive,
+// and sets *port. Called unlocked: the engine is locked to pick a pair, not while its ports are bound.
+// Returns NULL when the port is out of the pool's range, used by another call or cannot be bound,
+// or when no pair is left.
+RtpSession* MediaEngine::take_rtp_session(int *port) {
+	rtp_port_pool_t *pool = &mData->port_pool;
+	RtpSession *rtps = NULL;
+	int failures = 0;
+	int slot;
+
+	ms_mutex_lock(&mData->mutex);
+	while (rtps == NULL && pool->nslots > 0) {
+		if (*port <= 0) {
+			slot = port_list_pop(pool, &pool->warm_slots);
+			if (slot == -1 && failures < RTP_WARM_BIND_FAILURES) slot = port_list_pop(pool, &pool->free_slots);
+			if (slot == -1) {
+				ms_warning("No RTP port pair can be taken in [%i-%i]", mData->rtp_conf.audio_rtp_min_port, mData->rtp_conf.audio_rtp_max_port);
+				break;
+			}
+		} else {
+			if (*port < pool->first_port || ((*port - pool->first_port) & 1) || (*port - pool->first_port) / 2 >= pool->nslots)
+				break;
+			slot = (*port - pool->first_port) / 2;
+			if (pool->state[slot] == RTP_PORT_BINDING) {
+				// the warm thread or another call is binding this pair, wait for the outcome
+				ms_cond_wait(&pool->bound_cond, &mData->mutex);
+				continue;
+			}
+			if (pool->state[slot] == RTP_PORT_WARM) port_list_remove(pool, &pool->warm_slots, slot);
+			else if (pool->state[slot] == RTP_PORT_FREE) port_list_remove(pool, &pool->free_slots, slot);
+			else {
+				ms_warning("RTP port %i is already in use", *port);
+				break;
+			}
+		}
+
+		if (pool->state[slot] == RTP_PORT_WARM) {
+			rtps = pool->warm[slot];
+			pool->warm[slot] = NULL;
+		} else {
+			// no warm session left, bind one without holding the engine
+			pool->state[slot] = RTP_PORT_BINDING;
+			ms_mutex_unlock(&mData->mutex);
+			rtps = bind_rtp_session(pool->first_port + 2*slot);
+			ms_mutex_lock(&mData->mutex);
+			if (pool->nslots == 0) {
+				// the pool went away meanwhile
+				if (rtps) rtp_session_destroy(rtps);
+				rtps = NULL;
+				break;
+			}
+			ms_cond_broadcast(&pool->bound_cond);
+			if (rtps == NULL) {
+				pool->state[slot] = RTP_PORT_FREE;
+				port_list_append(pool, &pool->free_slots, slot);
+				failures++;
+				if (*port > 0) break;
+				continue;
+			}
+		}
+		pool->state[slot] = RTP_PORT_USED;
+		*port = pool->first_port + 2*slot;
+	}
+	ms_mutex_unlock(&mData->mutex);
+	return rtps;
+}
+
+// Gives back a session taken from the pool and not used, as a warm one. Called with the engine locked.
+void MediaEngine::return_rtp_session(int port, RtpSession *rtps) {
+	rtp_port_pool_t *pool = &mData->port_pool;
+	int slot = (port - pool->first_port) / 2;
+
+	pool->warm[slot] = rtps;
+	pool->state[slot] = RTP_PORT_WARM;
+	port_list_append(pool, &pool->warm_slots, slot);
+}
+
+// Gives back the pair of a stopped session, at the end of the free list so that it rests before being reused.
+void MediaEngine::release_rtp_port(int port) {
+	rtp_port_pool_t *pool = &mData->port_pool;
+	int slot;
+
+	if (pool->nslots == 0 || port < pool->first_port || ((port - pool->first_port) & 1)) return;
+	slot = (port - pool->first_port) / 2;
+	if (slot >= pool->nslots || pool->state[slot] != RTP_PORT_USED) return;
+	pool->state[slot] = RTP_PORT_FREE;
+	port_list_append(pool, &pool->free_slots, slot);
+}
+
 void MediaEngine::preempt_sound_resources() {
 	MediaSession* current_session = mData->curSession;
 	if(current_session != NULL) {
@@ -1317,14 +2247,7 @@ void MediaEngine::background_tasks(MediaSession *session, bool_t one_second_elap
 		while (session->audiostream_app_evq && (NULL != (ev=ortp_ev_queue_get(session->audiostream_app_evq)))){
 			OrtpEventType evt=ortp_event_get_type(ev);
 			OrtpEventData *evd=ortp_event_get_data(ev);
-			if (evt == ORTP_EVENT_RTCP_PACKET_RECEIVED) {
-				session->stats[MEDIA_TYPE_AUDIO].round_trip_delay = rtp_session_get_round_trip_propagation(session->as->audiostream->ms.session);
-				if(session->stats[MEDIA_TYPE_AUDIO].received_rtcp != NULL)
-					freemsg(session->stats[MEDIA_TYPE_AUDIO].received_rtcp);
-				session->stats[MEDIA_TYPE_AUDIO].received_rtcp = evd->packet;
-				evd->packet = NULL;
-
-			} else if (evt == ORTP_EVENT_RTCP_PACKET_EMITTED) {
+			if (evt == ORTP_EVENT_RTCP_PACKET_EMITTED) {
 				memcpy(&session->stats[MEDIA_TYPE_AUDIO].jitter_stats,
 						rtp_session_get_jitter_stats(session->as->audiostream->ms.session),
 						sizeof(jitter_stats_t));
@@ -1347,6 +2270,14 @@ void MediaEngine::background_tasks(MediaSession *session, bool_t one_second_elap
 
 			ortp_event_destroy(ev);
 		}
+#if !ENABLE_RTCP_EMITTED_EVENTS
+		memcpy(&session->stats[MEDIA_TYPE_AUDIO].jitter_stats,
+				rtp_session_get_jitter_stats(session->as->audiostream->ms.session),
+				sizeof(jitter_stats_t));
+#endif
+		rtp_session_get_rtcp_summary(session->as->audiostream->ms.session, &session->stats[MEDIA_TYPE_AUDIO].rtcp);
+		if (session->stats[MEDIA_TYPE_AUDIO].rtcp.rtt > 0)
+			session->stats[MEDIA_TYPE_AUDIO].round_trip_delay = session->stats[MEDIA_TYPE_AUDIO].rtcp.rtt;
 	}
 	if (session->state == ME_SESSION_AUDIO_STREAMING && one_second_elapsed && session->as->audiostream!=NULL && disconnect_timeout>0 )
 		disconnected = !audio_stream_alive(session->as->audiostream, disconnect_timeout);
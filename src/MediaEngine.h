@@ -3,6 +3,7 @@
 
 #include <mediastreamer2/mediastream.h>
 #include <mediastreamer2/mscommon.h>
+#include <mediastreamer2/msconference.h>
 #include <ortp/ortp_srtp.h>
 
 
@@ -11,6 +12,16 @@
 #define ME_MINOR_VER    (0)
 
 #define ME_MAX_NB_SESSIONS (8)
+#define ME_SESSION_SLOT_BITS (16)	// a session handle is its slot in the low bits and the slot's generation above
+#define ME_SESSION_SLOT_MASK ((1<<ME_SESSION_SLOT_BITS)-1)
+#define ME_INVALID_SESSION_HANDLE (0U)
+#define ME_CONF_SAMPLERATE (8000)
+
+#if defined(__GNUC__)
+#define ME_DEPRECATED __attribute__((deprecated))
+#else
+#define ME_DEPRECATED
+#endif
 
 #define ME_MUTEX 			ms_mutex_t
 #define ME_MUTEX_INIT  		ms_mutex_init
@@ -54,6 +65,12 @@ public:
 		ME_SESSION_TERMINATING
 	} ME_MediaSessionState;
 
+	/**
+	 * Identifies a session for as long as it exists: once the session is deleted, its handle is never given to
+	 * another one (until the 16 bits generation of its slot wraps), so FindSession() returns NULL for it.
+	**/
+	typedef unsigned int ME_SessionHandle;
+
 	typedef enum _ME_Echo_Supression {
 		ME_ECS_NONE,
 		ME_ECS_NORMAL,
@@ -70,7 +87,7 @@ public:
 	typedef struct _MediaStats {
 		int		type; /* Can be either MEDIA_TYPE_AUDIO or MEDIA_TYPE_VIDEO */
 		jitter_stats_t	jitter_stats; /* jitter buffer statistics, see oRTP documentation for details */
-		mblk_t*		received_rtcp; /* last RTCP packet received, as a mblk_t structure. See oRTP documentation for details how to extract information from it*/
+		rtcp_summary_t	rtcp; /* summary of the RTCP reports sent and received, including the XR VoIP metrics. See oRTP documentation for details */
 		mblk_t*		sent_rtcp;	/* last RTCP packet sent, as a mblk_t structure. See oRTP documentation for details how to extract information from it */
 		float		round_trip_delay; /* Round trip propagation time in seconds if known, -1 if unknown. */
 		float download_bandwidth; /* download bandwidth measurement of received stream, expressed in kbit/s, including IP/UDP/RTP headers */
@@ -79,6 +96,28 @@ public:
 		float local_loss_rate; /**<percentage of lost packet over last second*/
 	} MediaStats;
 
+	/**
+	 * Time spent in the steps of the last Initialize(), in milliseconds, see GetInitTimings().
+	**/
+	typedef struct _ME_InitTimings {
+		float codecs;			// registration of the codec plugins
+		float ortp;				// oRTP stack, arenas and payload types
+		float mediastreamer;	// ms_init()
+		float sound;			// sound configuration, the cards are detected when the first call needs them
+		float rtp_sessions;		// RTP port pool and warm sessions
+		float total;
+	} ME_InitTimings;
+
+	/**
+	 * Number of port pairs of the RTP port range in each state, see GetRtpPortStats().
+	**/
+	typedef struct _ME_RtpPortStats {
+		int free;
+		int binding;	// being bound out of the engine lock
+		int warm;		// bound ahead, waiting for a call
+		int used;
+	} ME_RtpPortStats;
+
 	typedef enum {
 		ME_StreamSendRecv,
 		ME_StreamSendOnly,
@@ -105,6 +144,8 @@ public:
 
 	}ME_AudioStream;
 
+	struct _MediaConference;
+
 	typedef struct _MediaSession
 	{
 		struct _RtpProfile *audio_profile;
@@ -112,6 +153,7 @@ public:
 		ME_MediaSessionState	state;
 		void* user_pointer;
 		int audio_port;
+		bool_t audio_port_pooled; //audio_port is a pair of the port pool, given back when the session is deleted
 
 		ME_AudioStream *as;
 		bool_t audiostream_encrypted;
@@ -132,18 +174,96 @@ public:
 
 		bool_t all_muted; /*this flag is set during early medias*/
 
+		struct _MediaConference *conference; /*conference this session takes part to, if any*/
+		MSAudioEndpoint *conf_endpoint; /*set while the audio stream is plugged into the conference mixer*/
+
+		struct _MediaSession *relay_peer; /*session whose payloads are forwarded as is to this one, and vice versa*/
+
+		ME_SessionHandle handle; /*slot and generation of the session in the engine's registry*/
+
 	} MediaSession;
 
+	/**
+	 * A MediaConference mixes the audio of its member sessions on a single ticker, without using any sound card.
+	 * Each member hears the sum of all the other ones.
+	**/
+	typedef struct _MediaConference
+	{
+		MSAudioConference *conf;
+		MSList *members; //MediaSession not owned
+		int samplerate;
+	} MediaConference;
+
 	typedef struct rtp_config
 	{
 		int audio_rtp_min_port;
 		int audio_rtp_max_port;
 		int audio_jitt_comp;  //jitter compensation
+		int audio_jitt_comp_min; //lowest jitter compensation reachable by the adaptive jitter buffer
+		int audio_jitt_comp_max; //highest jitter compensation reachable by the adaptive jitter buffer
+		int audio_jitt_percentile; //percentage of packets the adaptive jitter buffer shall deliver in time
 		int nortp_timeout;
 		bool_t rtp_no_xmit_on_audio_mute; // stop rtp xmit when audio muted
 		bool_t audio_adaptive_jitt_comp_enabled;
 	} rtp_config_t;
 
+	typedef struct rtp_port_list
+	{
+		int head;
+		int tail;
+		int count;
+	} rtp_port_list_t;
+
+	/**
+	 * The RTP/RTCP port pairs of rtp_conf's range. A pair is free, warm (a session is already bound to it
+	 * and waits for a call) or used by a call. It is binding while its ports are bound out of the engine lock,
+	 * bound_cond is broadcast when that is done. Free and warm pairs are kept in two doubly linked lists
+	 * threaded through the prev/next arrays, so that any pair is taken or given back in constant time.
+	**/
+	typedef struct rtp_port_pool
+	{
+		int first_port;
+		int nslots;		//pair i is first_port+2*i, first_port+2*i+1
+		char *state;
+		int *prev;
+		int *next;
+		struct _RtpSession **warm;	//session bound to each warm pair
+		rtp_port_list_t free_slots;
+		rtp_port_list_t warm_slots;
+		ms_cond_t bound_cond;
+	} rtp_port_pool_t;
+
+	/**
+	 * Index of the available codecs, built by Initialize() once all of them are assigned a number and left
+	 * unchanged until Uninitialize(), so that it is read without locking. It holds positions in codecs: by
+	 * number in by_number, chained through next_same_number, and by mime type and clock rate in the open
+	 * addressed by_name table. -1 stands for none.
+	**/
+	typedef struct codec_registry
+	{
+		int count;
+		PayloadType **codecs;	//payload_types, in order
+		int *next_same_number;
+		int by_number[RTP_PROFILE_MAX_PAYLOADS];
+		int *by_name;
+		int by_name_mask;		//size of by_name minus one, a power of two
+	} codec_registry_t;
+
+	/**
+	 * The open sessions, stored in the slot of their handle. Free slots are chained through next_free, and the
+	 * generation of a slot is bumped each time it is given back so that stale handles no longer match. The
+	 * slots are allocated for max_calls sessions and grow with SetMaxSessions().
+	**/
+	typedef struct session_registry
+	{
+		int capacity;
+		int count;
+		MediaSession **slots;
+		unsigned short *generations;
+		int *next_free;
+		int first_free;		//-1 when all the slots are used
+	} session_registry_t;
+
 	typedef struct sound_config
 	{
 		struct _MSSndCard * play_sndcard;	// the playback sndcard currently used
@@ -160,6 +280,7 @@ public:
 		bool_t ea;		//echo limiter (AES)
 		bool_t ng; 		//noise gate
 		bool_t agc;		//automatic gain control
+		bool_t cards_selected;	//cards and play_sndcard/capt_sndcard are looked up by the first call
 	} sound_config_t;
 
 	typedef struct _ME_PrivData
@@ -167,12 +288,15 @@ public:
 		ME_state state;
 		RtpProfile *default_profile;
 		rtp_config_t rtp_conf;
+		rtp_port_pool_t port_pool;
 		sound_config_t sound_conf;
 		MSList *payload_types; // all available codecs
+		codec_registry_t codec_registry;
 		int dyn_pt;
 
 		MediaSession *curSession;   // the current media session
-		MSList *sessions;		 // all the active media session
+		session_registry_t session_registry;	 // all the active media sessions
+		MSList *conferences;	 // all the audio conferences
 
 		struct _MSEventQueue *msevq;
 
@@ -189,6 +313,15 @@ public:
 
 		char *echo_canceller_state_str;
 
+		ME_InitTimings init_timings;
+
+		MSFileRecAsyncParams recorder_async; // how the wav recorders of the sessions write to disk
+
+		ms_thread_t warm_thread;	// binds the warm sessions of the port pool out of the API calls
+		ms_cond_t warm_cond;
+		bool_t warm_running;
+		bool_t warm_pending;	// warm_thread has to top up the warm sessions
+
 		ms_mutex_t mutex; //ME lock
 
 	} ME_PrivData;
@@ -208,6 +341,8 @@ public:	// Public functions
 
 	bool_t isInitialized();
 
+	const ME_InitTimings* GetInitTimings() const;
+
 	virtual void Uninitialize();
 
 	virtual const char* EngineName() const;
@@ -224,8 +359,20 @@ public:	// Public functions
 
 	virtual MediaSession* CreateSession();
 
-	virtual int DeleteSession(MediaSession* session);
+	// -1 if the session of this handle was already deleted
+	virtual int DeleteSession(ME_SessionHandle handle);
+
+	// Deprecated: the pointer of a deleted session may be given to a new one, use the session's handle.
+	virtual int DeleteSession(MediaSession* session) ME_DEPRECATED;
+
+	// NULL if the session of this handle was deleted
+	virtual MediaSession* FindSession(ME_SessionHandle handle);
 
+	virtual int GetSessionCount();
+
+	virtual void GetRtpPortStats(ME_RtpPortStats *stats);
+
+	// a local_audio_port <= 0 takes a pre-bound port pair of rtp_conf's range
 	virtual void InitStreams(MediaSession* session, int local_audio_port, int local_video_port = -1);
 
 	virtual void StartStreams(MediaSession* session, PayloadType* sendAudioCodec, ME_List* recAudioCodecs, const char *cname, const char *remIp, const int remAudioPort, const int remVideoPort =-1, const bool_t sendAudio = TRUE, const char* audio_rcv_key=NULL);
@@ -246,10 +393,30 @@ public:	// Public functions
 
 	virtual void SetPlaybackGain(float gain);
 
+	virtual void SetMaxSessions(int max_sessions);
+
+	virtual void SetRecorderAsyncParams(const MSFileRecAsyncParams* params);
+
+	virtual void SetAsyncLogging(bool_t enable, int rate_limit = 0);
+
+	virtual MediaConference* CreateConference(int samplerate = ME_CONF_SAMPLERATE);
+
+	virtual int DeleteConference(MediaConference* conf);
+
+	virtual int AddToConference(MediaConference* conf, MediaSession* session);
+
+	virtual int RemoveFromConference(MediaSession* session);
+
+	virtual int RelaySessions(MediaSession* session, MediaSession* peer);
+
+	virtual int SetRelayTap(MediaSession* session, MSFilter* tap);
+
 private: // Private functions
 
 	void init_sound();
 
+	void select_sound_cards();
+
 	void uninit_sound();
 
 	void build_sound_devices_table();
@@ -260,6 +427,10 @@ private: // Private functions
 
 	void free_payload_types();
 
+	void build_codec_registry();
+
+	PayloadType* find_codec(const char *mime, int clock_rate, int channels) const;
+
 	void stop_media_streams(MediaSession* session);
 
 	void enable_echo_limiter(const MediaSession* session, bool_t val, bool_t isFull);
@@ -276,17 +447,44 @@ private: // Private functions
 
 	//Audio stream
 	void preempt_sound_resources();
-	void init_audio_stream(MediaSession* session, int local_port);
+	void init_audio_stream(MediaSession* session, int local_port, struct _RtpSession *rtps, bool_t pooled);
 	void start_audio_stream(MediaSession* session, const char *cname, const char *remIp, const int remport, bool_t muted, bool_t use_arc, bool_t sendAudio, const char* rcv_key);
 	void stop_audio_stream(MediaSession* session);
+	struct _AudioStream* detach_audio_stream(MediaSession* session);
 	void pause_audio_stream(MediaSession* session);
 	void resume_audio_stream(MediaSession* session);
 
+	//Audio conference
+	void plug_to_conference(MediaSession* session);
+	void unplug_from_conference(MediaSession* session);
+
+	//Relayed calls
+	void link_relay_peer(MediaSession* session);
+	void unlink_relay_peer(MediaSession* session);
+
 	// DTMF tone
 	void send_dtmf(const MediaSession* session, char dtmf);
 
+	//Session registry
+	void init_session_registry();
+	void uninit_session_registry();
+	int resize_session_registry(int capacity);
 	int add_session(MediaSession* session);
 	int delete_session(MediaSession* session);
+	void free_session(MediaSession* session);
+	void delete_all_sessions();
+
+	//RTP port pairs and pre-bound sessions
+	void init_port_pool();
+	void uninit_port_pool();
+	void warm_rtp_sessions(int count);
+	static void* warm_rtp_thread(void *data);
+	void start_warm_thread();
+	void stop_warm_thread();
+	void schedule_warm_rtp_sessions();
+	struct _RtpSession* take_rtp_session(int *port);
+	void return_rtp_session(int port, struct _RtpSession *rtps);
+	void release_rtp_port(int port);
 
 	//Voice play back (DTMF and ring tone optionally)
 	void set_play_level(int level);
@@ -27,6 +27,7 @@ LOCAL_SRC_FILES =       src/LP2LSPConversion.c \
                         src/postProcessing.c \
                         src/preProcessing.c \
                         src/qLSP2LP.c \
+                        src/simdKernels.c \
                         src/utils.c
 LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH)/include
@@ -33,4 +33,44 @@ void initLSPQuantization(bcg729EncoderChannelContextStruct *encoderChannelContex
 /*                                                                           */
 /*****************************************************************************/
 void LSPQuantization(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t LSPCoefficients[], word16_t qLSPCoefficients[], uint16_t parameters[]);
+
+/*** LSPQuantization steps, used separately by the multi channel encoder ***/
+/*****************************************************************************/
+/* computeLSPQuantizationTargets : first step of LSPQuantization: compute   */
+/*      the LSF weights and the vectors to be quantized                      */
+/*    parameters:                                                            */
+/*      -(i) encoderChannelContext : the channel context data                */
+/*      -(i) LSPCoefficients : 10 LSP coefficients in Q15                    */
+/*      -(o) weights : 10 weights in Q11 spec 3.2.4 eq22                     */
+/*      -(o) targetVector : for each MA Predictor, the 10 values vector to   */
+/*           be quantized in Q13 spec 3.2.4 eq23                             */
+/*                                                                           */
+/*****************************************************************************/
+void computeLSPQuantizationTargets(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t LSPCoefficients[], word16_t weights[], word16_t targetVector[][NB_LSP_COEFF]);
+
+/*****************************************************************************/
+/* searchLSPCodebooksMultiChannel : L1, L2 and L3 codebooks search for both  */
+/*      MA Predictors on all the lanes of a lanes context at once            */
+/*    parameters:                                                            */
+/*      -(i/o) encoderLanesContext : the lanes context data, input read from */
+/*             LSPWeights and LSPTargetVectors, output in L1index, L2index   */
+/*             and L3index                                                   */
+/*                                                                           */
+/*****************************************************************************/
+void searchLSPCodebooksMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext);
+
+/*****************************************************************************/
+/* selectLSPQuantization : last step of LSPQuantization: select the MA      */
+/*      Predictor, compute the qLSP and update the channel memory            */
+/*    parameters:                                                            */
+/*      -(i/o) encoderChannelContext : the channel context data              */
+/*      -(i) weights : 10 weights in Q11                                     */
+/*      -(i) targetVector : for each MA Predictor the vector to be quantized */
+/*      -(i) L1index, L2index, L3index : for each MA Predictor the codebooks */
+/*           entries found by the search                                     */
+/*      -(o) qLSPCoefficients : 10 qLSP coefficients in Q15                  */
+/*      -(o) parameters : 4 parameters L0, L1, L2, L3                        */
+/*                                                                           */
+/*****************************************************************************/
+void selectLSPQuantization(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t weights[], word16_t targetVector[][NB_LSP_COEFF], word16_t L1index[], word16_t L2index[], word16_t L3index[], word16_t qLSPCoefficients[], uint16_t parameters[]);
 #endif /* LSPQUANTIZATION_H */
@@ -22,6 +22,7 @@
 #define ENCODER_H
 #include <stdint.h>
 typedef struct bcg729EncoderChannelContextStruct_struct bcg729EncoderChannelContextStruct;
+typedef struct bcg729EncoderMultiChannelContextStruct_struct bcg729EncoderMultiChannelContextStruct;
 
 /*****************************************************************************/
 /* initBcg729EncoderChannel : create context structure and initialise it     */
@@ -49,4 +50,44 @@ __attribute__ ((visibility ("default"))) void closeBcg729EncoderChannel(bcg729En
 /*                                                                           */
 /*****************************************************************************/
 __attribute__ ((visibility ("default"))) void bcg729Encoder(bcg729EncoderChannelContextStruct *encoderChannelContext, int16_t inputFrame[], uint8_t bitStream[]);
+
+/*** Multi channel API: encode the same frame index on a batch of channels in one call ***/
+/*****************************************************************************/
+/* initBcg729EncoderMultiChannel : create a batch of encoder channels        */
+/*    parameters:                                                            */
+/*      -(i) nbChannels : number of channels in the batch                    */
+/*    return value :                                                         */
+/*      - the batch context data, NULL on allocation failure                */
+/*                                                                           */
+/*****************************************************************************/
+__attribute__ ((visibility ("default"))) bcg729EncoderMultiChannelContextStruct *initBcg729EncoderMultiChannel(int nbChannels);
+
+/*****************************************************************************/
+/* closeBcg729EncoderMultiChannel : free memory of a batch context           */
+/*    parameters:                                                            */
+/*      -(i) encoderMultiChannelContext : the batch context data             */
+/*                                                                           */
+/*****************************************************************************/
+__attribute__ ((visibility ("default"))) void closeBcg729EncoderMultiChannel(bcg729EncoderMultiChannelContextStruct *encoderMultiChannelContext);
+
+/*****************************************************************************/
+/* resetBcg729EncoderMultiChannel : reset one channel of a batch so it can   */
+/*      be reused for a new stream                                           */
+/*    parameters:                                                            */
+/*      -(i/o) encoderMultiChannelContext : the batch context data           */
+/*      -(i) channel : index of the channel in [0, nbChannels[               */
+/*                                                                           */
+/*****************************************************************************/
+__attribute__ ((visibility ("default"))) void resetBcg729EncoderMultiChannel(bcg729EncoderMultiChannelContextStruct *encoderMultiChannelContext, int channel);
+
+/*****************************************************************************/
+/* bcg729EncoderMultiChannel :                                               */
+/*    parameters:                                                            */
+/*      -(i/o) encoderMultiChannelContext : the batch context data           */
+/*      -(i) inputFrames : nbChannels*80 samples (16 bits PCM), the 80       */
+/*           samples of channel 0 followed by the ones of channel 1...       */
+/*      -(o) bitStreams : nbChannels*80 bits, 10 bytes per channel           */
+/*                                                                           */
+/*****************************************************************************/
+__attribute__ ((visibility ("default"))) void bcg729EncoderMultiChannel(bcg729EncoderMultiChannelContextStruct *encoderMultiChannelContext, int16_t inputFrames[], uint8_t bitStreams[]);
 #endif /* ifndef ENCODER_H */
@@ -29,4 +29,26 @@
 /*                                                                           */
 /*****************************************************************************/
 void computeLP(word16_t signal[], word16_t LPCoefficientsQ12[]);
+
+/*****************************************************************************/
+/* autoCorrelation2LP : As described in spec 3.2.1 and 3.2.2 : lag window   */
+/*      and Levinson-Durbin algorithm, second half of computeLP              */
+/*    parameters:                                                            */
+/*      -(i) autoCorrelationCoefficients: r[0..10] in Q0 on 64 bits, when    */
+/*           r[0] fits on 32 bits, only the lower 32 bits of r[1..10] are    */
+/*           used                                                            */
+/*      -(o) LPCoefficientsQ12: 10 LP coefficients in Q12                    */
+/*                                                                           */
+/*****************************************************************************/
+void autoCorrelation2LP(word64_t autoCorrelationCoefficients[], word16_t LPCoefficientsQ12[]);
+
+/*****************************************************************************/
+/* computeAutoCorrelationMultiChannel : Windowing and Autocorrelation of     */
+/*      computeLP on all the lanes of a lanes context at once                */
+/*    parameters:                                                            */
+/*      -(i/o) encoderLanesContext : the lanes context data, input read from */
+/*             signalBuffer, output in autoCorrelationCoefficients           */
+/*                                                                           */
+/*****************************************************************************/
+void computeAutoCorrelationMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext);
 #endif /* ifndef COMPUTELP_H */
@@ -34,4 +34,15 @@
 /*                                                                           */
 /*****************************************************************************/
 void computeWeightedSpeech(word16_t inputSignal[], word16_t qLPCoefficients[], word16_t weightedqLPCoefficients[], word16_t weightedInputSignal[], word16_t LPResidualSignal[]);
+/*****************************************************************************/
+/* computeWeightedSpeechMultiChannel : same as computeWeightedSpeech on all  */
+/*      the lanes of a lanes context at once                                 */
+/*    parameters:                                                            */
+/*      -(i/o) encoderLanesContext : the lanes context data, input read from */
+/*             the current frame of signalBuffer, qLPCoefficients and        */
+/*             weightedqLPCoefficients. Output in the current frame of       */
+/*             weightedInputSignal and in LPResidualSignal                   */
+/*                                                                           */
+/*****************************************************************************/
+void computeWeightedSpeechMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext);
 #endif /* ifndef COMPUTEWEIGHTEDSPEECH */
@@ -30,4 +30,15 @@
 /*                                                                           */
 /*****************************************************************************/
 uint16_t findOpenLoopPitchDelay(word16_t weightedInputSignal[]);
+
+/*****************************************************************************/
+/* findOpenLoopPitchDelayMultiChannel : same as findOpenLoopPitchDelay on    */
+/*      all the lanes of a lanes context at once: the correlations of each  */
+/*      delay are computed for all the lanes                                 */
+/*    paremeters:                                                            */
+/*      -(i/o) encoderLanesContext : the lanes context data, input read from */
+/*             weightedInputSignal, output in openLoopPitchDelay             */
+/*                                                                           */
+/*****************************************************************************/
+void findOpenLoopPitchDelayMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext);
 #endif /* ifndef FINDOPENLOOPPITCHDELAY_H */
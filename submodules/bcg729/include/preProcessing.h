@@ -34,4 +34,18 @@ void initPreProcessing(bcg729EncoderChannelContextStruct *encoderChannelContext)
 /*                                                                           */
 /*****************************************************************************/
 void preProcessing(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t signal[], word16_t preProcessedSignal[]);
+
+/* reset the filter memory of one lane of a lanes context                    */
+void initPreProcessingMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext, int lane);
+
+/*****************************************************************************/
+/* preProcessingMultiChannel : same filter than preProcessing applied to all */
+/*      the lanes of a lanes context at once                                 */
+/*    parameters :                                                           */
+/*      -(i/o) encoderLanesContext : the lanes context data, input is read   */
+/*             from inputSignal, output written in the last input frame of   */
+/*             signalBuffer, L_FRAME values per lane in Q0                   */
+/*                                                                           */
+/*****************************************************************************/
+void preProcessingMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext);
 #endif /* ifndef PREPROCESSING_H */
@@ -0,0 +1,93 @@
+/*
+ simdKernels.h
+
+ Copyright (C) 2011 Belledonne Communications, Grenoble, France
+ Author : Johan Pascal
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+/*****************************************************************************/
+/* Vectorised versions of the dot products used by the encoder hot loops     */
+/*   (autocorrelation, open loop pitch correlation, target/impulse response  */
+/*   correlations, gain quantization energies).                              */
+/*   Every implementation gives exactly the same result than the scalar      */
+/*   MAC16_16/MAC64 loop it replaces:                                        */
+/*     - DOT16_16 accumulates on 32 bits with wrap around as MAC16_16 does,  */
+/*       the addition modulo 2^32 being associative, the order of the sums   */
+/*       does not matter.                                                    */
+/*     - DOT16_16_64 accumulates on 64 bits as MAC64 does, each 16*16        */
+/*       product being exact on 32 bits it never overflows.                  */
+/*   The implementation is selected at runtime according to the CPU features */
+/*****************************************************************************/
+
+/* available implementations, BCG729_KERNELS_AUTO selects the best supported one */
+#define BCG729_KERNELS_AUTO	-1
+#define BCG729_KERNELS_SCALAR	0
+#define BCG729_KERNELS_SSE41	1
+#define BCG729_KERNELS_AVX2	2
+#define BCG729_KERNELS_NEON	3
+
+typedef struct bcg729KernelsStruct_struct {
+	int level; /* one of the BCG729_KERNELS_XXX implementation */
+	word32_t (*dot16_16)(const word16_t x[], const word16_t y[], int length);
+	word32_t (*dot16_16Even)(const word16_t x[], const word16_t y[], int length);
+	word64_t (*dot16_16_64)(const word16_t x[], const word16_t y[], int length);
+} bcg729KernelsStruct;
+
+extern bcg729KernelsStruct bcg729Kernels;
+
+/* Sum(x[i]*y[i]) i in [0, length[ on 32 bits */
+#define DOT16_16(x,y,length) (bcg729Kernels.dot16_16((x),(y),(length)))
+/* Sum(x[i]*y[i]) i in [0, length[ and even, on 32 bits */
+#define DOT16_16_EVEN(x,y,length) (bcg729Kernels.dot16_16Even((x),(y),(length)))
+/* Sum(x[i]*y[i]) i in [0, length[ on 64 bits */
+#define DOT16_16_64(x,y,length) (bcg729Kernels.dot16_16_64((x),(y),(length)))
+
+/*****************************************************************************/
+/* Multi channel encoder stages: loops over the lanes of a block of channels */
+/*   (see bcg729EncoderLanesContextStruct) are plain C on contiguous arrays  */
+/*   and rely on the compiler to vectorise them. clang does it at -O2, gcc   */
+/*   only vectorises the cheapest loops at -O2: enable it on these functions */
+/*****************************************************************************/
+#if defined(__GNUC__) && !defined(__clang__)
+#define LANES_VECTORISED __attribute__((optimize("tree-vectorize", "vect-cost-model=dynamic")))
+#else
+#define LANES_VECTORISED
+#endif
+
+/*****************************************************************************/
+/* selectBcg729Kernels : select the dot products implementation              */
+/*    parameters:                                                            */
+/*      -(i) level: one of BCG729_KERNELS_XXX, BCG729_KERNELS_AUTO selects   */
+/*           the best one supported by the CPU                               */
+/*    return value:                                                          */
+/*      - the level actually selected: the requested one may be unsupported */
+/*        by the CPU or the build, in that case the scalar one is used       */
+/*                                                                           */
+/*****************************************************************************/
+int selectBcg729Kernels(int level);
+
+/*****************************************************************************/
+/* initBcg729Kernels : select the best implementation supported by the CPU   */
+/*      unless one was already explicitely selected by selectBcg729Kernels   */
+/*      called at encoder channel creation                                   */
+/*                                                                           */
+/*****************************************************************************/
+void initBcg729Kernels(void);
+
+#endif /* ifndef SIMDKERNELS_H */
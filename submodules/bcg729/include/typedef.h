@@ -110,6 +110,54 @@ struct bcg729EncoderChannelContextStruct_struct {
 
 };
 
+/* the channels of a multi channel encoder are encoded by blocks of BCG729_ENCODER_LANES channels */
+#define BCG729_ENCODER_LANES 8
+
+/* define the context structure of a block of channels encoded at the same time */
+/* the frame basis stages which run the same computation whatever the data (filters, correlations, codebooks distances) */
+/* process all the channels of the block at once, one lane per channel: their buffers are stored as structure of arrays, */
+/* sample major: buffer[n][lane]. The loops over the lanes walk contiguous arrays of constant length and get vectorised */
+/* The lanes not mapped to a channel in the last block stay at zero, they are computed but never read */
+typedef struct bcg729EncoderLanesContextStruct_struct {
+	/*** buffers used in preProcessing bloc ***/
+	word16_t inputX0[BCG729_ENCODER_LANES], inputX1[BCG729_ENCODER_LANES];
+	word32_t outputY2[BCG729_ENCODER_LANES], outputY1[BCG729_ENCODER_LANES];
+	word16_t inputSignal[L_FRAME][BCG729_ENCODER_LANES]; /* the input frame of each channel */
+
+	/*** signal buffer: same mapping than the channel context one, the preProcessing output is written in its last frame ***/
+	word16_t signalBuffer[L_LP_ANALYSIS_WINDOW][BCG729_ENCODER_LANES];
+
+	/*** LP analysis: autocorrelation coefficients r[0..10] on 64 bits, not normalised ***/
+	word64_t autoCorrelationCoefficients[NB_LSP_COEFF+1][BCG729_ENCODER_LANES];
+
+	/*** LSP quantization: codebooks searches inputs and outputs ***/
+	word16_t LSPWeights[NB_LSP_COEFF][BCG729_ENCODER_LANES]; /* in Q11 */
+	word16_t LSPTargetVectors[L0_RANGE][NB_LSP_COEFF][BCG729_ENCODER_LANES]; /* in Q13, one for each MA predictor */
+	word16_t L1index[L0_RANGE][BCG729_ENCODER_LANES];
+	word16_t L2index[L0_RANGE][BCG729_ENCODER_LANES];
+	word16_t L3index[L0_RANGE][BCG729_ENCODER_LANES];
+
+	/*** weighted speech ***/
+	word16_t qLPCoefficients[2*NB_LSP_COEFF][BCG729_ENCODER_LANES]; /* in Q12, one set for each subframe */
+	word16_t weightedqLPCoefficients[2*NB_LSP_COEFF][BCG729_ENCODER_LANES]; /* in Q12, one set for each subframe */
+	word16_t LPResidualSignal[L_FRAME][BCG729_ENCODER_LANES]; /* in Q0 */
+	word16_t weightedInputSignal[MAXIMUM_INT_PITCH_DELAY+L_FRAME][BCG729_ENCODER_LANES]; /* same as the channel context one */
+
+	/*** open loop pitch search output ***/
+	uint16_t openLoopPitchDelay[BCG729_ENCODER_LANES];
+
+	/*** impulse responses of the weighted synthesis filter for each subframe, in Q12. The first NB_LSP_COEFF values are always zero ***/
+	word16_t impulseResponses[2][NB_LSP_COEFF+L_SUBFRAME][BCG729_ENCODER_LANES];
+} bcg729EncoderLanesContextStruct;
+
+/* define the context structure for a batch of encoder channels all encoded at the same time */
+struct bcg729EncoderMultiChannelContextStruct_struct {
+	int nbChannels;
+	bcg729EncoderChannelContextStruct *channels; /* nbChannels contexts allocated in one contiguous block */
+	int nbLanesContexts;
+	bcg729EncoderLanesContextStruct *lanesContexts; /* channel i is the lane i%BCG729_ENCODER_LANES of lanesContexts[i/BCG729_ENCODER_LANES] */
+};
+
 /* MAXINTXX define the maximum signed integer value on XX bits(2^(XX-1) - 1) */
 /* used to check on overflows in fixed point mode */
 #define MAXINT16 0x7fff
@@ -66,6 +66,19 @@ void rearrangeCoefficients(word16_t qLSP[], word16_t J);
 /*****************************************************************************/
 void synthesisFilter(word16_t inputSignal[], word16_t filterCoefficients[], word16_t filteredSignal[]);
 
+/*****************************************************************************/
+/* synthesisFilterMultiChannel : same filter than synthesisFilter on all the */
+/*      lanes of a lanes context at once, each lane with its own filter      */
+/*      coefficients. All buffers are sample major: buffer[n][lane]          */
+/*    parameters:                                                            */
+/*      -(i) inputSignal: 40 values per lane in Q0                           */
+/*      -(i) filterCoefficients: 10 coefficients per lane in Q12             */
+/*      -(i/o) filteredSignal: 50 values per lane in Q0 accessed in ranges   */
+/*             [-10,-1] as input and [0, 39] as output.                      */
+/*                                                                           */
+/*****************************************************************************/
+void synthesisFilterMultiChannel(word16_t inputSignal[][BCG729_ENCODER_LANES], word16_t filterCoefficients[][BCG729_ENCODER_LANES], word16_t filteredSignal[][BCG729_ENCODER_LANES]);
+
 /*****************************************************************************/
 /* correlateVectors : compute the correlations between two vectors of        */
 /*      L_SUBFRAME length: c[i] = Sum(x[j]*y[j-i]) j in [i..L_SUBFRAME]      */
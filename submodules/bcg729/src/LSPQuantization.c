@@ -23,10 +23,14 @@
 #include "basicOperationsMacros.h"
 #include "g729FixedPointMath.h"
 #include "codebooks.h"
+#include "simdKernels.h"
 
 #include "LSPQuantization.h"
 #include "string.h"
 
+/* local functions prototypes */
+static void searchLSPCodebooks(int L0, word16_t weights[], word16_t targetVector[], word16_t *L1index, word16_t *L2index, word16_t *L3index);
+
 /* static buffers */
 word16_t previousqLSFInit[NB_LSP_COEFF] = {2339, 4679, 7018, 9358, 11698, 14037, 16377, 18717, 21056, 23396}; /* PI*(float)(j+1)/(float)(M+1) */
 
@@ -51,6 +55,35 @@ void initLSPQuantization(bcg729EncoderChannelContextStruct *encoderChannelContex
 /*                                                                           */
 /*****************************************************************************/
 void LSPQuantization(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t LSPCoefficients[], word16_t qLSPCoefficients[], uint16_t parameters[])
+{
+	word16_t weights[NB_LSP_COEFF]; /* weights in Q11 */
+	word16_t targetVector[L0_RANGE][NB_LSP_COEFF]; /* vectors to be quantized in Q13, one for each MA Predictor */
+	word16_t L1index[L0_RANGE];
+	word16_t L2index[L0_RANGE];
+	word16_t L3index[L0_RANGE];
+	int L0;
+
+	computeLSPQuantizationTargets(encoderChannelContext, LSPCoefficients, weights, targetVector);
+
+	for (L0=0; L0<L0_RANGE; L0++) {
+		searchLSPCodebooks(L0, weights, targetVector[L0], &(L1index[L0]), &(L2index[L0]), &(L3index[L0]));
+	}
+
+	selectLSPQuantization(encoderChannelContext, weights, targetVector, L1index, L2index, L3index, qLSPCoefficients, parameters);
+}
+
+/*****************************************************************************/
+/* computeLSPQuantizationTargets : first step of LSPQuantization: compute   */
+/*      the LSF weights and the vectors to be quantized                      */
+/*    parameters:                                                            */
+/*      -(i) encoderChannelContext : the channel context data                */
+/*      -(i) LSPCoefficients : 10 LSP coefficients in Q15                    */
+/*      -(o) weights : 10 weights in Q11 spec 3.2.4 eq22                     */
+/*      -(o) targetVector : for each MA Predictor, the 10 values vector to   */
+/*           be quantized in Q13 spec 3.2.4 eq23                             */
+/*                                                                           */
+/*****************************************************************************/
+void computeLSPQuantizationTargets(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t LSPCoefficients[], word16_t weights[], word16_t targetVector[][NB_LSP_COEFF])
 {
 	int i,j;
 
@@ -61,7 +94,6 @@ void LSPQuantization(bcg729EncoderChannelContextStruct *encoderChannelContext, w
 	}
 
 	/*** compute the weights vector as in spec 3.2.4 eq22 ***/
-	word16_t weights[NB_LSP_COEFF]; /* weights in Q11 */
 	word16_t weightsThreshold[NB_LSP_COEFF]; /* store in Q13 the threshold used to compute the weights */
 	weightsThreshold[0] = SUB16(LSF[1], OO4PIPLUS1_IN_Q13);
 	for (i=1; i<NB_LSP_COEFF-1; i++) {
@@ -80,78 +112,208 @@ void LSPQuantization(bcg729EncoderChannelContextStruct *encoderChannelContext, w
 	weights[4] = MULT16_16_Q14(weights[4], ONE_POINT_2_IN_Q14);
 	weights[5] = MULT16_16_Q14(weights[5], ONE_POINT_2_IN_Q14);
 
-	/*** compute the coefficients for the two MA Predictors ***/
+	/*** compute the target Vector (l) to be quantized as in spec 3.2.4 eq23 for the two MA Predictors ***/
 	int L0;
-	word32_t weightedMeanSquareError[L0_RANGE];
-	word16_t L1index[L0_RANGE];
-	word16_t L2index[L0_RANGE];
-	word16_t L3index[L0_RANGE];
-
 	for (L0=0; L0<L0_RANGE; L0++) {
-
-		/* compute the target Vector (l) to be quantized as in spec 3.2.4 eq23 */
-		word16_t targetVector[NB_LSP_COEFF]; /* vector to be quantized in Q13 */
 		for (i=0; i<NB_LSP_COEFF; i++) {
 			word32_t acc = SHL(LSF[i],15); /* acc in Q2.28 */
 			for (j=0; j<MA_MAX_K; j++) {
 				acc = MSU16_16(acc, encoderChannelContext->previousqLSF[j][i], MAPredictor[L0][j][i]); /* previousqLSF in Q2.13 and MAPredictor in Q0.15-> acc in Q2.28 */
 			}
-			targetVector[i] = MULT16_16_Q12((word16_t)PSHR(acc, 15), invMAPredictorSum[L0][i]); /* acc->Q13 and invMAPredictorSum in Q12 -> targetVector in Q13 */
+			targetVector[L0][i] = MULT16_16_Q12((word16_t)PSHR(acc, 15), invMAPredictorSum[L0][i]); /* acc->Q13 and invMAPredictorSum in Q12 -> targetVector in Q13 */
+		}
+	}
+}
+
+/*****************************************************************************/
+/* searchLSPCodebooks : find the L1, L2 and L3 codebooks indexes for one MA  */
+/*      Predictor as described in spec 3.2.4                                 */
+/*    parameters:                                                            */
+/*      -(i) L0 : the MA Predictor                                           */
+/*      -(i) weights : 10 weights in Q11                                     */
+/*      -(i) targetVector : 10 values in Q13, vector to be quantized         */
+/*      -(o) L1index, L2index, L3index : the selected codebooks entries      */
+/*                                                                           */
+/*****************************************************************************/
+static void searchLSPCodebooks(int L0, word16_t weights[], word16_t targetVector[], word16_t *L1index, word16_t *L2index, word16_t *L3index)
+{
+	int i,j;
+
+	/* find closest match for predictionError (minimize mean square diff) in L1 codebook */
+	word32_t meanSquareDiff = MAXINT32;
+	for (i=0; i<L1_RANGE; i++) {
+		word32_t acc = 0;
+		for (j=0; j<NB_LSP_COEFF; j++) {
+			word16_t difftargetVectorL1 = SATURATE(SUB32(targetVector[j], L1[i][j]), MAXINT16);
+			acc = MAC16_16(acc, difftargetVectorL1, difftargetVectorL1);
 		}
 
-		/* find closest match for predictionError (minimize mean square diff) in L1 codebook */
-		word32_t meanSquareDiff = MAXINT32;
+		if (acc<meanSquareDiff) {
+			meanSquareDiff = acc;
+			*L1index = i;
+		}
+	}
+	
+	/* find the closest match in L2 wich will minimise the weighted sum of (targetVector - L1 result - L2)^2 */
+	/* using eq20, eq21 and eq23 in spec 3.2.4 -> l[i] - l^[i] = (wi - w^[i])/(1-SumMAPred[i]) but ITU code ignores this denominator */
+	/* works on the first five coefficients only */
+	meanSquareDiff = MAXINT32;
+	for (i=0; i<L2_RANGE; i++) {
+		word32_t acc = 0;
+		for (j=0; j<NB_LSP_COEFF/2; j++) {
+			/* commented code : compute in the same way of the ITU code: ignore the denonimator and minimize (wi - w^[i])/(1-SumMAPred[i]) instead of (wi - w^[i]) square sum */
+			//word16_t difftargetVectorL1L2 = SATURATE(SUB32(SUB32(targetVector[j], L1[*L1index][j]), L2L3[i][j]), MAXINT16); /* targetVector, L1 and L2L3 in Q13 -> result in Q13 */
+			word16_t difftargetVectorL1L2 = SATURATE(MULT16_16_Q15(SUB32(SUB32(targetVector[j], L1[*L1index][j]), L2L3[i][j]), MAPredictorSum[L0][j]), MAXINT16); /* targetVector, L1 and L2L3 in Q13 -> result in Q13 */
+			acc = MAC16_16(acc, difftargetVectorL1L2, MULT16_16_Q11(difftargetVectorL1L2, weights[j])); /* weights in Q11, diff in Q13 */
+		}
+
+		if (acc<meanSquareDiff) {
+			meanSquareDiff = acc;
+			*L2index = i;
+		}
+	}
+
+	/* find the closest match in L3 wich will minimise the weighted sum of (targetVector - L1 result - L3)^2 */
+	/* using eq20, eq21 and eq23 in spec 3.2.4 -> l[i] - l^[i] = (wi - w^[i])/(1-SumMAPred[i]) but ITU code ignores this denominator */
+	/* works on the first five coefficients only */
+	meanSquareDiff = MAXINT32;
+	for (i=0; i<L2_RANGE; i++) {
+		word32_t acc = 0;
+		for (j=NB_LSP_COEFF/2; j<NB_LSP_COEFF; j++) {
+			/* commented code : compute in the same way of the ITU code: ignore the denonimator and minimize (wi - w^[i])/(1-SumMAPred[i]) instead of (wi - w^[i]) square sum */
+			//word16_t difftargetVectorL1L3 = SATURATE(SUB32(SUB32(targetVector[j], L1[*L1index][j]), L2L3[i][j]), MAXINT16); /* targetVector, L1 and L2L3 in Q13 -> result in Q13 */
+			word16_t difftargetVectorL1L3 = SATURATE(MULT16_16_Q15(SUB32(SUB32(targetVector[j], L1[*L1index][j]), L2L3[i][j]), MAPredictorSum[L0][j]), MAXINT16); /* targetVector, L1 and L2L3 in Q13 -> result in Q13 */
+			acc = MAC16_16(acc, difftargetVectorL1L3, MULT16_16_Q11(difftargetVectorL1L3, weights[j])); /* weights in Q11, diff in Q13 */
+		}
+
+		if (acc<meanSquareDiff) {
+			meanSquareDiff = acc;
+			*L3index = i;
+		}
+	}
+}
+
+/*****************************************************************************/
+/* searchLSPCodebooksMultiChannel : same search than searchLSPCodebooks for  */
+/*      both MA Predictors on all the lanes of a lanes context at once: each */
+/*      codebook entry distance is computed for all lanes, then the lanes    */
+/*      having a new minimum select it                                       */
+/*    parameters:                                                            */
+/*      -(i/o) encoderLanesContext : the lanes context data, input read from */
+/*             LSPWeights and LSPTargetVectors, output in L1index, L2index   */
+/*             and L3index                                                   */
+/*                                                                           */
+/*****************************************************************************/
+LANES_VECTORISED void searchLSPCodebooksMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext)
+{
+	int i,j,l;
+	int L0;
+	word16_t (*weights)[BCG729_ENCODER_LANES] = encoderLanesContext->LSPWeights;
+
+	for (L0=0; L0<L0_RANGE; L0++) {
+		word16_t (*targetVector)[BCG729_ENCODER_LANES] = encoderLanesContext->LSPTargetVectors[L0];
+		word16_t *L1index = encoderLanesContext->L1index[L0];
+		word16_t *L2index = encoderLanesContext->L2index[L0];
+		word16_t *L3index = encoderLanesContext->L3index[L0];
+		word32_t meanSquareDiff[BCG729_ENCODER_LANES];
+		word32_t acc[BCG729_ENCODER_LANES];
+
+		/*** L1 codebook, see searchLSPCodebooks for comments ***/
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			meanSquareDiff[l] = MAXINT32;
+			L1index[l] = 0;
+		}
 		for (i=0; i<L1_RANGE; i++) {
-			word32_t acc = 0;
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				acc[l] = 0;
+			}
 			for (j=0; j<NB_LSP_COEFF; j++) {
-				word16_t difftargetVectorL1 = SATURATE(SUB32(targetVector[j], L1[i][j]), MAXINT16);
-				acc = MAC16_16(acc, difftargetVectorL1, difftargetVectorL1);
+				for (l=0; l<BCG729_ENCODER_LANES; l++) {
+					word16_t difftargetVectorL1 = SATURATE(SUB32(targetVector[j][l], L1[i][j]), MAXINT16);
+					acc[l] = MAC16_16(acc[l], difftargetVectorL1, difftargetVectorL1);
+				}
+			}
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				int isLower = acc[l]<meanSquareDiff[l];
+				meanSquareDiff[l] = isLower?acc[l]:meanSquareDiff[l];
+				L1index[l] = isLower?i:L1index[l];
 			}
+		}
 
-			if (acc<meanSquareDiff) {
-				meanSquareDiff = acc;
-				L1index[L0] = i;
+		/* targetVector - L1 result, in Q13 on 32 bits: the L1 entry differs on each lane, get it once for the L2 and L3 searches */
+		word32_t difftargetVectorL1[NB_LSP_COEFF][BCG729_ENCODER_LANES];
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			for (j=0; j<NB_LSP_COEFF; j++) {
+				difftargetVectorL1[j][l] = SUB32(targetVector[j][l], L1[L1index[l]][j]);
 			}
 		}
-		
-		/* find the closest match in L2 wich will minimise the weighted sum of (targetVector - L1 result - L2)^2 */
-		/* using eq20, eq21 and eq23 in spec 3.2.4 -> l[i] - l^[i] = (wi - w^[i])/(1-SumMAPred[i]) but ITU code ignores this denominator */
-		/* works on the first five coefficients only */
-		meanSquareDiff = MAXINT32;
+
+		/*** L2 codebook on the first five coefficients ***/
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			meanSquareDiff[l] = MAXINT32;
+			L2index[l] = 0;
+		}
 		for (i=0; i<L2_RANGE; i++) {
-			word32_t acc = 0;
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				acc[l] = 0;
+			}
 			for (j=0; j<NB_LSP_COEFF/2; j++) {
-				/* commented code : compute in the same way of the ITU code: ignore the denonimator and minimize (wi - w^[i])/(1-SumMAPred[i]) instead of (wi - w^[i]) square sum */
-				//word16_t difftargetVectorL1L2 = SATURATE(SUB32(SUB32(targetVector[j], L1[L1index[L0]][j]), L2L3[i][j]), MAXINT16); /* targetVector, L1 and L2L3 in Q13 -> result in Q13 */
-				word16_t difftargetVectorL1L2 = SATURATE(MULT16_16_Q15(SUB32(SUB32(targetVector[j], L1[L1index[L0]][j]), L2L3[i][j]), MAPredictorSum[L0][j]), MAXINT16); /* targetVector, L1 and L2L3 in Q13 -> result in Q13 */
-				acc = MAC16_16(acc, difftargetVectorL1L2, MULT16_16_Q11(difftargetVectorL1L2, weights[j])); /* weights in Q11, diff in Q13 */
+				for (l=0; l<BCG729_ENCODER_LANES; l++) {
+					word16_t difftargetVectorL1L2 = SATURATE(MULT16_16_Q15(SUB32(difftargetVectorL1[j][l], L2L3[i][j]), MAPredictorSum[L0][j]), MAXINT16);
+					acc[l] = MAC16_16(acc[l], difftargetVectorL1L2, MULT16_16_Q11(difftargetVectorL1L2, weights[j][l]));
+				}
 			}
-
-			if (acc<meanSquareDiff) {
-				meanSquareDiff = acc;
-				L2index[L0] = i;
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				int isLower = acc[l]<meanSquareDiff[l];
+				meanSquareDiff[l] = isLower?acc[l]:meanSquareDiff[l];
+				L2index[l] = isLower?i:L2index[l];
 			}
 		}
 
-		/* find the closest match in L3 wich will minimise the weighted sum of (targetVector - L1 result - L3)^2 */
-		/* using eq20, eq21 and eq23 in spec 3.2.4 -> l[i] - l^[i] = (wi - w^[i])/(1-SumMAPred[i]) but ITU code ignores this denominator */
-		/* works on the first five coefficients only */
-		meanSquareDiff = MAXINT32;
+		/*** L3 codebook on the last five coefficients ***/
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			meanSquareDiff[l] = MAXINT32;
+			L3index[l] = 0;
+		}
 		for (i=0; i<L2_RANGE; i++) {
-			word32_t acc = 0;
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				acc[l] = 0;
+			}
 			for (j=NB_LSP_COEFF/2; j<NB_LSP_COEFF; j++) {
-				/* commented code : compute in the same way of the ITU code: ignore the denonimator and minimize (wi - w^[i])/(1-SumMAPred[i]) instead of (wi - w^[i]) square sum */
-				//word16_t difftargetVectorL1L3 = SATURATE(SUB32(SUB32(targetVector[j], L1[L1index[L0]][j]), L2L3[i][j]), MAXINT16); /* targetVector, L1 and L2L3 in Q13 -> result in Q13 */
-				word16_t difftargetVectorL1L3 = SATURATE(MULT16_16_Q15(SUB32(SUB32(targetVector[j], L1[L1index[L0]][j]), L2L3[i][j]), MAPredictorSum[L0][j]), MAXINT16); /* targetVector, L1 and L2L3 in Q13 -> result in Q13 */
-				acc = MAC16_16(acc, difftargetVectorL1L3, MULT16_16_Q11(difftargetVectorL1L3, weights[j])); /* weights in Q11, diff in Q13 */
+				for (l=0; l<BCG729_ENCODER_LANES; l++) {
+					word16_t difftargetVectorL1L3 = SATURATE(MULT16_16_Q15(SUB32(difftargetVectorL1[j][l], L2L3[i][j]), MAPredictorSum[L0][j]), MAXINT16);
+					acc[l] = MAC16_16(acc[l], difftargetVectorL1L3, MULT16_16_Q11(difftargetVectorL1L3, weights[j][l]));
+				}
 			}
-
-			if (acc<meanSquareDiff) {
-				meanSquareDiff = acc;
-				L3index[L0] = i;
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				int isLower = acc[l]<meanSquareDiff[l];
+				meanSquareDiff[l] = isLower?acc[l]:meanSquareDiff[l];
+				L3index[l] = isLower?i:L3index[l];
 			}
 		}
+	}
+}
 
+/*****************************************************************************/
+/* selectLSPQuantization : last step of LSPQuantization: select the MA      */
+/*      Predictor, compute the qLSP and update the channel memory            */
+/*    parameters:                                                            */
+/*      -(i/o) encoderChannelContext : the channel context data              */
+/*      -(i) weights : 10 weights in Q11                                     */
+/*      -(i) targetVector : for each MA Predictor the vector to be quantized */
+/*      -(i) L1index, L2index, L3index : for each MA Predictor the codebooks */
+/*           entries found by the search                                     */
+/*      -(o) qLSPCoefficients : 10 qLSP coefficients in Q15                  */
+/*      -(o) parameters : 4 parameters L0, L1, L2, L3                        */
+/*                                                                           */
+/*****************************************************************************/
+void selectLSPQuantization(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t weights[], word16_t targetVector[][NB_LSP_COEFF], word16_t L1index[], word16_t L2index[], word16_t L3index[], word16_t qLSPCoefficients[], uint16_t parameters[])
+{
+	int i,j;
+	int L0;
+	word32_t weightedMeanSquareError[L0_RANGE];
+
+	for (L0=0; L0<L0_RANGE; L0++) {
 		/* compute the quantized vector L1+L2/L3 and rearrange it as specified in spec 3.2.4(first the higher part (L2) and then the lower part (L3)) */
 		/* Note: according to the spec, the rearrangement shall be done on each candidate while looking for best match, but the ITU code does it after picking the best match and so we do */
 		word16_t quantizedVector[NB_LSP_COEFF]; /* in Q13, the current state of quantized vector */
@@ -187,7 +349,7 @@ void LSPQuantization(bcg729EncoderChannelContextStruct *encoderChannelContext, w
 		/* compute the weighted mean square distance using the final quantized vector according to eq21 */
 		weightedMeanSquareError[L0]=0;
 		for (i=0; i<NB_LSP_COEFF; i++) {
-			word16_t difftargetVectorQuantizedVector = SATURATE(MULT16_16_Q15(SUB32(targetVector[i], quantizedVector[i]), MAPredictorSum[L0][i]), MAXINT16); /* targetVector and quantizedVector in Q13 -> result in Q13 */
+			word16_t difftargetVectorQuantizedVector = SATURATE(MULT16_16_Q15(SUB32(targetVector[L0][i], quantizedVector[i]), MAPredictorSum[L0][i]), MAXINT16); /* targetVector and quantizedVector in Q13 -> result in Q13 */
 			weightedMeanSquareError[L0] = MAC16_16(weightedMeanSquareError[L0], difftargetVectorQuantizedVector, MULT16_16_Q11(difftargetVectorQuantizedVector, weights[i])); /* weights in Q11, diff in Q13 */
 		}
 	}
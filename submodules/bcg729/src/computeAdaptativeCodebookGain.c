@@ -23,6 +23,7 @@
 #include "codecParameters.h"
 #include "basicOperationsMacros.h"
 #include "utils.h"
+#include "simdKernels.h"
 
 #include "computeAdaptativeCodebookGain.h"
 
@@ -40,14 +41,8 @@
 /*****************************************************************************/
 word16_t computeAdaptativeCodebookGain(word16_t targetSignal[], word16_t filteredAdaptativeCodebookVector[], word64_t *gainQuantizationXy, word64_t *gainQuantizationYy)
 {
-	int i;
-	*gainQuantizationXy = 0; /* contains the scalar product targetSignal, filteredAdaptativeCodebookVector : numerator */
-	*gainQuantizationYy = 0; /* contains the scalar product filteredAdaptativeCodebookVector^2 : denominator */
-
-	for (i=0; i<L_SUBFRAME; i++) {
-		*gainQuantizationXy = MAC64(*gainQuantizationXy, targetSignal[i], filteredAdaptativeCodebookVector[i]);
-		*gainQuantizationYy = MAC64(*gainQuantizationYy, filteredAdaptativeCodebookVector[i], filteredAdaptativeCodebookVector[i]);
-	}
+	*gainQuantizationXy = DOT16_16_64(targetSignal, filteredAdaptativeCodebookVector, L_SUBFRAME); /* contains the scalar product targetSignal, filteredAdaptativeCodebookVector : numerator */
+	*gainQuantizationYy = DOT16_16_64(filteredAdaptativeCodebookVector, filteredAdaptativeCodebookVector, L_SUBFRAME); /* contains the scalar product filteredAdaptativeCodebookVector^2 : denominator */
 
 	/* check on values of xx and xy */
 	if (*gainQuantizationXy<=0) { /* gain would be negative -> return 0 */
@@ -23,6 +23,7 @@
 #include "basicOperationsMacros.h"
 #include "codebooks.h"
 #include "utils.h"
+#include "simdKernels.h"
 
 #include "computeLP.h"
 
@@ -36,7 +37,7 @@
 /*****************************************************************************/
 void computeLP(word16_t signal[], word16_t LPCoefficientsQ12[])
 {
-	int i,j;
+	int i;
 
 	/*********************************************************************/
 	/* Compute the windowed signal according to spec 3.2.1 eq4           */
@@ -49,14 +50,76 @@ void computeLP(word16_t signal[], word16_t LPCoefficientsQ12[])
 	/*********************************************************************************/
 	/* Compute the autoCorrelation coefficients r[0..10] according to spec 3.2.1 eq5 */
 	/*********************************************************************************/
-	word32_t autoCorrelationCoefficient[NB_LSP_COEFF+1];
-	/* Compute autoCorrelationCoefficient[0] first as it is the highest number and normalise it on 32 bits then apply the same normalisation to the other coefficients */
-	/* autoCorrelationCoefficient are normalised on 32 bits and then considered as Q31 in range [-1,1[ */
-	/* autoCorrelationCoefficient[0] is computed on 64 bits as it is likely to overflow 32 bits */
-	word64_t acc64=0; /* acc on 64 bits */ 
+	word64_t autoCorrelationCoefficients[NB_LSP_COEFF+1];
+	/* autoCorrelationCoefficients[0] is computed on 64 bits as it is likely to overflow 32 bits */
+	autoCorrelationCoefficients[0] = DOT16_16_64(windowedSignal, windowedSignal, L_LP_ANALYSIS_WINDOW);
+	if (autoCorrelationCoefficients[0]>MAXINT32) { /* r[0] is not fitting on 32 bits so compute the other sum on 64 bits too */
+		for (i=1; i<NB_LSP_COEFF+1; i++) {
+			autoCorrelationCoefficients[i] = DOT16_16_64(&(windowedSignal[i]), windowedSignal, L_LP_ANALYSIS_WINDOW-i);
+		}
+	} else { /* r[0] is fitting on 32 bits and |r[i]|<=r[0], compute the other sum on 32 bits only as it is faster */
+		for (i=1; i<NB_LSP_COEFF+1; i++) {
+			autoCorrelationCoefficients[i] = DOT16_16(&(windowedSignal[i]), windowedSignal, L_LP_ANALYSIS_WINDOW-i);
+		}
+	}
+
+	autoCorrelation2LP(autoCorrelationCoefficients, LPCoefficientsQ12);
+
+	return;
+}
+
+/*****************************************************************************/
+/* computeAutoCorrelationMultiChannel : Windowing and Autocorrelation of     */
+/*      computeLP on all the lanes of a lanes context at once                */
+/*    parameters:                                                            */
+/*      -(i/o) encoderLanesContext : the lanes context data, input read from */
+/*             signalBuffer, output in autoCorrelationCoefficients           */
+/*                                                                           */
+/*****************************************************************************/
+LANES_VECTORISED void computeAutoCorrelationMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext)
+{
+	int i,j,l;
+
+	/*** windowing spec 3.2.1 eq4 ***/
+	word16_t windowedSignal[L_LP_ANALYSIS_WINDOW][BCG729_ENCODER_LANES];
 	for (i=0; i<L_LP_ANALYSIS_WINDOW; i++) {
-		acc64 = MAC64(acc64, windowedSignal[i], windowedSignal[i]);
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			windowedSignal[i][l] = MULT16_16_P15(encoderLanesContext->signalBuffer[i][l], wlp[i]); /* signal in Q0, wlp in Q0.15, windowedSignal in Q0 */
+		}
 	}
+
+	/*** autocorrelation spec 3.2.1 eq5: all computed on 64 bits, autoCorrelation2LP picks the 32 bits normalisation when r[0] fits on 32 bits ***/
+	for (i=0; i<NB_LSP_COEFF+1; i++) {
+		word64_t *autoCorrelationCoefficients = encoderLanesContext->autoCorrelationCoefficients[i];
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			autoCorrelationCoefficients[l] = 0;
+		}
+		for (j=i; j<L_LP_ANALYSIS_WINDOW; j++) {
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				autoCorrelationCoefficients[l] = ADD64_32(autoCorrelationCoefficients[l], MULT16_16(windowedSignal[j][l], windowedSignal[j-i][l]));
+			}
+		}
+	}
+}
+
+/*****************************************************************************/
+/* autoCorrelation2LP : As described in spec 3.2.1 and 3.2.2 : lag window   */
+/*      and Levinson-Durbin algorithm                                        */
+/*    parameters:                                                            */
+/*      -(i) autoCorrelationCoefficients: r[0..10] in Q0 on 64 bits, when    */
+/*           r[0] fits on 32 bits, only the lower 32 bits of r[1..10] are    */
+/*           used                                                            */
+/*      -(o) LPCoefficientsQ12: 10 LP coefficients in Q12                    */
+/*                                                                           */
+/*****************************************************************************/
+void autoCorrelation2LP(word64_t autoCorrelationCoefficients[], word16_t LPCoefficientsQ12[])
+{
+	int i,j;
+
+	/* normalise the autoCorrelationCoefficients on 32 bits, they are then considered as Q31 in range [-1,1[ */
+	/* compute the normalisation on r[0] as it is the highest number then apply it to the other coefficients */
+	word32_t autoCorrelationCoefficient[NB_LSP_COEFF+1];
+	word64_t acc64 = autoCorrelationCoefficients[0];
 	if (acc64==0) {
 		acc64 = 1; /* spec 3.2.1: To avoid arithmetic problems for low-level input signals the value of r(0) has a lower boundary of r(0) = 1.0 */
 	}
@@ -73,26 +136,14 @@ void computeLP(word16_t signal[], word16_t LPCoefficientsQ12[])
 		autoCorrelationCoefficient[0] = SHL((word32_t)acc64, -rightShiftToNormalise);
 	}
 
-	/* compute autoCorrelationCoefficient 1 to 10 */
-	if (rightShiftToNormalise>0) { /* acc64 was not fitting on 32 bits so compute the other sum on 64 bits too */
+	/* normalise autoCorrelationCoefficient 1 to 10 */
+	if (rightShiftToNormalise>0) { /* r[0] was not fitting on 32 bits */
 		for (i=1; i<NB_LSP_COEFF+1; i++) {
-			/* compute the sum in the 64 bits acc*/
-			acc64=0;
-			for (j=i; j<L_LP_ANALYSIS_WINDOW; j++) {
-				acc64 = ADD64_32(acc64, MULT16_16(windowedSignal[j], windowedSignal[j-i]));
-			}
-			/* normalise it */
-			autoCorrelationCoefficient[i] = SHR(acc64 ,rightShiftToNormalise);
+			autoCorrelationCoefficient[i] = SHR(autoCorrelationCoefficients[i], rightShiftToNormalise);
 		}
-	} else { /* acc64 was fitting on 32 bits, compute the other sum on 32 bits only as it is faster */
+	} else { /* r[0] was fitting on 32 bits, so do the other ones */
 		for (i=1; i<NB_LSP_COEFF+1; i++) {
-			/* compute the sum in the 64 bits acc*/
-			word32_t acc32=0;
-			for (j=i; j<L_LP_ANALYSIS_WINDOW; j++) {
-				acc32 = MAC16_16(acc32, windowedSignal[j], windowedSignal[j-i]);
-			}
-			/* normalise it */
-			autoCorrelationCoefficient[i] = SHL(acc32, -rightShiftToNormalise);
+			autoCorrelationCoefficient[i] = SHL((word32_t)autoCorrelationCoefficients[i], -rightShiftToNormalise);
 		}
 	}
 
@@ -23,6 +23,7 @@
 #include "codecParameters.h"
 #include "basicOperationsMacros.h"
 #include "utils.h"
+#include "simdKernels.h"
 
 #include "computeWeightedSpeech.h"
 
@@ -86,3 +87,57 @@ void computeWeightedSpeech(word16_t inputSignal[], word16_t qLPCoefficients[], w
 	/* weightedInputSignal for the second subframe: synthesis filter  1/[A'(z)] */
 	synthesisFilter(&(LPResidualSignal[L_SUBFRAME]), weightedqLPLowPassCoefficients, &(weightedInputSignal[L_SUBFRAME]));
 }
+
+/*****************************************************************************/
+/* computeWeightedSpeechMultiChannel : same as computeWeightedSpeech on all  */
+/*      the lanes of a lanes context at once                                 */
+/*    parameters:                                                            */
+/*      -(i/o) encoderLanesContext : the lanes context data, input read from */
+/*             the current frame of signalBuffer, qLPCoefficients and        */
+/*             weightedqLPCoefficients. Output in the current frame of       */
+/*             weightedInputSignal and in LPResidualSignal                   */
+/*                                                                           */
+/*****************************************************************************/
+LANES_VECTORISED void computeWeightedSpeechMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext)
+{
+	int i,j,l;
+	/* current frame in the signal buffer, see signal buffer mapping in bcg729EncoderChannelContextStruct */
+	word16_t (*inputSignal)[BCG729_ENCODER_LANES] = &(encoderLanesContext->signalBuffer[L_LP_ANALYSIS_WINDOW-L_SUBFRAME-L_FRAME]);
+	word16_t (*LPResidualSignal)[BCG729_ENCODER_LANES] = encoderLanesContext->LPResidualSignal;
+	int subframeIndex;
+
+	for (subframeIndex=0; subframeIndex<L_FRAME; subframeIndex+=L_SUBFRAME) {
+		word16_t (*qLPCoefficients)[BCG729_ENCODER_LANES] = &(encoderLanesContext->qLPCoefficients[subframeIndex==0?0:NB_LSP_COEFF]);
+		word16_t (*weightedqLPCoefficients)[BCG729_ENCODER_LANES] = &(encoderLanesContext->weightedqLPCoefficients[subframeIndex==0?0:NB_LSP_COEFF]);
+
+		/*** compute LPResisualSignal (spec A3.3.3 eqA.3) in Q0, see computeWeightedSpeech for comments ***/
+		for (i=subframeIndex; i<subframeIndex+L_SUBFRAME; i++) {
+			word32_t acc[BCG729_ENCODER_LANES];
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				acc[l] = SHL((word32_t)inputSignal[i][l], 12);
+			}
+			for (j=0; j<NB_LSP_COEFF; j++) {
+				for (l=0; l<BCG729_ENCODER_LANES; l++) {
+					acc[l] = MAC16_16(acc[l], qLPCoefficients[j][l], inputSignal[i-j-1][l]);
+				}
+			}
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				LPResidualSignal[i][l] = (word16_t)SATURATE(PSHR(acc[l], 12), MAXINT16);
+			}
+		}
+
+		/*** compute weightedqLPLowPassCoefficients a'[i] = weightedqLP[i] - 0.7*weightedqLP[i-1] spec A3.3.3 ***/
+		word16_t weightedqLPLowPassCoefficients[NB_LSP_COEFF][BCG729_ENCODER_LANES]; /* in Q12 */
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			weightedqLPLowPassCoefficients[0][l] = SUB16(weightedqLPCoefficients[0][l],O7_IN_Q12);
+		}
+		for (i=1; i<NB_LSP_COEFF; i++) {
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				weightedqLPLowPassCoefficients[i][l] = SUB16(weightedqLPCoefficients[i][l], MULT16_16_Q12(weightedqLPCoefficients[i-1][l], O7_IN_Q12));
+			}
+		}
+
+		/* weightedInputSignal for the subframe: synthesis filter  1/[A'(z)] */
+		synthesisFilterMultiChannel(&(LPResidualSignal[subframeIndex]), weightedqLPLowPassCoefficients, &(encoderLanesContext->weightedInputSignal[MAXIMUM_INT_PITCH_DELAY+subframeIndex]));
+	}
+}
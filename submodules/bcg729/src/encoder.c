@@ -25,6 +25,7 @@
 #include "codecParameters.h"
 #include "basicOperationsMacros.h"
 #include "utils.h"
+#include "simdKernels.h"
 
 #include "bcg729/encoder.h"
 
@@ -42,20 +43,23 @@
 #include "fixedCodebookSearch.h"
 #include "gainQuantization.h"
 
+/* local functions prototypes */
+static void initEncoderChannelContext(bcg729EncoderChannelContextStruct *encoderChannelContext);
+static void computeqLPCoefficients(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t qLSPCoefficients[], word16_t qLPCoefficients[], word16_t weightedqLPCoefficients[]);
+static void encodeSubframes(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t weightedqLPCoefficients[], uint16_t openLoopPitchDelay, word16_t impulseResponses[], uint16_t parameters[], uint8_t bitStream[]);
+static void encodeLanes(bcg729EncoderLanesContextStruct *encoderLanesContext, bcg729EncoderChannelContextStruct *encoderChannelContexts, int nbLanes, int16_t inputFrames[], uint8_t bitStreams[]);
+
 /* buffers allocation */
 static const word16_t previousLSPInitialValues[NB_LSP_COEFF] = {30000, 26000, 21000, 15000, 8000, 0, -8000,-15000,-21000,-26000}; /* in Q0.15 the initials values for the previous LSP buffer */
 
 /*****************************************************************************/
-/* initBcg729EncoderChannel : create context structure and initialise it     */
-/*    return value :                                                         */
-/*      - the encoder channel context data                                   */
+/* initEncoderChannelContext : initialise an allocated context structure     */
+/*    parameters:                                                            */
+/*      -(o) encoderChannelContext : the channel context data                */
 /*                                                                           */
 /*****************************************************************************/
-bcg729EncoderChannelContextStruct *initBcg729EncoderChannel()
+static void initEncoderChannelContext(bcg729EncoderChannelContextStruct *encoderChannelContext)
 {
-	/* create the context structure */
-	bcg729EncoderChannelContextStruct *encoderChannelContext = malloc(sizeof(bcg729EncoderChannelContextStruct));
-
 	/* initialise statics buffers and variables */
 	memset(encoderChannelContext->signalBuffer, 0, (L_LP_ANALYSIS_WINDOW-L_FRAME)*sizeof(word16_t)); /* set to zero all the past signal */
 	encoderChannelContext->signalLastInputFrame = &(encoderChannelContext->signalBuffer[L_LP_ANALYSIS_WINDOW-L_FRAME]); /* point to the last frame in the signal buffer */
@@ -68,9 +72,24 @@ bcg729EncoderChannelContextStruct *initBcg729EncoderChannel()
 	encoderChannelContext->lastQuantizedAdaptativeCodebookGain = O2_IN_Q14; /* quantized gain is initialized at his minimum value: 0.2 */
 
 	/* initialisation of the differents blocs which need to be initialised */
+	initBcg729Kernels();
 	initPreProcessing(encoderChannelContext);
 	initLSPQuantization(encoderChannelContext);
 	initGainQuantization(encoderChannelContext);
+}
+
+/*****************************************************************************/
+/* initBcg729EncoderChannel : create context structure and initialise it     */
+/*    return value :                                                         */
+/*      - the encoder channel context data                                   */
+/*                                                                           */
+/*****************************************************************************/
+bcg729EncoderChannelContextStruct *initBcg729EncoderChannel()
+{
+	/* create the context structure */
+	bcg729EncoderChannelContextStruct *encoderChannelContext = malloc(sizeof(bcg729EncoderChannelContextStruct));
+
+	initEncoderChannelContext(encoderChannelContext);
 
 	return encoderChannelContext;
 }
@@ -97,7 +116,6 @@ void closeBcg729EncoderChannel(bcg729EncoderChannelContextStruct *encoderChannel
 /*****************************************************************************/
 void bcg729Encoder(bcg729EncoderChannelContextStruct *encoderChannelContext, int16_t inputFrame[], uint8_t bitStream[])
 {
-	int i;
 	uint16_t parameters[NB_PARAMETERS]; /* the output parameters in an array */
 
 	/* internal buffers which we do not need to keep between calls */
@@ -106,7 +124,7 @@ void bcg729Encoder(bcg729EncoderChannelContextStruct *encoderChannelContext, int
 	word16_t weightedqLPCoefficients[2*NB_LSP_COEFF]; /* the qLP coefficients in Q3.12 weighted according to spec A3.3.3 */
 	word16_t LSPCoefficients[NB_LSP_COEFF]; /* the LSP coefficients in Q15 */
 	word16_t qLSPCoefficients[NB_LSP_COEFF]; /* the quantized LSP coefficients in Q15 */
-	word16_t interpolatedqLSP[NB_LSP_COEFF]; /* the interpolated qLSP used for first subframe in Q15 */
+	word16_t impulseResponses[2*L_SUBFRAME]; /* the impulse responses of the weighted synthesis filter in Q12, one for each subframe */
 
 
 	/*****************************************************************************************/
@@ -122,7 +140,58 @@ void bcg729Encoder(bcg729EncoderChannelContextStruct *encoderChannelContext, int
 
 	/*** LSPQuantization and compute L0, L1, L2, L3: the first four parameters ***/
 	LSPQuantization(encoderChannelContext, LSPCoefficients, qLSPCoefficients, parameters);
-	
+
+	/*** interpolate qLSP and convert to LP, weight the qLP ***/
+	computeqLPCoefficients(encoderChannelContext, qLSPCoefficients, qLPCoefficients, weightedqLPCoefficients);
+
+	/*** Compute weighted signal according to spec A3.3.3, this function also set LPResidualSignal(entire frame values) as specified in eq A.3 in excitationVector[L_PAST_EXCITATION] ***/
+	computeWeightedSpeech(encoderChannelContext->signalCurrentFrame, qLPCoefficients, weightedqLPCoefficients, &(encoderChannelContext->weightedInputSignal[MAXIMUM_INT_PITCH_DELAY]), &(encoderChannelContext->excitationVector[L_PAST_EXCITATION])); /* weightedInputSignal contains MAXIMUM_INT_PITCH_DELAY values from previous frame, points to current frame  */
+
+	/*** find the open loop pitch delay ***/
+	uint16_t openLoopPitchDelay = findOpenLoopPitchDelay(&(encoderChannelContext->weightedInputSignal[MAXIMUM_INT_PITCH_DELAY]));
+
+	/*** Compute the impulse responses : filter a subframe long buffer filled with unit and only zero through the 1/weightedqLPCoefficients as in spec A.3.5 ***/
+	int subframeIndex;
+	word16_t impulseResponseInput[L_SUBFRAME]; /* input buffer for the impulse response computation: in Q12, 1 followed by all zeros see spec A3.5*/
+	impulseResponseInput[0] = ONE_IN_Q12;
+	memset(&(impulseResponseInput[1]), 0, (L_SUBFRAME-1)*sizeof(word16_t));
+	for (subframeIndex=0; subframeIndex<L_FRAME; subframeIndex+=L_SUBFRAME) {
+		word16_t impulseResponseBuffer[NB_LSP_COEFF+L_SUBFRAME]; /* impulseResponseBuffer in Q12, need NB_LSP_COEFF as past value to go through filtering function */
+		memset(impulseResponseBuffer, 0, (NB_LSP_COEFF)*sizeof(word16_t)); /* set the past values to zero */
+		synthesisFilter(impulseResponseInput, &(weightedqLPCoefficients[subframeIndex==0?0:NB_LSP_COEFF]), &(impulseResponseBuffer[NB_LSP_COEFF]));
+		memcpy(&(impulseResponses[subframeIndex]), &(impulseResponseBuffer[NB_LSP_COEFF]), L_SUBFRAME*sizeof(word16_t));
+	}
+
+	/*** Closed loop searches on the two subframes and bitStream output ***/
+	encodeSubframes(encoderChannelContext, weightedqLPCoefficients, openLoopPitchDelay, impulseResponses, parameters, bitStream);
+
+	/*****************************************************************************************/
+	/*** frame basis memory updates                                                        ***/
+	/* shift left by L_FRAME the signal buffer */
+	memmove(encoderChannelContext->signalBuffer, &(encoderChannelContext->signalBuffer[L_FRAME]), (L_LP_ANALYSIS_WINDOW-L_FRAME)*sizeof(word16_t)); 
+	/* update previousLSP coefficient buffer */
+	memcpy(encoderChannelContext->previousLSPCoefficients, LSPCoefficients, NB_LSP_COEFF*sizeof(word16_t));
+	/* shift left by L_FRAME the weightedInputSignal buffer */
+	memmove(encoderChannelContext->weightedInputSignal, &(encoderChannelContext->weightedInputSignal[L_FRAME]), MAXIMUM_INT_PITCH_DELAY*sizeof(word16_t));
+
+	return;
+}
+
+/*****************************************************************************/
+/* computeqLPCoefficients : interpolate the qLSP for the first subframe,    */
+/*      convert them to qLP and compute the weighted qLP                     */
+/*    parameters:                                                            */
+/*      -(i/o) encoderChannelContext : context for this encoder channel      */
+/*      -(i) qLSPCoefficients : the quantized LSP coefficients in Q15        */
+/*      -(o) qLPCoefficients : 20 qLP coefficients in Q12, 10 per subframe   */
+/*      -(o) weightedqLPCoefficients : 20 weighted qLP coefficients in Q12   */
+/*                                                                           */
+/*****************************************************************************/
+static void computeqLPCoefficients(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t qLSPCoefficients[], word16_t qLPCoefficients[], word16_t weightedqLPCoefficients[])
+{
+	int i;
+	word16_t interpolatedqLSP[NB_LSP_COEFF]; /* the interpolated qLSP used for first subframe in Q15 */
+
 	/*** interpolate qLSP and convert to LP ***/
 	interpolateqLSP(encoderChannelContext->previousqLSPCoefficients, qLSPCoefficients, interpolatedqLSP);
 	/* copy the currentqLSP to previousqLSP buffer */
@@ -157,12 +226,29 @@ void bcg729Encoder(bcg729EncoderChannelContextStruct *encoderChannelContext, int
 	weightedqLPCoefficients[17] = MULT16_16_P15(qLPCoefficients[17], GAMMA_E8);
 	weightedqLPCoefficients[18] = MULT16_16_P15(qLPCoefficients[18], GAMMA_E9);
 	weightedqLPCoefficients[19] = MULT16_16_P15(qLPCoefficients[19], GAMMA_E10);
+}
 
-	/*** Compute weighted signal according to spec A3.3.3, this function also set LPResidualSignal(entire frame values) as specified in eq A.3 in excitationVector[L_PAST_EXCITATION] ***/
-	computeWeightedSpeech(encoderChannelContext->signalCurrentFrame, qLPCoefficients, weightedqLPCoefficients, &(encoderChannelContext->weightedInputSignal[MAXIMUM_INT_PITCH_DELAY]), &(encoderChannelContext->excitationVector[L_PAST_EXCITATION])); /* weightedInputSignal contains MAXIMUM_INT_PITCH_DELAY values from previous frame, points to current frame  */
-
-	/*** find the open loop pitch delay ***/
-	uint16_t openLoopPitchDelay = findOpenLoopPitchDelay(&(encoderChannelContext->weightedInputSignal[MAXIMUM_INT_PITCH_DELAY]));
+/*****************************************************************************/
+/* encodeSubframes : closed loop searches on the two subframes once the     */
+/*      frame basis analysis is done, then output the bitStream              */
+/*    parameters:                                                            */
+/*      -(i/o) encoderChannelContext : context for this encoder channel,     */
+/*             excitationVector[L_PAST_EXCITATION] holds the LP residual     */
+/*             signal of the frame                                           */
+/*      -(i) weightedqLPCoefficients : 20 weighted qLP coefficients in Q12   */
+/*      -(i) openLoopPitchDelay : the open loop pitch delay in range         */
+/*           [20, 143]                                                       */
+/*      -(i/o) impulseResponses : the 40 values impulse response of the      */
+/*             weighted synthesis filter for each subframe in Q12, modified  */
+/*             by the fixed codebook search                                  */
+/*      -(i/o) parameters : the 15 parameters, L0 to L3 are already set      */
+/*      -(o) bitStream : The 15 parameters for a frame on 80 bits            */
+/*           on 80 bits (10 8bits words)                                     */
+/*                                                                           */
+/*****************************************************************************/
+static void encodeSubframes(bcg729EncoderChannelContextStruct *encoderChannelContext, word16_t weightedqLPCoefficients[], uint16_t openLoopPitchDelay, word16_t impulseResponses[], uint16_t parameters[], uint8_t bitStream[])
+{
+	int i;
 
 	/* define boundaries for closed loop pitch delay search as specified in 3.7 */
 	int16_t intPitchDelayMin = openLoopPitchDelay-3;
@@ -181,16 +267,8 @@ void bcg729Encoder(bcg729EncoderChannelContextStruct *encoderChannelContext, int
 	int subframeIndex;
 	int LPCoefficientsIndex = 0;
 	int parametersIndex = 4; /* index to insert parameters in the parameters output array */
-	word16_t impulseResponseInput[L_SUBFRAME]; /* input buffer for the impulse response computation: in Q12, 1 followed by all zeros see spec A3.5*/
-	impulseResponseInput[0] = ONE_IN_Q12;
-	memset(&(impulseResponseInput[1]), 0, (L_SUBFRAME-1)*sizeof(word16_t));
 
 	for (subframeIndex=0; subframeIndex<L_FRAME; subframeIndex+=L_SUBFRAME) {
-		/*** Compute the impulse response : filter a subframe long buffer filled with unit and only zero through the 1/weightedqLPCoefficients as in spec A.3.5 ***/
-		word16_t impulseResponseBuffer[NB_LSP_COEFF+L_SUBFRAME]; /* impulseResponseBuffer in Q12, need NB_LSP_COEFF as past value to go through filtering function */
-		memset(impulseResponseBuffer, 0, (NB_LSP_COEFF)*sizeof(word16_t)); /* set the past values to zero */
-		synthesisFilter(impulseResponseInput, &(weightedqLPCoefficients[LPCoefficientsIndex]), &(impulseResponseBuffer[NB_LSP_COEFF]));
-	
 		/*** Compute the target signal (x[n]) as in spec A.3.6 in Q0 ***/
 		/* excitationVector[L_PAST_EXCITATION+subframeIndex] currently store in Q0 the LPResidualSignal as in spec A.3.3 eq A.3*/
 		synthesisFilter( &(encoderChannelContext->excitationVector[L_PAST_EXCITATION+subframeIndex]), &(weightedqLPCoefficients[LPCoefficientsIndex]), &(encoderChannelContext->targetSignal[NB_LSP_COEFF]));
@@ -198,7 +276,7 @@ void bcg729Encoder(bcg729EncoderChannelContextStruct *encoderChannelContext, int
 		/*** Adaptative Codebook search : compute the intPitchDelay, fracPitchDelay and associated parameter, compute also the adaptative codebook vector used to generate the excitation ***/
 		/* after this call, the excitationVector[L_PAST_EXCITATION + subFrameIndex] contains the adaptative codebook vector as in spec 3.7.1 */
 		int16_t intPitchDelay, fracPitchDelay;
-		adaptativeCodebookSearch(&(encoderChannelContext->excitationVector[L_PAST_EXCITATION + subframeIndex]), &intPitchDelayMin, &intPitchDelayMax, &(impulseResponseBuffer[NB_LSP_COEFF]), &(encoderChannelContext->targetSignal[NB_LSP_COEFF]),
+		adaptativeCodebookSearch(&(encoderChannelContext->excitationVector[L_PAST_EXCITATION + subframeIndex]), &intPitchDelayMin, &intPitchDelayMax, &(impulseResponses[subframeIndex]), &(encoderChannelContext->targetSignal[NB_LSP_COEFF]),
 			&intPitchDelay, &fracPitchDelay, &(parameters[parametersIndex]), subframeIndex);
 
 		/*** Compute adaptative codebook gain spec 3.7.3, result in Q14 ***/
@@ -224,7 +302,7 @@ void bcg729Encoder(bcg729EncoderChannelContextStruct *encoderChannelContext, int
 		/*** Fixed Codebook Search : compute the parameters for fixed codebook and the regular and convolved version of the fixed codebook vector ***/
 		word16_t fixedCodebookVector[L_SUBFRAME]; /* in Q13 */
 		word16_t convolvedFixedCodebookVector[L_SUBFRAME]; /* in Q12 */
-		fixedCodebookSearch(&(encoderChannelContext->targetSignal[NB_LSP_COEFF]), &(impulseResponseBuffer[NB_LSP_COEFF]), intPitchDelay, encoderChannelContext->lastQuantizedAdaptativeCodebookGain, &(filteredAdaptativeCodebookVector[NB_LSP_COEFF]), adaptativeCodebookGain,
+		fixedCodebookSearch(&(encoderChannelContext->targetSignal[NB_LSP_COEFF]), &(impulseResponses[subframeIndex]), intPitchDelay, encoderChannelContext->lastQuantizedAdaptativeCodebookGain, &(filteredAdaptativeCodebookVector[NB_LSP_COEFF]), adaptativeCodebookGain,
 			&(parameters[parametersIndex]), &(parameters[parametersIndex+1]), fixedCodebookVector, convolvedFixedCodebookVector);
 		parametersIndex+=2;
 
@@ -258,20 +336,238 @@ void bcg729Encoder(bcg729EncoderChannelContextStruct *encoderChannelContext, int
 		}
 	}
 
-	/*****************************************************************************************/
-	/*** frame basis memory updates                                                        ***/
-	/* shift left by L_FRAME the signal buffer */
-	memmove(encoderChannelContext->signalBuffer, &(encoderChannelContext->signalBuffer[L_FRAME]), (L_LP_ANALYSIS_WINDOW-L_FRAME)*sizeof(word16_t)); 
-	/* update previousLSP coefficient buffer */
-	memcpy(encoderChannelContext->previousLSPCoefficients, LSPCoefficients, NB_LSP_COEFF*sizeof(word16_t));
-	memcpy(encoderChannelContext->previousqLSPCoefficients, qLSPCoefficients, NB_LSP_COEFF*sizeof(word16_t));
-	/* shift left by L_FRAME the weightedInputSignal buffer */
-	memmove(encoderChannelContext->weightedInputSignal, &(encoderChannelContext->weightedInputSignal[L_FRAME]), MAXIMUM_INT_PITCH_DELAY*sizeof(word16_t));
 	/* shift left by L_FRAME the excitationVector */
 	memmove(encoderChannelContext->excitationVector, &(encoderChannelContext->excitationVector[L_FRAME]), L_PAST_EXCITATION*sizeof(word16_t));
 
 	/*** Convert array of parameters into bitStream ***/
 	parametersArray2BitStream(parameters, bitStream);
+}
 
-	return;
+/*****************************************************************************/
+/* initBcg729EncoderMultiChannel : create a batch of encoder channels        */
+/*    parameters:                                                            */
+/*      -(i) nbChannels : number of channels in the batch                    */
+/*    return value :                                                         */
+/*      - the batch context data, NULL on allocation failure                */
+/*                                                                           */
+/*****************************************************************************/
+bcg729EncoderMultiChannelContextStruct *initBcg729EncoderMultiChannel(int nbChannels)
+{
+	int i;
+	bcg729EncoderMultiChannelContextStruct *encoderMultiChannelContext;
+
+	if (nbChannels<=0) return NULL;
+	encoderMultiChannelContext = malloc(sizeof(bcg729EncoderMultiChannelContextStruct));
+	if (encoderMultiChannelContext == NULL) return NULL;
+
+	encoderMultiChannelContext->nbChannels = nbChannels;
+	encoderMultiChannelContext->nbLanesContexts = (nbChannels+BCG729_ENCODER_LANES-1)/BCG729_ENCODER_LANES;
+	encoderMultiChannelContext->channels = malloc(nbChannels*sizeof(bcg729EncoderChannelContextStruct));
+	encoderMultiChannelContext->lanesContexts = malloc(encoderMultiChannelContext->nbLanesContexts*sizeof(bcg729EncoderLanesContextStruct));
+	if (encoderMultiChannelContext->channels==NULL || encoderMultiChannelContext->lanesContexts==NULL) {
+		closeBcg729EncoderMultiChannel(encoderMultiChannelContext);
+		return NULL;
+	}
+
+	/* lanes not mapped to a channel stay at zero */
+	memset(encoderMultiChannelContext->lanesContexts, 0, encoderMultiChannelContext->nbLanesContexts*sizeof(bcg729EncoderLanesContextStruct));
+	for (i=0; i<nbChannels; i++) {
+		resetBcg729EncoderMultiChannel(encoderMultiChannelContext, i);
+	}
+
+	return encoderMultiChannelContext;
+}
+
+/*****************************************************************************/
+/* closeBcg729EncoderMultiChannel : free memory of a batch context           */
+/*    parameters:                                                            */
+/*      -(i) encoderMultiChannelContext : the batch context data             */
+/*                                                                           */
+/*****************************************************************************/
+void closeBcg729EncoderMultiChannel(bcg729EncoderMultiChannelContextStruct *encoderMultiChannelContext)
+{
+	if (encoderMultiChannelContext == NULL) return;
+	free(encoderMultiChannelContext->channels);
+	free(encoderMultiChannelContext->lanesContexts);
+	free(encoderMultiChannelContext);
+}
+
+/*****************************************************************************/
+/* resetBcg729EncoderMultiChannel : reset one channel of a batch so it can   */
+/*      be reused for a new stream                                           */
+/*    parameters:                                                            */
+/*      -(i/o) encoderMultiChannelContext : the batch context data           */
+/*      -(i) channel : index of the channel in [0, nbChannels[               */
+/*                                                                           */
+/*****************************************************************************/
+void resetBcg729EncoderMultiChannel(bcg729EncoderMultiChannelContextStruct *encoderMultiChannelContext, int channel)
+{
+	int i;
+	bcg729EncoderLanesContextStruct *encoderLanesContext = &(encoderMultiChannelContext->lanesContexts[channel/BCG729_ENCODER_LANES]);
+	int lane = channel%BCG729_ENCODER_LANES;
+
+	initEncoderChannelContext(&(encoderMultiChannelContext->channels[channel]));
+	initPreProcessingMultiChannel(encoderLanesContext, lane);
+	/* the past signal and weighted signal of the channel are stored in the lanes context */
+	for (i=0; i<L_LP_ANALYSIS_WINDOW; i++) {
+		encoderLanesContext->signalBuffer[i][lane] = 0;
+	}
+	for (i=0; i<MAXIMUM_INT_PITCH_DELAY+L_FRAME; i++) {
+		encoderLanesContext->weightedInputSignal[i][lane] = 0;
+	}
+}
+
+/*****************************************************************************/
+/* bcg729EncoderMultiChannel : encode one frame on every channel of a batch  */
+/*      gives the same bitStreams than calling bcg729Encoder on each channel */
+/*    parameters:                                                            */
+/*      -(i/o) encoderMultiChannelContext : the batch context data           */
+/*      -(i) inputFrames : nbChannels*80 samples (16 bits PCM), the 80       */
+/*           samples of channel 0 followed by the ones of channel 1...       */
+/*      -(o) bitStreams : nbChannels*10 bytes, the 80 bits of each channel   */
+/*           one after the other                                             */
+/*                                                                           */
+/*****************************************************************************/
+void bcg729EncoderMultiChannel(bcg729EncoderMultiChannelContextStruct *encoderMultiChannelContext, int16_t inputFrames[], uint8_t bitStreams[])
+{
+	int i;
+
+	for (i=0; i<encoderMultiChannelContext->nbLanesContexts; i++) {
+		int firstChannel = i*BCG729_ENCODER_LANES;
+		int nbLanes = encoderMultiChannelContext->nbChannels - firstChannel;
+		if (nbLanes>BCG729_ENCODER_LANES) {
+			nbLanes = BCG729_ENCODER_LANES;
+		}
+		encodeLanes(&(encoderMultiChannelContext->lanesContexts[i]), &(encoderMultiChannelContext->channels[firstChannel]), nbLanes, &(inputFrames[firstChannel*L_FRAME]), &(bitStreams[firstChannel*10]));
+	}
+}
+
+/*****************************************************************************/
+/* encodeLanes : encode one frame on the channels of a lanes context.        */
+/*      The stages running the same computation whatever the data are done  */
+/*      on all the lanes at once, the data dependent ones lane by lane using */
+/*      the same functions than bcg729Encoder                                */
+/*    parameters:                                                            */
+/*      -(i/o) encoderLanesContext : the lanes context data                  */
+/*      -(i/o) encoderChannelContexts : the contexts of the channels mapped  */
+/*             to the lanes                                                  */
+/*      -(i) nbLanes : number of channels mapped to lanes in [1, 8]          */
+/*      -(i) inputFrames : nbLanes*80 samples (16 bits PCM)                  */
+/*      -(o) bitStreams : nbLanes*10 bytes                                   */
+/*                                                                           */
+/*****************************************************************************/
+static void encodeLanes(bcg729EncoderLanesContextStruct *encoderLanesContext, bcg729EncoderChannelContextStruct *encoderChannelContexts, int nbLanes, int16_t inputFrames[], uint8_t bitStreams[])
+{
+	int i,j,l;
+	int L0;
+	int subframeIndex;
+	uint16_t parameters[BCG729_ENCODER_LANES][NB_PARAMETERS]; /* the output parameters of each lane */
+	word16_t weightedqLPCoefficients[BCG729_ENCODER_LANES][2*NB_LSP_COEFF]; /* the weighted qLP coefficients of each lane in Q12 */
+
+	/*****************************************************************************************/
+	/*** on frame basis : preProcessing, the input frames are transposed to get one lane per channel ***/
+	for (l=0; l<nbLanes; l++) {
+		for (i=0; i<L_FRAME; i++) {
+			encoderLanesContext->inputSignal[i][l] = inputFrames[l*L_FRAME+i];
+		}
+	}
+	preProcessingMultiChannel(encoderLanesContext);
+
+	/*** LP Analysis: windowing and autocorrelation on all the lanes, Levinson-Durbin and LSP computation lane by lane ***/
+	computeAutoCorrelationMultiChannel(encoderLanesContext);
+	for (l=0; l<nbLanes; l++) {
+		bcg729EncoderChannelContextStruct *encoderChannelContext = &(encoderChannelContexts[l]);
+		word64_t autoCorrelationCoefficients[NB_LSP_COEFF+1];
+		word16_t LPCoefficients[NB_LSP_COEFF]; /* the LP coefficients in Q3.12 */
+		word16_t LSPCoefficients[NB_LSP_COEFF]; /* the LSP coefficients in Q15 */
+		word16_t weights[NB_LSP_COEFF];
+		word16_t targetVector[L0_RANGE][NB_LSP_COEFF];
+
+		for (i=0; i<NB_LSP_COEFF+1; i++) {
+			autoCorrelationCoefficients[i] = encoderLanesContext->autoCorrelationCoefficients[i][l];
+		}
+		autoCorrelation2LP(autoCorrelationCoefficients, LPCoefficients);
+		/*** compute LSP: it might fail, get the previous one in this case ***/
+		if (!LP2LSPConversion(LPCoefficients, LSPCoefficients)) {
+			memcpy(LSPCoefficients, encoderChannelContext->previousLSPCoefficients, NB_LSP_COEFF*sizeof(word16_t));
+		}
+		/* previousLSP is not used after this point: update it now */
+		memcpy(encoderChannelContext->previousLSPCoefficients, LSPCoefficients, NB_LSP_COEFF*sizeof(word16_t));
+
+		/*** LSPQuantization first step: the codebooks searches inputs ***/
+		computeLSPQuantizationTargets(encoderChannelContext, LSPCoefficients, weights, targetVector);
+		for (i=0; i<NB_LSP_COEFF; i++) {
+			encoderLanesContext->LSPWeights[i][l] = weights[i];
+			for (L0=0; L0<L0_RANGE; L0++) {
+				encoderLanesContext->LSPTargetVectors[L0][i][l] = targetVector[L0][i];
+			}
+		}
+	}
+
+	/*** LSPQuantization: codebooks searches on all the lanes, then select the quantized LSP and compute the qLP lane by lane ***/
+	searchLSPCodebooksMultiChannel(encoderLanesContext);
+	for (l=0; l<nbLanes; l++) {
+		bcg729EncoderChannelContextStruct *encoderChannelContext = &(encoderChannelContexts[l]);
+		word16_t weights[NB_LSP_COEFF];
+		word16_t targetVector[L0_RANGE][NB_LSP_COEFF];
+		word16_t L1index[L0_RANGE], L2index[L0_RANGE], L3index[L0_RANGE];
+		word16_t qLSPCoefficients[NB_LSP_COEFF]; /* the quantized LSP coefficients in Q15 */
+		word16_t qLPCoefficients[2*NB_LSP_COEFF]; /* the quantized LP coefficients in Q3.12 */
+
+		for (i=0; i<NB_LSP_COEFF; i++) {
+			weights[i] = encoderLanesContext->LSPWeights[i][l];
+			for (L0=0; L0<L0_RANGE; L0++) {
+				targetVector[L0][i] = encoderLanesContext->LSPTargetVectors[L0][i][l];
+			}
+		}
+		for (L0=0; L0<L0_RANGE; L0++) {
+			L1index[L0] = encoderLanesContext->L1index[L0][l];
+			L2index[L0] = encoderLanesContext->L2index[L0][l];
+			L3index[L0] = encoderLanesContext->L3index[L0][l];
+		}
+		selectLSPQuantization(encoderChannelContext, weights, targetVector, L1index, L2index, L3index, qLSPCoefficients, parameters[l]);
+
+		computeqLPCoefficients(encoderChannelContext, qLSPCoefficients, qLPCoefficients, weightedqLPCoefficients[l]);
+		for (j=0; j<2*NB_LSP_COEFF; j++) {
+			encoderLanesContext->qLPCoefficients[j][l] = qLPCoefficients[j];
+			encoderLanesContext->weightedqLPCoefficients[j][l] = weightedqLPCoefficients[l][j];
+		}
+	}
+
+	/*** weighted speech and open loop pitch search on all the lanes, the LP residual signal goes to the channel excitationVector as in bcg729Encoder ***/
+	computeWeightedSpeechMultiChannel(encoderLanesContext);
+	for (l=0; l<nbLanes; l++) {
+		for (i=0; i<L_FRAME; i++) {
+			encoderChannelContexts[l].excitationVector[L_PAST_EXCITATION+i] = encoderLanesContext->LPResidualSignal[i][l];
+		}
+	}
+	findOpenLoopPitchDelayMultiChannel(encoderLanesContext);
+
+	/*** impulse responses on all the lanes: filter a unit followed by zeros through 1/weightedqLPCoefficients as in spec A.3.5 ***/
+	word16_t impulseResponseInput[L_SUBFRAME][BCG729_ENCODER_LANES]; /* in Q12 */
+	memset(impulseResponseInput, 0, sizeof(impulseResponseInput));
+	for (l=0; l<BCG729_ENCODER_LANES; l++) {
+		impulseResponseInput[0][l] = ONE_IN_Q12;
+	}
+	for (subframeIndex=0; subframeIndex<L_FRAME; subframeIndex+=L_SUBFRAME) {
+		synthesisFilterMultiChannel(impulseResponseInput, &(encoderLanesContext->weightedqLPCoefficients[subframeIndex==0?0:NB_LSP_COEFF]), &(encoderLanesContext->impulseResponses[subframeIndex==0?0:1][NB_LSP_COEFF])); /* the first NB_LSP_COEFF values stay at zero */
+	}
+
+	/*****************************************************************************************/
+	/*** closed loop searches depend on each channel pitch: lane by lane ***/
+	for (l=0; l<nbLanes; l++) {
+		word16_t impulseResponses[2*L_SUBFRAME];
+		for (i=0; i<L_SUBFRAME; i++) {
+			impulseResponses[i] = encoderLanesContext->impulseResponses[0][NB_LSP_COEFF+i][l];
+			impulseResponses[L_SUBFRAME+i] = encoderLanesContext->impulseResponses[1][NB_LSP_COEFF+i][l];
+		}
+		encodeSubframes(&(encoderChannelContexts[l]), weightedqLPCoefficients[l], encoderLanesContext->openLoopPitchDelay[l], impulseResponses, parameters[l], &(bitStreams[l*10]));
+	}
+
+	/*****************************************************************************************/
+	/*** frame basis memory updates of the lanes context                                   ***/
+	/* shift left by L_FRAME the signal buffer */
+	memmove(encoderLanesContext->signalBuffer, &(encoderLanesContext->signalBuffer[L_FRAME]), (L_LP_ANALYSIS_WINDOW-L_FRAME)*sizeof(encoderLanesContext->signalBuffer[0]));
+	/* shift left by L_FRAME the weightedInputSignal buffer */
+	memmove(encoderLanesContext->weightedInputSignal, &(encoderLanesContext->weightedInputSignal[L_FRAME]), MAXIMUM_INT_PITCH_DELAY*sizeof(encoderLanesContext->weightedInputSignal[0]));
 }
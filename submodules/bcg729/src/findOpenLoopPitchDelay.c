@@ -25,6 +25,7 @@
 #include "codecParameters.h"
 #include "basicOperationsMacros.h"
 #include "utils.h"
+#include "simdKernels.h"
 #include "g729FixedPointMath.h"
 
 /* local functions prototypes */
@@ -32,6 +33,8 @@
 word32_t getCorrelationMax(uint16_t *index, word16_t inputSignal[], uint16_t rangeOpen, uint16_t rangeClose, uint16_t step);
 /* compute eqA.4 from spec3.4 */
 word32_t getCorrelation(word16_t inputSignal[], uint16_t index); 
+/* end of the search once the correlation maximum of each range is found */
+static uint16_t selectOpenLoopPitchDelay(word16_t scaledWeightedInputSignal[], uint16_t indexRange1, word32_t correlationMaxRange1, uint16_t indexRange2, word32_t correlationMaxRange2, uint16_t indexRange3Even, word32_t correlationMaxRange3);
 
 /*****************************************************************************/
 /* findOpenLoopPitchDelay : as specified in specA3.4                         */
@@ -50,10 +53,7 @@ uint16_t findOpenLoopPitchDelay(word16_t weightedInputSignal[])
 	word16_t *scaledWeightedInputSignal; /* points to the begining of present frame either scaled or directly the input signal */
 
 	/* compute on 64 bits the autocorrelation on the input signal and if needed scale to have it on 32 bits */
-	word64_t autocorrelation = 0;
-	for (i=-MAXIMUM_INT_PITCH_DELAY; i<L_FRAME; i++) {
-		autocorrelation = MAC64(autocorrelation, weightedInputSignal[i], weightedInputSignal[i]);
-	}
+	word64_t autocorrelation = DOT16_16_64(&(weightedInputSignal[-MAXIMUM_INT_PITCH_DELAY]), &(weightedInputSignal[-MAXIMUM_INT_PITCH_DELAY]), MAXIMUM_INT_PITCH_DELAY+L_FRAME);
 	if (autocorrelation>MAXINT32) {
 		scaledWeightedInputSignal = &(scaledWeightedInputSignalBuffer[MAXIMUM_INT_PITCH_DELAY]);
 		int overflowScale = PSHR(31-countLeadingZeros((word32_t)(autocorrelation>>31)),1); /* count number of bits needed over the 31 bits allowed and divide by 2 to get the right scaling for the signal */
@@ -67,11 +67,106 @@ uint16_t findOpenLoopPitchDelay(word16_t weightedInputSignal[])
 
 
 	/*** compute the correlationMax in the different ranges ***/
-	uint16_t indexRange1=0, indexRange2=0, indexRange3Even=0, indexRange3;
+	uint16_t indexRange1=0, indexRange2=0, indexRange3Even=0;
 	word32_t correlationMaxRange1 = getCorrelationMax(&indexRange1, scaledWeightedInputSignal, 20, 39, 1);
 	word32_t correlationMaxRange2 = getCorrelationMax(&indexRange2, scaledWeightedInputSignal, 40, 79, 1);
 	word32_t correlationMaxRange3 = getCorrelationMax(&indexRange3Even, scaledWeightedInputSignal, 80, 143, 2);
-	indexRange3 = indexRange3Even;
+
+	return selectOpenLoopPitchDelay(scaledWeightedInputSignal, indexRange1, correlationMaxRange1, indexRange2, correlationMaxRange2, indexRange3Even, correlationMaxRange3);
+}
+
+/*****************************************************************************/
+/* findOpenLoopPitchDelayMultiChannel : same as findOpenLoopPitchDelay on    */
+/*      all the lanes of a lanes context at once: the correlations of each  */
+/*      delay are computed for all the lanes                                 */
+/*    paremeters:                                                            */
+/*      -(i/o) encoderLanesContext : the lanes context data, input read from */
+/*             weightedInputSignal, output in openLoopPitchDelay             */
+/*                                                                           */
+/*****************************************************************************/
+LANES_VECTORISED void findOpenLoopPitchDelayMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext)
+{
+	int i,l;
+	uint16_t range, index;
+	static const uint16_t ranges[3][3] = {{20, 39, 1}, {40, 79, 1}, {80, 143, 2}}; /* rangeOpen, rangeClose and step as in findOpenLoopPitchDelay */
+
+	/*** scale the signal to avoid overflows, see findOpenLoopPitchDelay. A lane not needing it gets a 0 scale ***/
+	word16_t scaledWeightedInputSignalBuffer[MAXIMUM_INT_PITCH_DELAY+L_FRAME][BCG729_ENCODER_LANES];
+	word16_t (*scaledWeightedInputSignal)[BCG729_ENCODER_LANES] = &(scaledWeightedInputSignalBuffer[MAXIMUM_INT_PITCH_DELAY]); /* points to the beginning of present frame */
+	word64_t autocorrelation[BCG729_ENCODER_LANES];
+	word16_t overflowScale[BCG729_ENCODER_LANES];
+	for (l=0; l<BCG729_ENCODER_LANES; l++) {
+		autocorrelation[l] = 0;
+	}
+	for (i=0; i<MAXIMUM_INT_PITCH_DELAY+L_FRAME; i++) {
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			autocorrelation[l] = ADD64_32(autocorrelation[l], MULT16_16(encoderLanesContext->weightedInputSignal[i][l], encoderLanesContext->weightedInputSignal[i][l]));
+		}
+	}
+	for (l=0; l<BCG729_ENCODER_LANES; l++) {
+		overflowScale[l] = (autocorrelation[l]>MAXINT32)?PSHR(31-countLeadingZeros((word32_t)(autocorrelation[l]>>31)),1):0;
+	}
+	for (i=0; i<MAXIMUM_INT_PITCH_DELAY+L_FRAME; i++) {
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			scaledWeightedInputSignalBuffer[i][l] = SHR(encoderLanesContext->weightedInputSignal[i][l], overflowScale[l]);
+		}
+	}
+
+	/*** compute the correlationMax in the different ranges: eqA.4 Sum(inputSignal[2*i]*inputSignal[2*i-index]) ***/
+	uint16_t indexRange[3][BCG729_ENCODER_LANES];
+	word32_t correlationMaxRange[3][BCG729_ENCODER_LANES];
+	for (range=0; range<3; range++) {
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			indexRange[range][l] = 0;
+			correlationMaxRange[range][l] = MININT32;
+		}
+		for (index=ranges[range][0]; index<=ranges[range][1]; index+=ranges[range][2]) {
+			word32_t correlation[BCG729_ENCODER_LANES];
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				correlation[l] = 0;
+			}
+			for (i=0; i<L_FRAME; i+=2) {
+				for (l=0; l<BCG729_ENCODER_LANES; l++) {
+					correlation[l] = MAC16_16(correlation[l], scaledWeightedInputSignal[i][l], scaledWeightedInputSignal[i-index][l]);
+				}
+			}
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				int isGreater = correlation[l]>correlationMaxRange[range][l];
+				correlationMaxRange[range][l] = isGreater?correlation[l]:correlationMaxRange[range][l];
+				indexRange[range][l] = isGreater?index:indexRange[range][l];
+			}
+		}
+	}
+
+	/*** the end of the search only computes a few correlations around the maximums found: lane by lane ***/
+	for (l=0; l<BCG729_ENCODER_LANES; l++) {
+		word16_t laneScaledWeightedInputSignal[MAXIMUM_INT_PITCH_DELAY+L_FRAME];
+		for (i=0; i<MAXIMUM_INT_PITCH_DELAY+L_FRAME; i++) {
+			laneScaledWeightedInputSignal[i] = scaledWeightedInputSignalBuffer[i][l];
+		}
+		encoderLanesContext->openLoopPitchDelay[l] = selectOpenLoopPitchDelay(&(laneScaledWeightedInputSignal[MAXIMUM_INT_PITCH_DELAY]), indexRange[0][l], correlationMaxRange[0][l], indexRange[1][l], correlationMaxRange[1][l], indexRange[2][l], correlationMaxRange[2][l]);
+	}
+}
+
+/*****************************************************************************/
+/* selectOpenLoopPitchDelay : end of findOpenLoopPitchDelay once the         */
+/*      correlation maximum of each range is found: refine the third range,  */
+/*      normalise and pick the delay                                         */
+/*    paremeters:                                                            */
+/*      -(i) scaledWeightedInputSignal: 223 values in Q0, buffer             */
+/*           accessed in range [-MAXIMUM_INT_PITCH_DELAY(143), L_FRAME(80)[  */
+/*      -(i) indexRange1, correlationMaxRange1 : index and value of the      */
+/*           correlation maximum in [20, 39]                                 */
+/*      -(i) indexRange2, correlationMaxRange2 : same in [40, 79]            */
+/*      -(i) indexRange3Even, correlationMaxRange3 : same on the even        */
+/*           indexes in [80, 143]                                            */
+/*    return value:                                                          */
+/*      - the openLoopIntegerPitchDelay in Q0 range [20, 143]                */
+/*                                                                           */
+/*****************************************************************************/
+static uint16_t selectOpenLoopPitchDelay(word16_t scaledWeightedInputSignal[], uint16_t indexRange1, word32_t correlationMaxRange1, uint16_t indexRange2, word32_t correlationMaxRange2, uint16_t indexRange3Even, word32_t correlationMaxRange3)
+{
+	uint16_t indexRange3 = indexRange3Even;
 	/* for the third range, correlationMax shall be computed at +1 and -1 around the maximum found as described in spec A3.4 */
 	word32_t correlationMaxRange3Odd;
 	if (indexRange3>80) { /* don't test value out of range [80, 143] */
@@ -154,15 +249,8 @@ uint16_t findOpenLoopPitchDelay(word16_t weightedInputSignal[])
 /*****************************************************************************/
 word32_t getCorrelation(word16_t inputSignal[], uint16_t index) 
 {
-	int i,j=-index; /* i will be the [2*i] index and j the [2*i-index] in eqA.4 */
-	
-	word32_t correlation = 0;
-	
-	for (i=0; i<L_FRAME; i+=2,j+=2) {
-		correlation = MAC16_16(correlation, inputSignal[i], inputSignal[j]);
-	}
-
-	return correlation;
+	/* Sum(inputSignal[2*i]*inputSignal[2*i-index]) */
+	return DOT16_16_EVEN(inputSignal, &(inputSignal[-index]), L_FRAME);
 }
 
 /*****************************************************************************/
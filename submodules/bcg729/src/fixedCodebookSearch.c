@@ -23,6 +23,7 @@
 #include "codecParameters.h"
 #include "basicOperationsMacros.h"
 #include "utils.h"
+#include "simdKernels.h"
 #include <stdlib.h>
 
 #include "fixedCodebookSearch.h"
@@ -70,10 +71,7 @@ void fixedCodebookSearch(word16_t targetSignal[], word16_t impulseResponse[], in
 	word32_t correlationSignalMax = 0;
 	/* compute on 32 bits and get the maximum */
 	for (n=0; n<L_SUBFRAME; n++) {
-		correlationSignal32[n] = 0;
-		for (i=n; i<L_SUBFRAME; i++) {
-			correlationSignal32[n] = MAC16_16(correlationSignal32[n], fixedCodebookTargetSignal[i], impulseResponse[i-n]);
-		}
+		correlationSignal32[n] = DOT16_16(&(fixedCodebookTargetSignal[n]), impulseResponse, L_SUBFRAME-n);
 		word32_t abscCrrelationSignal32 = correlationSignal32[n]>=0?correlationSignal32[n]:-correlationSignal32[n];
 		if (abscCrrelationSignal32>correlationSignalMax) {
 			correlationSignalMax = abscCrrelationSignal32;
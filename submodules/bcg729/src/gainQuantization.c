@@ -23,6 +23,7 @@
 #include "codecParameters.h"
 #include "basicOperationsMacros.h"
 #include "utils.h"
+#include "simdKernels.h"
 #include "codebooks.h"
 
 #include "gainQuantization.h"
@@ -60,12 +61,9 @@ void gainQuantization(bcg729EncoderChannelContextStruct *encoderChannelContext,
 
 	/*** compute spec 3.9 eq63 terms first on 64 bits and then scale them if needed to fit on 32 ***/
 	/* Xy64 and Yy64 already computed during adaptativeCodebookGain computation */
-	word64_t xz64=0, yz64=0, zz64=0;
-	for (i=0; i<L_SUBFRAME; i++) {
-		xz64 = MAC64(xz64, targetSignal[i], convolvedFixedCodebookVector[i]); /* in Q12 */
-		yz64 = MAC64(yz64, filteredAdaptativeCodebookVector[i], convolvedFixedCodebookVector[i]); /* in Q12 */
-		zz64 = MAC64(zz64, convolvedFixedCodebookVector[i], convolvedFixedCodebookVector[i]); /* in Q24 */
-	}
+	word64_t xz64 = DOT16_16_64(targetSignal, convolvedFixedCodebookVector, L_SUBFRAME); /* in Q12 */
+	word64_t yz64 = DOT16_16_64(filteredAdaptativeCodebookVector, convolvedFixedCodebookVector, L_SUBFRAME); /* in Q12 */
+	word64_t zz64 = DOT16_16_64(convolvedFixedCodebookVector, convolvedFixedCodebookVector, L_SUBFRAME); /* in Q24 */
 	
 	/* now scale this terms to have them fit on 32 bits - terms Xy, Xz and Yz shall fit on 31 bits because used in eq63 with a factor 2 */
 	word32_t xy = SHR64(((xy64<0)?-xy64:xy64),30);
@@ -21,6 +21,7 @@
 #include "typedef.h"
 #include "codecParameters.h"
 #include "basicOperationsMacros.h"
+#include "simdKernels.h"
 
 #include "preProcessing.h"
 
@@ -94,3 +95,51 @@ void preProcessing(bcg729EncoderChannelContextStruct *encoderChannelContext, wor
 	}
 	return;
 }
+
+/* Initialization of one lane of a lanes context */
+void initPreProcessingMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext, int lane) {
+	encoderLanesContext->outputY2[lane] = 0;
+	encoderLanesContext->outputY1[lane] = 0;
+	encoderLanesContext->inputX0[lane] = 0;
+	encoderLanesContext->inputX1[lane] = 0;
+}
+
+/*****************************************************************************/
+/* preProcessingMultiChannel : 2nd order highpass filter on all the lanes    */
+/*    parameters :                                                           */
+/*      -(i/o) encoderLanesContext : the lanes context data, input is read   */
+/*             from inputSignal, output written in the last input frame of   */
+/*             signalBuffer                                                  */
+/*                                                                           */
+/*****************************************************************************/
+LANES_VECTORISED void preProcessingMultiChannel(bcg729EncoderLanesContextStruct *encoderLanesContext) {
+	int i,l;
+	word16_t *inputX0 = encoderLanesContext->inputX0;
+	word16_t *inputX1 = encoderLanesContext->inputX1;
+	word32_t *outputY1 = encoderLanesContext->outputY1;
+	word32_t *outputY2 = encoderLanesContext->outputY2;
+
+	for(i=0; i<L_FRAME; i++) {
+		word16_t *signal = encoderLanesContext->inputSignal[i];
+		word16_t *preProcessedSignal = encoderLanesContext->signalBuffer[L_LP_ANALYSIS_WINDOW-L_FRAME+i];
+
+		/* same computation than preProcessing, see comments there */
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			word16_t inputX2 = inputX1[l];
+			inputX1[l] = inputX0[l];
+			inputX0[l] = signal[l];
+
+			word32_t acc = MULT16_32_Q12(A1, outputY1[l]);
+			acc = MAC16_32_Q12(acc, A2, outputY2[l]);
+			acc = MAC16_16(acc, inputX0[l], B0);
+			acc = MAC16_16(acc, inputX1[l], B1);
+			acc = MAC16_16(acc, inputX2, B2);
+			acc = SATURATE(acc, MAXINT28);
+
+			preProcessedSignal[l] = PSHR(acc,12);
+			outputY2[l] = outputY1[l];
+			outputY1[l] = acc;
+		}
+	}
+	return;
+}
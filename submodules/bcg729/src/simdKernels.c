@@ -0,0 +1,335 @@
+/*
+ simdKernels.c
+
+ Copyright (C) 2011 Belledonne Communications, Grenoble, France
+ Author : Johan Pascal
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "typedef.h"
+#include "codecParameters.h"
+#include "basicOperationsMacros.h"
+
+#include "simdKernels.h"
+
+/* x86 kernels are compiled with target attributes and selected according to cpuid, no specific compiler flag is needed */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BCG729_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/* NEON availability is known at compile time (always there on aarch64, armv7 build with -mfpu=neon) */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BCG729_KERNELS_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+/*** scalar implementations: reference ones, used when no SIMD is available ***/
+static word32_t dot16_16Scalar(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	word32_t acc = 0;
+	for (i=0; i<length; i++) {
+		acc = MAC16_16(acc, x[i], y[i]);
+	}
+	return acc;
+}
+
+static word32_t dot16_16EvenScalar(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	word32_t acc = 0;
+	for (i=0; i<length; i+=2) {
+		acc = MAC16_16(acc, x[i], y[i]);
+	}
+	return acc;
+}
+
+static word64_t dot16_16_64Scalar(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	word64_t acc = 0;
+	for (i=0; i<length; i++) {
+		acc = MAC64(acc, x[i], y[i]);
+	}
+	return acc;
+}
+
+#ifdef BCG729_KERNELS_X86
+/*** SSE4.1: pmaddwd for the 32 bits sums, pmulld and sign extension to 64 bits for the 64 bits ones ***/
+/* horizontal sums are performed on unsigned to get the wrap around of MAC16_16 without relying on signed overflow */
+__attribute__((target("sse4.1"))) static uword32_t hsum32SSE41(__m128i acc)
+{
+	return (uword32_t)_mm_extract_epi32(acc, 0) + (uword32_t)_mm_extract_epi32(acc, 1) + (uword32_t)_mm_extract_epi32(acc, 2) + (uword32_t)_mm_extract_epi32(acc, 3);
+}
+
+__attribute__((target("sse4.1"))) static word32_t dot16_16SSE41(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	__m128i acc = _mm_setzero_si128();
+	for (i=0; i+8<=length; i+=8) {
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)&x[i]), _mm_loadu_si128((const __m128i *)&y[i])));
+	}
+	uword32_t sum = hsum32SSE41(acc);
+	for (; i<length; i++) {
+		sum += (uword32_t)MULT16_16(x[i], y[i]);
+	}
+	return (word32_t)sum;
+}
+
+__attribute__((target("sse4.1"))) static word32_t dot16_16EvenSSE41(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	const __m128i evenMask = _mm_set1_epi32(0x0000ffff); /* keep lanes 0, 2, 4, 6 */
+	__m128i acc = _mm_setzero_si128();
+	for (i=0; i+8<=length; i+=8) {
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_and_si128(_mm_loadu_si128((const __m128i *)&x[i]), evenMask), _mm_loadu_si128((const __m128i *)&y[i])));
+	}
+	uword32_t sum = hsum32SSE41(acc);
+	for (; i<length; i+=2) {
+		sum += (uword32_t)MULT16_16(x[i], y[i]);
+	}
+	return (word32_t)sum;
+}
+
+__attribute__((target("sse4.1"))) static word64_t dot16_16_64SSE41(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	__m128i acc = _mm_setzero_si128();
+	for (i=0; i+4<=length; i+=4) {
+		__m128i product = _mm_mullo_epi32(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)&x[i])), _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)&y[i]))); /* exact on 32 bits */
+		acc = _mm_add_epi64(acc, _mm_cvtepi32_epi64(product));
+		acc = _mm_add_epi64(acc, _mm_cvtepi32_epi64(_mm_srli_si128(product, 8)));
+	}
+	word64_t lanes[2]; /* no 64 bits extraction on i386 */
+	_mm_storeu_si128((__m128i *)lanes, acc);
+	word64_t sum = lanes[0] + lanes[1];
+	for (; i<length; i++) {
+		sum = MAC64(sum, x[i], y[i]);
+	}
+	return sum;
+}
+
+/*** AVX2: same as SSE4.1 on 256 bits registers ***/
+__attribute__((target("avx2"))) static uword32_t hsum32AVX2(__m256i acc)
+{
+	__m128i acc128 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(1,0,3,2)));
+	acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(2,3,0,1)));
+	return (uword32_t)_mm_cvtsi128_si32(acc128);
+}
+
+__attribute__((target("avx2"))) static word32_t dot16_16AVX2(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	__m256i acc = _mm256_setzero_si256();
+	for (i=0; i+16<=length; i+=16) {
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)&x[i]), _mm256_loadu_si256((const __m256i *)&y[i])));
+	}
+	uword32_t sum = hsum32AVX2(acc);
+	if (i+8<=length) {
+		__m128i acc128 = _mm_madd_epi16(_mm_loadu_si128((const __m128i *)&x[i]), _mm_loadu_si128((const __m128i *)&y[i]));
+		acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(1,0,3,2)));
+		acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(2,3,0,1)));
+		sum += (uword32_t)_mm_cvtsi128_si32(acc128);
+		i += 8;
+	}
+	for (; i<length; i++) {
+		sum += (uword32_t)MULT16_16(x[i], y[i]);
+	}
+	return (word32_t)sum;
+}
+
+__attribute__((target("avx2"))) static word32_t dot16_16EvenAVX2(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	const __m256i evenMask = _mm256_set1_epi32(0x0000ffff);
+	__m256i acc = _mm256_setzero_si256();
+	for (i=0; i+16<=length; i+=16) {
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_and_si256(_mm256_loadu_si256((const __m256i *)&x[i]), evenMask), _mm256_loadu_si256((const __m256i *)&y[i])));
+	}
+	uword32_t sum = hsum32AVX2(acc);
+	for (; i<length; i+=2) {
+		sum += (uword32_t)MULT16_16(x[i], y[i]);
+	}
+	return (word32_t)sum;
+}
+
+__attribute__((target("avx2"))) static word64_t dot16_16_64AVX2(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	__m256i acc = _mm256_setzero_si256();
+	for (i=0; i+8<=length; i+=8) {
+		__m256i product = _mm256_mullo_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&x[i])), _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&y[i]))); /* exact on 32 bits */
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(product)));
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(product, 1)));
+	}
+	word64_t lanes[2];
+	_mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+	word64_t sum = lanes[0] + lanes[1];
+	for (; i<length; i++) {
+		sum = MAC64(sum, x[i], y[i]);
+	}
+	return sum;
+}
+#endif /* BCG729_KERNELS_X86 */
+
+#ifdef BCG729_KERNELS_ARM_NEON
+/*** NEON: vmlal on 32 bits lanes (wrap around as MAC16_16), vmull then pairwise add to 64 bits lanes for MAC64 ***/
+static uword32_t hsum32NEON(int32x4_t acc)
+{
+	uint32x4_t uacc = vreinterpretq_u32_s32(acc);
+	return vgetq_lane_u32(uacc, 0) + vgetq_lane_u32(uacc, 1) + vgetq_lane_u32(uacc, 2) + vgetq_lane_u32(uacc, 3);
+}
+
+static word32_t dot16_16NEON(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	int32x4_t acc = vdupq_n_s32(0);
+	for (i=0; i+8<=length; i+=8) {
+		int16x8_t x8 = vld1q_s16(&x[i]);
+		int16x8_t y8 = vld1q_s16(&y[i]);
+		acc = vmlal_s16(acc, vget_low_s16(x8), vget_low_s16(y8));
+		acc = vmlal_s16(acc, vget_high_s16(x8), vget_high_s16(y8));
+	}
+	uword32_t sum = hsum32NEON(acc);
+	for (; i<length; i++) {
+		sum += (uword32_t)MULT16_16(x[i], y[i]);
+	}
+	return (word32_t)sum;
+}
+
+static word32_t dot16_16EvenNEON(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	int32x4_t acc = vdupq_n_s32(0);
+	for (i=0; i+16<=length; i+=16) {
+		int16x8_t x8 = vld2q_s16(&x[i]).val[0]; /* deinterleave: val[0] holds the even samples */
+		int16x8_t y8 = vld2q_s16(&y[i]).val[0];
+		acc = vmlal_s16(acc, vget_low_s16(x8), vget_low_s16(y8));
+		acc = vmlal_s16(acc, vget_high_s16(x8), vget_high_s16(y8));
+	}
+	uword32_t sum = hsum32NEON(acc);
+	for (; i<length; i+=2) {
+		sum += (uword32_t)MULT16_16(x[i], y[i]);
+	}
+	return (word32_t)sum;
+}
+
+static word64_t dot16_16_64NEON(const word16_t x[], const word16_t y[], int length)
+{
+	int i;
+	int64x2_t acc = vdupq_n_s64(0);
+	for (i=0; i+8<=length; i+=8) {
+		int16x8_t x8 = vld1q_s16(&x[i]);
+		int16x8_t y8 = vld1q_s16(&y[i]);
+		acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(x8), vget_low_s16(y8))); /* products are exact on 32 bits */
+		acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(x8), vget_high_s16(y8)));
+	}
+	word64_t sum = vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1);
+	for (; i<length; i++) {
+		sum = MAC64(sum, x[i], y[i]);
+	}
+	return sum;
+}
+#endif /* BCG729_KERNELS_ARM_NEON */
+
+/* default to the scalar implementation until the first selection */
+bcg729KernelsStruct bcg729Kernels = {
+	BCG729_KERNELS_SCALAR,
+	dot16_16Scalar,
+	dot16_16EvenScalar,
+	dot16_16_64Scalar
+};
+
+static int bcg729KernelsSelected = 0;
+
+/* return the best implementation available on this CPU */
+static int getBestBcg729Kernels(void)
+{
+#ifdef BCG729_KERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return BCG729_KERNELS_AVX2;
+	if (__builtin_cpu_supports("sse4.1")) return BCG729_KERNELS_SSE41;
+#endif
+#ifdef BCG729_KERNELS_ARM_NEON
+	return BCG729_KERNELS_NEON;
+#endif
+	return BCG729_KERNELS_SCALAR;
+}
+
+/*****************************************************************************/
+/* selectBcg729Kernels : select the dot products implementation              */
+/*    parameters:                                                            */
+/*      -(i) level: one of BCG729_KERNELS_XXX                                */
+/*    return value:                                                          */
+/*      - the level actually selected                                        */
+/*                                                                           */
+/*****************************************************************************/
+int selectBcg729Kernels(int level)
+{
+	int best = getBestBcg729Kernels();
+	if (level == BCG729_KERNELS_AUTO) {
+		level = best;
+	}
+	bcg729KernelsSelected = 1;
+
+	switch (level) {
+#ifdef BCG729_KERNELS_X86
+		case BCG729_KERNELS_AVX2:
+			if (best != BCG729_KERNELS_AVX2) break;
+			bcg729Kernels.dot16_16 = dot16_16AVX2;
+			bcg729Kernels.dot16_16Even = dot16_16EvenAVX2;
+			bcg729Kernels.dot16_16_64 = dot16_16_64AVX2;
+			bcg729Kernels.level = level;
+			return level;
+		case BCG729_KERNELS_SSE41:
+			if (best != BCG729_KERNELS_AVX2 && best != BCG729_KERNELS_SSE41) break;
+			bcg729Kernels.dot16_16 = dot16_16SSE41;
+			bcg729Kernels.dot16_16Even = dot16_16EvenSSE41;
+			bcg729Kernels.dot16_16_64 = dot16_16_64SSE41;
+			bcg729Kernels.level = level;
+			return level;
+#endif
+#ifdef BCG729_KERNELS_ARM_NEON
+		case BCG729_KERNELS_NEON:
+			bcg729Kernels.dot16_16 = dot16_16NEON;
+			bcg729Kernels.dot16_16Even = dot16_16EvenNEON;
+			bcg729Kernels.dot16_16_64 = dot16_16_64NEON;
+			bcg729Kernels.level = level;
+			return level;
+#endif
+		default:
+			break;
+	}
+
+	bcg729Kernels.dot16_16 = dot16_16Scalar;
+	bcg729Kernels.dot16_16Even = dot16_16EvenScalar;
+	bcg729Kernels.dot16_16_64 = dot16_16_64Scalar;
+	bcg729Kernels.level = BCG729_KERNELS_SCALAR;
+	return BCG729_KERNELS_SCALAR;
+}
+
+/*****************************************************************************/
+/* initBcg729Kernels : select the best implementation unless one was already */
+/*      explicitely selected                                                 */
+/*                                                                           */
+/*****************************************************************************/
+void initBcg729Kernels(void)
+{
+	if (!bcg729KernelsSelected) {
+		selectBcg729Kernels(BCG729_KERNELS_AUTO);
+	}
+}
@@ -24,6 +24,7 @@
 #include "codecParameters.h"
 #include "g729FixedPointMath.h"
 #include "codebooks.h"
+#include "simdKernels.h"
 
 /*****************************************************************************/
 /* insertionSort : sort an array in growing order using insertion algorithm  */
@@ -127,6 +128,38 @@ void synthesisFilter(word16_t inputSignal[], word16_t filterCoefficients[], word
 	return;
 }
 
+/*****************************************************************************/
+/* synthesisFilterMultiChannel : same filter than synthesisFilter on all the */
+/*      lanes of a lanes context at once, each lane with its own filter      */
+/*      coefficients. All buffers are sample major: buffer[n][lane]          */
+/*    parameters:                                                            */
+/*      -(i) inputSignal: 40 values per lane in Q0                           */
+/*      -(i) filterCoefficients: 10 coefficients per lane in Q12             */
+/*      -(i/o) filteredSignal: 50 values per lane in Q0 accessed in ranges   */
+/*             [-10,-1] as input and [0, 39] as output.                      */
+/*                                                                           */
+/*****************************************************************************/
+LANES_VECTORISED void synthesisFilterMultiChannel(word16_t inputSignal[][BCG729_ENCODER_LANES], word16_t filterCoefficients[][BCG729_ENCODER_LANES], word16_t filteredSignal[][BCG729_ENCODER_LANES])
+{
+	int i,j,l;
+	for (i=0; i<L_SUBFRAME; i++) {
+		word32_t acc[BCG729_ENCODER_LANES];
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			acc[l] = SHL(inputSignal[i][l],12); /* acc get the first term of the sum, in Q12 (inputSignal is in Q0)*/
+		}
+		for (j=0; j<NB_LSP_COEFF; j++) {
+			for (l=0; l<BCG729_ENCODER_LANES; l++) {
+				acc[l] = MSU16_16(acc[l], filterCoefficients[j][l], filteredSignal[i-j-1][l]); /* filterCoefficients in Q12 and signal in Q0 -> acc in Q12 */
+			}
+		}
+		for (l=0; l<BCG729_ENCODER_LANES; l++) {
+			filteredSignal[i][l] = (word16_t)SATURATE(PSHR(acc[l], 12), MAXINT16); /* shift right acc to get it back in Q0 and check overflow on 16 bits */
+		}
+	}
+
+	return;
+}
+
 /*****************************************************************************/
 /* correlateVectors : compute the correlations between two vectors of        */
 /*      L_SUBFRAME length: c[i] = Sum(x[j]*y[j-i]) j in [i, L_SUBFRAME[      */
@@ -138,12 +171,9 @@ void synthesisFilter(word16_t inputSignal[], word16_t filterCoefficients[], word
 /*****************************************************************************/
 void correlateVectors (word16_t x[], word16_t y[], word32_t c[])
 {
-	int i,j;
+	int i;
 	for (i=0; i<L_SUBFRAME; i++) {
-		c[i] = 0;
-		for (j=i; j<L_SUBFRAME; j++) {
-			c[i] = MAC16_16(c[i], x[j], y[j-i]);
-		}
+		c[i] = DOT16_16(&(x[i]), y, L_SUBFRAME-i);
 	}
 
 	return;
@@ -28,6 +28,12 @@
 /*    All arguments shall be filenames for input file                        */
 /*    output file keep the prefix and change the file extension to .out.multi*/
 /*                                                                           */
+/*    Throughput benchmark: encoderMultiChannelTest -b channels [seconds]    */
+/*    encodes a synthetic signal on the given number of channels using the   */
+/*    single channel and the batch API, check they give the same bitstreams */
+/*    (one channel is reset half way) and print the number of realtime      */
+/*    channels one core can sustain                                          */
+/*                                                                           */
 /*****************************************************************************/
 
 #include <stdio.h>
@@ -46,10 +52,101 @@
 #include "bcg729/encoder.h"
 
 #define MAX_CHANNEL_NBR 50
+
+/* fill a frame of each channel with a different synthetic signal: square wave plus noise */
+static void generateFrames(int16_t *inputFrames, int nbChannels, int frameIndex)
+{
+	int i,k;
+	for (k=0; k<nbChannels; k++) {
+		for (i=0; i<L_FRAME; i++) {
+			int sample = (((frameIndex*L_FRAME+i)/(10+k%30))&1)?6000:-6000;
+			sample += (rand()%4096)-2048;
+			inputFrames[k*L_FRAME+i] = (int16_t)sample;
+		}
+	}
+}
+
+/* run the throughput benchmark, return 0 if batch and single channel API gave the same output */
+static int benchmarkMultiChannel(int nbChannels, int seconds)
+{
+	int j,k;
+	int framesNbr = seconds*100; /* 10 ms frames */
+	int16_t *inputFrames = malloc(nbChannels*L_FRAME*sizeof(int16_t));
+	uint8_t *bitStreams = malloc(nbChannels*10);
+	uint8_t *batchBitStreams = malloc(nbChannels*10);
+	bcg729EncoderChannelContextStruct **encoderChannelContext = malloc(nbChannels*sizeof(bcg729EncoderChannelContextStruct *));
+	bcg729EncoderMultiChannelContextStruct *encoderMultiChannelContext = initBcg729EncoderMultiChannel(nbChannels);
+	double singleTime=0.0, batchTime=0.0;
+	int mismatch = 0;
+	clock_t start;
+
+	for (k=0; k<nbChannels; k++) {
+		encoderChannelContext[k] = initBcg729EncoderChannel();
+	}
+
+	srand(1);
+	for (j=0; j<framesNbr; j++) {
+		generateFrames(inputFrames, nbChannels, j);
+
+		start = clock();
+		for (k=0; k<nbChannels; k++) {
+			bcg729Encoder(encoderChannelContext[k], &(inputFrames[k*L_FRAME]), &(bitStreams[k*10]));
+		}
+		singleTime += (double)(clock() - start);
+
+		start = clock();
+		bcg729EncoderMultiChannel(encoderMultiChannelContext, inputFrames, batchBitStreams);
+		batchTime += (double)(clock() - start);
+
+		if (memcmp(bitStreams, batchBitStreams, nbChannels*10) != 0) {
+			mismatch = 1;
+		}
+
+		/* half way, recycle a channel for a new stream on both sides */
+		if (j == framesNbr/2) {
+			closeBcg729EncoderChannel(encoderChannelContext[nbChannels/2]);
+			encoderChannelContext[nbChannels/2] = initBcg729EncoderChannel();
+			resetBcg729EncoderMultiChannel(encoderMultiChannelContext, nbChannels/2);
+		}
+	}
+
+	singleTime /= CLOCKS_PER_SEC;
+	batchTime /= CLOCKS_PER_SEC;
+	/* a channel needs 100 frames per second to run in realtime */
+	printf("%d channels, %d frames each\n", nbChannels, framesNbr);
+	printf("single channel API: %f us/frame, %.1f realtime channels per core\n", singleTime*1000000/((double)framesNbr*nbChannels), ((double)framesNbr*nbChannels)/(singleTime*100));
+	printf("batch API         : %f us/frame, %.1f realtime channels per core\n", batchTime*1000000/((double)framesNbr*nbChannels), ((double)framesNbr*nbChannels)/(batchTime*100));
+	if (mismatch) {
+		printf("Error: batch and single channel API output differ\n");
+	}
+
+	for (k=0; k<nbChannels; k++) {
+		closeBcg729EncoderChannel(encoderChannelContext[k]);
+	}
+	closeBcg729EncoderMultiChannel(encoderMultiChannelContext);
+	free(encoderChannelContext);
+	free(inputFrames);
+	free(bitStreams);
+	free(batchBitStreams);
+
+	return mismatch;
+}
+
 int main(int argc, char *argv[] )
 {
 	int i,j,k;
 
+	/*** throughput benchmark mode ***/
+	if (argc>2 && strcmp(argv[1], "-b")==0) {
+		int nbChannels = atoi(argv[2]);
+		int seconds = (argc>3)?atoi(argv[3]):10;
+		if (nbChannels<=0 || seconds<=0) {
+			printf("%s - Error: usage %s -b channels [seconds]\n", argv[0], argv[0]);
+			exit(-1);
+		}
+		exit(benchmarkMultiChannel(nbChannels, seconds)?-1:0);
+	}
+
 	/*** get calling argument ***/
   	char *filePrefix[MAX_CHANNEL_NBR];
 	getArgumentsMultiChannel(argc, argv, filePrefix); /* check argument and set filePrefix if needed */
@@ -0,0 +1,160 @@
+/*
+ simdKernelsBenchmark.c
+
+ Copyright (C) 2011 Belledonne Communications, Grenoble, France
+ Author : Johan Pascal
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+/*****************************************************************************/
+/*                                                                           */
+/* Test Program for the SIMD dot products                                    */
+/*    No input: random and worst case vectors are generated                  */
+/*    - check each available implementation gives exactly the scalar result */
+/*    - check the encoder bitstream does not depend on the implementation    */
+/*    - print the time spent per call for each function and implementation   */
+/*                                                                           */
+/*    Exit with -1 if any difference is found                                */
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <time.h>
+
+#include "typedef.h"
+#include "codecParameters.h"
+#include "simdKernels.h"
+
+#include "bcg729/encoder.h"
+
+#define CHECK_LOOPS 20000
+#define BENCH_LOOPS 200000
+#define ENCODED_FRAMES 500
+#define MAX_LENGTH (MAXIMUM_INT_PITCH_DELAY+L_LP_ANALYSIS_WINDOW)
+
+static const char *levelNames[] = {"scalar", "SSE4.1", "AVX2", "NEON"};
+
+static word16_t randomSample(int worstCase)
+{
+	if (worstCase) { /* the extremes values stress the 32 bits pair sums of pmaddwd/vmlal */
+		return (rand()&1)?-32768:32767;
+	}
+	return (word16_t)(rand()&0xffff);
+}
+
+/* compare the selected implementation with the scalar one on random lengths and offsets */
+static int checkKernels(int level)
+{
+	word16_t x[MAX_LENGTH], y[MAX_LENGTH];
+	int i, loop;
+	bcg729KernelsStruct scalar;
+
+	selectBcg729Kernels(BCG729_KERNELS_SCALAR);
+	scalar = bcg729Kernels;
+	selectBcg729Kernels(level);
+
+	for (loop=0; loop<CHECK_LOOPS; loop++) {
+		int worstCase = (loop%4 == 0);
+		int length = rand()%(MAX_LENGTH/2);
+		int offset = rand()%(MAX_LENGTH/2); /* unaligned accesses */
+		for (i=0; i<MAX_LENGTH; i++) {
+			x[i] = randomSample(worstCase);
+			y[i] = randomSample(worstCase);
+		}
+		if (bcg729Kernels.dot16_16(&x[offset], y, length) != scalar.dot16_16(&x[offset], y, length)
+			|| bcg729Kernels.dot16_16Even(&x[offset], y, length) != scalar.dot16_16Even(&x[offset], y, length)
+			|| bcg729Kernels.dot16_16_64(&x[offset], y, length) != scalar.dot16_16_64(&x[offset], y, length)) {
+			printf("%s - mismatch with scalar implementation, length %d offset %d\n", levelNames[level], length, offset);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* encode a synthetic signal and store the bitstream */
+static void encodeSignal(uint8_t bitStream[ENCODED_FRAMES][10])
+{
+	int i, j;
+	int16_t inputBuffer[L_FRAME];
+	bcg729EncoderChannelContextStruct *encoderChannelContext = initBcg729EncoderChannel();
+
+	srand(1);
+	for (i=0; i<ENCODED_FRAMES; i++) {
+		for (j=0; j<L_FRAME; j++) { /* a loud square wave mixed with noise, with a few saturated frames */
+			int sample = (((i*L_FRAME+j)/20)&1)?8000:-8000;
+			sample += (rand()%8192)-4096;
+			if (i%50 == 0) sample *= 8;
+			inputBuffer[j] = (int16_t)(sample>32767?32767:(sample<-32768?-32768:sample));
+		}
+		bcg729Encoder(encoderChannelContext, inputBuffer, bitStream[i]);
+	}
+	closeBcg729EncoderChannel(encoderChannelContext);
+}
+
+static double benchmark(word32_t (*dot32)(const word16_t[], const word16_t[], int), word64_t (*dot64)(const word16_t[], const word16_t[], int), const word16_t *x, const word16_t *y, int length)
+{
+	int loop;
+	volatile word64_t sink = 0;
+	clock_t start = clock();
+	for (loop=0; loop<BENCH_LOOPS; loop++) {
+		sink += dot32?dot32(x, y, length):dot64(x, y, length);
+	}
+	return ((double)(clock()-start))*1000000000/((double)BENCH_LOOPS*CLOCKS_PER_SEC);
+}
+
+int main(int argc, char *argv[] )
+{
+	int level, i;
+	int best = selectBcg729Kernels(BCG729_KERNELS_AUTO);
+	uint8_t referenceBitStream[ENCODED_FRAMES][10];
+	uint8_t bitStream[ENCODED_FRAMES][10];
+	word16_t x[MAX_LENGTH], y[MAX_LENGTH];
+
+	printf("Best implementation available: %s\n", levelNames[best]);
+
+	selectBcg729Kernels(BCG729_KERNELS_SCALAR);
+	encodeSignal(referenceBitStream);
+
+	for (i=0; i<MAX_LENGTH; i++) {
+		x[i] = randomSample(0);
+		y[i] = randomSample(0);
+	}
+
+	printf("%-8s %14s %14s %14s %14s\n", "", "dot16_16(40)", "dot16_16(240)", "even(80)", "dot64(240)");
+	for (level=BCG729_KERNELS_SCALAR; level<=BCG729_KERNELS_NEON; level++) {
+		if (selectBcg729Kernels(level) != level) continue; /* not supported here */
+
+		if (checkKernels(level) != 0) {
+			exit(-1);
+		}
+		selectBcg729Kernels(level);
+		encodeSignal(bitStream);
+		if (memcmp(bitStream, referenceBitStream, sizeof(bitStream)) != 0) {
+			printf("%s - encoded bitstream differs from the scalar one\n", levelNames[level]);
+			exit(-1);
+		}
+
+		printf("%-8s %11.1f ns %11.1f ns %11.1f ns %11.1f ns\n", levelNames[level],
+			benchmark(bcg729Kernels.dot16_16, NULL, x, y, L_SUBFRAME),
+			benchmark(bcg729Kernels.dot16_16, NULL, x, y, L_LP_ANALYSIS_WINDOW),
+			benchmark(bcg729Kernels.dot16_16Even, NULL, x, y, L_FRAME),
+			benchmark(NULL, bcg729Kernels.dot16_16_64, x, y, L_LP_ANALYSIS_WINDOW));
+	}
+
+	exit (0);
+}
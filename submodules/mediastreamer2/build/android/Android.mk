@@ -80,12 +80,15 @@ LOCAL_SRC_FILES = \
 	audiofilters/alaw.c \
 	audiofilters/ulaw.c \
 	audiofilters/msfileplayer.c \
+	audiofilters/promptcache.c \
+	audiofilters/msencodedprompt.c \
 	audiofilters/dtmfgen.c \
 	audiofilters/msfilerec.c \
 	audiofilters/msconf.c \
 	audiofilters/msvolume.c \
 	audiofilters/equalizer.c \
 	audiofilters/tonedetector.c \
+	audiofilters/timestretch.c \
 	audiofilters/msg722.c \
 	audiofilters/l16.c \
 	audiofilters/msresample.c \
@@ -37,6 +37,9 @@ extern MSFilterDesc ms_g722_enc_desc;
 extern MSFilterDesc ms_l16_enc_desc;
 extern MSFilterDesc ms_l16_dec_desc;
 extern MSFilterDesc ms_jpeg_writer_desc;
+extern MSFilterDesc ms_time_stretch_desc;
+extern MSFilterDesc ms_encoded_player_desc;
+extern MSFilterDesc ms_encoded_rec_desc;
 #if defined(__arm__) && defined(BUILD_WEBRTC_AECM)
 extern MSFilterDesc ms_webrtc_aec_desc;
 #endif
@@ -69,6 +72,9 @@ MSFilterDesc * ms_voip_filter_descs[]={
 &ms_g722_enc_desc,
 &ms_l16_enc_desc,
 &ms_l16_dec_desc,
+&ms_time_stretch_desc,
+&ms_encoded_player_desc,
+&ms_encoded_rec_desc,
 #ifdef VIDEO_ENABLED
 &ms_mpeg4_enc_desc,
 &ms_mpeg4_dec_desc,
@@ -139,7 +139,10 @@ typedef enum MSFilterId{
 	MS_AAC_ELD_ENC_ID,
 	MS_AAC_ELD_DEC_ID,
 	MS_OPUS_ENC_ID,
-	MS_OPUS_DEC_ID
+	MS_OPUS_DEC_ID,
+	MS_TIME_STRETCH_ID,
+	MS_ENCODED_PLAYER_ID,
+	MS_ENCODED_REC_ID
 } MSFilterId;
 
 
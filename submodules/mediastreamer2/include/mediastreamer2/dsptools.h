@@ -381,6 +381,23 @@ void ms_ifft(void *table, ms_word16_t *in, ms_word16_t *out);
 /** digital filtering api*/
 void ms_fir_mem16(const ms_word16_t *x, const ms_coef_t *num, ms_word16_t *y, int N, int ord, ms_mem_t *mem);
 
+/** from this number of taps, MSFirFilter convolves in the frequency domain*/
+#define MS_FIR_FFT_MIN_TAPS 64
+
+typedef struct _MSFirFilter MSFirFilter;
+
+/** Create a FIR filter of ord taps: direct form for short filters, FFT overlap-save for long ones (floating point only).
+ * The fft size is chosen on the first ms_fir_process() call to take the whole block at once.*/
+MSFirFilter *ms_fir_new(int ord);
+
+/** Set the ord taps of the filter, the filter history is kept*/
+void ms_fir_set_coefs(MSFirFilter *obj, const ms_coef_t *num);
+
+/** Filter N samples, x and y may be the same buffer*/
+void ms_fir_process(MSFirFilter *obj, const ms_word16_t *x, ms_word16_t *y, int N);
+
+void ms_fir_destroy(MSFirFilter *obj);
+
 #ifdef __cplusplus
 }
 #endif
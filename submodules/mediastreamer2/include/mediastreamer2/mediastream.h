@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <mediastreamer2/msticker.h>
 #include <mediastreamer2/mssndcard.h>
 #include <mediastreamer2/mswebcam.h>
+#include <mediastreamer2/msfilerec.h>
 #include <mediastreamer2/msvideo.h>
 #include <mediastreamer2/bitratecontrol.h>
 #include <mediastreamer2/qualityindicator.h>
@@ -117,6 +118,12 @@ MS2_PUBLIC float media_stream_get_quality_rating(MediaStream *stream);
 
 MS2_PUBLIC float media_stream_get_average_quality_rating(MediaStream *stream);
 
+/**
+ * Creates a duplex RTP session with the settings used by the streams, bound to the given local ports.
+ * Check rtp_session_get_rtp_socket() and rtp_session_get_rtcp_socket() to know whether binding succeeded.
+**/
+MS2_PUBLIC RtpSession * ms_create_duplex_rtp_session(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6);
+
 /*shall only called internally*/
 void media_stream_iterate(MediaStream * stream);
 /**
@@ -138,6 +145,7 @@ struct _AudioStream
 	MSFilter *dtmfgen;
 	MSFilter *dtmfgen_rtp;
 	MSFilter *plc;
+	MSFilter *time_stretch;
 	MSFilter *ec;/*echo canceler*/
 	MSFilter *volsend,*volrecv; /*MSVolumes*/
 	MSFilter *read_resampler;
@@ -149,8 +157,17 @@ struct _AudioStream
 	MSFilter *recorder_mixer;
 	MSFilter *recorder;
 	char *recorder_file;
+	MSFileRecAsyncParams recorder_async; /*applied to the wav recorders of the stream when they are opened*/
+	MSFilter *relay_sink; /*relay mode: hands received payloads over to the peer stream*/
+	MSFilter *relay_source; /*relay mode: payloads coming from the peer stream, to be sent*/
+	MSFilter *relay_tee;
+	MSFilter *relay_tap; /*relay mode: filter consuming the decoded audio, if any*/
+	MSFilter *prompt_player; /*prompt mode: MSEncodedPlayer feeding rtpsend*/
+	MSFilter *prompt_sink; /*prompt mode: discards the received payloads*/
+	OrtpArena *arena; /*region holding the filters of a full graph, NULL if allocated from the heap (always for relay and prompt streams)*/
 	uint64_t last_packet_count;
 	time_t last_packet_time;
+	uint64_t last_rtcp_count; /*received_packets of the RTCP summary at the last audio_stream_iterate()*/
 	EchoLimiterType el_type; /*use echo limiter: two MSVolume, measured input level controlling local output level*/
 	uint32_t features;
 	bool_t play_dtmfs;
@@ -206,6 +223,110 @@ MS2_PUBLIC int audio_stream_start_full(AudioStream *stream, RtpProfile *profile,
 	MSSndCard *playcard, MSSndCard *captcard, bool_t use_ec);
 
 
+/**
+ * Starts an audio stream in relay mode, for a leg of a call bridged to another one using the same codec.
+ *
+ * No sound card, file, encoder or decoder is involved: received payloads are handed over as is to the peer stream set with
+ * audio_stream_relay_link(), which sends them with its own SSRC, sequence numbers and timestamps, and with their payload
+ * type renumbered as negotiated on its side (comfort noise, for instance, stays comfort noise).
+ * There is no jitter buffer on a relay stream: packets are forwarded as they arrive and the endpoints' jitter buffers
+ * absorb the jitter of the whole path, rather than adding one jitter buffer delay per hop.
+ * The received audio is only decoded when a tap is set with audio_stream_relay_set_tap().
+ *
+ * @param stream an AudioStream previously created with audio_stream_new().
+ * @param profile a RtpProfile containing all PayloadType possible during the audio session.
+ * @param rem_rtp_ip remote IP address where to send the audio.
+ * @param rem_rtp_port remote IP port where to send the audio.
+ * @param rem_rtcp_ip remote IP address for RTCP.
+ * @param rem_rtcp_port remote port for RTCP.
+ * @param payload payload type index of the main codec, it must be the one used by the peer stream.
+ * @returns 0 if sucessful, -1 otherwise.
+**/
+MS2_PUBLIC int audio_stream_start_relay(AudioStream *stream, RtpProfile *profile, const char *rem_rtp_ip, int rem_rtp_port,
+	const char *rem_rtcp_ip, int rem_rtcp_port, int payload);
+
+/**
+ * Forwards the payloads received by each of two relay streams to the other one.
+ * Both streams must have been started with audio_stream_start_relay().
+**/
+MS2_PUBLIC void audio_stream_relay_link(AudioStream *st1, AudioStream *st2);
+
+/**
+ * Stops forwarding payloads between two relay streams. Must be called before stopping any of them.
+**/
+MS2_PUBLIC void audio_stream_relay_unlink(AudioStream *st1, AudioStream *st2);
+
+/**
+ * Sets the filter that shall receive the decoded audio of a relay stream, or NULL to stop decoding.
+ * The decoder is only created and run while a tap is set. The tap is run by the stream's ticker and stays owned by the caller;
+ * as there is no jitter buffer, it receives the audio as the packets arrive, without loss concealment.
+ * The decoder follows the payload type changes of the received stream. Setting or removing a tap restarts the receiver,
+ * which discards the packets waiting in its socket.
+ * @returns 0 if sucessful, -1 otherwise.
+**/
+MS2_PUBLIC int audio_stream_relay_set_tap(AudioStream *stream, MSFilter *tap);
+
+/**
+ * Starts an audio stream that sends a pre-encoded prompt (see msencodedprompt.h), for hold music or announcements.
+ *
+ * The payloads of the prompt go as is to the RTP sender: there is no sound card, resampler, volume or encoder.
+ * The prompt is shared by all the streams of the process playing it. Received packets are discarded, RTCP keeps working.
+ *
+ * @param stream an AudioStream previously created with audio_stream_new().
+ * @param profile a RtpProfile containing all PayloadType possible during the audio session.
+ * @param rem_rtp_ip remote IP address where to send the encoded audio.
+ * @param rem_rtp_port remote IP port where to send the encoded audio.
+ * @param rem_rtcp_ip remote IP address for RTCP.
+ * @param rem_rtcp_port remote port for RTCP.
+ * @param payload payload type index to use for the sending stream, its mime type and clock rate must be the prompt's ones.
+ * @param file the pre-encoded prompt.
+ * @param loop_interval -1 to play the prompt once, otherwise delay in milliseconds before playing it again.
+ * @returns 0 if sucessful, -1 otherwise.
+**/
+MS2_PUBLIC int audio_stream_start_prompt(AudioStream *stream, RtpProfile *profile, const char *rem_rtp_ip, int rem_rtp_port,
+	const char *rem_rtcp_ip, int rem_rtcp_port, int payload, const char *file, int loop_interval);
+
+/**
+ * A graph template holds a stream configuration (codec, sound cards, echo canceller, features) and a set of
+ * streams built ahead from it: filters created, configured and linked, codecs initialized.
+ * Setting up a call from it only binds the rtp sockets, points the session to the remote end and attaches the graph to a ticker.
+**/
+typedef struct _AudioStreamTemplate AudioStreamTemplate;
+
+/**
+ * Creates a graph template, see audio_stream_start_full() for the parameters.
+ * @param features the AUDIO_STREAM_FEATURE_* of the streams built from the template.
+ * @returns the template, or NULL if the payload type is not in the profile.
+**/
+MS2_PUBLIC AudioStreamTemplate *audio_stream_template_new(RtpProfile *profile, int payload, int jitt_comp,
+	MSSndCard *playcard, MSSndCard *captcard, bool_t use_ec, uint32_t features);
+
+/**
+ * Builds streams ahead until count of them are waiting, typically between calls.
+ * @returns the number of streams waiting.
+**/
+MS2_PUBLIC int audio_stream_template_fill(AudioStreamTemplate *tpl, int count);
+
+/**
+ * Takes a pre-built stream from the template, building one if none is left, and binds its rtp session to the local ports.
+ * The stream can be configured like one returned by audio_stream_new(), except for what decides which filters
+ * are in the graph: features, echo canceller and sound cards are the template's ones.
+ * @returns the stream, to be started with audio_stream_template_start() and stopped with audio_stream_stop().
+**/
+MS2_PUBLIC AudioStream *audio_stream_template_instantiate(AudioStreamTemplate *tpl, int loc_rtp_port, int loc_rtcp_port, bool_t ipv6);
+
+/**
+ * Starts a stream returned by audio_stream_template_instantiate().
+ * @returns 0 if sucessful, -1 otherwise.
+**/
+MS2_PUBLIC int audio_stream_template_start(AudioStream *stream, const char *rem_rtp_ip, int rem_rtp_port,
+	const char *rem_rtcp_ip, int rem_rtcp_port);
+
+/**
+ * Destroys the template and the streams still waiting in it. Streams already instantiated are not affected.
+**/
+MS2_PUBLIC void audio_stream_template_destroy(AudioStreamTemplate *tpl);
+
 MS2_PUBLIC void audio_stream_play(AudioStream *st, const char *name);
 MS2_PUBLIC void audio_stream_record(AudioStream *st, const char *name);
 
@@ -224,6 +345,13 @@ MS2_PUBLIC void audio_stream_play_received_dtmfs(AudioStream *st, bool_t yesno);
 **/
 MS2_PUBLIC AudioStream *audio_stream_new(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6);
 
+/**
+ * Creates an AudioStream object around an existing RTP session, for instance one bound ahead of time.
+ * @param session a duplex session, typically made by ms_create_duplex_rtp_session(). The stream takes it over and destroys it when stopped.
+ * @returns a new AudioStream.
+**/
+MS2_PUBLIC AudioStream *audio_stream_new_with_session(RtpSession *session);
+
 #define AUDIO_STREAM_FEATURE_PLC 		(1 << 0)
 #define AUDIO_STREAM_FEATURE_EC 		(1 << 1)
 #define AUDIO_STREAM_FEATURE_EQUALIZER		(1 << 2)
@@ -232,6 +360,7 @@ MS2_PUBLIC AudioStream *audio_stream_new(int loc_rtp_port, int loc_rtcp_port, bo
 #define AUDIO_STREAM_FEATURE_DTMF		(1 << 5)
 #define AUDIO_STREAM_FEATURE_DTMF_ECHO		(1 << 6)
 #define AUDIO_STREAM_FEATURE_MIXED_RECORDING	(1 << 7)
+#define AUDIO_STREAM_FEATURE_TIME_STRETCH	(1 << 8)
 
 #define AUDIO_STREAM_FEATURE_ALL	(\
 					AUDIO_STREAM_FEATURE_PLC | \
@@ -241,7 +370,8 @@ MS2_PUBLIC AudioStream *audio_stream_new(int loc_rtp_port, int loc_rtcp_port, bo
 					AUDIO_STREAM_FEATURE_VOL_RCV | \
 					AUDIO_STREAM_FEATURE_DTMF | \
 					AUDIO_STREAM_FEATURE_DTMF_ECHO |\
-					AUDIO_STREAM_FEATURE_MIXED_RECORDING \
+					AUDIO_STREAM_FEATURE_MIXED_RECORDING |\
+					AUDIO_STREAM_FEATURE_TIME_STRETCH \
 					)
 
 
@@ -326,6 +456,12 @@ MS2_PUBLIC int audio_stream_mixed_record_start(AudioStream *st);
 
 MS2_PUBLIC int audio_stream_mixed_record_stop(AudioStream *st);
 
+/**
+ * Sets the asynchronous writing parameters of the wav recorders of the stream, that is the one used by
+ * audio_stream_record() and the mixed recorder. They are applied the next time a file is opened.
+**/
+MS2_PUBLIC void audio_stream_set_recorder_async_params(AudioStream *st, const MSFileRecAsyncParams *params);
+
 MS2_PUBLIC void audio_stream_set_default_card(int cardindex);
 
 /* retrieve RTP statistics*/
@@ -32,5 +32,9 @@ typedef struct MSAudioMixerCtl{
 #define MS_AUDIO_MIXER_SET_INPUT_GAIN			MS_FILTER_METHOD(MS_AUDIO_MIXER_ID,0,MSAudioMixerCtl)
 #define MS_AUDIO_MIXER_SET_ACTIVE				MS_FILTER_METHOD(MS_AUDIO_MIXER_ID,1,MSAudioMixerCtl)
 #define MS_AUDIO_MIXER_ENABLE_CONFERENCE_MODE	MS_FILTER_METHOD(MS_AUDIO_MIXER_ID,2,int)
+/**number of loudest channels mixed together, 0 (default) to mix all channels*/
+#define MS_AUDIO_MIXER_SET_ACTIVE_SPEAKERS		MS_FILTER_METHOD(MS_AUDIO_MIXER_ID,3,int)
+/**level in dB relative to full scale under which a channel is considered silent and skipped*/
+#define MS_AUDIO_MIXER_SET_NOISE_FLOOR			MS_FILTER_METHOD(MS_AUDIO_MIXER_ID,4,float)
 
 #endif
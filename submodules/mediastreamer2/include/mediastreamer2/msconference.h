@@ -37,6 +37,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 **/
 struct _MSAudioConferenceParams{
 	int samplerate; /**< Conference audio sampling rate in Hz: 8000, 16000 ...*/
+	int max_speakers; /**< Number of loudest participants mixed together, 0 to mix everybody*/
+	float noise_floor; /**< Level in dB relative to full scale under which a participant is not mixed, 0 to disable*/
 };
 
 /**
@@ -195,6 +197,15 @@ MS2_PUBLIC int ms_audio_recorder_endpoint_start(MSAudioEndpoint *ep, const char
 **/
 MS2_PUBLIC int ms_audio_recorder_endpoint_stop(MSAudioEndpoint *ep);
 
+/**
+ * Sets how the recorder endpoint writes to disk, applied the next time recording is started.
+ * Recorder endpoints write asynchronously by default so that disk stalls do not hold up the conference mixer.
+ * @param ep the endpoint
+ * @param params the asynchronous writing parameters, with a buffer_size of 0 to write synchronously.
+ * @return 0 if successful, -1 if the endpoint isn't a recorder endpoint.
+**/
+MS2_PUBLIC int ms_audio_recorder_endpoint_set_async_params(MSAudioEndpoint *ep, const MSFileRecAsyncParams *params);
+
 /**
  * Destroy an audio endpoint.
  * @note Endpoints created by ms_audio_endpoint_get_from_stream() must be released by ms_audio_endpoint_release_from_stream().
@@ -0,0 +1,55 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006  Simon MORLAT (simon.morlat@linphone.org)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef msencodedprompt_h
+#define msencodedprompt_h
+
+#include <mediastreamer2/msfilter.h>
+
+/**
+ * Pre-encoded prompts hold the payloads produced once by an encoder (G.711, G.729, Opus, Speex...), so that
+ * announcements and hold music are given as is to MSRtpSend, without any resampling, volume or encoding cost.
+ * MSEncodedRec writes them from an encoder's output, MSEncodedPlayer plays them. The player shares the loaded file
+ * with all the other players of the process, like MSFilePlayer (see ms_file_player_cache_set_max_file_size()).
+ *
+ * File format, integers are little endian:
+ * - header: "MSEP", uint16 version (1), uint16 reserved, uint32 clock rate, char mime_type[16] (NUL padded)
+ * - then for each payload: uint16 size, uint16 duration in clock rate units, payload.
+**/
+
+#define MS_ENCODED_PROMPT_MIME_SIZE 16
+
+/*MSEncodedPlayer methods, the clock rate of the opened prompt is given by MS_FILTER_GET_SAMPLE_RATE*/
+#define MS_ENCODED_PLAYER_OPEN	MS_FILTER_METHOD(MS_ENCODED_PLAYER_ID,0,const char)
+#define MS_ENCODED_PLAYER_START	MS_FILTER_METHOD_NO_ARG(MS_ENCODED_PLAYER_ID,1)
+#define MS_ENCODED_PLAYER_STOP	MS_FILTER_METHOD_NO_ARG(MS_ENCODED_PLAYER_ID,2)
+#define MS_ENCODED_PLAYER_CLOSE	MS_FILTER_METHOD_NO_ARG(MS_ENCODED_PLAYER_ID,3)
+/* loop mode, as for MSFilePlayer: -1 no looping, x>=0 loop x milliseconds after eof*/
+#define MS_ENCODED_PLAYER_LOOP	MS_FILTER_METHOD(MS_ENCODED_PLAYER_ID,4,int)
+/* mime type of the opened prompt, to be checked against the payload type of the stream*/
+#define MS_ENCODED_PLAYER_GET_MIME_TYPE	MS_FILTER_METHOD(MS_ENCODED_PLAYER_ID,5,const char *)
+
+#define MS_ENCODED_PLAYER_EOF	MS_FILTER_EVENT_NO_ARG(MS_ENCODED_PLAYER_ID,0)
+
+/*MSEncodedRec methods, the mime type and clock rate (MS_FILTER_SET_SAMPLE_RATE) must be set before opening*/
+#define MS_ENCODED_REC_OPEN	MS_FILTER_METHOD(MS_ENCODED_REC_ID,0,const char)
+#define MS_ENCODED_REC_CLOSE	MS_FILTER_METHOD_NO_ARG(MS_ENCODED_REC_ID,1)
+#define MS_ENCODED_REC_SET_MIME_TYPE	MS_FILTER_METHOD(MS_ENCODED_REC_ID,2,const char)
+
+#endif
@@ -35,9 +35,32 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define MS_FILE_PLAYER_LOOP	MS_FILTER_METHOD(MS_FILE_PLAYER_ID,4,int)
 #define MS_FILE_PLAYER_DONE	MS_FILTER_METHOD(MS_FILE_PLAYER_ID,5,int)
 #define MS_FILE_PLAYER_BIG_BUFFER	MS_FILTER_METHOD(MS_FILE_PLAYER_ID,6,int)
+/* rate at which a wav file served from the prompt cache is resampled once, to be set before opening it.
+	0 (default) keeps the file's rate. MS_FILTER_GET_SAMPLE_RATE returns the rate actually played.*/
+#define MS_FILE_PLAYER_SET_CACHED_RATE	MS_FILTER_METHOD(MS_FILE_PLAYER_ID,7,int)
 
 /*events*/
 #define MS_FILE_PLAYER_EOF	MS_FILTER_EVENT_NO_ARG(MS_FILE_PLAYER_ID,0)
 
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * The file players share a process-wide cache of the wav files they play: each prompt is loaded once
+ * and played by any number of players without I/O nor copies.
+ * Files whose samples exceed this size (1 MB by default) are read from disk, 0 disables the cache.
+**/
+MS2_PUBLIC void ms_file_player_cache_set_max_file_size(int bytes);
+
+/**
+ * Releases the cached prompts not being played.
+**/
+MS2_PUBLIC void ms_file_player_cache_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
 
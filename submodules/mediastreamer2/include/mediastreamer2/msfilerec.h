@@ -28,6 +28,35 @@ extern MSFilterDesc ms_file_rec_desc;
 #define MS_FILE_REC_STOP	MS_FILTER_METHOD_NO_ARG(MS_FILE_REC_ID,2)
 #define MS_FILE_REC_CLOSE	MS_FILTER_METHOD_NO_ARG(MS_FILE_REC_ID,3)
 
+typedef enum _MSFileRecFsyncPolicy{
+	MSFileRecFsyncNever,
+	MSFileRecFsyncOnClose,
+	MSFileRecFsyncPeriodic /**< fsync and update the wav header every sync_interval*/
+} MSFileRecFsyncPolicy;
+
+/**
+ * Parameters of the asynchronous recording mode: audio is batched into large buffers
+ * that a background thread, shared by all recorders, writes to disk.
+**/
+typedef struct _MSFileRecAsyncParams{
+	int buffer_size; /**< size in bytes of the batches handed to the writer thread, 0 to write synchronously (default)*/
+	int max_pending; /**< number of batches that may wait for the writer before incoming audio is dropped*/
+	MSFileRecFsyncPolicy fsync_policy;
+	int sync_interval; /**< time in ms between two periodic syncs*/
+} MSFileRecAsyncParams;
+
+typedef struct _MSFileRecStats{
+	uint64_t bytes_written;
+	uint64_t bytes_dropped; /**< audio lost because the writer could not keep up*/
+	int batches_written;
+	int overruns; /**< number of times the pending batches limit was reached*/
+	int max_pending; /**< highest number of batches waiting for the writer*/
+} MSFileRecStats;
+
+/*to be called before MS_FILE_REC_OPEN*/
+#define MS_FILE_REC_SET_ASYNC_PARAMS	MS_FILTER_METHOD(MS_FILE_REC_ID,4,MSFileRecAsyncParams)
+#define MS_FILE_REC_GET_STATS		MS_FILTER_METHOD(MS_FILE_REC_ID,5,MSFileRecStats)
+
 
 
 #endif
@@ -73,6 +73,10 @@ MS2_PUBLIC void ms_queue_flush(MSQueue *q);
 
 MS2_PUBLIC void ms_queue_destroy(MSQueue *q);
 
+/*returns a message whose data can be modified in place: m itself, or a private copy of it when its buffer is
+shared with other messages (see dupb()), in which case m is freed*/
+MS2_PUBLIC mblk_t *ms_msg_make_writable(mblk_t *m);
+
 
 #define __mblk_set_flag(m,pos,bitval) \
 	(m)->reserved2=(m->reserved2 & ~(1<<pos)) | ((!!bitval)<<pos) 
@@ -87,6 +91,8 @@ MS2_PUBLIC void ms_queue_destroy(MSQueue *q);
 #define mblk_get_plc_flag(m)    (((m)->reserved2)>>1 & 0x2) /*bit 2*/
 #define mblk_set_cseq(m,value) (m)->reserved2=(m)->reserved2| ((value&0xFFFF)<<16);	
 #define mblk_get_cseq(m) ((m)->reserved2>>16)
+#define mblk_set_payload_type_info(m,pt) (m)->reserved2=((m)->reserved2 & ~(0xFF<<3)) | ((((pt)&0x7F)+1)<<3)
+#define mblk_get_payload_type_info(m) ((int)(((m)->reserved2>>3) & 0xFF)-1) /*bits 4 to 11, -1 if not set*/
 	
 struct _MSBufferizer{
 	queue_t q;
@@ -43,6 +43,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define MS_RTP_SEND_SET_RELAY_SESSION_ID	MS_FILTER_METHOD(MS_RTP_SEND_ID,5,const char *)
 
+/*renumbers the payloads that carry their payload type (see mblk_get_payload_type_info()): an array of
+RTP_PROFILE_MAX_PAYLOADS numbers, -1 to drop the payload, or NULL to send everything with the session's payload type*/
+#define MS_RTP_SEND_SET_PAYLOAD_TYPE_MAP	MS_FILTER_METHOD(MS_RTP_SEND_ID,6,const int *)
+
 
 
 
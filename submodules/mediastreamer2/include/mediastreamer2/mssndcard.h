@@ -40,6 +40,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 struct _MSSndCardManager{
 	MSList *cards;
 	MSList *descs;
+	bool_t detected; /*the cards are detected when first looked up*/
+	ms_mutex_t lock; /*serializes the detection between the threads looking up cards*/
 };
 
 /**
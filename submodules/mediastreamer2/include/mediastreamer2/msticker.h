@@ -82,6 +82,7 @@ struct _MSTicker
 	MSTickerPrio prio;
 	MSTickerTickFunc wait_next_tick;
 	void *wait_next_tick_data;
+	MSTimeSpec stats_stamp; /* end of the last filter execution of the current tick, the tick start at first*/
 	bool_t run;       /* flag to indicate whether the ticker must be run or not */
 };
 
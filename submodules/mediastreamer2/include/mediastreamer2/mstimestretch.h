@@ -0,0 +1,43 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006  Simon MORLAT (simon.morlat@linphone.org)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef mstimestretch_h
+#define mstimestretch_h
+
+#include <mediastreamer2/msfilter.h>
+
+/**
+ * The MSTimeStretch filter is placed after the decoder of a receiving graph.
+ * It reads the jitter compensation error of the RtpSession (see rtp_session_get_jitter_compensation_error())
+ * and applies it by removing or repeating one pitch period at a time (WSOLA-like overlap-add), so that
+ * the playout delay follows the jitter buffer target without skipping or holding packets.
+ * Only mono 16 bits signal is stretched, other signals go through untouched.
+**/
+
+/** Sets the RtpSession whose jitter buffer is to be driven. Enables time stretching mode on the session.*/
+#define MS_TIME_STRETCH_SET_SESSION	MS_FILTER_METHOD(MS_TIME_STRETCH_ID,0,struct _RtpSession)
+
+typedef struct _MSTimeStretchStats{
+	int expanded;	/**<number of pitch periods inserted*/
+	int compressed;	/**<number of pitch periods removed*/
+} MSTimeStretchStats;
+
+#define MS_TIME_STRETCH_GET_STATS	MS_FILTER_METHOD(MS_TIME_STRETCH_ID,1,MSTimeStretchStats)
+
+#endif
@@ -51,6 +51,12 @@ typedef struct _MSToneDetectorEvent MSToneDetectorEvent;
 /** Remove previously added scans*/
 #define MS_TONE_DETECTOR_CLEAR_SCANS	MS_FILTER_METHOD_NO_ARG(MS_TONE_DETECTOR_ID,1)
 
+/**
+ * Sliding window mode: the tones are analysed on 20 ms windows starting every hop milliseconds instead of back to back.
+ * The hop must divide 20 ms in at most 4 windows (5, 10 or 20 which is the default).
+**/
+#define MS_TONE_DETECTOR_SET_WINDOW_HOP	MS_FILTER_METHOD(MS_TONE_DETECTOR_ID,2,int)
+
 /** Event generated when a tone is detected */
 #define MS_TONE_DETECTOR_EVENT		MS_FILTER_EVENT(MS_TONE_DETECTOR_ID,0,MSToneDetectorEvent)
 
@@ -41,6 +41,12 @@ MS2_PUBLIC MSQualityIndicator *ms_quality_indicator_new(RtpSession *session);
 **/
 MS2_PUBLIC void ms_quality_indicator_update_from_feedback(MSQualityIndicator *qi, mblk_t *rtcp);
 
+/**
+ * Updates quality indicator based on the last report of the remote end kept in the RTCP summary of the session,
+ * see rtp_session_get_rtcp_summary(). It does not need the RTCP packets to be notified to the application.
+**/
+MS2_PUBLIC void ms_quality_indicator_update_from_summary(MSQualityIndicator *qi, const rtcp_summary_t *summary);
+
 /**
  * Updates quality indicator based on the local statistics directly computed by the RtpSession used when creating the indicator.
  * This function must be called typically every second.
@@ -21,14 +21,19 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/msaudiomixer.h"
 #include "mediastreamer2/msticker.h"
 
+#include <math.h>
+
 #ifdef _MSC_VER
 #include <malloc.h>
 #define alloca _alloca
 #endif
 
-#define MIXER_MAX_CHANNELS 20
+#define MIXER_MAX_CHANNELS 64
 #define MAX_LATENCY 0.08
 #define ALWAYS_STREAMOUT 1
+/*per tick decay of a channel's energy once it stops talking, gives ~200ms of hangover*/
+#define ENERGY_DECAY 0.9f
+#define FULL_SCALE_ENERGY (32767.0f*32767.0f)
 
 static void accumulate(int32_t *sum, int16_t* contrib, int nwords){
 	int i;
@@ -37,6 +42,15 @@ static void accumulate(int32_t *sum, int16_t* contrib, int nwords){
 	}
 }
 
+static float block_energy(const int16_t *samples, int nwords){
+	float acc=0;
+	int i;
+	for(i=0;i<nwords;++i){
+		acc+=(float)samples[i]*(float)samples[i];
+	}
+	return acc/(float)nwords;
+}
+
 static inline int16_t saturate(int32_t s){
 	if (s>32767) return 32767;
 	if (s<-32767) return -32767;
@@ -55,6 +69,8 @@ typedef struct Channel{
 	int16_t *input;	/*the channel contribution, for removal at output*/
 	float gain;
 	int active;
+	int contributed; /*whether the channel added something to the sum during this tick*/
+	float energy; /*smoothed mean square of the channel's input, used to rank speakers*/
 } Channel;
 
 static void channel_init(Channel *chan){
@@ -62,26 +78,36 @@ static void channel_init(Channel *chan){
 	chan->input=NULL;
 	chan->gain=1.0;
 	chan->active=1;
+	chan->contributed=0;
+	chan->energy=0;
 }
 
 static void channel_prepare(Channel *chan, int bytes_per_tick){
 	chan->input=ms_malloc0(bytes_per_tick);
 }
 
-static int channel_process_in(Channel *chan, MSQueue *q, int32_t *sum, int nsamples){
+/*reads the channel's block for this tick and updates its energy, without mixing it*/
+static int channel_process_in(Channel *chan, MSQueue *q, int nsamples){
 	ms_bufferizer_put_from_queue(&chan->bufferizer,q);
+	chan->contributed=0;
 	if (ms_bufferizer_read(&chan->bufferizer,(uint8_t*)chan->input,nsamples*2)!=0){
-		if (chan->active){
-			if (chan->gain!=1.0){
-				apply_gain(chan->input,nsamples,chan->gain);
-			}
-			accumulate(sum,chan->input,nsamples);
-		}
+		float e=block_energy(chan->input,nsamples)*chan->gain*chan->gain;
+		chan->energy=(e>chan->energy) ? e : chan->energy*ENERGY_DECAY;
 		return nsamples;
-	}else memset(chan->input,0,nsamples*2);
+	}
+	memset(chan->input,0,nsamples*2);
+	chan->energy*=ENERGY_DECAY;
 	return 0;
 }
 
+static void channel_contribute(Channel *chan, int32_t *sum, int nsamples){
+	if (chan->gain!=1.0){
+		apply_gain(chan->input,nsamples,chan->gain);
+	}
+	accumulate(sum,chan->input,nsamples);
+	chan->contributed=1;
+}
+
 static mblk_t *channel_process_out(Channel *chan, int32_t *sum, int nsamples){
 	int i;
 	mblk_t *om=allocb(nsamples*2,0);
@@ -118,8 +144,24 @@ typedef struct MixerState{
 	Channel channels[MIXER_MAX_CHANNELS];
 	int32_t *sum;
 	int conf_mode;
+	int max_speakers; /*number of loudest channels actually mixed, 0 to mix everybody*/
+	float noise_floor; /*energy under which a channel is not mixed at all*/
 } MixerState;
 
+/*inserts a channel into the list of speakers sorted by decreasing energy, keeping at most max_speakers of them*/
+static int rank_speaker(MixerState *s, int *speakers, int nspeakers, int index){
+	int max=s->max_speakers>0 ? s->max_speakers : MIXER_MAX_CHANNELS;
+	float e=s->channels[index].energy;
+	int pos=nspeakers;
+
+	while(pos>0 && s->channels[speakers[pos-1]].energy<e) pos--;
+	if (pos>=max) return nspeakers;
+	if (nspeakers<max) nspeakers++;
+	memmove(&speakers[pos+1],&speakers[pos],(nspeakers-1-pos)*sizeof(int));
+	speakers[pos]=index;
+	return nspeakers;
+}
+
 
 
 
@@ -180,21 +222,31 @@ static void mixer_process(MSFilter *f){
 	int i;
 	int nwords=s->bytespertick/2;
 	bool_t got_something=FALSE;
+	int speakers[MIXER_MAX_CHANNELS];
+	int nspeakers=0;
 
 	memset(s->sum,0,nwords*sizeof(int32_t));
 
-	/* read from all inputs and sum everybody */
+	/* read from all inputs and rank the channels that are talking */
 	for(i=0;i<MIXER_MAX_CHANNELS;++i){
 		MSQueue *q=f->inputs[i];
 		if (q){
-			if (channel_process_in(&s->channels[i],q,s->sum,nwords))
+			Channel *chan=&s->channels[i];
+			if (channel_process_in(chan,q,nwords)){
 				got_something=TRUE;
+				if (chan->active && chan->energy>s->noise_floor)
+					nspeakers=rank_speaker(s,speakers,nspeakers,i);
+			}
 			/*FIXME: incorporate the following into the channel and use a better flow control algorithm*/
 			if (ms_bufferizer_get_avail(&s->channels[i].bufferizer)>s->purgeoffset){
 				ms_warning("Too much data in channel %i",i);
 				ms_bufferizer_flush(&s->channels[i].bufferizer);
 			}
-		}
+		}else s->channels[i].contributed=0;
+	}
+	/* sum the selected speakers only, silent and quieter channels are skipped */
+	for(i=0;i<nspeakers;++i){
+		channel_contribute(&s->channels[speakers[i]],s->sum,nwords);
 	}
 #ifdef ALWAYS_STREAMOUT
 	got_something=TRUE;
@@ -215,10 +267,22 @@ static void mixer_process(MSFilter *f){
 				}
 			}
 		}else{
+			/*channels that are not among the speakers all hear the full mix: compute it once and share it*/
+			mblk_t *full=NULL;
 			for(i=0;i<MIXER_MAX_CHANNELS;++i){
 				MSQueue *q=f->outputs[i];
 				if (q){
-					ms_queue_put(q,channel_process_out(&s->channels[i],s->sum,nwords));
+					Channel *chan=&s->channels[i];
+					if (chan->contributed){
+						ms_queue_put(q,channel_process_out(chan,s->sum,nwords));
+					}else{
+						if (full==NULL){
+							full=make_output(s->sum,nwords);
+						}else{
+							full=dupb(full);
+						}
+						ms_queue_put(q,full);
+					}
 				}
 			}
 		}
@@ -277,6 +341,18 @@ static int mixer_set_conference_mode(MSFilter *f, void *data){
 	return 0;
 }
 
+static int mixer_set_active_speakers(MSFilter *f, void *data){
+	MixerState *s=(MixerState *)f->data;
+	s->max_speakers=*(int*)data;
+	return 0;
+}
+
+static int mixer_set_noise_floor(MSFilter *f, void *data){
+	MixerState *s=(MixerState *)f->data;
+	s->noise_floor=FULL_SCALE_ENERGY*powf(10,*(float*)data/10);
+	return 0;
+}
+
 static MSFilterMethod methods[]={
 	{	MS_FILTER_SET_NCHANNELS , mixer_set_nchannels },
 	{	MS_FILTER_GET_NCHANNELS , mixer_get_nchannels },
@@ -285,6 +361,8 @@ static MSFilterMethod methods[]={
 	{	MS_AUDIO_MIXER_SET_INPUT_GAIN , mixer_set_input_gain },
 	{	MS_AUDIO_MIXER_SET_ACTIVE , mixer_set_active },
 	{	MS_AUDIO_MIXER_ENABLE_CONFERENCE_MODE, mixer_set_conference_mode	},
+	{	MS_AUDIO_MIXER_SET_ACTIVE_SPEAKERS, mixer_set_active_speakers	},
+	{	MS_AUDIO_MIXER_SET_NOISE_FLOOR, mixer_set_noise_floor	},
 	{0,NULL}
 };
 
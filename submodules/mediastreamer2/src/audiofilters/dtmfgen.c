@@ -44,6 +44,8 @@ struct DtmfGenState{
 	int pos;
 	float highfreq;
 	float lowfreq;
+	double highcoef; /*2*cos(2*pi*highfreq), for the recursive oscillator*/
+	double lowcoef;
 	int nosamples_time;
 	int silence;
 	int amplitude;
@@ -73,6 +75,14 @@ static void dtmfgen_uninit(MSFilter *f){
 	ms_free(f->data);
 }
 
+/*frequencies are normalized by the sampling rate*/
+static void dtmfgen_set_frequencies(DtmfGenState *s, float lowfreq, float highfreq){
+	s->lowfreq=lowfreq;
+	s->highfreq=highfreq;
+	s->lowcoef=2*cos(2*M_PI*lowfreq);
+	s->highcoef=2*cos(2*M_PI*highfreq);
+}
+
 static int dtmfgen_put(MSFilter *f, void *arg){
 	DtmfGenState *s=(DtmfGenState*)f->data;
 	const char *dtmf=(char*)arg;
@@ -155,8 +165,7 @@ static int dtmfgen_put(MSFilter *f, void *arg){
 	}
 	ms_filter_lock(f);
 	s->pos=0;
-	s->lowfreq=s->lowfreq/s->rate;
-	s->highfreq=s->highfreq/s->rate;
+	dtmfgen_set_frequencies(s,s->lowfreq/s->rate,s->highfreq/s->rate);
 	s->dur=s->rate/10; /*100 ms duration */
 	s->silence=0;
 	s->amplitude=s->default_amplitude*32767*0.7;
@@ -178,8 +187,7 @@ static int dtmfgen_play_tone(MSFilter *f, void *arg){
 	s->current_tone=*def;
 	s->pos=0;
 	s->dur=(s->rate*def->duration)/1000;
-	s->lowfreq=((float)def->frequencies[0])/(float)s->rate;
-	s->highfreq=((float)def->frequencies[1])/(float)s->rate;;
+	dtmfgen_set_frequencies(s,((float)def->frequencies[0])/(float)s->rate,((float)def->frequencies[1])/(float)s->rate);
 	s->silence=0;
 	s->amplitude=((float)def->amplitude)* 0.7*32767.0;
 	s->repeat_count=0;
@@ -241,12 +249,35 @@ static int dtmfgen_set_amp(MSFilter *f, void *arg){
 }
 
 
+/*
+ * The sines are generated by recursive oscillators y[n]=2*cos(w)*y[n-1]-y[n-2], so that only two multiplications
+ * per sample are needed. They are started again from the current position at each block, which keeps the rounding
+ * errors from accumulating over long tones.
+ */
 static void write_dtmf(DtmfGenState *s , int16_t *sample, int nsamples){
 	int i, j;
 	int16_t dtmf_sample;
+	/*in double precision the oscillators round exactly as sin() would*/
+	double amplitude=(double)s->amplitude;
+	double wl=2*M_PI*s->lowfreq;
+	double wh=2*M_PI*s->highfreq;
+	double low0=sin(wl*s->pos);
+	double low1=sin(wl*(s->pos-1));
+	double high0=sin(wh*s->pos);
+	double high1=sin(wh*(s->pos-1));
+	double tmp;
+
 	for (i=0;i<nsamples && s->pos<s->dur;i++,s->pos++){
-		dtmf_sample = (int16_t)(((float)s->amplitude)*sin(2*M_PI*(float)s->pos*s->lowfreq));
-		if (s->highfreq!=0) dtmf_sample += (int16_t)(((float)s->amplitude)*sin(2*M_PI*(float)s->pos*s->highfreq));
+		dtmf_sample = (int16_t)(amplitude*low0);
+		tmp=s->lowcoef*low0-low1;
+		low1=low0;
+		low0=tmp;
+		if (s->highfreq!=0){
+			dtmf_sample += (int16_t)(amplitude*high0);
+			tmp=s->highcoef*high0-high1;
+			high1=high0;
+			high0=tmp;
+		}
 		for (j = 0; j < s->nchannels; j++) {
 			sample[(i * s->nchannels) + j] = dtmf_sample;
 		}
@@ -277,7 +308,13 @@ static void dtmfgen_process(MSFilter *f){
 	int nsamples;
 
 	ms_filter_lock(f);
-	if (ms_queue_empty(f->inputs[0])){
+	if (!s->playing && s->silence==0){
+		/*nothing to generate: the input is forwarded untouched*/
+		s->nosamples_time=ms_queue_empty(f->inputs[0]) ? s->nosamples_time+f->ticker->interval : 0;
+		while((m=ms_queue_get(f->inputs[0]))!=NULL){
+			ms_queue_put(f->outputs[0],m);
+		}
+	}else if (ms_queue_empty(f->inputs[0])){
 		s->nosamples_time+=f->ticker->interval;
 		if ((s->playing || s->silence!=0) && s->nosamples_time>NO_SAMPLES_THRESHOLD){
 			/*after 100 ms without stream we decide to generate our own sample
@@ -314,6 +351,7 @@ static void dtmfgen_process(MSFilter *f){
 					strncpy(ev.tone_name,s->current_tone.tone_name,sizeof(ev.tone_name));
 					ms_filter_notify(f,MS_DTMF_GEN_EVENT,&ev);
 				}
+				m=ms_msg_make_writable(m);
 				nsamples=(m->b_wptr-m->b_rptr)/(2*s->nchannels);
 				write_dtmf(s, (int16_t*)m->b_rptr,nsamples);
 			}
@@ -40,7 +40,7 @@ typedef struct _EqualizerState{
 	ms_word16_t *fft_cpx;
 	int fir_len;
 	ms_word16_t *fir;
-	ms_mem_t *mem; /*memories for filtering computations*/
+	MSFirFilter *fir_filter; /*direct or fft convolution according to fir_len*/
 	bool_t needs_update;
 	bool_t active;
 } EqualizerState;
@@ -62,7 +62,7 @@ static EqualizerState * equalizer_state_new(int nfft){
 	equalizer_state_flatten(s);
 	s->fir_len=s->nfft;
 	s->fir=(ms_word16_t*)ms_new(ms_word16_t,s->fir_len);
-	s->mem=(ms_mem_t*)ms_new0(ms_mem_t,s->fir_len);
+	s->fir_filter=ms_fir_new(s->fir_len);
 	s->needs_update=TRUE;
 	s->active=TRUE;
 	return s;
@@ -71,7 +71,7 @@ static EqualizerState * equalizer_state_new(int nfft){
 static void equalizer_state_destroy(EqualizerState *s){
 	ms_free(s->fft_cpx);
 	ms_free(s->fir);
-	ms_free(s->mem);
+	ms_fir_destroy(s->fir_filter);
 	ms_free(s);
 }
 
@@ -212,6 +212,7 @@ static void equalizer_state_compute_impulse_response(EqualizerState *s){
 	norm_and_apodize(s->fir,s->fir_len);
 	ms_message("Apodized impulse response:");
 	dump_table(s->fir,s->fir_len);
+	ms_fir_set_coefs(s->fir_filter,s->fir);
 	s->needs_update=FALSE;
 }
 
@@ -244,7 +245,7 @@ static void equalizer_state_run(EqualizerState *s, int16_t *samples, int nsample
 	if (s->needs_update)
 		equalizer_state_compute_impulse_response(s);
 	INT16_TO_WORD16(samples,w,nsamples);
-	ms_fir_mem16(w,s->fir,w,nsamples,s->fir_len,s->mem);
+	ms_fir_process(s->fir_filter,w,w,nsamples);
 	WORD16_TO_INT16(w,samples,nsamples);
 }
 
@@ -262,6 +263,7 @@ static void equalizer_process(MSFilter *f){
 	EqualizerState *s=(EqualizerState*)f->data;
 	while((m=ms_queue_get(f->inputs[0]))!=NULL){
 		if (s->active){
+			m=ms_msg_make_writable(m);
 			equalizer_state_run(s,(int16_t*)m->b_rptr,(m->b_wptr-m->b_rptr)/2);
 		}
 		ms_queue_put(f->outputs[0],m);
@@ -0,0 +1,455 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006  Simon MORLAT (simon.morlat@linphone.org)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/msencodedprompt.h"
+#include "mediastreamer2/msticker.h"
+#include "waveheader.h"
+#include "promptcache.h"
+
+#define ENCODED_PROMPT_MAGIC "MSEP"
+#define ENCODED_PROMPT_VERSION 1
+#define ENCODED_PROMPT_HEADER_SIZE (12+MS_ENCODED_PROMPT_MIME_SIZE)
+#define ENCODED_PROMPT_RECORD_HEADER_SIZE 4
+
+static uint16_t read_le16(const uint8_t *p){
+	return (uint16_t)(p[0] | (p[1]<<8));
+}
+
+static uint32_t read_le32(const uint8_t *p){
+	return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24);
+}
+
+static void write_le16(uint8_t *p, uint16_t val){
+	p[0]=val & 0xff;
+	p[1]=val>>8;
+}
+
+static void write_le32(uint8_t *p, uint32_t val){
+	write_le16(p,val & 0xffff);
+	write_le16(p+2,val>>16);
+}
+
+typedef struct _EncodedPlayerData{
+	MSPromptCacheEntry *prompt;
+	MSPlayerState state;
+	char mime_type[MS_ENCODED_PROMPT_MIME_SIZE+1];
+	int rate;
+	int pos; /*offset of the next payload record in the prompt*/
+	int loop_after;
+	uint32_t clock; /*in clock rate units*/
+	uint32_t next_ts; /*timestamp of the next payload*/
+	uint32_t pass_ts; /*timestamp at which the current pass over the prompt began*/
+	bool_t marker;
+}EncodedPlayerData;
+
+static int encoded_player_close(MSFilter *f, void *arg);
+
+static void encoded_player_init(MSFilter *f){
+	EncodedPlayerData *d=ms_new0(EncodedPlayerData,1);
+	d->state=MSPlayerClosed;
+	d->rate=8000;
+	d->loop_after=-1;
+	f->data=d;
+}
+
+static void encoded_player_uninit(MSFilter *f){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	if (d->prompt!=NULL) encoded_player_close(f,NULL);
+	ms_free(d);
+}
+
+/*the whole file is cached, header included*/
+static mblk_t *encoded_player_load(int fd, int size, MSPromptFormat *fmt, void *user_data){
+	mblk_t *data=allocb(size,0);
+	int err=read(fd,data->b_wptr,size);
+	if (err<ENCODED_PROMPT_HEADER_SIZE){
+		freemsg(data);
+		return NULL;
+	}
+	data->b_wptr+=err;
+	if (memcmp(data->b_rptr,ENCODED_PROMPT_MAGIC,4)!=0 || read_le16(data->b_rptr+4)!=ENCODED_PROMPT_VERSION){
+		freemsg(data);
+		return NULL;
+	}
+	/*a prompt without any complete payload record has nothing to play*/
+	if (err<ENCODED_PROMPT_HEADER_SIZE+ENCODED_PROMPT_RECORD_HEADER_SIZE
+		|| err<ENCODED_PROMPT_HEADER_SIZE+ENCODED_PROMPT_RECORD_HEADER_SIZE+read_le16(data->b_rptr+ENCODED_PROMPT_HEADER_SIZE)){
+		ms_warning("MSEncodedPlayer: prompt has no payload record.");
+		freemsg(data);
+		return NULL;
+	}
+	fmt->rate=read_le32(data->b_rptr+8);
+	return data;
+}
+
+static void encoded_player_rewind(EncodedPlayerData *d){
+	d->pos=ENCODED_PROMPT_HEADER_SIZE;
+	d->marker=TRUE;
+}
+
+static int encoded_player_open(MSFilter *f, void *arg){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	const char *file=(const char*)arg;
+	MSPromptFormat fmt={0};
+	MSPromptCacheEntry *prompt;
+	int fd;
+
+	if ((fd=open(file,O_RDONLY|O_BINARY))==-1){
+		ms_warning("Failed to open %s",file);
+		return -1;
+	}
+	prompt=ms_prompt_cache_get(file,fd,0,0,&fmt,encoded_player_load,NULL);
+	close(fd);
+	if (prompt==NULL){
+		ms_warning("%s is not a pre-encoded prompt, or is too big to be cached.",file);
+		return -1;
+	}
+	ms_filter_lock(f);
+	if (d->prompt!=NULL) ms_prompt_cache_release(d->prompt);
+	d->prompt=prompt;
+	d->rate=prompt->fmt.rate;
+	memcpy(d->mime_type,prompt->data->b_rptr+12,MS_ENCODED_PROMPT_MIME_SIZE);
+	d->mime_type[MS_ENCODED_PROMPT_MIME_SIZE]='\0';
+	d->state=MSPlayerPaused;
+	encoded_player_rewind(d);
+	ms_filter_unlock(f);
+	ms_message("%s opened: %s/%i",file,d->mime_type,d->rate);
+	return 0;
+}
+
+static int encoded_player_start(MSFilter *f, void *arg){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	ms_filter_lock(f);
+	if (d->state==MSPlayerPaused){
+		d->state=MSPlayerPlaying;
+		d->next_ts=d->clock;
+		d->pass_ts=d->next_ts;
+	}
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int encoded_player_stop(MSFilter *f, void *arg){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	ms_filter_lock(f);
+	if (d->state!=MSPlayerClosed){
+		d->state=MSPlayerPaused;
+		encoded_player_rewind(d);
+	}
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int encoded_player_pause(MSFilter *f, void *arg){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	ms_filter_lock(f);
+	if (d->state==MSPlayerPlaying) d->state=MSPlayerPaused;
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int encoded_player_close(MSFilter *f, void *arg){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	ms_filter_lock(f);
+	if (d->prompt!=NULL){
+		ms_prompt_cache_release(d->prompt);
+		d->prompt=NULL;
+	}
+	d->state=MSPlayerClosed;
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int encoded_player_get_state(MSFilter *f, void *arg){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	*(int*)arg=d->state;
+	return 0;
+}
+
+static int encoded_player_loop(MSFilter *f, void *arg){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	d->loop_after=*(int*)arg;
+	return 0;
+}
+
+static int encoded_player_get_sr(MSFilter *f, void *arg){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	*(int*)arg=d->rate;
+	return 0;
+}
+
+static int encoded_player_get_mime_type(MSFilter *f, void *arg){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+	if (d->prompt==NULL) return -1;
+	*(const char**)arg=d->mime_type;
+	return 0;
+}
+
+/*returns FALSE when playing is over*/
+static bool_t encoded_player_eof(MSFilter *f, EncodedPlayerData *d){
+	ms_filter_notify_no_arg(f,MS_ENCODED_PLAYER_EOF);
+	encoded_player_rewind(d);
+	if (d->loop_after<0){
+		d->state=MSPlayerPaused;
+		return FALSE;
+	}
+	d->next_ts+=(uint32_t)(((uint64_t)d->loop_after*d->rate)/1000);
+	/*a pass that took no time at all (null durations, no loop interval) would be replayed forever within this tick:
+	resume at the next one instead*/
+	if (d->next_ts==d->pass_ts) d->next_ts=d->clock+1;
+	d->pass_ts=d->next_ts;
+	return TRUE;
+}
+
+static void encoded_player_process(MSFilter *f){
+	EncodedPlayerData *d=(EncodedPlayerData*)f->data;
+
+	ms_filter_lock(f);
+	d->clock+=(f->ticker->interval*d->rate)/1000;
+	if (d->state==MSPlayerPlaying){
+		const mblk_t *data=d->prompt->data;
+		int size=data->b_wptr-data->b_rptr;
+		/*send every payload whose time has come, as a view on the shared prompt*/
+		while((int32_t)(d->clock-d->next_ts)>=0){
+			const uint8_t *record=data->b_rptr+d->pos;
+			int len;
+			mblk_t *om;
+			if (d->pos+ENCODED_PROMPT_RECORD_HEADER_SIZE>size
+				|| d->pos+ENCODED_PROMPT_RECORD_HEADER_SIZE+(len=read_le16(record))>size){
+				if (!encoded_player_eof(f,d)) break;
+				continue;
+			}
+			om=ms_prompt_cache_view(d->prompt,d->pos+ENCODED_PROMPT_RECORD_HEADER_SIZE,len);
+			mblk_set_timestamp_info(om,d->next_ts);
+			mblk_set_marker_info(om,d->marker);
+			ms_queue_put(f->outputs[0],om);
+			d->marker=FALSE;
+			d->next_ts+=read_le16(record+2);
+			d->pos+=ENCODED_PROMPT_RECORD_HEADER_SIZE+len;
+		}
+	}
+	ms_filter_unlock(f);
+}
+
+static MSFilterMethod encoded_player_methods[]={
+	{	MS_ENCODED_PLAYER_OPEN,	encoded_player_open	},
+	{	MS_ENCODED_PLAYER_START,	encoded_player_start	},
+	{	MS_ENCODED_PLAYER_STOP,	encoded_player_stop	},
+	{	MS_ENCODED_PLAYER_CLOSE,	encoded_player_close	},
+	{	MS_ENCODED_PLAYER_LOOP,	encoded_player_loop	},
+	{	MS_ENCODED_PLAYER_GET_MIME_TYPE,	encoded_player_get_mime_type	},
+	{	MS_FILTER_GET_SAMPLE_RATE,	encoded_player_get_sr	},
+	/* this player implements the MSFilterPlayerInterface*/
+	{	MS_PLAYER_OPEN,	encoded_player_open	},
+	{	MS_PLAYER_START,	encoded_player_start	},
+	{	MS_PLAYER_PAUSE,	encoded_player_pause	},
+	{	MS_PLAYER_CLOSE,	encoded_player_close	},
+	{	MS_PLAYER_GET_STATE,	encoded_player_get_state	},
+	{	0,	NULL	}
+};
+
+typedef struct _EncodedRecData{
+	int fd;
+	int rate;
+	char mime_type[MS_ENCODED_PROMPT_MIME_SIZE];
+	mblk_t *pending; /*written once the timestamp of the next payload gives its duration*/
+	uint16_t last_duration;
+}EncodedRecData;
+
+static int encoded_rec_close(MSFilter *f, void *arg);
+
+static void encoded_rec_init(MSFilter *f){
+	EncodedRecData *d=ms_new0(EncodedRecData,1);
+	d->fd=-1;
+	d->rate=8000;
+	f->data=d;
+}
+
+static void encoded_rec_uninit(MSFilter *f){
+	EncodedRecData *d=(EncodedRecData*)f->data;
+	if (d->fd!=-1) encoded_rec_close(f,NULL);
+	ms_free(d);
+}
+
+static void encoded_rec_write(EncodedRecData *d, mblk_t *m, uint16_t duration){
+	uint8_t header[ENCODED_PROMPT_RECORD_HEADER_SIZE];
+	int len;
+	if (m->b_cont!=NULL) msgpullup(m,-1);
+	len=m->b_wptr-m->b_rptr;
+	write_le16(header,len);
+	write_le16(header+2,duration);
+	if (write(d->fd,header,sizeof(header))!=sizeof(header) || write(d->fd,m->b_rptr,len)!=len){
+		ms_warning("MSEncodedRec: fail to write %i bytes: %s",len,strerror(errno));
+	}
+	freemsg(m);
+}
+
+static int encoded_rec_open(MSFilter *f, void *arg){
+	EncodedRecData *d=(EncodedRecData*)f->data;
+	const char *file=(const char*)arg;
+	uint8_t header[ENCODED_PROMPT_HEADER_SIZE]={0};
+
+	if (d->fd!=-1) encoded_rec_close(f,NULL);
+	if (d->mime_type[0]=='\0'){
+		ms_error("MSEncodedRec: mime type must be set before opening %s",file);
+		return -1;
+	}
+	d->fd=open(file,O_WRONLY|O_CREAT|O_TRUNC|O_BINARY,S_IRUSR|S_IWUSR);
+	if (d->fd==-1){
+		ms_warning("Cannot open %s: %s",file,strerror(errno));
+		return -1;
+	}
+	memcpy(header,ENCODED_PROMPT_MAGIC,4);
+	write_le16(header+4,ENCODED_PROMPT_VERSION);
+	write_le32(header+8,d->rate);
+	memcpy(header+12,d->mime_type,MS_ENCODED_PROMPT_MIME_SIZE);
+	if (write(d->fd,header,sizeof(header))!=sizeof(header)){
+		ms_warning("MSEncodedRec: cannot write header of %s: %s",file,strerror(errno));
+	}
+	d->last_duration=(d->rate*20)/1000;
+	return 0;
+}
+
+static int encoded_rec_close(MSFilter *f, void *arg){
+	EncodedRecData *d=(EncodedRecData*)f->data;
+	ms_filter_lock(f);
+	if (d->fd!=-1){
+		/*the last payload is assumed to be as long as the previous one*/
+		if (d->pending!=NULL) encoded_rec_write(d,d->pending,d->last_duration);
+		d->pending=NULL;
+		close(d->fd);
+		d->fd=-1;
+	}
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int encoded_rec_set_mime_type(MSFilter *f, void *arg){
+	EncodedRecData *d=(EncodedRecData*)f->data;
+	memset(d->mime_type,0,sizeof(d->mime_type));
+	strncpy(d->mime_type,(const char*)arg,sizeof(d->mime_type)-1);
+	return 0;
+}
+
+static int encoded_rec_set_sr(MSFilter *f, void *arg){
+	EncodedRecData *d=(EncodedRecData*)f->data;
+	d->rate=*(int*)arg;
+	return 0;
+}
+
+static void encoded_rec_process(MSFilter *f){
+	EncodedRecData *d=(EncodedRecData*)f->data;
+	mblk_t *m;
+
+	ms_filter_lock(f);
+	while((m=ms_queue_get(f->inputs[0]))!=NULL){
+		if (d->fd==-1){
+			freemsg(m);
+			continue;
+		}
+		if (d->pending!=NULL){
+			uint32_t duration=mblk_get_timestamp_info(m)-mblk_get_timestamp_info(d->pending);
+			/*discontinuous transmission gaps longer than what a record can hold are shortened*/
+			if (duration>0xffff) duration=0xffff;
+			d->last_duration=duration;
+			encoded_rec_write(d,d->pending,duration);
+		}
+		d->pending=m;
+	}
+	ms_filter_unlock(f);
+}
+
+static MSFilterMethod encoded_rec_methods[]={
+	{	MS_ENCODED_REC_OPEN,	encoded_rec_open	},
+	{	MS_ENCODED_REC_CLOSE,	encoded_rec_close	},
+	{	MS_ENCODED_REC_SET_MIME_TYPE,	encoded_rec_set_mime_type	},
+	{	MS_FILTER_SET_SAMPLE_RATE,	encoded_rec_set_sr	},
+	{	0,	NULL	}
+};
+
+#ifdef _MSC_VER
+
+MSFilterDesc ms_encoded_player_desc={
+	MS_ENCODED_PLAYER_ID,
+	"MSEncodedPlayer",
+	N_("Pre-encoded prompts player"),
+	MS_FILTER_OTHER,
+	NULL,
+	0,
+	1,
+	encoded_player_init,
+	NULL,
+	encoded_player_process,
+	NULL,
+	encoded_player_uninit,
+	encoded_player_methods
+};
+
+MSFilterDesc ms_encoded_rec_desc={
+	MS_ENCODED_REC_ID,
+	"MSEncodedRec",
+	N_("Pre-encoded prompts recorder"),
+	MS_FILTER_OTHER,
+	NULL,
+	1,
+	0,
+	encoded_rec_init,
+	NULL,
+	encoded_rec_process,
+	NULL,
+	encoded_rec_uninit,
+	encoded_rec_methods
+};
+
+#else
+
+MSFilterDesc ms_encoded_player_desc={
+	.id=MS_ENCODED_PLAYER_ID,
+	.name="MSEncodedPlayer",
+	.text=N_("Pre-encoded prompts player"),
+	.category=MS_FILTER_OTHER,
+	.ninputs=0,
+	.noutputs=1,
+	.init=encoded_player_init,
+	.process=encoded_player_process,
+	.uninit=encoded_player_uninit,
+	.methods=encoded_player_methods
+};
+
+MSFilterDesc ms_encoded_rec_desc={
+	.id=MS_ENCODED_REC_ID,
+	.name="MSEncodedRec",
+	.text=N_("Pre-encoded prompts recorder"),
+	.category=MS_FILTER_OTHER,
+	.ninputs=1,
+	.noutputs=0,
+	.init=encoded_rec_init,
+	.process=encoded_rec_process,
+	.uninit=encoded_rec_uninit,
+	.methods=encoded_rec_methods
+};
+
+#endif
+
+MS_FILTER_DESC_EXPORT(ms_encoded_player_desc)
+MS_FILTER_DESC_EXPORT(ms_encoded_rec_desc)
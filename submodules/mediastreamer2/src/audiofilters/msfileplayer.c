@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/msfileplayer.h"
 #include "waveheader.h"
+#include "promptcache.h"
 #include "mediastreamer2/msticker.h"
 
 #ifdef HAVE_PCAP
@@ -33,6 +34,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <speex/speex_resampler.h>
 
 
 static int player_close(MSFilter *f, void *arg);
@@ -50,6 +52,9 @@ struct _PlayerData{
 	uint32_t ts;
 	bool_t swap;
 	bool_t is_raw;
+	MSPromptCacheEntry *prompt;
+	int prompt_pos;
+	int cached_rate;
 #ifdef HAVE_PCAP
 	pcap_t *pcap;
 	struct pcap_pkthdr *pcap_hdr;
@@ -77,6 +82,9 @@ static void player_init(MSFilter *f){
 	d->count=0;
 	d->ts=0;
 	d->is_raw=TRUE;
+	d->prompt=NULL;
+	d->prompt_pos=0;
+	d->cached_rate=0;
 #ifdef HAVE_PCAP
 	d->pcap = NULL;
 	d->pcap_hdr = NULL;
@@ -172,6 +180,63 @@ static int read_wav_header(PlayerData *d){
 		return -1;
 }
 
+static void swap_bytes(unsigned char *bytes, int len){
+	int i;
+	unsigned char tmp;
+	for(i=0;i<len;i+=2){
+		tmp=bytes[i];
+		bytes[i]=bytes[i+1];
+		bytes[i+1]=tmp;
+	}
+}
+
+static mblk_t *player_resample_prompt(mblk_t *im, int nchannels, int inrate, int outrate){
+	int err=0;
+	SpeexResamplerState *handle=speex_resampler_init(nchannels,inrate,outrate,SPEEX_RESAMPLER_QUALITY_VOIP,&err);
+	/*the input is followed by the resampler latency worth of silence, so that the end of the prompt comes out*/
+	spx_uint32_t latency=speex_resampler_get_input_latency(handle);
+	spx_uint32_t inlen=(im->b_wptr-im->b_rptr)/(2*nchannels);
+	spx_uint32_t outlen=(spx_uint32_t)(((uint64_t)(inlen+latency)*outrate)/inrate)+1;
+	spx_uint32_t total_inlen=inlen+latency;
+	mblk_t *om=allocb(outlen*2*nchannels,0);
+	int16_t *in=(int16_t*)ms_malloc0((total_inlen)*2*nchannels);
+
+	memcpy(in,im->b_rptr,inlen*2*nchannels);
+	speex_resampler_skip_zeros(handle);
+	speex_resampler_process_interleaved_int(handle,in,&total_inlen,(int16_t*)om->b_wptr,&outlen);
+	om->b_wptr+=outlen*2*nchannels;
+	speex_resampler_destroy(handle);
+	ms_free(in);
+	freemsg(im);
+	return om;
+}
+
+static mblk_t *player_load_prompt(int fd, int size, MSPromptFormat *fmt, void *user_data){
+	PlayerData *d=(PlayerData*)user_data;
+	mblk_t *data=allocb(size,0);
+	int err=read(fd,data->b_wptr,size);
+
+	if (err<=0){
+		freemsg(data);
+		return NULL;
+	}
+	data->b_wptr+=err;
+	if (d->swap) swap_bytes(data->b_rptr,err);
+	if (d->cached_rate!=0 && d->cached_rate!=fmt->rate && fmt->samplesize==2){
+		data=player_resample_prompt(data,fmt->nchannels,fmt->rate,d->cached_rate);
+		fmt->rate=d->cached_rate;
+	}
+	return data;
+}
+
+static MSPromptCacheEntry *player_get_prompt(PlayerData *d, const char *file){
+	MSPromptFormat fmt;
+	fmt.rate=d->rate;
+	fmt.nchannels=d->nchannels;
+	fmt.samplesize=d->samplesize;
+	return ms_prompt_cache_get(file,d->fd,d->hsize,d->cached_rate,&fmt,player_load_prompt,d);
+}
+
 static int player_open(MSFilter *f, void *arg){
 	PlayerData *d=(PlayerData*)f->data;
 	int fd;
@@ -204,6 +269,13 @@ static int player_open(MSFilter *f, void *arg){
 	if (read_wav_header(d)!=0 && strstr(file,".wav")){
 		ms_warning("File %s has .wav extension but wav header could be found.",file);
 	}
+	if (!d->is_raw && (d->prompt=player_get_prompt(d,file))!=NULL){
+		d->rate=d->prompt->fmt.rate;
+		d->swap=FALSE;
+		d->prompt_pos=0;
+		d->fd=-1;
+		close(fd);
+	}
 	ms_message("%s opened: rate=%i,channel=%i",file,d->rate,d->nchannels);
 	return 0;
 }
@@ -215,12 +287,17 @@ static int player_start(MSFilter *f, void *arg){
 	return 0;
 }
 
+static void player_rewind(PlayerData *d){
+	if (d->prompt!=NULL) d->prompt_pos=0;
+	else lseek(d->fd,d->hsize,SEEK_SET);
+}
+
 static int player_stop(MSFilter *f, void *arg){
 	PlayerData *d=(PlayerData*)f->data;
 	ms_filter_lock(f);
 	if (d->state!=MSPlayerClosed){
 		d->state=MSPlayerPaused;
-		lseek(d->fd,d->hsize,SEEK_SET);
+		player_rewind(d);
 	}
 	ms_filter_unlock(f);
 	return 0;
@@ -244,6 +321,10 @@ static int player_close(MSFilter *f, void *arg){
 #endif
 	if (d->fd!=-1)	close(d->fd);
 	d->fd=-1;
+	if (d->prompt!=NULL){
+		ms_prompt_cache_release(d->prompt);
+		d->prompt=NULL;
+	}
 	d->state=MSPlayerClosed;
 	return 0;
 }
@@ -256,18 +337,26 @@ static int player_get_state(MSFilter *f, void *arg){
 
 static void player_uninit(MSFilter *f){
 	PlayerData *d=(PlayerData*)f->data;
-	if (d->fd!=-1) player_close(f,NULL);
+	if (d->fd!=-1 || d->prompt!=NULL) player_close(f,NULL);
 	ms_free(d);
 }
 
-static void swap_bytes(unsigned char *bytes, int len){
-	int i;
-	unsigned char tmp;
-	for(i=0;i<len;i+=2){
-		tmp=bytes[i];
-		bytes[i]=bytes[i+1];
-		bytes[i+1]=tmp;
+/*returns a view on the cached samples, or a copy of the last ones padded by the caller*/
+static mblk_t *player_read_prompt(PlayerData *d, int bytes, int *err){
+	mblk_t *data=d->prompt->data;
+	int avail=(data->b_wptr-data->b_rptr)-d->prompt_pos;
+	mblk_t *om;
+	if (avail>=bytes){
+		om=ms_prompt_cache_view(d->prompt,d->prompt_pos,0);
+		*err=bytes;
+	}else{
+		om=allocb(bytes,0);
+		if (avail>0) memcpy(om->b_wptr,data->b_rptr+d->prompt_pos,avail);
+		else avail=0;
+		*err=avail;
 	}
+	d->prompt_pos+=*err;
+	return om;
 }
 
 static void player_process(MSFilter *f){
@@ -353,12 +442,16 @@ static void player_process(MSFilter *f){
 #endif
 		{
 			int err;
-			mblk_t *om=allocb(bytes,0);
+			mblk_t *om;
 			if (d->pause_time>0){
+				om=allocb(bytes,0);
 				err=bytes;
 				memset(om->b_wptr,0,bytes);
 				d->pause_time-=f->ticker->interval;
+			}else if (d->prompt!=NULL){
+				om=player_read_prompt(d,bytes,&err);
 			}else{
+				om=allocb(bytes,0);
 				err=read(d->fd,om->b_wptr,bytes);
 				if (d->swap) swap_bytes(om->b_wptr,bytes);
 			}
@@ -373,7 +466,7 @@ static void player_process(MSFilter *f){
 				}else freemsg(om);
 				if (err<bytes){
 					ms_filter_notify_no_arg(f,MS_FILE_PLAYER_EOF);
-					lseek(d->fd,d->hsize,SEEK_SET);
+					player_rewind(d);
 
 					/* special value for playing file only once */
 					if (d->loop_after<0)
@@ -409,6 +502,12 @@ static int player_set_sr(MSFilter *f, void *arg) {
 	return 0;
 }
 
+static int player_set_cached_rate(MSFilter *f, void *arg){
+	PlayerData *d=(PlayerData*)f->data;
+	d->cached_rate=*(int*)arg;
+	return 0;
+}
+
 static int player_loop(MSFilter *f, void *arg){
 	PlayerData *d=(PlayerData*)f->data;
 	d->loop_after=*((int*)arg);
@@ -440,6 +539,7 @@ static MSFilterMethod player_methods[]={
 	{	MS_FILTER_GET_NCHANNELS, player_get_nch	},
 	{	MS_FILE_PLAYER_LOOP,	player_loop	},
 	{	MS_FILE_PLAYER_DONE,	player_eof	},
+	{	MS_FILE_PLAYER_SET_CACHED_RATE,	player_set_cached_rate	},
 	/* this wav file player implements the MSFilterPlayerInterface*/
 	{ MS_PLAYER_OPEN , player_open },
 	{ MS_PLAYER_START , player_start },
@@ -24,8 +24,17 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/msfilerec.h"
 #include "waveheader.h"
 
+#ifdef WIN32
+#include <io.h>
+#define fsync _commit
+#endif
+
+#define REC_DEFAULT_MAX_PENDING 16
+#define REC_DEFAULT_SYNC_INTERVAL 5000
+
 
 static int rec_close(MSFilter *f, void *arg);
+static void write_wav_header(int fd, int rate, int nchannels, int size);
 
 typedef struct RecState{
 	int fd;
@@ -33,18 +42,211 @@ typedef struct RecState{
 	int nchannels;
 	int size;
 	MSRecorderState state;
+	MSFileRecAsyncParams async;
+	MSFileRecStats stats;
+	mblk_t *batch; /*batch being filled by the ticker thread*/
+	/*the following are protected by the writer's lock*/
+	queue_t pending; /*batches waiting for the writer thread*/
+	int npending;
+	int disk_size;
+	uint64_t last_sync_time;
+	bool_t writing;
+	bool_t registered;
 } RecState;
 
+/*background thread writing the batches of all asynchronous recorders*/
+typedef struct RecWriter{
+	ms_thread_t thread;
+	ms_mutex_t mutex;
+	ms_cond_t cond;
+	MSList *recorders;
+	int refcount;
+	bool_t running;
+	bool_t stopping; /*the last recorder left and the thread is being joined*/
+} RecWriter;
+
+static RecWriter rec_writer;
+
+void ms_file_rec_writer_init(void){
+	memset(&rec_writer,0,sizeof(rec_writer));
+	ms_mutex_init(&rec_writer.mutex,NULL);
+	ms_cond_init(&rec_writer.cond,NULL);
+}
+
+void ms_file_rec_writer_exit(void){
+	ms_mutex_destroy(&rec_writer.mutex);
+	ms_cond_destroy(&rec_writer.cond);
+}
+
+static uint64_t rec_get_cur_time_ms(void){
+	MSTimeSpec ts;
+	ms_get_cur_time(&ts);
+	return (ts.tv_sec*1000LL) + ((ts.tv_nsec+500000LL)/1000000LL);
+}
+
+/*called by the writer thread without the lock*/
+static int rec_write_batch(RecState *s, mblk_t *m){
+	int len=m->b_wptr-m->b_rptr;
+	int err;
+	if ((err=write(s->fd,m->b_rptr,len))!=len){
+		if (err<0)
+			ms_warning("MSFileRec: fail to write %i bytes: %s",len,strerror(errno));
+	}
+	freemsg(m);
+	return err>0 ? err : 0;
+}
+
+static void rec_periodic_sync(RecState *s){
+	uint64_t now=rec_get_cur_time_ms();
+	if (now-s->last_sync_time<(uint64_t)s->async.sync_interval) return;
+	/*keep the file playable if we crash: update the header, then go back to the end of data*/
+	write_wav_header(s->fd,s->rate,s->nchannels,s->disk_size);
+	lseek(s->fd,0,SEEK_END);
+	fsync(s->fd);
+	s->last_sync_time=now;
+}
+
+static void *rec_writer_run(void *arg){
+	RecWriter *w=(RecWriter*)arg;
+	ms_mutex_lock(&w->mutex);
+	while(w->running){
+		MSList *elem;
+		bool_t worked=FALSE;
+		for(elem=w->recorders;elem!=NULL;elem=elem->next){
+			RecState *s=(RecState*)elem->data;
+			mblk_t *m=getq(&s->pending);
+			int written;
+			if (m==NULL) continue;
+			s->npending--;
+			/*a recorder being written cannot be removed from the list*/
+			s->writing=TRUE;
+			ms_mutex_unlock(&w->mutex);
+			written=rec_write_batch(s,m);
+			ms_mutex_lock(&w->mutex);
+			s->disk_size+=written;
+			s->stats.bytes_written+=written;
+			s->stats.batches_written++;
+			if (s->async.fsync_policy==MSFileRecFsyncPeriodic){
+				ms_mutex_unlock(&w->mutex);
+				rec_periodic_sync(s);
+				ms_mutex_lock(&w->mutex);
+			}
+			s->writing=FALSE;
+			worked=TRUE;
+			ms_cond_broadcast(&w->cond);
+		}
+		if (!worked) ms_cond_wait(&w->cond,&w->mutex);
+	}
+	ms_mutex_unlock(&w->mutex);
+	return NULL;
+}
+
+static void rec_writer_add(RecState *s){
+	RecWriter *w=&rec_writer;
+	ms_mutex_lock(&w->mutex);
+	/*a new thread cannot be started before the previous one is joined*/
+	while(w->stopping){
+		ms_cond_wait(&w->cond,&w->mutex);
+	}
+	w->recorders=ms_list_append(w->recorders,s);
+	s->registered=TRUE;
+	s->npending=0;
+	s->disk_size=s->size;
+	s->last_sync_time=rec_get_cur_time_ms();
+	if (w->refcount++==0){
+		w->running=TRUE;
+		ms_thread_create(&w->thread,NULL,rec_writer_run,w);
+	}
+	ms_mutex_unlock(&w->mutex);
+}
+
+/*waits for all the pending batches of the recorder to be written*/
+static void rec_writer_remove(RecState *s){
+	RecWriter *w=&rec_writer;
+	ms_thread_t thread;
+	bool_t last;
+	ms_mutex_lock(&w->mutex);
+	while(s->npending>0 || s->writing){
+		ms_cond_wait(&w->cond,&w->mutex);
+	}
+	w->recorders=ms_list_remove(w->recorders,s);
+	s->registered=FALSE;
+	last=(--w->refcount==0);
+	if (last){
+		w->running=FALSE;
+		w->stopping=TRUE;
+		thread=w->thread;
+		ms_cond_broadcast(&w->cond);
+	}
+	ms_mutex_unlock(&w->mutex);
+	if (last){
+		ms_thread_join(thread,NULL);
+		ms_mutex_lock(&w->mutex);
+		w->stopping=FALSE;
+		ms_cond_broadcast(&w->cond);
+		ms_mutex_unlock(&w->mutex);
+	}
+}
+
+/*hands the current batch over to the writer thread, or drops it if the writer is late*/
+static void rec_flush_batch(RecState *s){
+	RecWriter *w=&rec_writer;
+	mblk_t *m=s->batch;
+	int len;
+
+	if (m==NULL) return;
+	s->batch=NULL;
+	len=m->b_wptr-m->b_rptr;
+	if (len==0){
+		freemsg(m);
+		return;
+	}
+	ms_mutex_lock(&w->mutex);
+	if (s->npending>=s->async.max_pending){
+		s->stats.overruns++;
+		s->stats.bytes_dropped+=len;
+		ms_mutex_unlock(&w->mutex);
+		freemsg(m);
+		return;
+	}
+	putq(&s->pending,m);
+	if (++s->npending>s->stats.max_pending) s->stats.max_pending=s->npending;
+	s->size+=len;
+	ms_cond_broadcast(&w->cond);
+	ms_mutex_unlock(&w->mutex);
+}
+
 static void rec_init(MSFilter *f){
-	RecState *s=ms_new(RecState,1);
+	RecState *s=ms_new0(RecState,1);
 	s->fd=-1;
 	s->rate=8000;
 	s->nchannels = 1;
 	s->size=0;
 	s->state=MSRecorderClosed;
+	s->async.buffer_size=0;
+	s->async.max_pending=REC_DEFAULT_MAX_PENDING;
+	s->async.fsync_policy=MSFileRecFsyncNever;
+	s->async.sync_interval=REC_DEFAULT_SYNC_INTERVAL;
+	qinit(&s->pending);
 	f->data=s;
 }
 
+static void rec_process_async(RecState *s, mblk_t *it){
+	while(it!=NULL){
+		uint8_t *rptr=it->b_rptr;
+		while(rptr<it->b_wptr){
+			int len;
+			if (s->batch==NULL) s->batch=allocb(s->async.buffer_size,0);
+			len=MIN(it->b_wptr-rptr,s->batch->b_datap->db_lim-s->batch->b_wptr);
+			memcpy(s->batch->b_wptr,rptr,len);
+			s->batch->b_wptr+=len;
+			rptr+=len;
+			if (s->batch->b_wptr==s->batch->b_datap->db_lim) rec_flush_batch(s);
+		}
+		it=it->b_cont;
+	}
+}
+
 static void rec_process(MSFilter *f){
 	RecState *s=(RecState*)f->data;
 	mblk_t *m;
@@ -53,7 +255,9 @@ static void rec_process(MSFilter *f){
 		mblk_t *it=m;
 		ms_mutex_lock(&f->lock);
 		if (s->state==MSRecorderRunning){
-			while(it!=NULL){
+			if (s->registered){
+				rec_process_async(s,it);
+			}else while(it!=NULL){
 				int len=it->b_wptr-it->b_rptr;
 				if ((err=write(s->fd,it->b_rptr,len))!=len){
 					if (err<0)
@@ -109,7 +313,11 @@ static int rec_open(MSFilter *f, void *arg){
 				ms_error("Could not lseek to end of file: %s",strerror(errno));
 			}
 		}else ms_error("fstat() failed: %s",strerror(errno));
+	}else{
+		/*reserve room for the header, so that rewriting it on close or sync doesn't overwrite audio*/
+		write_wav_header(s->fd,s->rate,s->nchannels,0);
 	}
+	if (s->async.buffer_size>0) rec_writer_add(s);
 	ms_mutex_lock(&f->lock);
 	s->state=MSRecorderPaused;
 	ms_mutex_unlock(&f->lock);
@@ -132,6 +340,7 @@ static int rec_stop(MSFilter *f, void *arg){
 	RecState *s=(RecState*)f->data;
 	ms_mutex_lock(&f->lock);
 	s->state=MSRecorderPaused;
+	if (s->registered) rec_flush_batch(s);
 	ms_mutex_unlock(&f->lock);
 	return 0;
 }
@@ -161,14 +370,22 @@ static void write_wav_header(int fd, int rate, int nchannels, int size){
 
 static int rec_close(MSFilter *f, void *arg){
 	RecState *s=(RecState*)f->data;
+	bool_t registered;
 	ms_mutex_lock(&f->lock);
 	s->state=MSRecorderClosed;
+	registered=s->registered;
+	if (registered) rec_flush_batch(s);
+	ms_mutex_unlock(&f->lock);
+	/*the ticker no longer touches the file once closed, so drain without blocking it*/
+	if (registered) rec_writer_remove(s);
 	if (s->fd!=-1){
 		write_wav_header(s->fd, s->rate, s->nchannels, s->size);
+		if (s->async.fsync_policy!=MSFileRecFsyncNever) fsync(s->fd);
 		close(s->fd);
+		ms_mutex_lock(&f->lock);
 		s->fd=-1;
+		ms_mutex_unlock(&f->lock);
 	}
-	ms_mutex_unlock(&f->lock);
 	return 0;
 }
 
@@ -192,9 +409,31 @@ static int rec_set_nchannels(MSFilter *f, void *arg) {
 	return 0;
 }
 
+static int rec_set_async_params(MSFilter *f, void *arg){
+	RecState *s=(RecState*)f->data;
+	MSFileRecAsyncParams *params=(MSFileRecAsyncParams*)arg;
+	if (s->fd!=-1){
+		ms_error("MSFileRec: async params must be set before opening the file.");
+		return -1;
+	}
+	s->async=*params;
+	if (s->async.max_pending<=0) s->async.max_pending=REC_DEFAULT_MAX_PENDING;
+	if (s->async.sync_interval<=0) s->async.sync_interval=REC_DEFAULT_SYNC_INTERVAL;
+	return 0;
+}
+
+static int rec_get_stats(MSFilter *f, void *arg){
+	RecState *s=(RecState*)f->data;
+	ms_mutex_lock(&rec_writer.mutex);
+	*(MSFileRecStats*)arg=s->stats;
+	ms_mutex_unlock(&rec_writer.mutex);
+	return 0;
+}
+
 static void rec_uninit(MSFilter *f){
 	RecState *s=(RecState*)f->data;
 	if (s->fd!=-1) rec_close(f,NULL);
+	flushq(&s->pending,0);
 	ms_free(s);
 }
 
@@ -205,6 +444,8 @@ static MSFilterMethod rec_methods[]={
 	{	MS_FILE_REC_START	,	rec_start	},
 	{	MS_FILE_REC_STOP	,	rec_stop	},
 	{	MS_FILE_REC_CLOSE	,	rec_close	},
+	{	MS_FILE_REC_SET_ASYNC_PARAMS	,	rec_set_async_params	},
+	{	MS_FILE_REC_GET_STATS	,	rec_get_stats	},
 	{	MS_RECORDER_OPEN	,	rec_open	},
 	{	MS_RECORDER_START	,	rec_start	},
 	{	MS_RECORDER_PAUSE	,	rec_stop	},
@@ -384,7 +384,7 @@ static void update_energy(int16_t *signal, int numsamples, Volume *v) {
 	v->instant_energy = en;// currently non-averaged energy seems better (short artefacts)
 }
 
-static void apply_gain(Volume *v, mblk_t *m, float tgain) {
+static mblk_t *apply_gain(Volume *v, mblk_t *m, float tgain) {
 	int16_t *sample;
 	int dc_offset = 0;
 	int32_t intgain;
@@ -412,6 +412,7 @@ static void apply_gain(Volume *v, mblk_t *m, float tgain) {
 	//if (v->peer) ms_message("MSVolume:%p Applying gain %5f, v->gain=%5f, tgain=%5f, ng_gain=%5f",v,gain,v->gain,tgain,v->ng_gain); 
 
 	if (v->remove_dc){
+		m=ms_msg_make_writable(m);
 		for (	sample=(int16_t*)m->b_rptr;
 					sample<(int16_t*)m->b_wptr;
 					++sample){
@@ -421,12 +422,14 @@ static void apply_gain(Volume *v, mblk_t *m, float tgain) {
 		/* offset smoothing */
 		v->dc_offset = (v->dc_offset*7 + dc_offset*2/(m->b_wptr - m->b_rptr)) / 8;
 	}else if (gain!=1){
+		m=ms_msg_make_writable(m);
 		for (	sample=(int16_t*)m->b_rptr;
 					sample<(int16_t*)m->b_wptr;
 					++sample){
 			*sample = saturate(((*sample) * intgain) / 4096);
 		}
 	}
+	return m;
 }
 
 static void volume_preprocess(MSFilter *f){
@@ -482,7 +485,7 @@ static void volume_process(MSFilter *f){
 			if (v->agc_enabled) target_gain/= volume_agc_process(v, om);
 			if (v->noise_gate_enabled)
 				volume_noise_gate_process(v, v->instant_energy, om);
-			apply_gain(v, om, target_gain);
+			om=apply_gain(v, om, target_gain);
 			ms_queue_put(f->outputs[0],om);
 		}
 	}else{
@@ -493,7 +496,7 @@ static void volume_process(MSFilter *f){
 
 			if (v->noise_gate_enabled)
 				volume_noise_gate_process(v, v->instant_energy, m);
-			apply_gain(v, m, target_gain);
+			m=apply_gain(v, m, target_gain);
 			ms_queue_put(f->outputs[0],m);
 		}
 	}
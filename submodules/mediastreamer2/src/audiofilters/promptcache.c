@@ -0,0 +1,143 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006  Simon MORLAT (simon.morlat@linphone.org)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "mediastreamer-config.h"
+#endif
+
+#include "promptcache.h"
+#include "waveheader.h"
+
+/*files bigger than this are read from disk at each tick instead of being cached*/
+#define PROMPT_CACHE_DEFAULT_MAX_FILE_SIZE (1024*1024)
+
+typedef struct _PromptCache{
+	ms_mutex_t mutex;
+	MSList *entries;
+	int max_file_size;
+}PromptCache;
+
+static PromptCache prompt_cache;
+
+void ms_file_player_cache_init(void){
+	memset(&prompt_cache,0,sizeof(prompt_cache));
+	ms_mutex_init(&prompt_cache.mutex,NULL);
+	prompt_cache.max_file_size=PROMPT_CACHE_DEFAULT_MAX_FILE_SIZE;
+}
+
+static void prompt_cache_entry_destroy(MSPromptCacheEntry *e){
+	ms_free(e->path);
+	freemsg(e->data);
+	ms_free(e);
+}
+
+void ms_file_player_cache_flush(void){
+	MSList *elem;
+	MSList *used=NULL;
+	ms_mutex_lock(&prompt_cache.mutex);
+	for(elem=prompt_cache.entries;elem!=NULL;elem=elem->next){
+		MSPromptCacheEntry *e=(MSPromptCacheEntry*)elem->data;
+		if (e->refcount==0) prompt_cache_entry_destroy(e);
+		else used=ms_list_append(used,e);
+	}
+	ms_list_free(prompt_cache.entries);
+	prompt_cache.entries=used;
+	ms_mutex_unlock(&prompt_cache.mutex);
+}
+
+void ms_file_player_cache_exit(void){
+	ms_file_player_cache_flush();
+	if (prompt_cache.entries!=NULL)
+		ms_warning("%i prompts still in use at exit.",ms_list_size(prompt_cache.entries));
+	ms_mutex_destroy(&prompt_cache.mutex);
+}
+
+void ms_file_player_cache_set_max_file_size(int bytes){
+	ms_mutex_lock(&prompt_cache.mutex);
+	prompt_cache.max_file_size=bytes;
+	ms_mutex_unlock(&prompt_cache.mutex);
+}
+
+static MSPromptCacheEntry *prompt_cache_load(const char *path, int fd, const struct stat *st, int offset, int key,
+	const MSPromptFormat *fmt, MSPromptLoader loader, void *user_data){
+	MSPromptCacheEntry *e;
+	MSPromptFormat loaded_fmt=*fmt;
+	mblk_t *data=loader(fd,st->st_size-offset,&loaded_fmt,user_data);
+
+	if (data==NULL) return NULL;
+	e=ms_new0(MSPromptCacheEntry,1);
+	e->path=ms_strdup(path);
+	e->mtime=st->st_mtime;
+	e->file_size=st->st_size;
+	e->key=key;
+	e->fmt=loaded_fmt;
+	e->data=data;
+	ms_message("Prompt %s cached: %i bytes at %i Hz",path,(int)(data->b_wptr-data->b_rptr),e->fmt.rate);
+	return e;
+}
+
+MSPromptCacheEntry *ms_prompt_cache_get(const char *path, int fd, int offset, int key, const MSPromptFormat *fmt,
+	MSPromptLoader loader, void *user_data){
+	struct stat st;
+	MSList *elem;
+	MSPromptCacheEntry *found=NULL;
+
+	if (fstat(fd,&st)!=0) return NULL;
+	ms_mutex_lock(&prompt_cache.mutex);
+	if (st.st_size-offset>prompt_cache.max_file_size || st.st_size<=offset){
+		ms_mutex_unlock(&prompt_cache.mutex);
+		return NULL;
+	}
+	for(elem=prompt_cache.entries;elem!=NULL;){
+		MSPromptCacheEntry *e=(MSPromptCacheEntry*)elem->data;
+		MSList *next=elem->next;
+		if (strcmp(e->path,path)==0 && e->key==key){
+			if (e->mtime==st.st_mtime && e->file_size==st.st_size){
+				found=e;
+				break;
+			}
+			/*the file was modified*/
+			prompt_cache.entries=ms_list_remove_link(prompt_cache.entries,elem);
+			if (e->refcount==0) prompt_cache_entry_destroy(e);
+			else e->stale=TRUE;
+		}
+		elem=next;
+	}
+	if (found==NULL){
+		found=prompt_cache_load(path,fd,&st,offset,key,fmt,loader,user_data);
+		if (found!=NULL) prompt_cache.entries=ms_list_prepend(prompt_cache.entries,found);
+	}
+	if (found!=NULL) found->refcount++;
+	ms_mutex_unlock(&prompt_cache.mutex);
+	return found;
+}
+
+void ms_prompt_cache_release(MSPromptCacheEntry *e){
+	ms_mutex_lock(&prompt_cache.mutex);
+	e->refcount--;
+	if (e->refcount==0 && e->stale) prompt_cache_entry_destroy(e);
+	ms_mutex_unlock(&prompt_cache.mutex);
+}
+
+mblk_t *ms_prompt_cache_view(const MSPromptCacheEntry *e, int offset, int size){
+	mblk_t *om=dupb(e->data);
+	om->b_rptr=e->data->b_rptr+offset;
+	om->b_wptr=om->b_rptr+size;
+	return om;
+}
@@ -0,0 +1,66 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006  Simon MORLAT (simon.morlat@linphone.org)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef promptcache_h
+#define promptcache_h
+
+#include "mediastreamer2/mscommon.h"
+#include <ortp/str_utils.h>
+
+#include <sys/types.h>
+
+/*
+ * Process-wide cache of the prompts played by the players. A file is loaded once, then every player
+ * playing it sends dupb() views on the shared buffer: a prompt played on many calls at once costs neither
+ * I/O nor copies. The buffer is shared read-only: filters modifying samples in place use ms_msg_make_writable().
+ */
+
+typedef struct _MSPromptFormat{
+	int rate;
+	int nchannels;
+	int samplesize;
+}MSPromptFormat;
+
+typedef struct _MSPromptCacheEntry{
+	char *path;
+	time_t mtime;
+	off_t file_size;
+	int key; /*tells apart several versions of a same file, like resampled ones*/
+	MSPromptFormat fmt;
+	mblk_t *data;
+	int refcount;
+	bool_t stale; /*the file changed since it was loaded, dropped with its last user*/
+}MSPromptCacheEntry;
+
+/*
+ * Loads the content to cache: size bytes read from fd, which is positioned after the header already parsed by the caller.
+ * fmt is initialized with the format given to ms_prompt_cache_get() and is updated if the content is converted.
+ */
+typedef mblk_t *(*MSPromptLoader)(int fd, int size, MSPromptFormat *fmt, void *user_data);
+
+/*returns the cached content of the file opened on fd, loading it if needed, or NULL if it is too big to be cached*/
+MSPromptCacheEntry *ms_prompt_cache_get(const char *path, int fd, int offset, int key, const MSPromptFormat *fmt,
+	MSPromptLoader loader, void *user_data);
+
+void ms_prompt_cache_release(MSPromptCacheEntry *e);
+
+/*returns a read-only view on size bytes of the cached data starting at offset*/
+mblk_t *ms_prompt_cache_view(const MSPromptCacheEntry *e, int offset, int size);
+
+#endif
@@ -0,0 +1,244 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006  Simon MORLAT (simon.morlat@linphone.org)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include <mediastreamer2/msfilter.h>
+#include <mediastreamer2/msticker.h>
+#include <mediastreamer2/mstimestretch.h>
+#include <ortp/ortp.h>
+
+#include <math.h>
+
+/*searched pitch periods: 2.5ms to 12.5ms (400Hz down to 80Hz)*/
+#define MIN_PERIOD_DIV 400
+#define MAX_PERIOD_DIV 80
+/*below this normalized correlation, removing or repeating a period would be audible*/
+#define MIN_CORRELATION 0.5f
+/*mean square value under which a block is considered as silence (about -50 dbm0)*/
+#define SILENCE_ENERGY 10000.0f
+/*minimum interval between two stretching operations*/
+#define STRETCH_GUARD_MS 40
+
+typedef struct _TimeStretchState{
+	RtpSession *session;
+	int rate;
+	int nchannels;
+	uint64_t last_stretch_time;
+	MSTimeStretchStats stats;
+} TimeStretchState;
+
+static void time_stretch_init(MSFilter *f){
+	TimeStretchState *s=(TimeStretchState *)ms_new0(TimeStretchState,1);
+	s->rate=8000;
+	s->nchannels=1;
+	f->data=s;
+}
+
+static void time_stretch_uninit(MSFilter *f){
+	ms_free(f->data);
+}
+
+/*returns the period whose two first occurences are the most alike, 0 if none is good enough*/
+static int find_pitch_period(const int16_t *samples, int nsamples, int pmin, int pmax){
+	int p,i,best=0;
+	float best_corr=MIN_CORRELATION;
+	float energy=0;
+
+	if (2*pmax>nsamples) pmax=nsamples/2;
+	if (pmax<pmin) return 0;
+
+	for(i=0;i<2*pmax;++i) energy+=(float)samples[i]*(float)samples[i];
+	if (energy<SILENCE_ENERGY*2*pmax) return pmax;
+
+	for(p=pmin;p<=pmax;++p){
+		float corr=0,e1=0,e2=0;
+		for(i=0;i<p;++i){
+			float a=samples[i];
+			float b=samples[i+p];
+			corr+=a*b;
+			e1+=a*a;
+			e2+=b*b;
+		}
+		if (e1==0 || e2==0) continue;
+		corr=corr/sqrtf(e1*e2);
+		if (corr>best_corr){
+			best_corr=corr;
+			best=p;
+		}
+	}
+	return best;
+}
+
+/*replaces the two first periods by their cross-fade*/
+static void remove_period(mblk_t *m, int period){
+	int16_t *samples=(int16_t*)m->b_rptr;
+	int nsamples=(m->b_wptr-m->b_rptr)/2;
+	int i;
+	for(i=0;i<period;++i){
+		samples[i]=(int16_t)(((int)samples[i]*(period-i) + (int)samples[i+period]*i)/period);
+	}
+	memmove(samples+period,samples+2*period,(nsamples-2*period)*2);
+	m->b_wptr-=period*2;
+}
+
+/*inserts after the first period a cross-fade from the second period back to the first one*/
+static mblk_t *repeat_period(mblk_t *m, int period){
+	const int16_t *samples=(const int16_t*)m->b_rptr;
+	int nsamples=(m->b_wptr-m->b_rptr)/2;
+	mblk_t *om=allocb((nsamples+period)*2,0);
+	int16_t *out=(int16_t*)om->b_wptr;
+	int i;
+
+	mblk_meta_copy(m,om);
+	memcpy(out,samples,period*2);
+	for(i=0;i<period;++i){
+		out[period+i]=(int16_t)(((int)samples[period+i]*(period-i) + (int)samples[i]*i)/period);
+	}
+	memcpy(out+2*period,samples+period,(nsamples-period)*2);
+	om->b_wptr+=(nsamples+period)*2;
+	freemsg(m);
+	return om;
+}
+
+static mblk_t *time_stretch_block(MSFilter *f, TimeStretchState *s, mblk_t *m){
+	PayloadType *pt;
+	int error,period,nsamples;
+
+	if (f->ticker->time<s->last_stretch_time+STRETCH_GUARD_MS) return m;
+	error=rtp_session_get_jitter_compensation_error(s->session);
+	pt=rtp_profile_get_payload(rtp_session_get_profile(s->session),rtp_session_get_recv_payload_type(s->session));
+	if (pt==NULL || pt->clock_rate<=0) return m;
+	/*stretch when the error exceeds the shortest period we could use*/
+	if (abs(error)*MIN_PERIOD_DIV<pt->clock_rate) return m;
+
+	if (m->b_cont) msgpullup(m,-1);
+	nsamples=(m->b_wptr-m->b_rptr)/2;
+	period=find_pitch_period((int16_t*)m->b_rptr,nsamples,s->rate/MIN_PERIOD_DIV,s->rate/MAX_PERIOD_DIV);
+	if (period==0) return m;
+	/*do not overshoot the target*/
+	if (period*(int64_t)pt->clock_rate>abs(error)*(int64_t)s->rate){
+		period=(int)(((int64_t)abs(error)*s->rate)/pt->clock_rate);
+		if (period<s->rate/MIN_PERIOD_DIV) return m;
+	}
+
+	if (error<0){
+		remove_period(m,period);
+		s->stats.compressed++;
+		rtp_session_shift_jitter_compensation(s->session,-(int)(((int64_t)period*pt->clock_rate)/s->rate));
+	}else{
+		m=repeat_period(m,period);
+		s->stats.expanded++;
+		rtp_session_shift_jitter_compensation(s->session,(int)(((int64_t)period*pt->clock_rate)/s->rate));
+	}
+	s->last_stretch_time=f->ticker->time;
+	return m;
+}
+
+static void time_stretch_process(MSFilter *f){
+	TimeStretchState *s=(TimeStretchState*)f->data;
+	mblk_t *m;
+
+	while((m=ms_queue_get(f->inputs[0]))!=NULL){
+		if (s->session!=NULL && s->nchannels==1)
+			m=time_stretch_block(f,s,m);
+		ms_queue_put(f->outputs[0],m);
+	}
+}
+
+static void time_stretch_postprocess(MSFilter *f){
+	TimeStretchState *s=(TimeStretchState*)f->data;
+	ms_message("MSTimeStretch: %i periods inserted, %i periods removed",s->stats.expanded,s->stats.compressed);
+}
+
+static int time_stretch_set_session(MSFilter *f, void *arg){
+	TimeStretchState *s=(TimeStretchState*)f->data;
+	s->session=(RtpSession*)arg;
+	rtp_session_enable_jitter_buffer_time_stretching(s->session,TRUE);
+	return 0;
+}
+
+static int time_stretch_get_stats(MSFilter *f, void *arg){
+	TimeStretchState *s=(TimeStretchState*)f->data;
+	*(MSTimeStretchStats*)arg=s->stats;
+	return 0;
+}
+
+static int time_stretch_set_sr(MSFilter *f, void *arg){
+	TimeStretchState *s=(TimeStretchState*)f->data;
+	s->rate=*(int*)arg;
+	return 0;
+}
+
+static int time_stretch_get_sr(MSFilter *f, void *arg){
+	TimeStretchState *s=(TimeStretchState*)f->data;
+	*(int*)arg=s->rate;
+	return 0;
+}
+
+static int time_stretch_set_nchannels(MSFilter *f, void *arg){
+	TimeStretchState *s=(TimeStretchState*)f->data;
+	s->nchannels=*(int*)arg;
+	return 0;
+}
+
+static MSFilterMethod time_stretch_methods[]={
+	{	MS_TIME_STRETCH_SET_SESSION	,	time_stretch_set_session	},
+	{	MS_TIME_STRETCH_GET_STATS	,	time_stretch_get_stats		},
+	{	MS_FILTER_SET_SAMPLE_RATE	,	time_stretch_set_sr		},
+	{	MS_FILTER_GET_SAMPLE_RATE	,	time_stretch_get_sr		},
+	{	MS_FILTER_SET_NCHANNELS		,	time_stretch_set_nchannels	},
+	{	0				,	NULL				}
+};
+
+#ifdef _MSC_VER
+
+MSFilterDesc ms_time_stretch_desc={
+	MS_TIME_STRETCH_ID,
+	"MSTimeStretch",
+	N_("Applies jitter buffer delay changes by time stretching."),
+	MS_FILTER_OTHER,
+	NULL,
+	1,
+	1,
+	time_stretch_init,
+	NULL,
+	time_stretch_process,
+	time_stretch_postprocess,
+	time_stretch_uninit,
+	time_stretch_methods
+};
+
+#else
+
+MSFilterDesc ms_time_stretch_desc={
+	.id=MS_TIME_STRETCH_ID,
+	.name="MSTimeStretch",
+	.text=N_("Applies jitter buffer delay changes by time stretching."),
+	.category=MS_FILTER_OTHER,
+	.ninputs=1,
+	.noutputs=1,
+	.init=time_stretch_init,
+	.process=time_stretch_process,
+	.postprocess=time_stretch_postprocess,
+	.uninit=time_stretch_uninit,
+	.methods=time_stretch_methods
+};
+
+#endif
+
+MS_FILTER_DESC_EXPORT(ms_time_stretch_desc)
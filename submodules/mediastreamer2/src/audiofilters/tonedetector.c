@@ -32,73 +32,110 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 #define MAX_SCANS 10
+/*MAX_SCANS rounded up to a multiple of 4, so that the loop over the lanes of the bank maps on SIMD registers*/
+#define BANK_LANES 12
+/*maximum number of staggered analysis windows in sliding window mode*/
+#define MAX_WINDOWS 4
 
 static const float energy_min_threshold=0.01;
 
 typedef struct _GoertzelState{
 	uint64_t starttime;
 	int dur;
-	float coef;
 	bool_t event_sent;
 	bool_t pad[3];
 }GoertzelState;
 
-static void goertzel_state_init(GoertzelState *gs, int frequency, int sampling_frequency){
-	gs->coef=(float)2*(float)cos(2*M_PI*((float)frequency/(float)sampling_frequency));
-	gs->starttime=0;
-	gs->dur=0;
+/*
+ * Goertzel recurrences of all the scanned frequencies over one analysis window, one lane per frequency.
+ * nsamples is negative while the window waits for its start in sliding window mode.
+ */
+typedef struct _GoertzelWindow{
+	float q1[BANK_LANES];
+	float q2[BANK_LANES];
+	float energy;
+	int nsamples;
+}GoertzelWindow;
+
+static float goertzel_coef(int frequency, int sampling_frequency){
+	return (float)2*(float)cos(2*M_PI*((float)frequency/(float)sampling_frequency));
 }
 
-static float goertzel_state_run(GoertzelState *gs,int16_t  *samples, int nsamples, float total_energy){
-	int i;
-	float tmp;
-	float q1=0;
-	float q2=0;
-	float freq_en;
+/*one pass over the samples for all the frequencies at once, and the signal energy*/
+static void goertzel_bank_run(const float *coefs, GoertzelWindow *w, const int16_t *samples, int nsamples){
+	int i,k;
+	float q1[BANK_LANES];
+	float q2[BANK_LANES];
+	float en=w->energy;
 
+	memcpy(q1,w->q1,sizeof(q1));
+	memcpy(q2,w->q2,sizeof(q2));
 	for(i=0;i<nsamples;++i){
-		tmp=q1;
-		q1=(gs->coef*q1) - q2 + (float)samples[i];
-		q2=tmp;
+		float x=(float)samples[i];
+		for(k=0;k<BANK_LANES;++k){
+			float tmp=q1[k];
+			q1[k]=(coefs[k]*q1[k]) - q2[k] + x;
+			q2[k]=tmp;
+		}
+		en+=x*x;
 	}
-	
-	freq_en= (q1*q1) + (q2*q2) - (q1*q2*gs->coef);
-	/*return a relative frequency energy compared over the total signal energy */
-	return freq_en/(total_energy*(float)nsamples*0.5);
+	memcpy(w->q1,q1,sizeof(q1));
+	memcpy(w->q2,q2,sizeof(q2));
+	w->energy=en;
+	w->nsamples+=nsamples;
 }
 
-static float compute_energy(int16_t *samples, int nsamples){
-	float en=0;
-	int i;
-	for(i=0;i<nsamples;++i){
-		float s=(float)samples[i];
-		en+=s*s;
-	}
-	return en;
+/*return a relative frequency energy compared over the total signal energy */
+static float goertzel_bank_get(const float *coefs, const GoertzelWindow *w, int lane){
+	float q1=w->q1[lane];
+	float q2=w->q2[lane];
+	float freq_en= (q1*q1) + (q2*q2) - (q1*q2*coefs[lane]);
+	return freq_en/(w->energy*(float)w->nsamples*0.5);
 }
 
 typedef struct _DetectorState{
 	MSToneDetectorDef tone_def[MAX_SCANS];
 	GoertzelState tone_gs[MAX_SCANS];
+	float coefs[BANK_LANES];
+	GoertzelWindow windows[MAX_WINDOWS];
+	int nwindows;
 	int nscans;
-	MSBufferizer *buf;
 	int rate;
-	int framesize;
+	int framesize; /*in samples*/
 	int frame_ms;
+	int hop_ms;
 }DetectorState;
 
+/*restart the analysis windows, staggered by hop_ms*/
+static void detector_reset_windows(DetectorState *s){
+	int i;
+	int hop=s->framesize/s->nwindows;
+	memset(s->windows,0,sizeof(s->windows));
+	for(i=0;i<s->nwindows;++i){
+		s->windows[i].nsamples=-i*hop;
+	}
+}
+
+static void detector_update_params(DetectorState *s){
+	int i;
+	s->framesize=(s->frame_ms*s->rate)/1000;
+	s->nwindows=s->frame_ms/s->hop_ms;
+	for(i=0;i<MAX_SCANS;++i){
+		s->coefs[i]=(s->tone_def[i].frequency!=0) ? goertzel_coef(s->tone_def[i].frequency,s->rate) : 0;
+	}
+	detector_reset_windows(s);
+}
+
 static void detector_init(MSFilter *f){
 	DetectorState *s=ms_new0(DetectorState,1);
-	s->buf=ms_bufferizer_new();
 	s->rate=8000;
 	s->frame_ms=20;
-	s->framesize=2*(s->frame_ms*s->rate)/1000;
+	s->hop_ms=s->frame_ms;
+	detector_update_params(s);
 	f->data=s;
 }
 
 static void detector_uninit(MSFilter *f){
-	DetectorState *s=(DetectorState *)f->data;
-	ms_bufferizer_destroy (s->buf);
 	ms_free(f->data);
 }
 
@@ -114,78 +151,130 @@ static int find_free_slot(DetectorState *s){
 static int detector_add_scan(MSFilter *f, void *arg){
 	DetectorState *s=(DetectorState *)f->data;
 	MSToneDetectorDef *def=(MSToneDetectorDef*)arg;
-	int i=find_free_slot(s);
+	int i;
+	ms_filter_lock(f);
+	i=find_free_slot(s);
 	if (i!=-1){
 		s->tone_def[i]=*def;
+		memset(&s->tone_gs[i],0,sizeof(GoertzelState));
 		s->nscans++;
-		goertzel_state_init(&s->tone_gs[i],def->frequency,s->rate);
-		return 0;
+		detector_update_params(s);
 	}
-	return -1;
+	ms_filter_unlock(f);
+	return (i!=-1) ? 0 : -1;
 }
 
 static int detector_clear_scans(MSFilter *f, void *arg){
 	DetectorState *s=(DetectorState *)f->data;
+	ms_filter_lock(f);
 	memset(&s->tone_def,0,sizeof(s->tone_def));
 	s->nscans=0;
+	detector_update_params(s);
+	ms_filter_unlock(f);
 	return 0;
 }
 
 static int detector_set_rate(MSFilter *f, void *arg){
 	DetectorState *s=(DetectorState *)f->data;
+	ms_filter_lock(f);
 	s->rate = *((int*) arg);
+	detector_update_params(s);
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int detector_set_window_hop(MSFilter *f, void *arg){
+	DetectorState *s=(DetectorState *)f->data;
+	int hop_ms=*(int*)arg;
+	if (hop_ms<=0 || hop_ms>s->frame_ms || s->frame_ms%hop_ms!=0 || s->frame_ms/hop_ms>MAX_WINDOWS){
+		ms_error("MSToneDetector: unsupported window hop of %i ms, must divide %i ms at most %i times",hop_ms,s->frame_ms,MAX_WINDOWS);
+		return -1;
+	}
+	ms_filter_lock(f);
+	s->hop_ms=hop_ms;
+	detector_update_params(s);
+	ms_filter_unlock(f);
 	return 0;
 }
 
 static void end_all_tones(DetectorState *s){
 	int i;
-	for(i=0;i<s->nscans;++i){
+	for(i=0;i<MAX_SCANS;++i){
 		GoertzelState *gs=&s->tone_gs[i];
 		gs->dur=0;
 		gs->event_sent=FALSE;
 	}
 }
 
+/*a window covers a whole frame: check each scanned tone and restart it*/
+static void detector_window_complete(MSFilter *f, DetectorState *s, GoertzelWindow *w){
+	if (w->energy>energy_min_threshold*(32767.0*32767.0*0.7)){
+		int i;
+		for(i=0;i<MAX_SCANS;++i){
+			GoertzelState *gs=&s->tone_gs[i];
+			MSToneDetectorDef *tone_def=&s->tone_def[i];
+			float freq_en;
+			if (tone_def->frequency==0) continue;
+			freq_en=goertzel_bank_get(s->coefs,w,i);
+			if (freq_en>=tone_def->min_amplitude){
+				if (gs->dur==0) gs->starttime=f->ticker->time;
+				gs->dur+=s->hop_ms;
+				if (gs->dur>=tone_def->min_duration && !gs->event_sent){
+					MSToneDetectorEvent event;
+
+					strncpy(event.tone_name,tone_def->tone_name,sizeof(event.tone_name));
+					event.tone_start_time=gs->starttime;
+					ms_filter_notify(f,MS_TONE_DETECTOR_EVENT,&event);
+					gs->event_sent=TRUE;
+				}
+			}else{
+				gs->event_sent=FALSE;
+				gs->dur=0;
+				gs->starttime=0;
+			}
+		}
+	}else end_all_tones(s);
+	memset(w,0,sizeof(GoertzelWindow));
+}
+
+/*feed the samples of a fragment to every window, windows completing a frame are evaluated on the way*/
+static void detector_run(MSFilter *f, DetectorState *s, const int16_t *samples, int nsamples){
+	int i;
+	for(i=0;i<s->nwindows;++i){
+		GoertzelWindow *w=&s->windows[i];
+		const int16_t *p=samples;
+		int remaining=nsamples;
+		if (w->nsamples<0){
+			int skip=MIN(-w->nsamples,remaining);
+			w->nsamples+=skip;
+			p+=skip;
+			remaining-=skip;
+		}
+		while(remaining>0){
+			int n=MIN(s->framesize-w->nsamples,remaining);
+			goertzel_bank_run(s->coefs,w,p,n);
+			p+=n;
+			remaining-=n;
+			if (w->nsamples==s->framesize) detector_window_complete(f,s,w);
+		}
+	}
+}
+
 static void detector_process(MSFilter *f){
 	DetectorState *s=(DetectorState *)f->data;
 	mblk_t *m;
-	
+
 	while ((m=ms_queue_get(f->inputs[0]))!=NULL){
-		ms_queue_put(f->outputs[0],m);
 		if (s->nscans>0){
-			ms_bufferizer_put(s->buf,dupmsg(m));
-		}
-	}
-	if (s->nscans>0){
-		uint8_t *buf=alloca(s->framesize);
-
-		while(ms_bufferizer_read(s->buf,buf,s->framesize)!=0){
-			float en=compute_energy((int16_t*)buf,s->framesize/2);
-			if (en>energy_min_threshold*(32767.0*32767.0*0.7)){
-				int i;
-				for(i=0;i<s->nscans;++i){
-					GoertzelState *gs=&s->tone_gs[i];
-					MSToneDetectorDef *tone_def=&s->tone_def[i];
-					float freq_en=goertzel_state_run(gs,(int16_t*)buf,s->framesize/2,en);
-					if (freq_en>=tone_def->min_amplitude){
-						if (gs->dur==0) gs->starttime=f->ticker->time;
-						gs->dur+=s->frame_ms;
-						if (gs->dur>=tone_def->min_duration && !gs->event_sent){
-							MSToneDetectorEvent event;
-						
-							strncpy(event.tone_name,tone_def->tone_name,sizeof(event.tone_name));
-							event.tone_start_time=gs->starttime;
-							ms_filter_notify(f,MS_TONE_DETECTOR_EVENT,&event);
-							gs->event_sent=TRUE;
-						}
-					}else{
-						gs->event_sent=FALSE;
-						gs->dur=0;
-						gs->starttime=0;
-					}
-				}
-			}else end_all_tones(s);
+			/*samples are read in place, before the block is forwarded*/
+			mblk_t *frag;
+			ms_filter_lock(f);
+			for(frag=m;frag!=NULL;frag=frag->b_cont){
+				detector_run(f,s,(const int16_t*)frag->b_rptr,(frag->b_wptr-frag->b_rptr)/2);
+			}
+			ms_filter_unlock(f);
 		}
+		ms_queue_put(f->outputs[0],m);
 	}
 }
 
@@ -193,6 +282,7 @@ static MSFilterMethod detector_methods[]={
 	{	MS_TONE_DETECTOR_ADD_SCAN, 		detector_add_scan	},
 	{	MS_TONE_DETECTOR_CLEAR_SCANS,	detector_clear_scans	},
 	{	MS_FILTER_SET_SAMPLE_RATE,	detector_set_rate	},
+	{	MS_TONE_DETECTOR_SET_WINDOW_HOP,	detector_set_window_hop	},
 	{	0	,	NULL}
 };
 
@@ -779,7 +779,7 @@ static MSSndCard *winsndcard_new(const char *name, int in_dev, int out_dev, unsi
 
 static void add_or_update_card(MSSndCardManager *m, const char *name, int indev, int outdev, unsigned int capability){
 	MSSndCard *card;
-	const MSList *elem=ms_snd_card_manager_get_list(m);
+	const MSList *elem=m->cards; /*called from detect, with the manager locked*/
 	for(;elem!=NULL;elem=elem->next){
 		card=(MSSndCard*)elem->data;
 		if (strcmp(card->desc->driver_type, winsnd_card_desc.driver_type)==0
@@ -846,7 +846,7 @@ static void _winsndcard_detect(MSSndCardManager *m){
 
 static void deactivate_removed_cards(MSSndCardManager *m){
 	MSSndCard *card;
-	const MSList *elem=ms_snd_card_manager_get_list(m);
+	const MSList *elem=m->cards; /*called from detect, with the manager locked*/
 	for(;elem!=NULL;elem=elem->next){
 		card=(MSSndCard*)elem->data;
 		if (strcmp(card->desc->driver_type, winsnd_card_desc.driver_type)==0){
@@ -859,7 +859,7 @@ static void deactivate_removed_cards(MSSndCardManager *m){
 
 static void mark_as_removed(MSSndCardManager *m){
 	MSSndCard *card;
-	const MSList *elem=ms_snd_card_manager_get_list(m);
+	const MSList *elem=m->cards; /*called from detect, with the manager locked*/
 	for(;elem!=NULL;elem=elem->next){
 		card=(MSSndCard*)elem->data;
 		if (strcmp(card->desc->driver_type, winsnd_card_desc.driver_type)==0){
@@ -881,9 +881,12 @@ static void * new_device_polling_thread(void *ignore){
 		if (poller_running){
 			m=ms_snd_card_manager_get();
 			if(!m) break;
+			/*the cards are updated the way detection does it, with the manager locked*/
+			ms_mutex_lock(&m->lock);
 			mark_as_removed(m);
 			_winsndcard_detect(m);
 			deactivate_removed_cards(m);
+			ms_mutex_unlock(&m->lock);
 		}
 	}
 	return NULL;
@@ -150,7 +150,7 @@ static MSSndCard *winsndcard_new(const char *name, int in_dev, int out_dev, unsi
 
 static void add_or_update_card(MSSndCardManager *m, const char *name, int indev, int outdev, unsigned int capability){
 	MSSndCard *card;
-	const MSList *elem=ms_snd_card_manager_get_list(m);
+	const MSList *elem=m->cards; /*called from detect, with the manager locked*/
 	for(;elem!=NULL;elem=elem->next){
 		card=(MSSndCard*)elem->data;
 		if (strcmp(card->name,name)==0){
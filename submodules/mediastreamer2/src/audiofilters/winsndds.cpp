@@ -32,13 +32,13 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <msacm.h>
 
 #include <dsound.h>
-#include <dsconf.h>
+#include <dsconf.h>
 
 const GUID GUID_DSCFX_MS_AEC = {0xcdebb919, 0x379a, 0x488a, {0x87, 0x65, 0xf5, 0x3c, 0xfd, 0x36, 0xde, 0x40}};
 const GUID GUID_DSCFX_CLASS_AEC = {0xBF963D80L, 0xC559, 0x11D0, {0x8A, 0x2B, 0x00, 0xA0, 0xC9, 0x25, 0x5A, 0xC1}}; 
 
-const GUID CLSID_DirectSoundPrivate= { 0x11ab3ec0, 0x25ec, 0x11d1, {0xa4, 0xd8, 0x0, 0xc0, 0x4f, 0xc2, 0x8a, 0xca}};
-const GUID DSPROPSETID_DirectSoundDevice = {0x84624f82, 0x25ec, 0x11d1, {0xa4, 0xd8, 0x0, 0xc0, 0x4f, 0xc2, 0x8a, 0xca}};
+const GUID CLSID_DirectSoundPrivate= { 0x11ab3ec0, 0x25ec, 0x11d1, {0xa4, 0xd8, 0x0, 0xc0, 0x4f, 0xc2, 0x8a, 0xca}};
+const GUID DSPROPSETID_DirectSoundDevice = {0x84624f82, 0x25ec, 0x11d1, {0xa4, 0xd8, 0x0, 0xc0, 0x4f, 0xc2, 0x8a, 0xca}};
 
 #define WINSNDDS_MINIMUMBUFFER 5
 
@@ -67,73 +67,73 @@ typedef struct WinSndDsCard{
 	int removed;
 }WinSndDsCard;
 
-static BOOL GetWaveIdFromDSoundGUID( GUID i_sGUID, DWORD *dwWaveID)
-{ 
-    LPKSPROPERTYSET         pKsPropertySet = NULL; 
-    LPCLASSFACTORY          pClassFactory  = NULL; 
-    HRESULT                 hr;
-	BOOL					retval = FALSE;
-
-	PDSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION_DATA psDirectSoundDeviceDescription = NULL; 
-	DSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION_DATA sDirectSoundDeviceDescription;
-
-	memset(&sDirectSoundDeviceDescription,0,sizeof(sDirectSoundDeviceDescription)); 
-
-    hr = ms_DllGetClassObject (CLSID_DirectSoundPrivate, IID_IClassFactory, (LPVOID *)&pClassFactory );
-
-    if(SUCCEEDED(hr)) 
-    { 
-        hr = pClassFactory->CreateInstance ( NULL, IID_IKsPropertySet, (LPVOID *)&pKsPropertySet ); 
-    } 
-
-    // Release the class factory 
-    if(pClassFactory) 
-    { 
-        pClassFactory->Release(); 
-    }
-
-    if(SUCCEEDED(hr)) 
-	{ 
-		ULONG ulBytesReturned = 0;
-		sDirectSoundDeviceDescription.DeviceId = i_sGUID; 
-
-		// On the first call the final size is unknown so pass the size of the struct in order to receive
-		// "Type" and "DataFlow" values, ulBytesReturned will be populated with bytes required for struct+strings.
-        hr = pKsPropertySet->Get(DSPROPSETID_DirectSoundDevice, 
-                DSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION, 
-                NULL, 
-                0, 
-                &sDirectSoundDeviceDescription, 
-                sizeof(sDirectSoundDeviceDescription), 
-                &ulBytesReturned
-            ); 
-
-		if (ulBytesReturned)
-		{
-			// On the first call it notifies us of the required amount of memory in order to receive the strings.
-			// Allocate the required memory, the strings will be pointed to the memory space directly after the struct.
-			psDirectSoundDeviceDescription = (PDSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION_DATA)new BYTE[ulBytesReturned];
-			*psDirectSoundDeviceDescription = sDirectSoundDeviceDescription;
-
-			hr = pKsPropertySet->Get(DSPROPSETID_DirectSoundDevice, 
-					DSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION, 
-					NULL, 
-					0, 
-					psDirectSoundDeviceDescription, 
-					ulBytesReturned, 
-					&ulBytesReturned
-				); 
-
-			*dwWaveID  = psDirectSoundDeviceDescription->WaveDeviceId;
-			delete [] psDirectSoundDeviceDescription;
-			retval = TRUE;
-		}
-
-		pKsPropertySet->Release(); 
-	} 
-
-	return retval; 
-} 
+static BOOL GetWaveIdFromDSoundGUID( GUID i_sGUID, DWORD *dwWaveID)
+{ 
+    LPKSPROPERTYSET         pKsPropertySet = NULL; 
+    LPCLASSFACTORY          pClassFactory  = NULL; 
+    HRESULT                 hr;
+	BOOL					retval = FALSE;
+
+	PDSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION_DATA psDirectSoundDeviceDescription = NULL; 
+	DSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION_DATA sDirectSoundDeviceDescription;
+
+	memset(&sDirectSoundDeviceDescription,0,sizeof(sDirectSoundDeviceDescription)); 
+
+    hr = ms_DllGetClassObject (CLSID_DirectSoundPrivate, IID_IClassFactory, (LPVOID *)&pClassFactory );
+
+    if(SUCCEEDED(hr)) 
+    { 
+        hr = pClassFactory->CreateInstance ( NULL, IID_IKsPropertySet, (LPVOID *)&pKsPropertySet ); 
+    } 
+
+    // Release the class factory 
+    if(pClassFactory) 
+    { 
+        pClassFactory->Release(); 
+    }
+
+    if(SUCCEEDED(hr)) 
+	{ 
+		ULONG ulBytesReturned = 0;
+		sDirectSoundDeviceDescription.DeviceId = i_sGUID; 
+
+		// On the first call the final size is unknown so pass the size of the struct in order to receive
+		// "Type" and "DataFlow" values, ulBytesReturned will be populated with bytes required for struct+strings.
+        hr = pKsPropertySet->Get(DSPROPSETID_DirectSoundDevice, 
+                DSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION, 
+                NULL, 
+                0, 
+                &sDirectSoundDeviceDescription, 
+                sizeof(sDirectSoundDeviceDescription), 
+                &ulBytesReturned
+            ); 
+
+		if (ulBytesReturned)
+		{
+			// On the first call it notifies us of the required amount of memory in order to receive the strings.
+			// Allocate the required memory, the strings will be pointed to the memory space directly after the struct.
+			psDirectSoundDeviceDescription = (PDSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION_DATA)new BYTE[ulBytesReturned];
+			*psDirectSoundDeviceDescription = sDirectSoundDeviceDescription;
+
+			hr = pKsPropertySet->Get(DSPROPSETID_DirectSoundDevice, 
+					DSPROPERTY_DIRECTSOUNDDEVICE_DESCRIPTION, 
+					NULL, 
+					0, 
+					psDirectSoundDeviceDescription, 
+					ulBytesReturned, 
+					&ulBytesReturned
+				); 
+
+			*dwWaveID  = psDirectSoundDeviceDescription->WaveDeviceId;
+			delete [] psDirectSoundDeviceDescription;
+			retval = TRUE;
+		}
+
+		pKsPropertySet->Release(); 
+	} 
+
+	return retval; 
+} 
 
 static void winsnddscard_set_level(MSSndCard *card, MSSndCardMixerElem e, int percent){
 	WinSndDsCard *d=(WinSndDsCard*)card->data;
@@ -939,7 +939,7 @@ static MSSndCard *winsnddscard_new(const char *name, LPGUID lpguid, int in_dev,
 
 static void add_or_update_card(MSSndCardManager *m, const char *name, LPGUID lpguid, int indev, int outdev, unsigned int capability){
 	MSSndCard *card;
-	const MSList *elem=ms_snd_card_manager_get_list(m);
+	const MSList *elem=m->cards; /*called from detect, with the manager locked*/
 	for(;elem!=NULL;elem=elem->next){
 		card=(MSSndCard*)elem->data;
 		if (strcmp(card->desc->driver_type, winsndds_card_desc.driver_type)==0
@@ -1092,7 +1092,7 @@ static void _winsnddscard_detect(MSSndCardManager *m){
 
 static void deactivate_removed_cards(MSSndCardManager *m){
 	MSSndCard *card;
-	const MSList *elem=ms_snd_card_manager_get_list(m);
+	const MSList *elem=m->cards; /*called from detect, with the manager locked*/
 	for(;elem!=NULL;elem=elem->next){
 		card=(MSSndCard*)elem->data;
 		if (strcmp(card->desc->driver_type, winsndds_card_desc.driver_type)==0){
@@ -1105,7 +1105,7 @@ static void deactivate_removed_cards(MSSndCardManager *m){
 
 static void mark_as_removed(MSSndCardManager *m){
 	MSSndCard *card;
-	const MSList *elem=ms_snd_card_manager_get_list(m);
+	const MSList *elem=m->cards; /*called from detect, with the manager locked*/
 	for(;elem!=NULL;elem=elem->next){
 		card=(MSSndCard*)elem->data;
 		if (strcmp(card->desc->driver_type, winsndds_card_desc.driver_type)==0){
@@ -1127,9 +1127,12 @@ static void * new_device_polling_thread(void *ignore){
 		if (poller_running){
 			m=ms_snd_card_manager_get();
 			if(!m) break;
+			/*the cards are updated the way detection does it, with the manager locked*/
+			ms_mutex_lock(&m->lock);
 			mark_as_removed(m);
 			_winsnddscard_detect(m);
 			deactivate_removed_cards(m);
+			ms_mutex_unlock(&m->lock);
 		}
 	}
 	return NULL;
@@ -20,8 +20,17 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/msfilter.h"
 #include "mediastreamer2/msticker.h"
 
+#include <ctype.h>
 
-static MSList *desc_list=NULL;
+
+/*
+ * The registered filters, sorted by id and by name so that they are found by binary search. Among the filters
+ * with the same id or name, the lastly registered comes first: it replaces the older ones.
+ */
+static MSFilterDesc **descs_by_id=NULL;
+static MSFilterDesc **descs_by_name=NULL;
+static int desc_count=0;
+static int desc_capacity=0;
 static bool_t statistics_enabled=FALSE;
 static MSList *stats_list=NULL;
 
@@ -40,18 +49,152 @@ static MSFilterStats *find_or_create_stats(MSFilterDesc *desc){
 	return ret;
 }
 
+/*
+ * The encoders, decoders, encoding capturers and decoding renderers indexed by the mime types they handle, compared
+ * case insensitively. The index is updated as the filters are registered, at initialisation time, and only read
+ * afterwards.
+ */
+typedef struct _MSCodecIndexEntry{
+	char *mime; /*lower case*/
+	MSFilterDesc *descs[MS_FILTER_DECODING_RENDERER+1]; /*by category*/
+}MSCodecIndexEntry;
+
+static MSCodecIndexEntry *codec_index=NULL;
+static int codec_index_size=0; /*a power of two*/
+static int codec_index_count=0;
+
+static unsigned int codec_index_hash(const char *mime, int len){
+	unsigned int h=2166136261u;
+	int i;
+	for(i=0;i<len;i++) h=(h^(unsigned char)tolower(mime[i]))*16777619u;
+	return h;
+}
+
+static MSCodecIndexEntry *codec_index_find(const char *mime, int len){
+	unsigned int h;
+	if (codec_index==NULL) return NULL;
+	for(h=codec_index_hash(mime,len)&(codec_index_size-1);codec_index[h].mime!=NULL;h=(h+1)&(codec_index_size-1)){
+		MSCodecIndexEntry *entry=&codec_index[h];
+		if (strncasecmp(entry->mime,mime,len)==0 && entry->mime[len]=='\0') return entry;
+	}
+	return NULL;
+}
+
+static MSCodecIndexEntry *codec_index_add(const char *mime, int len){
+	MSCodecIndexEntry *entry=codec_index_find(mime,len);
+	unsigned int h;
+	int i;
+	if (entry!=NULL) return entry;
+	if (2*(codec_index_count+1)>codec_index_size){
+		/*keep it at most half full*/
+		MSCodecIndexEntry *old=codec_index;
+		int old_size=codec_index_size;
+		codec_index_size=old_size>0 ? 2*old_size : 64;
+		codec_index=ms_new0(MSCodecIndexEntry,codec_index_size);
+		for(i=0;i<old_size;i++){
+			if (old[i].mime==NULL) continue;
+			for(h=codec_index_hash(old[i].mime,strlen(old[i].mime))&(codec_index_size-1);codec_index[h].mime!=NULL;h=(h+1)&(codec_index_size-1));
+			codec_index[h]=old[i];
+		}
+		if (old!=NULL) ms_free(old);
+	}
+	for(h=codec_index_hash(mime,len)&(codec_index_size-1);codec_index[h].mime!=NULL;h=(h+1)&(codec_index_size-1));
+	entry=&codec_index[h];
+	entry->mime=ms_new(char,len+1);
+	for(i=0;i<len;i++) entry->mime[i]=tolower(mime[i]);
+	entry->mime[len]='\0';
+	codec_index_count++;
+	return entry;
+}
+
+static void codec_index_register(MSFilterDesc *desc){
+	const char *mime;
+	OrtpArena *arena;
+
+	if (desc->category==MS_FILTER_OTHER || desc->enc_fmt==NULL) return;
+	arena=ortp_arena_set_current(NULL);
+	if (desc->category==MS_FILTER_ENCODER || desc->category==MS_FILTER_DECODER){
+		codec_index_add(desc->enc_fmt,strlen(desc->enc_fmt))->descs[desc->category]=desc;
+	}else{
+		/*capturers and renderers list the mime types they handle, separated by spaces*/
+		for(mime=desc->enc_fmt;*mime!='\0';){
+			int len=strcspn(mime," ");
+			if (len>0) codec_index_add(mime,len)->descs[desc->category]=desc;
+			mime+=len;
+			if (*mime==' ') mime++;
+		}
+	}
+	ortp_arena_set_current(arena);
+}
+
+static MSFilterDesc *codec_index_get(const char *mime, MSFilterCategory category){
+	MSCodecIndexEntry *entry=codec_index_find(mime,strlen(mime));
+	return entry!=NULL ? entry->descs[category] : NULL;
+}
+
+static int compare_desc_with_id(const MSFilterDesc *desc, const void *id){
+	MSFilterId i=*(const MSFilterId*)id;
+	return desc->id<i ? -1 : (desc->id>i);
+}
+
+static int compare_desc_with_name(const MSFilterDesc *desc, const void *name){
+	return strcmp(desc->name,(const char*)name);
+}
+
+/*position of the first filter not lower than the key*/
+static int desc_lower_bound(MSFilterDesc **descs, const void *key, int (*compare)(const MSFilterDesc*, const void*)){
+	int low=0,high=desc_count;
+	while(low<high){
+		int mid=(low+high)/2;
+		if (compare(descs[mid],key)<0) low=mid+1;
+		else high=mid;
+	}
+	return low;
+}
+
+static void desc_insert(MSFilterDesc **descs, int pos, MSFilterDesc *desc){
+	memmove(&descs[pos+1],&descs[pos],(desc_count-pos)*sizeof(MSFilterDesc*));
+	descs[pos]=desc;
+}
+
 void ms_filter_register(MSFilterDesc *desc){
+	OrtpArena *arena;
+	int id_pos,name_pos;
+
 	if (desc->id==MS_FILTER_NOT_SET_ID){
 		ms_fatal("MSFilterId for %s not set !",desc->name);
 	}
-	/*lastly registered encoder/decoders may replace older ones*/
-	desc_list=ms_list_prepend(desc_list,desc);
+	arena=ortp_arena_set_current(NULL);
+	if (desc_count==desc_capacity){
+		desc_capacity=desc_capacity>0 ? 2*desc_capacity : 256;
+		descs_by_id=(MSFilterDesc**)ms_realloc(descs_by_id,desc_capacity*sizeof(MSFilterDesc*));
+		descs_by_name=(MSFilterDesc**)ms_realloc(descs_by_name,desc_capacity*sizeof(MSFilterDesc*));
+	}
+	ortp_arena_set_current(arena);
+	/*lastly registered filters replace older ones: inserted before their equals*/
+	id_pos=desc_lower_bound(descs_by_id,&desc->id,compare_desc_with_id);
+	name_pos=desc_lower_bound(descs_by_name,desc->name,compare_desc_with_name);
+	desc_insert(descs_by_id,id_pos,desc);
+	desc_insert(descs_by_name,name_pos,desc);
+	desc_count++;
+	codec_index_register(desc);
 }
 
 void ms_filter_unregister_all(){
-	if (desc_list!=NULL) {
-		ms_list_free(desc_list);
-		desc_list=NULL;
+	int i;
+	if (descs_by_id!=NULL) {
+		ms_free(descs_by_id);
+		ms_free(descs_by_name);
+		descs_by_id=descs_by_name=NULL;
+		desc_count=desc_capacity=0;
+	}
+	if (codec_index!=NULL){
+		for(i=0;i<codec_index_size;i++){
+			if (codec_index[i].mime!=NULL) ms_free(codec_index[i].mime);
+		}
+		ms_free(codec_index);
+		codec_index=NULL;
+		codec_index_size=codec_index_count=0;
 	}
 	if (stats_list!=NULL){
 		ms_list_for_each(stats_list,ms_free);
@@ -75,73 +218,19 @@ bool_t ms_filter_codec_supported(const char *mime){
 }
 
 MSFilterDesc * ms_filter_get_encoding_capturer(const char *mime) {
-	MSList *elem;
-
-	for (elem = desc_list; elem != NULL; elem = ms_list_next(elem)) {
-		MSFilterDesc *desc = (MSFilterDesc *)elem->data;
-		if (desc->category == MS_FILTER_ENCODING_CAPTURER) {
-			char *saveptr=NULL;
-			char *enc_fmt = ms_strdup(desc->enc_fmt);
-			char *token = strtok_r(enc_fmt, " ", &saveptr);
-			while (token != NULL) {
-				if (strcasecmp(token, mime) == 0) {
-					break;
-				}
-				token = strtok_r(NULL, " ", &saveptr);
-			}
-			ms_free(enc_fmt);
-			if (token != NULL) return desc;
-		}
-	}
-
-	return NULL;
+	return codec_index_get(mime,MS_FILTER_ENCODING_CAPTURER);
 }
 
 MSFilterDesc * ms_filter_get_decoding_renderer(const char *mime) {
-	MSList *elem;
-
-	for (elem = desc_list; elem != NULL; elem = ms_list_next(elem)) {
-		MSFilterDesc *desc = (MSFilterDesc *)elem->data;
-		if (desc->category == MS_FILTER_DECODING_RENDERER) {
-			char *saveptr=NULL;
-			char *enc_fmt = ms_strdup(desc->enc_fmt);
-			char *token = strtok_r(enc_fmt, " ", &saveptr);
-			while (token != NULL) {
-				if (strcasecmp(token, mime) == 0) {
-					break;
-				}
-				token = strtok_r(NULL, " ", &saveptr);
-			}
-			ms_free(enc_fmt);
-			if (token != NULL) return desc;
-		}
-	}
-
-	return NULL;
+	return codec_index_get(mime,MS_FILTER_DECODING_RENDERER);
 }
 
 MSFilterDesc * ms_filter_get_encoder(const char *mime){
-	MSList *elem;
-	for (elem=desc_list;elem!=NULL;elem=ms_list_next(elem)){
-		MSFilterDesc *desc=(MSFilterDesc*)elem->data;
-		if (desc->category==MS_FILTER_ENCODER && 
-			strcasecmp(desc->enc_fmt,mime)==0){
-			return desc;
-		}
-	}
-	return NULL;
+	return codec_index_get(mime,MS_FILTER_ENCODER);
 }
 
 MSFilterDesc * ms_filter_get_decoder(const char *mime){
-	MSList *elem;
-	for (elem=desc_list;elem!=NULL;elem=ms_list_next(elem)){
-		MSFilterDesc *desc=(MSFilterDesc*)elem->data;
-		if (desc->category==MS_FILTER_DECODER && 
-			strcasecmp(desc->enc_fmt,mime)==0){
-			return desc;
-		}
-	}
-	return NULL;
+	return codec_index_get(mime,MS_FILTER_DECODER);
 }
 
 MSFilter * ms_filter_create_encoder(const char *mime){
@@ -165,7 +254,10 @@ MSFilter *ms_filter_new_from_desc(MSFilterDesc *desc){
 	if (desc->noutputs>0)	obj->outputs=(MSQueue**)ms_new0(MSQueue*,desc->noutputs);
 
 	if (statistics_enabled){
+		/*the stats are global and outlive the filter, keep them out of any per-stream arena*/
+		OrtpArena *arena=ortp_arena_set_current(NULL);
 		obj->stats=find_or_create_stats(desc);
+		ortp_arena_set_current(arena);
 	}
 	if (obj->desc->init!=NULL)
 		obj->desc->init(obj);
@@ -173,28 +265,23 @@ MSFilter *ms_filter_new_from_desc(MSFilterDesc *desc){
 }
 
 MSFilter *ms_filter_new(MSFilterId id){
-	MSList *elem;
+	int pos;
 	if (id==MS_FILTER_PLUGIN_ID){
 		ms_warning("cannot create plugin filters with ms_filter_new_from_id()");
 		return NULL;
 	}
-	for (elem=desc_list;elem!=NULL;elem=ms_list_next(elem)){
-		MSFilterDesc *desc=(MSFilterDesc*)elem->data;
-		if (desc->id==id){
-			return ms_filter_new_from_desc(desc);
-		}
+	pos=desc_lower_bound(descs_by_id,&id,compare_desc_with_id);
+	if (pos<desc_count && descs_by_id[pos]->id==id){
+		return ms_filter_new_from_desc(descs_by_id[pos]);
 	}
 	ms_error("No such filter with id %i",id);
 	return NULL;
 }
 
 MSFilterDesc *ms_filter_lookup_by_name(const char *filter_name){
-	MSList *elem;
-	for (elem=desc_list;elem!=NULL;elem=ms_list_next(elem)){
-		MSFilterDesc *desc=(MSFilterDesc*)elem->data;
-		if (strcmp(desc->name,filter_name)==0){
-			return desc;
-		}
+	int pos=desc_lower_bound(descs_by_name,filter_name,compare_desc_with_name);
+	if (pos<desc_count && strcmp(descs_by_name[pos]->name,filter_name)==0){
+		return descs_by_name[pos];
 	}
 	return NULL;
 }
@@ -293,36 +380,46 @@ void ms_filter_destroy(MSFilter *f){
 	ms_free(f);
 }
 
+/*
+ * The filters of a tick are timed back to back: a filter execution starts when the previous one ended,
+ * so that the clock is read once per filter.
+ */
+static void stats_start(MSFilter *f, MSTimeSpec *start){
+	if (f->ticker) *start=f->ticker->stats_stamp;
+	else ms_get_cur_time(start);
+}
+
+static void stats_update(MSFilter *f, const MSTimeSpec *start){
+	MSTimeSpec stop;
+	ms_get_cur_time(&stop);
+	f->stats->count++;
+	f->stats->elapsed+=(stop.tv_sec-start->tv_sec)*1000000000LL + (stop.tv_nsec-start->tv_nsec);
+	if (f->ticker) f->ticker->stats_stamp=stop;
+}
+
 void ms_filter_process(MSFilter *f){
-	MSTimeSpec start,stop;
+	MSTimeSpec start;
 	ms_debug("Executing process of filter %s:%p",f->desc->name,f);
 
 	if (f->stats)
-		ms_get_cur_time(&start);
+		stats_start(f,&start);
 
 	f->desc->process(f);
-	if (f->stats){
-		ms_get_cur_time(&stop);
-		f->stats->count++;
-		f->stats->elapsed+=(stop.tv_sec-start.tv_sec)*1000000000LL + (stop.tv_nsec-start.tv_nsec);
-	}
-
+	if (f->stats)
+		stats_update(f,&start);
 }
 
 void ms_filter_task_process(MSFilterTask *task){
-	MSTimeSpec start,stop;
+	MSTimeSpec start;
 	MSFilter *f=task->f;
 	/*ms_message("Executing task of filter %s:%p",f->desc->name,f);*/
 
 	if (f->stats)
-		ms_get_cur_time(&start);
+		stats_start(f,&start);
 
 	task->taskfunc(f);
-	if (f->stats){
-		ms_get_cur_time(&stop);
-		f->stats->count++;
-		f->stats->elapsed+=(stop.tv_sec-start.tv_sec)*1000000000LL + (stop.tv_nsec-start.tv_nsec);
-	}
+	if (f->stats)
+		stats_update(f,&start);
 	f->postponed_task--;
 }
 
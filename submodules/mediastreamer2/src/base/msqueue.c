@@ -56,6 +56,24 @@ void ms_queue_flush(MSQueue *q){
 	flushq(&q->q,0);
 }
 
+mblk_t *ms_msg_make_writable(mblk_t *m){
+	mblk_t *frag;
+	mblk_t *om;
+	for(frag=m;frag!=NULL;frag=frag->b_cont){
+		if (frag->b_datap->db_ref>1) break;
+	}
+	if (frag==NULL) return m;
+	om=allocb(msgdsize(m),0);
+	mblk_meta_copy(m,om);
+	for(frag=m;frag!=NULL;frag=frag->b_cont){
+		int len=frag->b_wptr-frag->b_rptr;
+		memcpy(om->b_wptr,frag->b_rptr,len);
+		om->b_wptr+=len;
+	}
+	freemsg(m);
+	return om;
+}
+
 
 void ms_bufferizer_init(MSBufferizer *obj){
 	qinit(&obj->q);
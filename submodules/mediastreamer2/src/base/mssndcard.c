@@ -29,9 +29,31 @@ static MSSndCardManager * create_manager(){
 	MSSndCardManager *obj=(MSSndCardManager *)ms_new(MSSndCardManager,1);
 	obj->cards=NULL;
 	obj->descs=NULL;
+	obj->detected=FALSE;
+	ms_mutex_init(&obj->lock,NULL);
 	return obj;
 }
 
+static void card_detect(MSSndCardManager *m, MSSndCardDesc *desc){
+	if (desc->detect!=NULL)
+		desc->detect(m);
+}
+
+/*
+ * Probing the sound devices is slow on some platforms: it is done when the cards are first looked up rather
+ * than when the drivers are registered at initialisation.
+ */
+static void detect_cards(MSSndCardManager *m){
+	MSList *elem;
+	ms_mutex_lock(&m->lock);
+	if (!m->detected){
+		for(elem=m->descs;elem!=NULL;elem=elem->next)
+			card_detect(m,(MSSndCardDesc*)elem->data);
+		m->detected=TRUE;
+	}
+	ms_mutex_unlock(&m->lock);
+}
+
 void ms_snd_card_manager_destroy(void){
 	if (scm!=NULL){
 		MSList *elem;
@@ -43,6 +65,7 @@ void ms_snd_card_manager_destroy(void){
 		ms_list_for_each(scm->cards,(void (*)(void*))ms_snd_card_destroy);
 		ms_list_free(scm->cards);
 		ms_list_free(scm->descs);
+		ms_mutex_destroy(&scm->lock);
 	}
 	ms_free(scm);
 	scm=NULL;
@@ -55,6 +78,7 @@ MSSndCardManager * ms_snd_card_manager_get(void){
 
 MSSndCard * ms_snd_card_manager_get_card(MSSndCardManager *m, const char *id){
 	MSList *elem;
+	detect_cards(m);
 	for (elem=m->cards;elem!=NULL;elem=elem->next){
 		MSSndCard *card=(MSSndCard*)elem->data;
 		if (id==NULL) return card;
@@ -67,6 +91,7 @@ MSSndCard * ms_snd_card_manager_get_card(MSSndCardManager *m, const char *id){
 MSSndCard * ms_snd_card_manager_get_default_card(MSSndCardManager *m){
 	/*return the first card that has the capture+playback capability */
 	MSList *elem;
+	detect_cards(m);
 	for (elem=m->cards;elem!=NULL;elem=elem->next){
 		MSSndCard *card=(MSSndCard*)elem->data;
 		if ((card->capabilities & MS_SND_CARD_CAP_CAPTURE )
@@ -78,6 +103,7 @@ MSSndCard * ms_snd_card_manager_get_default_card(MSSndCardManager *m){
 
 MSSndCard * ms_snd_card_manager_get_default_capture_card(MSSndCardManager *m){
 	MSList *elem;
+	detect_cards(m);
 	for (elem=m->cards;elem!=NULL;elem=elem->next){
 		MSSndCard *card=(MSSndCard*)elem->data;
 		if (card->capabilities & MS_SND_CARD_CAP_CAPTURE)
@@ -88,6 +114,7 @@ MSSndCard * ms_snd_card_manager_get_default_capture_card(MSSndCardManager *m){
 
 MSSndCard * ms_snd_card_manager_get_default_playback_card(MSSndCardManager *m){
 	MSList *elem;
+	detect_cards(m);
 	for (elem=m->cards;elem!=NULL;elem=elem->next){
 		MSSndCard *card=(MSSndCard*)elem->data;
 		if (card->capabilities & MS_SND_CARD_CAP_PLAYBACK)
@@ -97,6 +124,7 @@ MSSndCard * ms_snd_card_manager_get_default_playback_card(MSSndCardManager *m){
 }
 
 const MSList * ms_snd_card_manager_get_list(MSSndCardManager *m){
+	detect_cards(m);
 	return m->cards;
 }
 
@@ -105,23 +133,21 @@ void ms_snd_card_manager_add_card(MSSndCardManager *m, MSSndCard *c){
 	m->cards=ms_list_append(m->cards,c);
 }
 
-static void card_detect(MSSndCardManager *m, MSSndCardDesc *desc){
-	if (desc->detect!=NULL)
-		desc->detect(m);
-}
-
 void ms_snd_card_manager_register_desc(MSSndCardManager *m, MSSndCardDesc *desc){
+	ms_mutex_lock(&m->lock);
 	m->descs=ms_list_append(m->descs,desc);
-	card_detect(m,desc);
+	if (m->detected) card_detect(m,desc);
+	ms_mutex_unlock(&m->lock);
 }
 
 void ms_snd_card_manager_reload(MSSndCardManager *m){
-	MSList *elem;
+	ms_mutex_lock(&m->lock);
 	ms_list_for_each(m->cards,(void (*)(void*))ms_snd_card_destroy);
 	ms_list_free(m->cards);
 	m->cards=NULL;
-	for(elem=m->descs;elem!=NULL;elem=elem->next)
-		card_detect(m,(MSSndCardDesc*)elem->data);
+	m->detected=FALSE;
+	ms_mutex_unlock(&m->lock);
+	detect_cards(m);
 }
 
 MSSndCard * ms_snd_card_dup(MSSndCard *card){
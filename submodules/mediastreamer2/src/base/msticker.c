@@ -18,6 +18,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "mediastreamer2/msticker.h"
+#include "ortp/rtpsession.h"
 
 #ifndef WIN32
 #include <sys/time.h>
@@ -423,6 +424,8 @@ void * ms_ticker_run(void *arg)
 
 	s->ticks=1;
 	s->orig=s->get_cur_time_ptr(s->get_cur_time_data);
+	/*the RTCP reports of the sessions handled by this ticker are sent together at the end of each tick*/
+	ortp_rtcp_batch_enable();
 
 	ms_mutex_lock(&s->lock);
 	
@@ -433,11 +436,16 @@ void * ms_ticker_run(void *arg)
 #if TICKER_MEASUREMENTS
 			MSTimeSpec begin,end;/*used to measure time spent in processing one tick*/
 			double iload;
-
-			ms_get_cur_time(&begin);
+#endif
+			/*the clock is read once per tick for the processing of the packets and for the filters statistics*/
+			ortp_tick_time_update();
+			ms_get_cur_time(&s->stats_stamp);
+#if TICKER_MEASUREMENTS
+			begin=s->stats_stamp;
 #endif
 			run_tasks(s);
 			run_graphs(s,s->execution_list,FALSE);
+			ortp_rtcp_batch_flush();
 #if TICKER_MEASUREMENTS
 			ms_get_cur_time(&end);
 			iload=100*((end.tv_sec-begin.tv_sec)*1000.0 + (end.tv_nsec-begin.tv_nsec)/1000000.0)/(double)s->interval;
@@ -455,6 +463,8 @@ void * ms_ticker_run(void *arg)
 		ms_mutex_lock(&s->lock);
 	}
 	ms_mutex_unlock(&s->lock);
+	ortp_tick_time_disable();
+	ortp_rtcp_batch_disable();
 	unset_high_prio(precision);
 	ms_message("%s thread exiting",s->name);
 
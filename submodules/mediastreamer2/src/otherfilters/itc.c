@@ -127,19 +127,29 @@ MSFilterDesc ms_itc_source_desc={
 
 static void itc_sink_preprocess(MSFilter *f){
 	MSFilter *other=(MSFilter *)f->data;
-	ms_filter_notify(other,MS_ITC_SOURCE_UPDATED,NULL);
+	if (other) ms_filter_notify(other,MS_ITC_SOURCE_UPDATED,NULL);
 }
 
 static void itc_sink_process(MSFilter *f){
-	MSFilter *other=(MSFilter *)f->data;
+	MSFilter *other;
 	mblk_t *im;
-	while((im=ms_queue_get(f->inputs[0]))!=NULL){
-		itc_source_queue_packet(other,im);
+	/*the sink may be connected or disconnected (NULL) while running*/
+	ms_filter_lock(f);
+	other=(MSFilter *)f->data;
+	if (other==NULL){
+		ms_queue_flush(f->inputs[0]);
+	}else{
+		while((im=ms_queue_get(f->inputs[0]))!=NULL){
+			itc_source_queue_packet(other,im);
+		}
 	}
+	ms_filter_unlock(f);
 }
 
 static int itc_sink_connect(MSFilter *f, void *data){
+	ms_filter_lock(f);
 	f->data=data;
+	ms_filter_unlock(f);
 	return 0;
 }
 
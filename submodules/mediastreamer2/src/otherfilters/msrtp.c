@@ -45,6 +45,7 @@ struct SenderData {
 	char relay_session_id[64];
 	int relay_session_id_size;
 	uint64_t last_rsi_time;
+	int *pt_map;
 	char dtmf;
 	bool_t dtmf_start;
 	bool_t skip;
@@ -102,6 +103,7 @@ static void sender_uninit(MSFilter * f)
 {
 	SenderData *d = (SenderData *) f->data;
 
+	if (d->pt_map) ms_free(d->pt_map);
 	ms_free(d);
 }
 
@@ -173,6 +175,22 @@ static int sender_set_relay_session_id(MSFilter *f, void*arg){
 	return 0;
 }
 
+static int sender_set_payload_type_map(MSFilter *f, void *arg){
+	SenderData *d = (SenderData *) f->data;
+	const int *map = (const int *) arg;
+
+	ms_filter_lock(f);
+	if (map){
+		if (d->pt_map==NULL) d->pt_map=ms_new(int,RTP_PROFILE_MAX_PAYLOADS);
+		memcpy(d->pt_map,map,RTP_PROFILE_MAX_PAYLOADS*sizeof(int));
+	}else if (d->pt_map){
+		ms_free(d->pt_map);
+		d->pt_map=NULL;
+	}
+	ms_filter_unlock(f);
+	return 0;
+}
+
 static int sender_get_sr(MSFilter *f, void *arg){
 	SenderData *d = (SenderData *) f->data;
 	PayloadType *pt;
@@ -377,10 +395,28 @@ static void _sender_process(MSFilter * f)
 			}
 		}
 		if (im){
+			int pt=-1;
+			if (d->pt_map && mblk_get_payload_type_info(im)!=-1){
+				pt=d->pt_map[mblk_get_payload_type_info(im)];
+				if (pt==-1){
+					/*not negotiated on this session*/
+					freemsg(im);
+					continue;
+				}
+			}
 			if (d->skip == FALSE && d->mute_mic==FALSE){
-				header = rtp_session_create_packet(s, 12, NULL, 0);
-				rtp_set_markbit(header, mblk_get_marker_info(im));
-				header->b_cont = im;
+				if (im->b_cont==NULL && rtp_session_get_send_tailroom(s)>0){
+					/*the transport (SRTP) rewrites the packet: build it in one buffer with room for its trailer,
+					rather than letting the transport copy header and payload into a new one*/
+					header = rtp_session_create_packet(s, 12, im->b_rptr, (int)(im->b_wptr-im->b_rptr));
+					rtp_set_markbit(header, mblk_get_marker_info(im));
+					freemsg(im);
+				}else{
+					header = rtp_session_create_packet(s, 12, NULL, 0);
+					rtp_set_markbit(header, mblk_get_marker_info(im));
+					header->b_cont = im;
+				}
+				if (pt!=-1) rtp_set_payload_type(header, pt);
 				rtp_session_sendm_with_ts(s, header, timestamp);
 			}else{
 				freemsg(im);
@@ -419,6 +455,7 @@ static MSFilterMethod sender_methods[] = {
 	{MS_RTP_SEND_SET_SESSION, sender_set_session},
 	{MS_RTP_SEND_SEND_DTMF, sender_send_dtmf},
 	{MS_RTP_SEND_SET_RELAY_SESSION_ID, sender_set_relay_session_id},
+	{MS_RTP_SEND_SET_PAYLOAD_TYPE_MAP, sender_set_payload_type_map},
 	{MS_FILTER_GET_SAMPLE_RATE, sender_get_sr },
 	{MS_FILTER_GET_NCHANNELS, sender_get_ch },
 	{MS_FILTER_SET_NCHANNELS, sender_set_ch },
@@ -583,6 +620,7 @@ static void receiver_process(MSFilter * f)
 		mblk_set_timestamp_info(m, rtp_get_timestamp(m));
 		mblk_set_marker_info(m, rtp_get_markbit(m));
 		mblk_set_cseq(m, rtp_get_seqnumber(m));
+		mblk_set_payload_type_info(m, rtp_get_payload_type(m));
 		rtp_get_payload(m,&m->b_rptr);
 		ms_queue_put(f->outputs[0], m);
 	}
@@ -249,47 +249,56 @@ void ms_fir_mem16(const ms_word16_t *x, const ms_coef_t *num, ms_word16_t *y, in
 #else
 
 #ifndef MS_FIXED_POINT
+#define FIR_OUTPUT(acc) (acc)
+#else
+#define FIR_OUTPUT(acc) ((ms_word16_t)SATURATE16((acc)>>14,32767))
+#endif
 
+/*
+ * The history and the input are laid out contiguously in a scratch buffer, so the memories are not shifted for each
+ * output sample anymore: a block costs O(N*ord) multiply-accumulates but only O(N+ord) moves.
+ * Taps are reversed so that each output is a forward dot product, and four outputs are computed at once: the taps loop
+ * then has four independent accumulators the compiler can put in SIMD lanes.
+ * As before mem[k] holds the past input x[-k] for k in [1,ord-1], mem[0] being the last input sample.
+ */
 void ms_fir_mem16(const ms_word16_t *x, const ms_coef_t *num, ms_word16_t *y, int N, int ord, ms_mem_t *mem){
 	int i,j;
-	ms_word16_t xi;
-	ms_word32_t acc;
-	for(i=0;i<N;++i){
-		xi=x[i];
-		mem[0]=xi;
-		/* accumulate and shift within the same loop*/
-		acc=mem[ord-1]*num[ord-1];
-		for(j=ord-2;j>=0;--j){
-			acc+=num[j]*mem[j];
-			mem[j+1]=mem[j];
+	ms_word16_t *buf;
+	ms_coef_t *rnum;
+	const int hist=ord-1;
+
+	ALLOC(buf,hist+N,ms_word16_t);
+	ALLOC(rnum,ord,ms_coef_t);
+	for(j=1;j<=hist;++j) buf[hist-j]=mem[j];
+	for(i=0;i<N;++i) buf[hist+i]=x[i]; /*x and y may be the same buffer*/
+	for(j=0;j<ord;++j) rnum[j]=num[ord-1-j];
+
+	for(i=0;i+4<=N;i+=4){
+		const ms_word16_t *b=&buf[i];
+		ms_word32_t acc0=0,acc1=0,acc2=0,acc3=0;
+		for(j=0;j<ord;++j){
+			ms_word32_t c=rnum[j];
+			acc0+=c*b[j];
+			acc1+=c*b[j+1];
+			acc2+=c*b[j+2];
+			acc3+=c*b[j+3];
 		}
-		y[i]=acc;
+		y[i]=FIR_OUTPUT(acc0);
+		y[i+1]=FIR_OUTPUT(acc1);
+		y[i+2]=FIR_OUTPUT(acc2);
+		y[i+3]=FIR_OUTPUT(acc3);
 	}
-}
-
-#else
-
-void ms_fir_mem16(const ms_word16_t *x, const ms_coef_t *num, ms_word16_t *y, int N, int ord, ms_mem_t *mem){
-	int i,j;
-	ms_word16_t xi;
-	ms_word32_t acc;
-	int shift=0; /* REVISIT: empiric value...*/
-
-	for(i=0;i<N;++i){
-		xi=x[i];
-		mem[0]=xi;
-		/* accumulate and shift memories within the same loop*/
-		acc=(mem[ord-1]*(ms_word32_t)num[ord-1])>>shift;
-		for(j=ord-2;j>=0;--j){
-			acc+=(((ms_word32_t)num[j])*mem[j])>>shift;
-			mem[j+1]=mem[j];
+	for(;i<N;++i){
+		ms_word32_t acc=0;
+		for(j=0;j<ord;++j){
+			acc+=((ms_word32_t)rnum[j])*buf[i+j];
 		}
-		y[i]=(ms_word16_t)SATURATE16(acc>>14,32767);
+		y[i]=FIR_OUTPUT(acc);
 	}
-}
 
-
-#endif
+	mem[0]=buf[hist+N-1];
+	for(j=1;j<=hist;++j) mem[j]=buf[hist+N-j];
+}
 
 #endif
 
@@ -388,3 +397,113 @@ void ms_ifft(void *table, ms_word16_t *in, ms_word16_t *out)
 	struct kiss_config *t = (struct kiss_config *)table;
 	kiss_fftri2(t->backward, in, out);
 }
+
+struct _MSFirFilter{
+	int ord;
+	ms_coef_t *num; /*taps for the direct form*/
+	ms_mem_t *mem;
+	/*overlap-save convolution, set up on first use as the fft size depends on the block size*/
+	bool_t use_fft;
+	void *fft;
+	int nfft;
+	int block; /*new input samples per fft*/
+	ms_word16_t *H; /*spectrum of the taps, half-complex*/
+	ms_word16_t *in; /*ord-1 samples of history followed by the current block, zero padded*/
+	ms_word16_t *X;
+	ms_word16_t *out;
+};
+
+MSFirFilter *ms_fir_new(int ord){
+	MSFirFilter *obj=(MSFirFilter*)ms_new0(MSFirFilter,1);
+	obj->ord=ord;
+	obj->num=(ms_coef_t*)ms_new0(ms_coef_t,ord);
+	obj->mem=(ms_mem_t*)ms_new0(ms_mem_t,ord);
+#ifndef MS_FIXED_POINT
+	/*the fixed point fft rescales its input at each run, which is not accurate enough to replace the direct form*/
+	obj->use_fft=(ord>=MS_FIR_FFT_MIN_TAPS);
+#endif
+	return obj;
+}
+
+static void fir_compute_spectrum(MSFirFilter *obj){
+	int i;
+	ms_word16_t *h=obj->out; /*used as scratch*/
+	memset(h,0,obj->nfft*sizeof(ms_word16_t));
+	for(i=0;i<obj->ord;++i) h[i]=obj->num[i];
+	ms_fft(obj->fft,h,obj->H);
+	/*ms_fft() scales by 1/nfft and ms_ifft() does not: undo one of the two scalings of the product*/
+	for(i=0;i<obj->nfft;++i) obj->H[i]*=obj->nfft;
+}
+
+/*the smallest fft processing a whole block of N samples at once*/
+static void fir_fft_setup(MSFirFilter *obj, int N){
+	const int hist=obj->ord-1;
+	obj->nfft=2;
+	while(obj->nfft<hist+N || obj->nfft<2*obj->ord) obj->nfft<<=1;
+	obj->block=obj->nfft-hist;
+	obj->fft=ms_fft_init(obj->nfft);
+	obj->H=(ms_word16_t*)ms_new0(ms_word16_t,obj->nfft);
+	obj->in=(ms_word16_t*)ms_new0(ms_word16_t,obj->nfft);
+	obj->X=(ms_word16_t*)ms_new0(ms_word16_t,obj->nfft);
+	obj->out=(ms_word16_t*)ms_new0(ms_word16_t,obj->nfft);
+	/*carry on with the history of the direct form*/
+	{
+		int i;
+		for(i=1;i<=hist;++i) obj->in[hist-i]=obj->mem[i];
+	}
+	fir_compute_spectrum(obj);
+}
+
+void ms_fir_set_coefs(MSFirFilter *obj, const ms_coef_t *num){
+	memcpy(obj->num,num,obj->ord*sizeof(ms_coef_t));
+	if (obj->fft) fir_compute_spectrum(obj);
+}
+
+/*multiply two spectrums in the half-complex layout of ms_fft(): DC, (re,im) pairs, then Nyquist*/
+static void spectrum_mult(const ms_word16_t *a, const ms_word16_t *b, ms_word16_t *out, int nfft){
+	int k;
+	out[0]=a[0]*b[0];
+	for(k=1;k<nfft-1;k+=2){
+		ms_word16_t re=a[k]*b[k]-a[k+1]*b[k+1];
+		ms_word16_t im=a[k]*b[k+1]+a[k+1]*b[k];
+		out[k]=re;
+		out[k+1]=im;
+	}
+	out[nfft-1]=a[nfft-1]*b[nfft-1];
+}
+
+static void fir_overlap_save(MSFirFilter *obj, const ms_word16_t *x, ms_word16_t *y, int N){
+	const int hist=obj->ord-1;
+	while(N>0){
+		int n=(N<obj->block) ? N : obj->block;
+		/*the history stays at the beginning of in[], the tail is zero padded so that the circular convolution does not alias on the n outputs*/
+		memcpy(&obj->in[hist],x,n*sizeof(ms_word16_t));
+		memset(&obj->in[hist+n],0,(obj->nfft-hist-n)*sizeof(ms_word16_t));
+		ms_fft(obj->fft,obj->in,obj->X);
+		spectrum_mult(obj->X,obj->H,obj->X,obj->nfft);
+		ms_ifft(obj->fft,obj->X,obj->out);
+		memcpy(y,&obj->out[hist],n*sizeof(ms_word16_t));
+		memmove(obj->in,&obj->in[n],hist*sizeof(ms_word16_t));
+		x+=n;
+		y+=n;
+		N-=n;
+	}
+}
+
+void ms_fir_process(MSFirFilter *obj, const ms_word16_t *x, ms_word16_t *y, int N){
+	if (obj->use_fft){
+		if (obj->fft==NULL) fir_fft_setup(obj,N);
+		fir_overlap_save(obj,x,y,N);
+	}else ms_fir_mem16(x,obj->num,y,N,obj->ord,obj->mem);
+}
+
+void ms_fir_destroy(MSFirFilter *obj){
+	if (obj->fft) ms_fft_destroy(obj->fft);
+	if (obj->H) ms_free(obj->H);
+	if (obj->in) ms_free(obj->in);
+	if (obj->X) ms_free(obj->X);
+	if (obj->out) ms_free(obj->out);
+	ms_free(obj->num);
+	ms_free(obj->mem);
+	ms_free(obj);
+}
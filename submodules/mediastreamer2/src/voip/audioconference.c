@@ -22,6 +22,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/msaudiomixer.h"
 #include "private.h"
 
+/*one second of 16 kHz mono audio per write*/
+#define RECORDER_ENDPOINT_BUFFER_SIZE 32000
+
 struct _MSAudioConference{
 	MSTicker *ticker;
 	MSFilter *mixer;
@@ -39,6 +42,7 @@ struct _MSAudioEndpoint{
 	MSCPoint mixer_out;
 	MSAudioConference *conference;
 	MSFilter *recorder; /* in case it is a recorder endpoint*/
+	MSFileRecAsyncParams recorder_async;
 	MSFilter *player; /* not used at the moment, but we need it so that there is a source connected to the mixer*/
 	int pin;
 	int samplerate;
@@ -56,6 +60,10 @@ MSAudioConference * ms_audio_conference_new(const MSAudioConferenceParams *param
 	obj->params=*params;
 	ms_filter_call_method(obj->mixer,MS_AUDIO_MIXER_ENABLE_CONFERENCE_MODE,&tmp);
 	ms_filter_call_method(obj->mixer,MS_FILTER_SET_SAMPLE_RATE,&obj->params.samplerate);
+	if (obj->params.max_speakers>0)
+		ms_filter_call_method(obj->mixer,MS_AUDIO_MIXER_SET_ACTIVE_SPEAKERS,&obj->params.max_speakers);
+	if (obj->params.noise_floor<0)
+		ms_filter_call_method(obj->mixer,MS_AUDIO_MIXER_SET_NOISE_FLOOR,&obj->params.noise_floor);
 	return obj;
 }
 
@@ -247,6 +255,7 @@ void ms_audio_endpoint_destroy(MSAudioEndpoint *ep){
 MSAudioEndpoint * ms_audio_endpoint_new_recorder(){
 	MSAudioEndpoint *ep=ms_audio_endpoint_new();
 	ep->recorder=ms_filter_new(MS_FILE_REC_ID);
+	ep->recorder_async.buffer_size=RECORDER_ENDPOINT_BUFFER_SIZE;
 	ep->player=ms_filter_new(MS_FILE_PLAYER_ID);
 	ep->mixer_out.filter=ep->recorder;
 	ep->mixer_in.filter=ep->player;
@@ -264,6 +273,7 @@ int ms_audio_recorder_endpoint_start(MSAudioEndpoint *ep, const char *path){
 	ms_filter_call_method(ep->recorder,MS_RECORDER_GET_STATE,&state);
 	if (state!=MSRecorderClosed)
 		ms_filter_call_method_noarg(ep->recorder,MS_RECORDER_CLOSE);
+	ms_filter_call_method(ep->recorder,MS_FILE_REC_SET_ASYNC_PARAMS,&ep->recorder_async);
 	err=ms_filter_call_method(ep->recorder,MS_RECORDER_OPEN,(void*)path);
 	if (err==-1) return -1;
 	return ms_filter_call_method_noarg(ep->recorder,MS_RECORDER_START);
@@ -276,3 +286,12 @@ int ms_audio_recorder_endpoint_stop(MSAudioEndpoint *ep){
 	return ms_filter_call_method_noarg(ep->recorder,MS_RECORDER_CLOSE);
 }
 
+int ms_audio_recorder_endpoint_set_async_params(MSAudioEndpoint *ep, const MSFileRecAsyncParams *params){
+	if (!ep->recorder){
+		ms_error("This endpoint isn't a recorder endpoint.");
+		return -1;
+	}
+	ep->recorder_async=*params;
+	return 0;
+}
+
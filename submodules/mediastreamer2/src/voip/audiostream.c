@@ -34,6 +34,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/mstee.h"
 #include "mediastreamer2/msaudiomixer.h"
 #include "mediastreamer2/mscodecutils.h"
+#include "mediastreamer2/mstimestretch.h"
+#include "mediastreamer2/msitc.h"
+#include "mediastreamer2/msencodedprompt.h"
 #include "private.h"
 
 #ifdef INET6
@@ -45,11 +48,13 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 static void audio_stream_free(AudioStream *stream) {
+	OrtpArena *arena=stream->arena;
 	media_stream_free(&stream->ms);
 	if (stream->soundread!=NULL) ms_filter_destroy(stream->soundread);
 	if (stream->soundwrite!=NULL) ms_filter_destroy(stream->soundwrite);
 	if (stream->dtmfgen!=NULL) ms_filter_destroy(stream->dtmfgen);
 	if (stream->plc!=NULL)	ms_filter_destroy(stream->plc);
+	if (stream->time_stretch!=NULL) ms_filter_destroy(stream->time_stretch);
 	if (stream->ec!=NULL)	ms_filter_destroy(stream->ec);
 	if (stream->volrecv!=NULL) ms_filter_destroy(stream->volrecv);
 	if (stream->volsend!=NULL) ms_filter_destroy(stream->volsend);
@@ -63,7 +68,14 @@ static void audio_stream_free(AudioStream *stream) {
 	if (stream->recorder) ms_filter_destroy(stream->recorder);
 	if (stream->recorder_mixer) ms_filter_destroy(stream->recorder_mixer);
 	if (stream->recorder_file) ms_free(stream->recorder_file);
+	if (stream->relay_sink) ms_filter_destroy(stream->relay_sink);
+	if (stream->relay_source) ms_filter_destroy(stream->relay_source);
+	if (stream->relay_tee) ms_filter_destroy(stream->relay_tee);
+	if (stream->prompt_player) ms_filter_destroy(stream->prompt_player);
+	if (stream->prompt_sink) ms_filter_destroy(stream->prompt_sink);
 	ms_free(stream);
+	/*everything the graph allocated while building is given back at once*/
+	ortp_arena_release(arena);
 }
 
 static int dtmf_tab[16]={'0','1','2','3','4','5','6','7','8','9','*','#','A','B','C','D'};
@@ -104,36 +116,38 @@ static void audio_stream_configure_resampler(MSFilter *resampler,MSFilter *from,
 	           from->desc->name, to->desc->name, from_rate, to_rate, from_channels, to_channels);
 }
 
+/*the bitrate controller is the only one needing the RTCP packets, it is fed from the event queue*/
 static void audio_stream_process_rtcp(AudioStream *stream, mblk_t *m){
 	do{
-		const report_block_t *rb=NULL;
-		if (rtcp_is_SR(m)){
-			rb=rtcp_SR_get_report_block(m,0);
-		}else if (rtcp_is_RR(m)){
-			rb=rtcp_RR_get_report_block(m,0);
-		}
-		if (rb){
-			unsigned int ij;
-			float rt=rtp_session_get_round_trip_propagation(stream->ms.session);
-			float flost;
-			ij=report_block_get_interarrival_jitter(rb);
-			flost=(float)(100.0*report_block_get_fraction_lost(rb)/256.0);
-			ms_message("audio_stream_iterate(): remote statistics available\n\tremote's interarrival jitter=%u\n"
-			           "\tremote's lost packets percentage since last report=%f\n\tround trip time=%f seconds",ij,flost,rt);
+		if (rtcp_is_SR(m) || rtcp_is_RR(m)){
 			if (stream->ms.rc) ms_bitrate_controller_process_rtcp(stream->ms.rc,m);
-			if (stream->ms.qi) ms_quality_indicator_update_from_feedback(stream->ms.qi,m);
 		}
 	}while(rtcp_next_packet(m));
 }
 
+/*the remote statistics are taken from the RTCP summary of the session, which does not need the packets to be queued*/
+static void audio_stream_process_rtcp_summary(AudioStream *stream){
+	rtcp_summary_t summary;
+	rtp_session_get_rtcp_summary(stream->ms.session,&summary);
+	if (summary.received_packets==stream->last_rtcp_count) return;
+	stream->last_rtcp_count=summary.received_packets;
+	stream->last_packet_time=ms_time(NULL);
+	if (summary.has_remote_report){
+		ms_message("audio_stream_iterate(): remote statistics available\n\tremote's interarrival jitter=%u\n"
+		           "\tremote's lost packets percentage since last report=%f\n\tround trip time=%f seconds",
+		           summary.remote_jitter,(float)(100.0*summary.remote_fraction_lost/256.0),summary.rtt);
+		if (stream->ms.qi) ms_quality_indicator_update_from_summary(stream->ms.qi,&summary);
+	}
+}
+
 void audio_stream_iterate(AudioStream *stream){
+	audio_stream_process_rtcp_summary(stream);
 	if (stream->ms.evq){
 		OrtpEvent *ev=ortp_ev_queue_get(stream->ms.evq);
 		if (ev!=NULL){
 			OrtpEventType evt=ortp_event_get_type(ev);
 			if (evt==ORTP_EVENT_RTCP_PACKET_RECEIVED){
 				audio_stream_process_rtcp(stream,ortp_event_get_data(ev)->packet);
-				stream->last_packet_time=ms_time(NULL);
 			}else if (evt==ORTP_EVENT_RTCP_PACKET_EMITTED){
 				ms_message("audio_stream_iterate(): local statistics available\n\tLocal's current jitter buffer size:%f ms",rtp_session_get_jitter_stats(stream->ms.session)->jitter_buffer_size_ms);
 			}else if ((evt==ORTP_EVENT_STUN_PACKET_RECEIVED)&&(stream->ms.ice_check_list)){
@@ -181,6 +195,14 @@ static void stop_preload_graph(AudioStream *stream){
 	stream->dummy=NULL;
 }
 
+/*sound card drivers may keep references to their filters in card-global state: never from an arena*/
+static MSFilter *audio_stream_create_sound_filter(MSSndCard *card, bool_t reader){
+	OrtpArena *arena=ortp_arena_set_current(NULL);
+	MSFilter *f=reader ? ms_snd_card_create_reader(card) : ms_snd_card_create_writer(card);
+	ortp_arena_set_current(arena);
+	return f;
+}
+
 bool_t audio_stream_started(AudioStream *stream){
 	return stream->ms.start_time!=0;
 }
@@ -221,9 +243,16 @@ void audio_stream_unprepare_sound(AudioStream *stream){
 	}
 }
 
-int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char *rem_rtp_ip,int rem_rtp_port,
-	const char *rem_rtcp_ip, int rem_rtcp_port, int payload,int jitt_comp, const char *infile, const char *outfile,
-	MSSndCard *playcard, MSSndCard *captcard, bool_t use_ec)
+/*sample rate of the audio exchanged with the rtp filters*/
+static int audio_stream_get_payload_rate(const PayloadType *pt){
+	/*G722 rtp clock rate is 8000 for historical reasons, but the codec works at 16000*/
+	if (strcasecmp(pt->mime_type,"G722")==0) return 16000;
+	return pt->clock_rate;
+}
+
+/*creates, configures and links the filters: everything that does not depend on the remote end*/
+static int audio_stream_build_graph(AudioStream *stream, RtpProfile *profile, int payload, int jitt_comp,
+	const char *infile, const char *outfile, MSSndCard *playcard, MSSndCard *captcard, bool_t use_ec)
 {
 	RtpSession *rtps=stream->ms.session;
 	PayloadType *pt,*tel_ev;
@@ -235,15 +264,9 @@ int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char
         bool_t has_builtin_ns=FALSE;
 
 	rtp_session_set_profile(rtps,profile);
-	if (rem_rtp_port>0) rtp_session_set_remote_addr_full(rtps,rem_rtp_ip,rem_rtp_port,rem_rtcp_ip,rem_rtcp_port);
-	if (rem_rtcp_port<=0){
-		rtp_session_enable_rtcp(rtps,FALSE);
-	}
 	rtp_session_set_payload_type(rtps,payload);
 	rtp_session_set_jitter_compensation(rtps,jitt_comp);
 
-	if (rem_rtp_port>0)
-		ms_filter_call_method(stream->ms.rtpsend,MS_RTP_SEND_SET_SESSION,rtps);
 	stream->ms.rtprecv=ms_filter_new(MS_RTP_RECV_ID);
 	ms_filter_call_method(stream->ms.rtprecv,MS_RTP_RECV_SET_SESSION,rtps);
 	stream->ms.session=rtps;
@@ -257,20 +280,36 @@ int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char
 	/* creates the local part */
 	if (captcard!=NULL){
 		if (stream->soundread==NULL)
-			stream->soundread=ms_snd_card_create_reader(captcard);
+			stream->soundread=audio_stream_create_sound_filter(captcard,TRUE);
 		has_builtin_ec=!!(ms_snd_card_get_capabilities(captcard) & MS_SND_CARD_CAP_BUILTIN_ECHO_CANCELLER);
 		has_builtin_ns=!!(ms_snd_card_get_capabilities(captcard) & MS_SND_CARD_CAP_BUILTIN_NOISE_SUPPRESSOR);
 	}else {
+		PayloadType *send_pt=rtp_profile_get_payload(profile,payload);
 		stream->soundread=ms_filter_new(MS_FILE_PLAYER_ID);
 		stream->read_resampler=ms_filter_new(MS_RESAMPLE_ID);
-		if (infile!=NULL) audio_stream_play(stream,infile);
+		if (send_pt!=NULL){
+			/*cached prompts are resampled once to the rate of the codec, the resampler is then a pass-through*/
+			int cached_rate=audio_stream_get_payload_rate(send_pt);
+			ms_filter_call_method(stream->soundread,MS_FILE_PLAYER_SET_CACHED_RATE,&cached_rate);
+		}
+		if (infile!=NULL) {
+			/*opening goes through the shared prompt cache*/
+			OrtpArena *arena=ortp_arena_set_current(NULL);
+			audio_stream_play(stream,infile);
+			ortp_arena_set_current(arena);
+		}
 	}
 	if (playcard!=NULL) {
 		if (stream->soundwrite==NULL)
-			stream->soundwrite=ms_snd_card_create_writer(playcard);
+			stream->soundwrite=audio_stream_create_sound_filter(playcard,FALSE);
 	}else {
 		stream->soundwrite=ms_filter_new(MS_FILE_REC_ID);
-		if (outfile!=NULL) audio_stream_record(stream,outfile);
+		if (outfile!=NULL) {
+			/*opening hands the file over to the shared writer thread*/
+			OrtpArena *arena=ortp_arena_set_current(NULL);
+			audio_stream_record(stream,outfile);
+			ortp_arena_set_current(arena);
+		}
 	}
 
 	/* creates the couple of encoder/decoder */
@@ -290,10 +329,7 @@ int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char
 		stream->dtmfgen_rtp=NULL;
 	}
 	
-	if (ms_filter_call_method(stream->ms.rtpsend,MS_FILTER_GET_SAMPLE_RATE,&sample_rate)!=0){
-		ms_error("Sample rate is unknown for RTP side !");
-		return -1;
-	}
+	sample_rate=audio_stream_get_payload_rate(pt);
 	
 	stream->ms.encoder=ms_filter_create_encoder(pt->mime_type);
 	stream->ms.decoder=ms_filter_create_decoder(pt->mime_type);
@@ -425,21 +461,9 @@ int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char
 		stream->equalizer=NULL;
 	
 
-	/*configure resampler if needed*/
 	ms_filter_call_method(stream->ms.rtpsend, MS_FILTER_SET_NCHANNELS, &pt->channels);
 	ms_filter_call_method(stream->ms.rtprecv, MS_FILTER_SET_NCHANNELS, &pt->channels);
-	if (stream->read_resampler){
-		audio_stream_configure_resampler(stream->read_resampler,stream->soundread,stream->ms.rtpsend);
-	}
-
-	if (stream->write_resampler){
-		audio_stream_configure_resampler(stream->write_resampler,stream->ms.rtprecv,stream->soundwrite);
-	}
 
-	if (stream->ms.use_rc){
-		stream->ms.rc=ms_audio_bitrate_controller_new(stream->ms.session,stream->ms.encoder,0);
-	}
-	
 	/* Create PLC */
 	if ((stream->features & AUDIO_STREAM_FEATURE_PLC) != 0) {
 		int decoder_have_plc = 0;
@@ -462,13 +486,18 @@ int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char
 		stream->plc = NULL;
 	}
 
-	/* create ticker */
-	if (stream->ms.ticker==NULL) start_ticker(&stream->ms);
-	else{
-		/*we were using the dummy preload graph, destroy it*/
-		if (stream->dummy) stop_preload_graph(stream);
+	/* the adaptive jitter buffer applies its delay changes through time stretching of the decoded signal*/
+	if ((stream->features & AUDIO_STREAM_FEATURE_TIME_STRETCH) != 0 && rtp_session_adaptive_jitter_compensation_enabled(rtps)) {
+		stream->time_stretch = ms_filter_new(MS_TIME_STRETCH_ID);
+		if (stream->time_stretch) {
+			ms_filter_call_method(stream->time_stretch, MS_FILTER_SET_NCHANNELS, &pt->channels);
+			ms_filter_call_method(stream->time_stretch, MS_FILTER_SET_SAMPLE_RATE, &sample_rate);
+			ms_filter_call_method(stream->time_stretch, MS_TIME_STRETCH_SET_SESSION, rtps);
+		}
+	} else {
+		stream->time_stretch = NULL;
 	}
-	
+
 	/* and then connect all */
 	/* tip: draw yourself the picture if you don't understand */
 
@@ -494,6 +523,8 @@ int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char
 	ms_connection_helper_link(&h,stream->ms.decoder,0,0);
 	if (stream->plc)
 		ms_connection_helper_link(&h,stream->plc,0,0);
+	if (stream->time_stretch)
+		ms_connection_helper_link(&h,stream->time_stretch,0,0);
 	if (stream->dtmfgen)
 		ms_connection_helper_link(&h,stream->dtmfgen,0,0);
 	if (stream->volrecv)
@@ -514,7 +545,48 @@ int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char
 		ms_filter_link(stream->recv_tee,1,stream->recorder_mixer,1);
 		ms_filter_link(stream->recorder_mixer,0,stream->recorder,0);
 	}
-	
+	return 0;
+}
+
+/*points the built graph to the remote end and starts it*/
+static int audio_stream_connect_graph(AudioStream *stream, const char *rem_rtp_ip,int rem_rtp_port,
+	const char *rem_rtcp_ip, int rem_rtcp_port)
+{
+	RtpSession *rtps=stream->ms.session;
+	int sample_rate;
+
+	if (rem_rtp_port>0) rtp_session_set_remote_addr_full(rtps,rem_rtp_ip,rem_rtp_port,rem_rtcp_ip,rem_rtcp_port);
+	if (rem_rtcp_port<=0){
+		rtp_session_enable_rtcp(rtps,FALSE);
+	}
+	if (rem_rtp_port>0)
+		ms_filter_call_method(stream->ms.rtpsend,MS_RTP_SEND_SET_SESSION,rtps);
+	if (ms_filter_call_method(stream->ms.rtpsend,MS_FILTER_GET_SAMPLE_RATE,&sample_rate)!=0){
+		ms_error("Sample rate is unknown for RTP side !");
+		return -1;
+	}
+
+	/*configure resampler if needed*/
+	if (stream->read_resampler){
+		audio_stream_configure_resampler(stream->read_resampler,stream->soundread,stream->ms.rtpsend);
+	}
+
+	if (stream->write_resampler){
+		audio_stream_configure_resampler(stream->write_resampler,stream->ms.rtprecv,stream->soundwrite);
+	}
+
+	if (stream->ms.use_rc){
+		stream->ms.rc=ms_audio_bitrate_controller_new(stream->ms.session,stream->ms.encoder,0);
+		ortp_ev_queue_ignore_type(stream->ms.evq,ORTP_EVENT_RTCP_PACKET_RECEIVED,FALSE);
+	}
+
+	/* create ticker */
+	if (stream->ms.ticker==NULL) start_ticker(&stream->ms);
+	else{
+		/*we were using the dummy preload graph, destroy it*/
+		if (stream->dummy) stop_preload_graph(stream);
+	}
+
 	/*to make sure all preprocess are done before befre processing audio*/
 	ms_ticker_attach_multiple(stream->ms.ticker
 				,stream->soundread
@@ -527,6 +599,242 @@ int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char
 	return 0;
 }
 
+/*when the application set up an arena pool, a stream with a full graph is built in one of its arenas.
+ relay and prompt graphs are a few filters: they stay on the heap and leave the arenas to decoding streams*/
+static OrtpArena *audio_stream_enter_arena(AudioStream *stream){
+	if (stream->arena==NULL) stream->arena=ortp_arena_get();
+	return ortp_arena_set_current(stream->arena);
+}
+
+int audio_stream_start_full(AudioStream *stream, RtpProfile *profile, const char *rem_rtp_ip,int rem_rtp_port,
+	const char *rem_rtcp_ip, int rem_rtcp_port, int payload,int jitt_comp, const char *infile, const char *outfile,
+	MSSndCard *playcard, MSSndCard *captcard, bool_t use_ec)
+{
+	/*filters, queues and codec states (preprocess runs at attach time) come from the stream's arena*/
+	OrtpArena *prev=audio_stream_enter_arena(stream);
+	int err=audio_stream_build_graph(stream,profile,payload,jitt_comp,infile,outfile,playcard,captcard,use_ec);
+	if (err==0) err=audio_stream_connect_graph(stream,rem_rtp_ip,rem_rtp_port,rem_rtcp_ip,rem_rtcp_port);
+	ortp_arena_set_current(prev);
+	return err;
+}
+
+static void relay_payload_type_changed(RtpSession *session, unsigned long data);
+
+int audio_stream_start_relay(AudioStream *stream, RtpProfile *profile, const char *rem_rtp_ip, int rem_rtp_port,
+	const char *rem_rtcp_ip, int rem_rtcp_port, int payload)
+{
+	RtpSession *rtps=stream->ms.session;
+
+	if (rtp_profile_get_payload(profile,payload)==NULL){
+		ms_error("audio_stream_start_relay: undefined payload type.");
+		return -1;
+	}
+	rtp_session_set_profile(rtps,profile);
+	if (rem_rtp_port>0) rtp_session_set_remote_addr_full(rtps,rem_rtp_ip,rem_rtp_port,rem_rtcp_ip,rem_rtcp_port);
+	if (rem_rtcp_port<=0){
+		rtp_session_enable_rtcp(rtps,FALSE);
+	}
+	rtp_session_set_payload_type(rtps,payload);
+	/*the far end of the peer leg has its own jitter buffer: packets are forwarded as soon as they arrive*/
+	rtp_session_enable_adaptive_jitter_compensation(rtps,FALSE);
+	rtp_session_enable_jitter_buffer(rtps,FALSE);
+
+	if (rem_rtp_port>0)
+		ms_filter_call_method(stream->ms.rtpsend,MS_RTP_SEND_SET_SESSION,rtps);
+	stream->ms.rtprecv=ms_filter_new(MS_RTP_RECV_ID);
+	ms_filter_call_method(stream->ms.rtprecv,MS_RTP_RECV_SET_SESSION,rtps);
+	rtp_session_signal_connect(rtps,"telephone-event",(RtpCallback)on_dtmf_received,(unsigned long)stream);
+	rtp_session_signal_connect(rtps,"payload_type_changed",(RtpCallback)relay_payload_type_changed,(unsigned long)stream);
+
+	/*payloads are not decoded: they go from one stream's rtprecv to the peer's rtpsend through a pair of itc filters*/
+	stream->relay_sink=ms_filter_new(MS_ITC_SINK_ID);
+	stream->relay_source=ms_filter_new(MS_ITC_SOURCE_ID);
+
+	if (stream->ms.ticker==NULL) start_ticker(&stream->ms);
+	else{
+		/*we were using the dummy preload graph, destroy it*/
+		if (stream->dummy) stop_preload_graph(stream);
+	}
+
+	ms_filter_link(stream->ms.rtprecv,0,stream->relay_sink,0);
+	ms_filter_link(stream->relay_source,0,stream->ms.rtpsend,0);
+	ms_ticker_attach_multiple(stream->ms.ticker
+				,stream->relay_source
+				,stream->ms.rtprecv
+				,NULL);
+
+	stream->ms.start_time=ms_time(NULL);
+	stream->ms.is_beginning=TRUE;
+	return 0;
+}
+
+/*the payload types received by one leg, numbered as negotiated on the other one, -1 for those it does not know*/
+static void relay_set_payload_type_map(AudioStream *from, AudioStream *to){
+	RtpProfile *recv_profile=rtp_session_get_recv_profile(from->ms.session);
+	RtpProfile *send_profile=rtp_session_get_send_profile(to->ms.session);
+	int map[RTP_PROFILE_MAX_PAYLOADS];
+	int i;
+
+	for(i=0;i<RTP_PROFILE_MAX_PAYLOADS;i++){
+		PayloadType *pt=rtp_profile_get_payload(recv_profile,i);
+		map[i]=pt ? rtp_profile_find_payload_number(send_profile,pt->mime_type,pt->clock_rate,pt->channels) : -1;
+	}
+	ms_filter_call_method(to->ms.rtpsend,MS_RTP_SEND_SET_PAYLOAD_TYPE_MAP,map);
+}
+
+void audio_stream_relay_link(AudioStream *st1, AudioStream *st2){
+	relay_set_payload_type_map(st1,st2);
+	relay_set_payload_type_map(st2,st1);
+	ms_filter_call_method(st1->relay_sink,MS_ITC_SINK_CONNECT,st2->relay_source);
+	ms_filter_call_method(st2->relay_sink,MS_ITC_SINK_CONNECT,st1->relay_source);
+}
+
+void audio_stream_relay_unlink(AudioStream *st1, AudioStream *st2){
+	ms_filter_call_method(st1->relay_sink,MS_ITC_SINK_CONNECT,NULL);
+	ms_filter_call_method(st2->relay_sink,MS_ITC_SINK_CONNECT,NULL);
+	ms_filter_call_method(st1->ms.rtpsend,MS_RTP_SEND_SET_PAYLOAD_TYPE_MAP,NULL);
+	ms_filter_call_method(st2->ms.rtpsend,MS_RTP_SEND_SET_PAYLOAD_TYPE_MAP,NULL);
+}
+
+int audio_stream_start_prompt(AudioStream *stream, RtpProfile *profile, const char *rem_rtp_ip, int rem_rtp_port,
+	const char *rem_rtcp_ip, int rem_rtcp_port, int payload, const char *file, int loop_interval)
+{
+	RtpSession *rtps=stream->ms.session;
+	PayloadType *pt=rtp_profile_get_payload(profile,payload);
+	const char *mime_type=NULL;
+	int rate=0;
+
+	if (pt==NULL){
+		ms_error("audio_stream_start_prompt: undefined payload type.");
+		return -1;
+	}
+	stream->prompt_player=ms_filter_new(MS_ENCODED_PLAYER_ID);
+	if (ms_filter_call_method(stream->prompt_player,MS_ENCODED_PLAYER_OPEN,(void*)file)!=0){
+		ms_filter_destroy(stream->prompt_player);
+		stream->prompt_player=NULL;
+		return -1;
+	}
+	ms_filter_call_method(stream->prompt_player,MS_ENCODED_PLAYER_GET_MIME_TYPE,&mime_type);
+	ms_filter_call_method(stream->prompt_player,MS_FILTER_GET_SAMPLE_RATE,&rate);
+	if (strcasecmp(mime_type,pt->mime_type)!=0 || rate!=pt->clock_rate){
+		ms_error("audio_stream_start_prompt: %s is encoded in %s/%i, cannot be sent as %s/%i.",file,mime_type,rate,
+			pt->mime_type,pt->clock_rate);
+		ms_filter_destroy(stream->prompt_player);
+		stream->prompt_player=NULL;
+		return -1;
+	}
+	ms_filter_call_method(stream->prompt_player,MS_ENCODED_PLAYER_LOOP,&loop_interval);
+
+	rtp_session_set_profile(rtps,profile);
+	if (rem_rtp_port>0) rtp_session_set_remote_addr_full(rtps,rem_rtp_ip,rem_rtp_port,rem_rtcp_ip,rem_rtcp_port);
+	if (rem_rtcp_port<=0){
+		rtp_session_enable_rtcp(rtps,FALSE);
+	}
+	rtp_session_set_payload_type(rtps,payload);
+	if (rem_rtp_port>0)
+		ms_filter_call_method(stream->ms.rtpsend,MS_RTP_SEND_SET_SESSION,rtps);
+	stream->ms.rtprecv=ms_filter_new(MS_RTP_RECV_ID);
+	ms_filter_call_method(stream->ms.rtprecv,MS_RTP_RECV_SET_SESSION,rtps);
+	stream->prompt_sink=ms_filter_new(MS_VOID_SINK_ID);
+
+	if (stream->ms.ticker==NULL) start_ticker(&stream->ms);
+	else{
+		/*we were using the dummy preload graph, destroy it*/
+		if (stream->dummy) stop_preload_graph(stream);
+	}
+
+	ms_filter_link(stream->ms.rtprecv,0,stream->prompt_sink,0);
+	ms_filter_link(stream->prompt_player,0,stream->ms.rtpsend,0);
+	ms_filter_call_method_noarg(stream->prompt_player,MS_ENCODED_PLAYER_START);
+	ms_ticker_attach_multiple(stream->ms.ticker
+				,stream->prompt_player
+				,stream->ms.rtprecv
+				,NULL);
+
+	stream->ms.start_time=ms_time(NULL);
+	stream->ms.is_beginning=TRUE;
+	return 0;
+}
+
+static void relay_stream_unlink_receiver(AudioStream *stream){
+	if (stream->relay_tap){
+		ms_filter_unlink(stream->ms.rtprecv,0,stream->relay_tee,0);
+		ms_filter_unlink(stream->relay_tee,0,stream->relay_sink,0);
+		ms_filter_unlink(stream->relay_tee,1,stream->ms.decoder,0);
+		ms_filter_unlink(stream->ms.decoder,0,stream->relay_tap,0);
+	}else ms_filter_unlink(stream->ms.rtprecv,0,stream->relay_sink,0);
+}
+
+/*a decoder for the payload type being received, configured as the rtp receiver outputs it*/
+static MSFilter *relay_new_decoder(AudioStream *stream, PayloadType *pt){
+	MSFilter *dec;
+	int sample_rate;
+	if (pt==NULL || (dec=ms_filter_create_decoder(pt->mime_type))==NULL) return NULL;
+	if (ms_filter_call_method(stream->ms.rtprecv,MS_FILTER_GET_SAMPLE_RATE,&sample_rate)==0)
+		ms_filter_call_method(dec,MS_FILTER_SET_SAMPLE_RATE,&sample_rate);
+	ms_filter_call_method(dec,MS_FILTER_SET_NCHANNELS,&pt->channels);
+	if (pt->recv_fmtp!=NULL) ms_filter_call_method(dec,MS_FILTER_ADD_FMTP,(void*)pt->recv_fmtp);
+	return dec;
+}
+
+int audio_stream_relay_set_tap(AudioStream *stream, MSFilter *tap){
+	MSFilter *dec=NULL;
+	if (stream->relay_sink==NULL){
+		ms_error("audio_stream_relay_set_tap: stream is not in relay mode.");
+		return -1;
+	}
+	if (tap!=NULL){
+		/*decoded audio is needed: the decoder matches the payload type received last*/
+		dec=relay_new_decoder(stream,rtp_profile_get_payload(rtp_session_get_profile(stream->ms.session),
+			rtp_session_get_recv_payload_type(stream->ms.session)));
+		if (dec==NULL){
+			ms_error("audio_stream_relay_set_tap: no decoder available.");
+			return -1;
+		}
+		if (stream->relay_tee==NULL) stream->relay_tee=ms_filter_new(MS_TEE_ID);
+	}
+
+	ms_ticker_detach(stream->ms.ticker,stream->ms.rtprecv);
+	relay_stream_unlink_receiver(stream);
+	/*the decoder only lives while a tap is set, a payload type change cannot find it out of the graph*/
+	if (stream->ms.decoder) ms_filter_destroy(stream->ms.decoder);
+	stream->ms.decoder=dec;
+	stream->relay_tap=tap;
+	if (tap){
+		ms_filter_link(stream->ms.rtprecv,0,stream->relay_tee,0);
+		ms_filter_link(stream->relay_tee,0,stream->relay_sink,0);
+		ms_filter_link(stream->relay_tee,1,stream->ms.decoder,0);
+		ms_filter_link(stream->ms.decoder,0,tap,0);
+	}else ms_filter_link(stream->ms.rtprecv,0,stream->relay_sink,0);
+	ms_ticker_attach(stream->ms.ticker,stream->ms.rtprecv);
+	return 0;
+}
+
+/*
+ * Called from the ticker, like mediastream_payload_type_changed(), but the decoder of a relay stream sits behind the
+ * tee and only exists while tapped.
+ */
+static void relay_payload_type_changed(RtpSession *session, unsigned long data){
+	AudioStream *stream=(AudioStream*)data;
+	PayloadType *pt=rtp_profile_get_payload(rtp_session_get_profile(session),rtp_session_get_recv_payload_type(session));
+	MSFilter *dec;
+
+	if (stream->ms.decoder==NULL || pt==NULL) return;
+	if (stream->ms.decoder->desc->enc_fmt!=NULL && strcasecmp(pt->mime_type,stream->ms.decoder->desc->enc_fmt)==0) return;
+	if ((dec=relay_new_decoder(stream,pt))==NULL){
+		ms_warning("relay_payload_type_changed: no decoder found for %s",pt->mime_type);
+		return;
+	}
+	ms_filter_unlink(stream->relay_tee,1,stream->ms.decoder,0);
+	ms_filter_unlink(stream->ms.decoder,0,stream->relay_tap,0);
+	ms_filter_postprocess(stream->ms.decoder);
+	ms_filter_destroy(stream->ms.decoder);
+	stream->ms.decoder=dec;
+	ms_filter_link(stream->relay_tee,1,stream->ms.decoder,0);
+	ms_filter_link(stream->ms.decoder,0,stream->relay_tap,0);
+	ms_filter_preprocess(stream->ms.decoder,stream->ms.ticker);
+}
+
 int audio_stream_start_with_files(AudioStream *stream, RtpProfile *prof,const char *remip, int remport,
 	int rem_rtcp_port, int pt,int jitt_comp, const char *infile, const char * outfile)
 {
@@ -589,6 +897,7 @@ void audio_stream_play(AudioStream *st, const char *name){
 void audio_stream_record(AudioStream *st, const char *name){
 	if (ms_filter_get_id(st->soundwrite)==MS_FILE_REC_ID){
 		ms_filter_call_method_noarg(st->soundwrite,MS_FILE_REC_CLOSE);
+		ms_filter_call_method(st->soundwrite,MS_FILE_REC_SET_ASYNC_PARAMS,&st->recorder_async);
 		ms_filter_call_method(st->soundwrite,MS_FILE_REC_OPEN,(void*)name);
 		ms_filter_call_method_noarg(st->soundwrite,MS_FILE_REC_START);
 	}else{
@@ -620,6 +929,7 @@ int audio_stream_mixed_record_start(AudioStream *st){
 		MSRecorderState state;
 		ms_filter_call_method(st->recorder,MS_RECORDER_GET_STATE,&state);
 		if (state==MSRecorderClosed){
+			ms_filter_call_method(st->recorder,MS_FILE_REC_SET_ASYNC_PARAMS,&st->recorder_async);
 			if (ms_filter_call_method(st->recorder,MS_RECORDER_OPEN,st->recorder_file)==-1)
 				return -1;
 		}
@@ -650,7 +960,12 @@ void audio_stream_set_features(AudioStream *st, uint32_t features){
 	st->features = features;
 }
 
-AudioStream *audio_stream_new(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6){
+void audio_stream_set_recorder_async_params(AudioStream *st, const MSFileRecAsyncParams *params){
+	st->recorder_async=*params;
+}
+
+AudioStream *audio_stream_new_with_session(RtpSession *session){
+	/*the arena is only taken when the graph is built, see audio_stream_enter_arena()*/
 	AudioStream *stream=(AudioStream *)ms_new0(AudioStream,1);
 	MSFilterDesc *ec_desc=ms_filter_lookup_by_name("MSOslec");
 	
@@ -658,7 +973,7 @@ AudioStream *audio_stream_new(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6){
 	ms_filter_reset_statistics();
 
 	stream->ms.type = AudioStreamType;
-	stream->ms.session=create_duplex_rtpsession(loc_rtp_port,loc_rtcp_port,ipv6);
+	stream->ms.session=session;
 	/*some filters are created right now to allow configuration by the application before start() */
 	stream->ms.rtpsend=ms_filter_new(MS_RTP_SEND_ID);
 	stream->ms.ice_check_list=NULL;
@@ -674,6 +989,8 @@ AudioStream *audio_stream_new(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6){
 #endif
 
 	stream->ms.evq=ortp_ev_queue_new();
+	/*the RTCP packets are only queued for a bitrate controller (see audio_stream_connect_graph()), this lets oRTP reuse its buffer*/
+	ortp_ev_queue_ignore_type(stream->ms.evq,ORTP_EVENT_RTCP_PACKET_RECEIVED,TRUE);
 	rtp_session_register_event_queue(stream->ms.session,stream->ms.evq);
 	stream->play_dtmfs=TRUE;
 	stream->use_gc=FALSE;
@@ -683,6 +1000,102 @@ AudioStream *audio_stream_new(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6){
 	return stream;
 }
 
+AudioStream *audio_stream_new(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6){
+	/*the rtp session is not part of the graph and stays on the heap*/
+	return audio_stream_new_with_session(create_duplex_rtpsession(loc_rtp_port,loc_rtcp_port,ipv6));
+}
+
+struct _AudioStreamTemplate{
+	RtpProfile *profile;
+	int payload;
+	int jitt_comp;
+	MSSndCard *playcard;
+	MSSndCard *captcard;
+	bool_t use_ec;
+	uint32_t features;
+	MSList *ready; /*streams whose graph is built and linked, waiting for a call*/
+	int nready;
+};
+
+AudioStreamTemplate *audio_stream_template_new(RtpProfile *profile, int payload, int jitt_comp,
+	MSSndCard *playcard, MSSndCard *captcard, bool_t use_ec, uint32_t features)
+{
+	AudioStreamTemplate *tpl;
+
+	if (rtp_profile_get_payload(profile,payload)==NULL){
+		ms_error("audio_stream_template_new: undefined payload type %i.",payload);
+		return NULL;
+	}
+	tpl=ms_new0(AudioStreamTemplate,1);
+	tpl->profile=profile;
+	tpl->payload=payload;
+	tpl->jitt_comp=jitt_comp;
+	tpl->playcard=playcard;
+	tpl->captcard=captcard;
+	tpl->use_ec=use_ec;
+	tpl->features=features;
+	return tpl;
+}
+
+/*the session has all its settings but no socket until the stream is instantiated*/
+static AudioStream *audio_stream_template_build(AudioStreamTemplate *tpl){
+	AudioStream *stream=audio_stream_new_with_session(create_unbound_duplex_rtpsession());
+	OrtpArena *prev;
+	int err;
+
+	stream->features=tpl->features;
+	prev=audio_stream_enter_arena(stream);
+	err=audio_stream_build_graph(stream,tpl->profile,tpl->payload,tpl->jitt_comp,NULL,NULL,
+		tpl->playcard,tpl->captcard,tpl->use_ec);
+	ortp_arena_set_current(prev);
+	if (err!=0){
+		audio_stream_free(stream);
+		return NULL;
+	}
+	return stream;
+}
+
+int audio_stream_template_fill(AudioStreamTemplate *tpl, int count){
+	while(tpl->nready<count){
+		AudioStream *stream=audio_stream_template_build(tpl);
+		if (stream==NULL) break;
+		tpl->ready=ms_list_append(tpl->ready,stream);
+		tpl->nready++;
+	}
+	return tpl->nready;
+}
+
+AudioStream *audio_stream_template_instantiate(AudioStreamTemplate *tpl, int loc_rtp_port, int loc_rtcp_port, bool_t ipv6){
+	AudioStream *stream;
+
+	if (tpl->ready!=NULL){
+		stream=(AudioStream*)tpl->ready->data;
+		tpl->ready=ms_list_remove_link(tpl->ready,tpl->ready);
+		tpl->nready--;
+	}else{
+		ms_warning("audio_stream_template_instantiate: no pre-built graph left, building one now.");
+		stream=audio_stream_template_build(tpl);
+		if (stream==NULL) return NULL;
+	}
+	bind_duplex_rtpsession(stream->ms.session,loc_rtp_port,loc_rtcp_port,ipv6);
+	return stream;
+}
+
+int audio_stream_template_start(AudioStream *stream, const char *rem_rtp_ip, int rem_rtp_port,
+	const char *rem_rtcp_ip, int rem_rtcp_port)
+{
+	OrtpArena *prev=ortp_arena_set_current(stream->arena);
+	int err=audio_stream_connect_graph(stream,rem_rtp_ip,rem_rtp_port,rem_rtcp_ip,rem_rtcp_port);
+	ortp_arena_set_current(prev);
+	return err;
+}
+
+void audio_stream_template_destroy(AudioStreamTemplate *tpl){
+	ms_list_for_each(tpl->ready,(void (*)(void*))audio_stream_free);
+	ms_list_free(tpl->ready);
+	ms_free(tpl);
+}
+
 void audio_stream_play_received_dtmfs(AudioStream *st, bool_t yesno){
 	st->play_dtmfs=yesno;
 }
@@ -726,6 +1139,11 @@ void audio_stream_enable_gain_control(AudioStream *stream, bool_t val){
 
 void audio_stream_enable_automatic_gain_control(AudioStream *stream, bool_t val){
 	stream->use_agc=val;
+	/*the graph may already be built, when the stream comes from a template*/
+	if (stream->volsend){
+		int tmp=val;
+		ms_filter_call_method(stream->volsend,MS_VOLUME_ENABLE_AGC,&tmp);
+	}
 }
 
 void audio_stream_enable_noise_gate(AudioStream *stream, bool_t val){
@@ -769,6 +1187,20 @@ void audio_stream_stop(AudioStream * stream)
 		
 		if (stream->dummy){
 			stop_preload_graph(stream);
+		}else if (stream->relay_sink!=NULL){
+			ms_ticker_detach(stream->ms.ticker,stream->relay_source);
+			ms_ticker_detach(stream->ms.ticker,stream->ms.rtprecv);
+			rtp_stats_display(rtp_session_get_stats(stream->ms.session),
+				"          AUDIO RELAY SESSION'S RTP STATISTICS             ");
+			relay_stream_unlink_receiver(stream);
+			ms_filter_unlink(stream->relay_source,0,stream->ms.rtpsend,0);
+		}else if (stream->prompt_player!=NULL){
+			ms_ticker_detach(stream->ms.ticker,stream->prompt_player);
+			ms_ticker_detach(stream->ms.ticker,stream->ms.rtprecv);
+			rtp_stats_display(rtp_session_get_stats(stream->ms.session),
+				"          AUDIO PROMPT SESSION'S RTP STATISTICS            ");
+			ms_filter_unlink(stream->ms.rtprecv,0,stream->prompt_sink,0);
+			ms_filter_unlink(stream->prompt_player,0,stream->ms.rtpsend,0);
 		}else if (stream->ms.start_time!=0){
 		
 			ms_ticker_detach(stream->ms.ticker,stream->soundread);
@@ -803,6 +1235,8 @@ void audio_stream_stop(AudioStream * stream)
 			ms_connection_helper_unlink(&h,stream->ms.decoder,0,0);
 			if (stream->plc!=NULL)
 				ms_connection_helper_unlink(&h,stream->plc,0,0);
+			if (stream->time_stretch!=NULL)
+				ms_connection_helper_unlink(&h,stream->time_stretch,0,0);
 			if (stream->dtmfgen!=NULL)
 				ms_connection_helper_unlink(&h,stream->dtmfgen,0,0);
 			if (stream->volrecv!=NULL)
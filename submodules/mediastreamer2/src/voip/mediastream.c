@@ -130,7 +130,7 @@ MSTickerPrio __ms_get_default_prio(bool_t is_video) {
 #endif
 }
 
-RtpSession * create_duplex_rtpsession(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6) {
+RtpSession * create_unbound_duplex_rtpsession(void) {
 	RtpSession *rtpr;
 
 	rtpr = rtp_session_new(RTP_SESSION_SENDRECV);
@@ -139,16 +139,30 @@ RtpSession * create_duplex_rtpsession(int loc_rtp_port, int loc_rtcp_port, bool_
 	rtp_session_set_blocking_mode(rtpr, 0);
 	rtp_session_enable_adaptive_jitter_compensation(rtpr, TRUE);
 	rtp_session_set_symmetric_rtp(rtpr, TRUE);
-	rtp_session_set_local_addr(rtpr, ipv6 ? "::" : "0.0.0.0", loc_rtp_port, loc_rtcp_port);
 	rtp_session_signal_connect(rtpr, "timestamp_jump", (RtpCallback)rtp_session_resync, (long)NULL);
 	rtp_session_signal_connect(rtpr, "ssrc_changed", (RtpCallback)rtp_session_resync, (long)NULL);
 	rtp_session_set_ssrc_changed_threshold(rtpr, 0);
 	rtp_session_set_rtcp_report_interval(rtpr, 2500);	/* At the beginning of the session send more reports. */
+
+	return rtpr;
+}
+
+void bind_duplex_rtpsession(RtpSession *rtpr, int loc_rtp_port, int loc_rtcp_port, bool_t ipv6) {
+	rtp_session_set_local_addr(rtpr, ipv6 ? "::" : "0.0.0.0", loc_rtp_port, loc_rtcp_port);
 	disable_checksums(rtp_session_get_rtp_socket(rtpr));
+}
+
+RtpSession * create_duplex_rtpsession(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6) {
+	RtpSession *rtpr = create_unbound_duplex_rtpsession();
 
+	bind_duplex_rtpsession(rtpr, loc_rtp_port, loc_rtcp_port, ipv6);
 	return rtpr;
 }
 
+RtpSession * ms_create_duplex_rtp_session(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6) {
+	return create_duplex_rtpsession(loc_rtp_port, loc_rtcp_port, ipv6);
+}
+
 void start_ticker(MediaStream *stream) {
 	MSTickerParams params = {0};
 	char name[16];
@@ -38,6 +38,10 @@ extern void ms_ffmpeg_check_init();
 extern bool_t libmsandroiddisplay_init(void);
 extern void libmsandroiddisplaybad_init(void);
 extern void libmsandroidopengldisplay_init(void);
+extern void ms_file_rec_writer_init(void);
+extern void ms_file_rec_writer_exit(void);
+extern void ms_file_player_cache_init(void);
+extern void ms_file_player_cache_exit(void);
 
 #include "voipdescs.h"
 #include "mediastreamer2/mssndcard.h"
@@ -226,6 +230,10 @@ void ms_voip_init(){
 	for (i=0;ms_voip_filter_descs[i]!=NULL;i++){
 		ms_filter_register(ms_voip_filter_descs[i]);
 	}
+#ifdef MS2_FILTERS
+	ms_file_rec_writer_init();
+	ms_file_player_cache_init();
+#endif
 	ms_message("Registering all soundcard handlers");
 	cm=ms_snd_card_manager_get();
 	for (i=0;ms_snd_card_descs[i]!=NULL;i++){
@@ -261,6 +269,10 @@ void ms_voip_init(){
 }
 
 void ms_voip_exit(){
+#ifdef MS2_FILTERS
+	ms_file_rec_writer_exit();
+	ms_file_player_cache_exit();
+#endif
 	ms_snd_card_manager_destroy();
 #ifdef VIDEO_ENABLED
 	ms_web_cam_manager_destroy();
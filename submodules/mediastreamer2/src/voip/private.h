@@ -45,6 +45,11 @@ MSTickerPrio __ms_get_default_prio(bool_t is_video);
 
 MEDIASTREAMER2_INTERNAL_EXPORT RtpSession * create_duplex_rtpsession(int loc_rtp_port, int loc_rtcp_port, bool_t ipv6);
 
+/*a duplex session with all its settings but no socket yet, bound later by bind_duplex_rtpsession()*/
+RtpSession * create_unbound_duplex_rtpsession(void);
+
+void bind_duplex_rtpsession(RtpSession *rtpr, int loc_rtp_port, int loc_rtcp_port, bool_t ipv6);
+
 void start_ticker(MediaStream *stream);
 
 void mediastream_payload_type_changed(RtpSession *session, unsigned long data);
@@ -89,6 +89,20 @@ static void update_global_rating(MSQualityIndicator *qi){
 	qi->count++;
 }
 
+/*fraction_lost in 1/256, jitter in stream clock units, rt_prop in seconds*/
+static void update_remote_rating(MSQualityIndicator *qi, uint8_t fraction_lost, uint32_t jitter, float rt_prop){
+	float loss_rate,inter_jitter;
+	if (qi->clockrate==0){
+		PayloadType *pt=rtp_profile_get_payload(rtp_session_get_send_profile(qi->session),rtp_session_get_send_payload_type(qi->session));
+		if (pt!=NULL) qi->clockrate=pt->clock_rate;
+		else return;
+	}
+	loss_rate=(float)fraction_lost/256.0;
+	inter_jitter=(float)jitter/(float)qi->clockrate;
+	qi->remote_rating=compute_rating(loss_rate,inter_jitter,0,rt_prop);
+	update_global_rating(qi);
+}
+
 void ms_quality_indicator_update_from_feedback(MSQualityIndicator *qi, mblk_t *rtcp){
 	const report_block_t *rb=NULL;
 	if (rtcp_is_SR(rtcp)){
@@ -98,17 +112,15 @@ void ms_quality_indicator_update_from_feedback(MSQualityIndicator *qi, mblk_t *r
 	}else{
 		ms_warning("ms_quality_indicator_update_from_feedback(): not a RTCP report");
 	}
-	if (qi->clockrate==0){
-		PayloadType *pt=rtp_profile_get_payload(rtp_session_get_send_profile(qi->session),rtp_session_get_send_payload_type(qi->session));
-		if (pt!=NULL) qi->clockrate=pt->clock_rate;
-		else return;
-	}
 	if (rb){
-		float loss_rate=(float)report_block_get_fraction_lost(rb)/256.0;
-		float inter_jitter=(float)report_block_get_interarrival_jitter(rb)/(float)qi->clockrate;
-		float rt_prop=rtp_session_get_round_trip_propagation(qi->session);
-		qi->remote_rating=compute_rating(loss_rate,inter_jitter,0,rt_prop);
-		update_global_rating(qi);
+		update_remote_rating(qi,report_block_get_fraction_lost(rb),report_block_get_interarrival_jitter(rb),
+			rtp_session_get_round_trip_propagation(qi->session));
+	}
+}
+
+void ms_quality_indicator_update_from_summary(MSQualityIndicator *qi, const rtcp_summary_t *summary){
+	if (summary->has_remote_report){
+		update_remote_rating(qi,summary->remote_fraction_lost,summary->remote_jitter,summary->rtt);
 	}
 }
 
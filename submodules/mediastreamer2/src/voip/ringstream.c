@@ -41,6 +41,10 @@ RingStream * ring_start_with_cb(const char *file,int interval,MSSndCard *sndcard
 
 	stream=(RingStream *)ms_new0(RingStream,1);
 	stream->source=ms_filter_new(MS_FILE_PLAYER_ID);
+	stream->sndwrite=ms_snd_card_create_writer(sndcard);
+	/*have the cached ring resampled once to the rate of the card rather than on every tick*/
+	if (ms_filter_call_method(stream->sndwrite,MS_FILTER_GET_SAMPLE_RATE,&dstrate)==0)
+		ms_filter_call_method(stream->source,MS_FILE_PLAYER_SET_CACHED_RATE,&dstrate);
 	if (file)
 		ms_filter_call_method(stream->source,MS_FILE_PLAYER_OPEN,(void*)file);
 
@@ -50,7 +54,6 @@ RingStream * ring_start_with_cb(const char *file,int interval,MSSndCard *sndcard
 		ms_filter_set_notify_callback(stream->source,func,user_data);
 	stream->gendtmf=ms_filter_new(MS_DTMF_GEN_ID);
 
-	stream->sndwrite=ms_snd_card_create_writer(sndcard);
 	ms_filter_call_method(stream->source,MS_FILTER_GET_SAMPLE_RATE,&srcrate);
 	ms_filter_call_method(stream->gendtmf,MS_FILTER_SET_SAMPLE_RATE,&srcrate);
 	ms_filter_call_method(stream->sndwrite,MS_FILTER_SET_SAMPLE_RATE,&srcrate);
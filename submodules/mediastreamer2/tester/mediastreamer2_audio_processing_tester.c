@@ -0,0 +1,938 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006-2013 Belledonne Communications, Grenoble
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "mediastreamer2/mediastream.h"
+#include "mediastreamer2/dsptools.h"
+#include "mediastreamer2/dtmfgen.h"
+#include "mediastreamer2/msaudiomixer.h"
+#include "mediastreamer2/msencodedprompt.h"
+#include "mediastreamer2/msequalizer.h"
+#include "mediastreamer2/msfileplayer.h"
+#include "mediastreamer2/msvolume.h"
+#include "mediastreamer2/mstimestretch.h"
+#include "mediastreamer2/mstonedetector.h"
+#include "private.h"
+#include "mediastreamer2_tester.h"
+#include "mediastreamer2_tester_private.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "CUnit/Basic.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BLOCK_SAMPLES 160 /*20 ms at 8 kHz*/
+
+
+static int audio_processing_tester_init(void) {
+	ms_init();
+	return 0;
+}
+
+static int audio_processing_tester_cleanup(void) {
+	ms_exit();
+	return 0;
+}
+
+/*
+ * The filters are run outside of any graph, so that the tests are deterministic and do not depend on timing:
+ * the blocks are pushed into private queues and the process function is called once per tick of a ticker that is
+ * never started.
+ */
+typedef struct _OfflineFilter {
+	MSFilter *f;
+	MSTicker ticker;
+	MSQueue in;
+	MSQueue out;
+} OfflineFilter;
+
+static void offline_filter_init(OfflineFilter *obj, MSFilter *f) {
+	memset(&obj->ticker, 0, sizeof(obj->ticker));
+	obj->ticker.interval = (BLOCK_SAMPLES * 1000) / 8000;
+	ms_queue_init(&obj->in);
+	ms_queue_init(&obj->out);
+	obj->f = f;
+	/*sources such as the file player have no input pin, sinks no output pin*/
+	if (f->desc->ninputs > 0) f->inputs[0] = &obj->in;
+	if (f->desc->noutputs > 0) f->outputs[0] = &obj->out;
+	ms_filter_preprocess(f, &obj->ticker);
+}
+
+static void offline_filter_uninit(OfflineFilter *obj) {
+	ms_filter_postprocess(obj->f);
+	if (obj->f->desc->ninputs > 0) obj->f->inputs[0] = NULL;
+	if (obj->f->desc->noutputs > 0) obj->f->outputs[0] = NULL;
+	ms_queue_flush(&obj->in);
+	ms_queue_flush(&obj->out);
+}
+
+/*runs one tick with the given input block, if any, leaving the output blocks in obj->out*/
+static void offline_filter_process(OfflineFilter *obj, mblk_t *m) {
+	if (m != NULL) ms_queue_put(&obj->in, m);
+	ms_filter_process(obj->f);
+	obj->ticker.time += obj->ticker.interval;
+	obj->ticker.ticks++;
+}
+
+/*runs one tick with the given input block, if any, and returns the first output block*/
+static mblk_t *offline_filter_tick(OfflineFilter *obj, mblk_t *m) {
+	mblk_t *o;
+	offline_filter_process(obj, m);
+	o = ms_queue_get(&obj->out);
+	ms_queue_flush(&obj->out);
+	return o;
+}
+
+static mblk_t *make_block(const int16_t *samples, int nsamples) {
+	mblk_t *m = allocb(nsamples * 2, 0);
+	memcpy(m->b_wptr, samples, nsamples * 2);
+	m->b_wptr += nsamples * 2;
+	return m;
+}
+
+/*deterministic, wide band test signal*/
+static void make_test_signal(int16_t *samples, int nsamples, int amplitude) {
+	unsigned int seed = 12345;
+	int i;
+	for (i = 0; i < nsamples; i++) {
+		seed = seed * 1103515245 + 12345;
+		samples[i] = (int16_t)((int)((seed >> 16) % (2 * amplitude + 1)) - amplitude);
+	}
+}
+
+/*direct convolution, computed in double precision*/
+static void fir_reference(const ms_coef_t *taps, int ord, const int16_t *x, double *y, int nsamples) {
+	int i, k;
+	for (i = 0; i < nsamples; i++) {
+		double acc = 0;
+		for (k = 0; k < ord && k <= i; k++) acc += (double)taps[k] * x[i - k];
+		y[i] = acc;
+	}
+}
+
+static void check_fir_filter(int ord) {
+#ifndef MS_FIXED_POINT
+	/*odd block sizes and a block longer than the fft, on top of the usual ticks*/
+	static const int block_sizes[] = { 160, 160, 37, 1, 160, 1000, 161, 160 };
+	ms_coef_t *taps = ms_new(ms_coef_t, ord);
+	MSFirFilter *fir = ms_fir_new(ord);
+	int16_t *x;
+	ms_word16_t *w;
+	double *ref;
+	double max_error = 0;
+	int nsamples = 0;
+	int pos = 0;
+	int i;
+
+	for (i = 0; i < (int)(sizeof(block_sizes) / sizeof(block_sizes[0])); i++) nsamples += block_sizes[i];
+	x = ms_new(int16_t, nsamples);
+	w = ms_new(ms_word16_t, nsamples);
+	ref = ms_new(double, nsamples);
+	for (i = 0; i < ord; i++) taps[i] = (ms_coef_t)(0.5 * sin(0.3 * i) / (1 + i));
+	make_test_signal(x, nsamples, 16000);
+	fir_reference(taps, ord, x, ref, nsamples);
+
+	ms_fir_set_coefs(fir, taps);
+	for (i = 0; i < nsamples; i++) w[i] = (ms_word16_t)x[i];
+	for (i = 0; i < (int)(sizeof(block_sizes) / sizeof(block_sizes[0])); i++) {
+		ms_fir_process(fir, &w[pos], &w[pos], block_sizes[i]);
+		pos += block_sizes[i];
+	}
+	for (i = 0; i < nsamples; i++) {
+		double error = fabs(w[i] - ref[i]);
+		if (error > max_error) max_error = error;
+	}
+	ms_message("FIR filter of %i taps: max error %g", ord, max_error);
+	/*far below the 1/32768 resolution of the int16 samples the filter is used on*/
+	CU_ASSERT_TRUE(max_error < 0.05);
+
+	ms_fir_destroy(fir);
+	ms_free(taps);
+	ms_free(x);
+	ms_free(w);
+	ms_free(ref);
+#endif
+}
+
+static void fir_direct_form(void) {
+	check_fir_filter(MS_FIR_FFT_MIN_TAPS / 2);
+}
+
+static void fir_fft_overlap_save(void) {
+	check_fir_filter(128);
+	check_fir_filter(256);
+}
+
+#define EQUALIZER_TAPS 128
+
+/*runs nsamples through a new equalizer, with a 300 Hz notch if requested*/
+static void run_equalizer(const int16_t *x, int16_t *y, int nsamples, bool_t notch) {
+	OfflineFilter obj;
+	MSFilter *eq = ms_filter_new(MS_EQUALIZER_ID);
+	int pos;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(eq);
+	if (notch) {
+		MSEqualizerGain gain;
+		gain.frequency = 300;
+		gain.gain = 0.1f;
+		gain.width = 100;
+		ms_filter_call_method(eq, MS_EQUALIZER_SET_GAIN, &gain);
+	}
+	offline_filter_init(&obj, eq);
+	for (pos = 0; pos < nsamples; pos += BLOCK_SAMPLES) {
+		int n = MIN(BLOCK_SAMPLES, nsamples - pos);
+		mblk_t *o = offline_filter_tick(&obj, make_block(&x[pos], n));
+		CU_ASSERT_PTR_NOT_NULL_FATAL(o);
+		CU_ASSERT_EQUAL((int)(o->b_wptr - o->b_rptr), n * 2);
+		memcpy(&y[pos], o->b_rptr, n * 2);
+		freemsg(o);
+	}
+	offline_filter_uninit(&obj);
+	ms_filter_destroy(eq);
+}
+
+/*a flat equalizer is a pure delay of half its taps*/
+static void equalizer_flat(void) {
+	int nsamples = 50 * BLOCK_SAMPLES;
+	int16_t *x = ms_new(int16_t, nsamples);
+	int16_t *y = ms_new(int16_t, nsamples);
+	int max_error = 0;
+	int i;
+
+	make_test_signal(x, nsamples, 8000);
+	run_equalizer(x, y, nsamples, FALSE);
+	for (i = EQUALIZER_TAPS / 2; i < nsamples; i++) {
+		int error = abs(y[i] - x[i - EQUALIZER_TAPS / 2]);
+		if (error > max_error) max_error = error;
+	}
+	CU_ASSERT_TRUE(max_error <= 1);
+	ms_free(x);
+	ms_free(y);
+}
+
+/*
+ * The output must be the direct convolution of the input with the impulse response of the equalizer,
+ * whatever the block boundaries: the impulse response is measured first with a full scale impulse.
+ */
+static void equalizer_notch(void) {
+	int nsamples = 50 * BLOCK_SAMPLES;
+	int16_t *impulse = ms_new0(int16_t, 2 * BLOCK_SAMPLES);
+	int16_t *response = ms_new0(int16_t, 2 * BLOCK_SAMPLES);
+	ms_coef_t *taps = ms_new(ms_coef_t, EQUALIZER_TAPS);
+	int16_t *x = ms_new(int16_t, nsamples);
+	int16_t *y = ms_new(int16_t, nsamples);
+	double *ref = ms_new(double, nsamples);
+	double max_error = 0;
+	double in_energy = 0, out_energy = 0;
+	int i;
+
+	impulse[0] = 32767;
+	run_equalizer(impulse, response, 2 * BLOCK_SAMPLES, TRUE);
+	for (i = 0; i < EQUALIZER_TAPS; i++) taps[i] = (ms_coef_t)(response[i] / 32767.0);
+
+	make_test_signal(x, nsamples, 2000);
+	run_equalizer(x, y, nsamples, TRUE);
+	fir_reference(taps, EQUALIZER_TAPS, x, ref, nsamples);
+	for (i = 0; i < nsamples; i++) {
+		double error = fabs(y[i] - ref[i]);
+		if (error > max_error) max_error = error;
+	}
+	ms_message("Equalizer: max error %g against the direct convolution", max_error);
+	/*the output is truncated to int16 and each measured tap is off by up to 1/32767*/
+	CU_ASSERT_TRUE(max_error <= 3.0);
+
+	/*and the notch actually attenuates a 300 Hz tone*/
+	for (i = 0; i < nsamples; i++) x[i] = (int16_t)(8000 * sin(2 * M_PI * 300 * i / 8000.0));
+	run_equalizer(x, y, nsamples, TRUE);
+	for (i = nsamples / 2; i < nsamples; i++) {
+		in_energy += (double)x[i] * x[i];
+		out_energy += (double)y[i] * y[i];
+	}
+	CU_ASSERT_TRUE(out_energy < in_energy / 10);
+
+	ms_free(impulse);
+	ms_free(response);
+	ms_free(taps);
+	ms_free(x);
+	ms_free(y);
+	ms_free(ref);
+}
+
+/*what the generator computed with sin() on each sample, for a tone of normalized frequencies set as floats*/
+static int16_t dtmf_reference(int amplitude, float lowfreq, float highfreq, int pos) {
+	int16_t sample = (int16_t)(amplitude * sin(2 * M_PI * lowfreq * (double)pos));
+	if (highfreq != 0) sample += (int16_t)(amplitude * sin(2 * M_PI * highfreq * (double)pos));
+	return sample;
+}
+
+static void dtmfgen_long_tone(void) {
+	static const int16_t silence[BLOCK_SAMPLES] = { 0 };
+	MSDtmfGenCustomTone tone;
+	OfflineFilter obj;
+	MSFilter *gen = ms_filter_new(MS_DTMF_GEN_ID);
+	int rate = 8000;
+	int nsamples;
+	int amplitude;
+	float lowfreq, highfreq;
+	int max_error = 0;
+	int pos = 0;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(gen);
+	memset(&tone, 0, sizeof(tone));
+	strncpy(tone.tone_name, "9", sizeof(tone.tone_name));
+	tone.duration = 5000;
+	tone.frequencies[0] = 852;
+	tone.frequencies[1] = 1477;
+	tone.amplitude = 1.0f;
+	ms_filter_call_method(gen, MS_FILTER_SET_SAMPLE_RATE, &rate);
+	offline_filter_init(&obj, gen);
+	ms_filter_call_method(gen, MS_DTMF_GEN_PLAY_CUSTOM, &tone);
+
+	nsamples = (rate * tone.duration) / 1000;
+	amplitude = (int)(tone.amplitude * 0.7 * 32767.0);
+	lowfreq = (float)tone.frequencies[0] / (float)rate;
+	highfreq = (float)tone.frequencies[1] / (float)rate;
+	while (pos < nsamples) {
+		mblk_t *o = offline_filter_tick(&obj, make_block(silence, BLOCK_SAMPLES));
+		int16_t *samples;
+		int i;
+		CU_ASSERT_PTR_NOT_NULL_FATAL(o);
+		samples = (int16_t *)o->b_rptr;
+		for (i = 0; i < BLOCK_SAMPLES && pos < nsamples; i++, pos++) {
+			int error = abs(samples[i] - dtmf_reference(amplitude, lowfreq, highfreq, pos));
+			if (error > max_error) max_error = error;
+		}
+		freemsg(o);
+	}
+	ms_message("DTMF generator: max error %i over %i ms", max_error, tone.duration);
+	CU_ASSERT_TRUE(max_error <= 1);
+	offline_filter_uninit(&obj);
+	ms_filter_destroy(gen);
+}
+
+/*when no tone is pending the blocks must go through untouched, before and after a tone*/
+static void dtmfgen_idle_passthrough(void) {
+	int16_t samples[BLOCK_SAMPLES];
+	OfflineFilter obj;
+	MSFilter *gen = ms_filter_new(MS_DTMF_GEN_ID);
+	int i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(gen);
+	make_test_signal(samples, BLOCK_SAMPLES, 10000);
+	offline_filter_init(&obj, gen);
+	for (i = 0; i < 10; i++) {
+		mblk_t *m = make_block(samples, BLOCK_SAMPLES);
+		mblk_t *o = offline_filter_tick(&obj, m);
+		CU_ASSERT_TRUE(o == m);
+		CU_ASSERT_EQUAL(memcmp(o->b_rptr, samples, sizeof(samples)), 0);
+		freemsg(o);
+	}
+	ms_filter_call_method(gen, MS_DTMF_GEN_PUT, "1");
+	/*the 100 ms tone spans five blocks*/
+	for (i = 0; i < 5; i++) {
+		mblk_t *o = offline_filter_tick(&obj, make_block(samples, BLOCK_SAMPLES));
+		CU_ASSERT_PTR_NOT_NULL_FATAL(o);
+		CU_ASSERT_NOT_EQUAL(memcmp(o->b_rptr, samples, sizeof(samples)), 0);
+		freemsg(o);
+	}
+	/*let the trailing silence elapse*/
+	for (i = 0; i < 10; i++) freemsg(offline_filter_tick(&obj, make_block(samples, BLOCK_SAMPLES)));
+	for (i = 0; i < 10; i++) {
+		mblk_t *m = make_block(samples, BLOCK_SAMPLES);
+		mblk_t *o = offline_filter_tick(&obj, m);
+		CU_ASSERT_TRUE(o == m);
+		CU_ASSERT_EQUAL(memcmp(o->b_rptr, samples, sizeof(samples)), 0);
+		freemsg(o);
+	}
+	offline_filter_uninit(&obj);
+	ms_filter_destroy(gen);
+}
+
+typedef struct _ToneDetection {
+	int count;
+	uint64_t start_time;
+} ToneDetection;
+
+static void tone_detection_cb(void *data, MSFilter *f, unsigned int event_id, MSToneDetectorEvent *ev) {
+	ToneDetection *detection = (ToneDetection *)data;
+	MS_UNUSED(f), MS_UNUSED(event_id);
+	if (detection->count++ == 0) detection->start_time = ev->tone_start_time;
+}
+
+/*
+ * A DTMF 40 dB below full scale must be detected once, the analysis windows being staggered every 5 ms.
+ * It starts in the middle of a block and is reported with the time of the block it is first detected in.
+ */
+static void tonedet_low_level_dtmf(void) {
+	static const int frequencies[2] = { 770, 1336 };
+	int16_t samples[BLOCK_SAMPLES];
+	MSToneDetectorDef def;
+	ToneDetection detection = { 0 };
+	OfflineFilter obj;
+	MSFilter *det = ms_filter_new(MS_TONE_DETECTOR_ID);
+	int tone_start = 8 * 135;
+	int tone_end = tone_start + 800;
+	int hop = 3;
+	int pos = 0;
+	int i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(det);
+	CU_ASSERT_EQUAL(ms_filter_call_method(det, MS_TONE_DETECTOR_SET_WINDOW_HOP, &hop), -1);
+	hop = 5;
+	CU_ASSERT_EQUAL(ms_filter_call_method(det, MS_TONE_DETECTOR_SET_WINDOW_HOP, &hop), 0);
+	memset(&def, 0, sizeof(def));
+	strncpy(def.tone_name, "5", sizeof(def.tone_name));
+	def.frequency = frequencies[0];
+	def.min_duration = 40;
+	def.min_amplitude = 0.3f;
+	ms_filter_call_method(det, MS_TONE_DETECTOR_ADD_SCAN, &def);
+	ms_filter_set_notify_callback(det, (MSFilterNotifyFunc)tone_detection_cb, &detection);
+	offline_filter_init(&obj, det);
+	for (pos = 0; pos < 4000;) {
+		mblk_t *m;
+		for (i = 0; i < BLOCK_SAMPLES; i++, pos++) {
+			double v = 0;
+			if (pos >= tone_start && pos < tone_end) {
+				v = 327 * (sin(2 * M_PI * frequencies[0] * pos / 8000.0) + sin(2 * M_PI * frequencies[1] * pos / 8000.0));
+			}
+			samples[i] = (int16_t)v;
+		}
+		m = make_block(samples, BLOCK_SAMPLES);
+		CU_ASSERT_TRUE(offline_filter_tick(&obj, m) == m);
+		freemsg(m);
+	}
+	CU_ASSERT_EQUAL(detection.count, 1);
+	/*the windows starting at 125, 130 and 135 ms end in the block starting at 140 ms*/
+	CU_ASSERT_EQUAL((int)detection.start_time, 140);
+	offline_filter_uninit(&obj);
+	ms_filter_destroy(det);
+}
+
+#define PROMPT_FILE_NAME SOUND_FILE_PATH "arpeggio_8000_mono.wav"
+#define PROMPT_MAX_SAMPLES (8000 * 10)
+
+static MSFilter *open_player(OfflineFilter *obj, const char *file, int cached_rate) {
+	MSFilter *player = ms_filter_new(MS_FILE_PLAYER_ID);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(player);
+	if (cached_rate != 0) ms_filter_call_method(player, MS_FILE_PLAYER_SET_CACHED_RATE, &cached_rate);
+	CU_ASSERT_EQUAL_FATAL(ms_filter_call_method(player, MS_FILE_PLAYER_OPEN, (void *)file), 0);
+	ms_filter_call_method_noarg(player, MS_FILE_PLAYER_START);
+	offline_filter_init(obj, player);
+	return player;
+}
+
+static void close_player(OfflineFilter *obj) {
+	offline_filter_uninit(obj);
+	ms_filter_call_method_noarg(obj->f, MS_FILE_PLAYER_CLOSE);
+	ms_filter_destroy(obj->f);
+}
+
+/*
+ * Two players of the same prompt share its cached buffer: applying a gain on the blocks of one of them must not
+ * change what the other one plays.
+ */
+static void fileplay_shared_prompt_gain(void) {
+	int16_t *reference = ms_new0(int16_t, PROMPT_MAX_SAMPLES);
+	OfflineFilter ref_obj, gain_obj, plain_obj, vol_obj;
+	MSFilter *vol = ms_filter_new(MS_VOLUME_ID);
+	float gain = 2.0f;
+	int nsamples = 0;
+	int pos = 0;
+	mblk_t *o;
+
+	/*what the prompt sounds like when nobody else plays it*/
+	open_player(&ref_obj, PROMPT_FILE_NAME, 0);
+	while ((o = offline_filter_tick(&ref_obj, NULL)) != NULL) {
+		int n = MIN((int)(o->b_wptr - o->b_rptr) / 2, PROMPT_MAX_SAMPLES - nsamples);
+		memcpy(&reference[nsamples], o->b_rptr, n * 2);
+		nsamples += n;
+		freemsg(o);
+	}
+	close_player(&ref_obj);
+	CU_ASSERT_TRUE_FATAL(nsamples > 0);
+
+	ms_filter_call_method(vol, MS_VOLUME_SET_GAIN, &gain);
+	offline_filter_init(&vol_obj, vol);
+	open_player(&gain_obj, PROMPT_FILE_NAME, 0);
+	open_player(&plain_obj, PROMPT_FILE_NAME, 0);
+	while (pos < nsamples) {
+		mblk_t *amplified = offline_filter_tick(&vol_obj, offline_filter_tick(&gain_obj, NULL));
+		mblk_t *plain = offline_filter_tick(&plain_obj, NULL);
+		int n;
+		int i;
+		CU_ASSERT_PTR_NOT_NULL_FATAL(amplified);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(plain);
+		n = (int)(plain->b_wptr - plain->b_rptr) / 2;
+		CU_ASSERT_EQUAL((int)(amplified->b_wptr - amplified->b_rptr) / 2, n);
+		n = MIN(n, nsamples - pos);
+		CU_ASSERT_EQUAL(memcmp(plain->b_rptr, &reference[pos], n * 2), 0);
+		for (i = 0; i < n; i++) {
+			int expected = reference[pos + i] * 2;
+			int sample = ((int16_t *)amplified->b_rptr)[i];
+			if (expected > 32767 || expected < -32767) continue;
+			CU_ASSERT_TRUE(abs(sample - expected) <= 1);
+		}
+		pos += n;
+		freemsg(amplified);
+		freemsg(plain);
+	}
+	close_player(&gain_obj);
+	close_player(&plain_obj);
+	offline_filter_uninit(&vol_obj);
+	ms_filter_destroy(vol);
+	ms_free(reference);
+}
+
+/*a prompt cached at another rate is played at that rate*/
+static void fileplay_cached_rate(void) {
+	OfflineFilter obj;
+	int rate = 0;
+	int i;
+	mblk_t *o;
+
+	open_player(&obj, SOUND_FILE_PATH "laserrocket_16000_mono.wav", 8000);
+	ms_filter_call_method(obj.f, MS_FILTER_GET_SAMPLE_RATE, &rate);
+	CU_ASSERT_EQUAL(rate, 8000);
+	for (i = 0; i < 10; i++) {
+		o = offline_filter_tick(&obj, NULL);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(o);
+		CU_ASSERT_EQUAL((int)(o->b_wptr - o->b_rptr), BLOCK_SAMPLES * 2);
+		freemsg(o);
+	}
+	close_player(&obj);
+}
+
+#define ENCODED_PROMPT_FILE_NAME "encoded_prompt.bin"
+#define ENCODED_PROMPT_RECORDS 10
+
+/*records the payloads with the given timestamps as a pre-encoded prompt*/
+static void record_encoded_prompt(const uint32_t *timestamps, int nrecords) {
+	MSFilter *rec = ms_filter_new(MS_ENCODED_REC_ID);
+	OfflineFilter obj;
+	int rate = 8000;
+	int i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(rec);
+	ms_filter_call_method(rec, MS_ENCODED_REC_SET_MIME_TYPE, "PCMU");
+	ms_filter_call_method(rec, MS_FILTER_SET_SAMPLE_RATE, &rate);
+	CU_ASSERT_EQUAL_FATAL(ms_filter_call_method(rec, MS_ENCODED_REC_OPEN, ENCODED_PROMPT_FILE_NAME), 0);
+	offline_filter_init(&obj, rec);
+	for (i = 0; i < nrecords; i++) {
+		int len = 20 + i;
+		mblk_t *m = allocb(len, 0);
+		memset(m->b_wptr, i, len);
+		m->b_wptr += len;
+		mblk_set_timestamp_info(m, timestamps[i]);
+		offline_filter_process(&obj, m);
+	}
+	offline_filter_uninit(&obj);
+	ms_filter_call_method_noarg(rec, MS_ENCODED_REC_CLOSE);
+	ms_filter_destroy(rec);
+}
+
+static MSFilter *open_encoded_player(OfflineFilter *obj, int loop_interval) {
+	MSFilter *player = ms_filter_new(MS_ENCODED_PLAYER_ID);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(player);
+	CU_ASSERT_EQUAL_FATAL(ms_filter_call_method(player, MS_ENCODED_PLAYER_OPEN, ENCODED_PROMPT_FILE_NAME), 0);
+	ms_filter_call_method(player, MS_ENCODED_PLAYER_LOOP, &loop_interval);
+	ms_filter_call_method_noarg(player, MS_ENCODED_PLAYER_START);
+	offline_filter_init(obj, player);
+	return player;
+}
+
+static void close_encoded_player(OfflineFilter *obj) {
+	offline_filter_uninit(obj);
+	ms_filter_call_method_noarg(obj->f, MS_ENCODED_PLAYER_CLOSE);
+	ms_filter_destroy(obj->f);
+}
+
+/*payloads, their spacing and the mime type survive a recording played back*/
+static void encoded_prompt_round_trip(void) {
+	uint32_t timestamps[ENCODED_PROMPT_RECORDS];
+	OfflineFilter obj;
+	const char *mime_type = NULL;
+	uint32_t first_ts = 0;
+	int received = 0;
+	int state = MSPlayerPlaying;
+	int ticks;
+	int i;
+	mblk_t *o;
+
+	/*20 ms payloads, with a discontinuous transmission gap in the middle*/
+	for (i = 0; i < ENCODED_PROMPT_RECORDS; i++)
+		timestamps[i] = 1000 + i * 160 + (i >= ENCODED_PROMPT_RECORDS / 2 ? 800 : 0);
+	record_encoded_prompt(timestamps, ENCODED_PROMPT_RECORDS);
+
+	open_encoded_player(&obj, -1);
+	CU_ASSERT_EQUAL(ms_filter_call_method(obj.f, MS_ENCODED_PLAYER_GET_MIME_TYPE, &mime_type), 0);
+	CU_ASSERT_STRING_EQUAL(mime_type, "PCMU");
+	for (ticks = 0; ticks < 100 && state == MSPlayerPlaying; ticks++) {
+		offline_filter_process(&obj, NULL);
+		while ((o = ms_queue_get(&obj.out)) != NULL) {
+			int len = (int)(o->b_wptr - o->b_rptr);
+			CU_ASSERT_TRUE_FATAL(received < ENCODED_PROMPT_RECORDS);
+			if (received == 0) first_ts = mblk_get_timestamp_info(o);
+			CU_ASSERT_EQUAL(len, 20 + received);
+			CU_ASSERT_TRUE(len > 0 && o->b_rptr[0] == received && o->b_rptr[len - 1] == received);
+			CU_ASSERT_EQUAL(mblk_get_timestamp_info(o) - first_ts, timestamps[received] - timestamps[0]);
+			CU_ASSERT_EQUAL(mblk_get_marker_info(o) != 0, received == 0);
+			received++;
+			freemsg(o);
+		}
+		ms_filter_call_method(obj.f, MS_PLAYER_GET_STATE, &state);
+	}
+	CU_ASSERT_EQUAL(received, ENCODED_PROMPT_RECORDS);
+	CU_ASSERT_EQUAL(state, MSPlayerPaused);
+	close_encoded_player(&obj);
+	unlink(ENCODED_PROMPT_FILE_NAME);
+}
+
+/*prompts with nothing to play are refused, and a prompt of null duration looped without interval plays once per tick*/
+static void encoded_prompt_degenerate(void) {
+	uint32_t timestamps[ENCODED_PROMPT_RECORDS] = {0};
+	MSFilter *player = ms_filter_new(MS_ENCODED_PLAYER_ID);
+	OfflineFilter obj;
+	int ticks;
+
+	record_encoded_prompt(timestamps, 0);
+	CU_ASSERT_EQUAL(ms_filter_call_method(player, MS_ENCODED_PLAYER_OPEN, ENCODED_PROMPT_FILE_NAME), -1);
+	ms_filter_destroy(player);
+
+	record_encoded_prompt(timestamps, ENCODED_PROMPT_RECORDS);
+	open_encoded_player(&obj, 0);
+	for (ticks = 0; ticks < 5; ticks++) {
+		offline_filter_process(&obj, NULL);
+		CU_ASSERT_EQUAL(obj.out.q.q_mcount, ENCODED_PROMPT_RECORDS);
+		ms_queue_flush(&obj.out);
+	}
+	close_encoded_player(&obj);
+	unlink(ENCODED_PROMPT_FILE_NAME);
+}
+
+
+/*the mixer has as many input and output pins as conference members*/
+typedef struct _MixerBench {
+	MSFilter *f;
+	MSTicker ticker;
+	MSQueue in[64];
+	MSQueue out[64];
+	int nmembers;
+} MixerBench;
+
+static MixerBench *open_mixer(int nmembers, int conf_mode) {
+	MixerBench *obj = ms_new0(MixerBench, 1);
+	int rate = 8000;
+	int i;
+	obj->f = ms_filter_new(MS_AUDIO_MIXER_ID);
+	obj->nmembers = nmembers;
+	obj->ticker.interval = (BLOCK_SAMPLES * 1000) / rate;
+	ms_filter_call_method(obj->f, MS_FILTER_SET_SAMPLE_RATE, &rate);
+	ms_filter_call_method(obj->f, MS_AUDIO_MIXER_ENABLE_CONFERENCE_MODE, &conf_mode);
+	for (i = 0; i < nmembers; i++) {
+		ms_queue_init(&obj->in[i]);
+		ms_queue_init(&obj->out[i]);
+		obj->f->inputs[i] = &obj->in[i];
+		obj->f->outputs[i] = &obj->out[i];
+	}
+	return obj;
+}
+
+static void close_mixer(MixerBench *obj) {
+	int i;
+	ms_filter_postprocess(obj->f);
+	for (i = 0; i < obj->nmembers; i++) {
+		obj->f->inputs[i] = NULL;
+		obj->f->outputs[i] = NULL;
+		ms_queue_flush(&obj->in[i]);
+		ms_queue_flush(&obj->out[i]);
+	}
+	ms_filter_destroy(obj->f);
+	ms_free(obj);
+}
+
+/*runs one tick, the blocks are left in the output queues of the members*/
+static void mixer_tick(MixerBench *obj) {
+	if (obj->ticker.ticks == 0) ms_filter_preprocess(obj->f, &obj->ticker);
+	ms_filter_process(obj->f);
+	obj->ticker.time += obj->ticker.interval;
+	obj->ticker.ticks++;
+}
+
+/*what member i says: a square wave whose amplitude grows with i, the sum of 64 members still fits in 16 bits*/
+static int16_t member_sample(int member, int pos) {
+	return (int16_t)((member + 1) * ((pos % 5) - 2) * 7);
+}
+
+/*with as many members as the mixer has pins, everybody hears all the others*/
+static void audiomixer_conference_many_members(void) {
+	MixerBench *obj = open_mixer(64, 1);
+	int16_t samples[BLOCK_SAMPLES];
+	int ticks, i, k;
+
+	for (ticks = 0; ticks < 3; ticks++) {
+		int errors = 0;
+		for (i = 0; i < obj->nmembers; i++) {
+			for (k = 0; k < BLOCK_SAMPLES; k++) samples[k] = member_sample(i, k);
+			ms_queue_put(&obj->in[i], make_block(samples, BLOCK_SAMPLES));
+		}
+		mixer_tick(obj);
+		for (i = 0; i < obj->nmembers; i++) {
+			mblk_t *o = ms_queue_get(&obj->out[i]);
+			CU_ASSERT_TRUE_FATAL(o != NULL);
+			CU_ASSERT_EQUAL((int)(o->b_wptr - o->b_rptr), BLOCK_SAMPLES * 2);
+			for (k = 0; k < BLOCK_SAMPLES; k++) {
+				int expected = 0, j;
+				for (j = 0; j < obj->nmembers; j++)
+					if (j != i) expected += member_sample(j, k);
+				if (((int16_t *)o->b_rptr)[k] != expected) errors++;
+			}
+			/*everybody contributes, so nobody shares a block*/
+			CU_ASSERT_TRUE(o->b_datap->db_ref == 1);
+			freemsg(o);
+			CU_ASSERT_TRUE(ms_queue_empty(&obj->out[i]));
+		}
+		CU_ASSERT_EQUAL(errors, 0);
+	}
+	close_mixer(obj);
+}
+
+
+#define SPEAKER_MEMBERS 8
+
+/*square waves of decreasing loudness, member 5 is under a -50 dBFS noise floor and member 6 sends nothing*/
+static const int speaker_amplitudes[SPEAKER_MEMBERS] = { 1000, 2000, 3000, 4000, 500, 20, 0, 1500 };
+
+static void feed_speakers(MixerBench *obj) {
+	int16_t samples[BLOCK_SAMPLES];
+	int i, k;
+	for (i = 0; i < SPEAKER_MEMBERS; i++) {
+		if (speaker_amplitudes[i] == 0) continue;
+		for (k = 0; k < BLOCK_SAMPLES; k++) samples[k] = (int16_t)((k & 1) ? speaker_amplitudes[i] : -speaker_amplitudes[i]);
+		ms_queue_put(&obj->in[i], make_block(samples, BLOCK_SAMPLES));
+	}
+}
+
+/*
+ * Checks one tick of the mixer against the expected set of speakers: they hear the other speakers, the remaining
+ * members all hear every speaker through one shared block.
+ */
+static void check_speakers(MixerBench *obj, const int *mixed) {
+	mblk_t *outs[SPEAKER_MEMBERS];
+	dblk_t *full = NULL;
+	int sum = 0;
+	int i, k;
+
+	for (i = 0; i < SPEAKER_MEMBERS; i++)
+		if (mixed[i]) sum += speaker_amplitudes[i];
+	for (i = 0; i < SPEAKER_MEMBERS; i++) {
+		int expected = mixed[i] ? sum - speaker_amplitudes[i] : sum;
+		int errors = 0;
+		outs[i] = ms_queue_get(&obj->out[i]);
+		CU_ASSERT_TRUE_FATAL(outs[i] != NULL);
+		for (k = 0; k < BLOCK_SAMPLES; k++)
+			if (((int16_t *)outs[i]->b_rptr)[k] != ((k & 1) ? expected : -expected)) errors++;
+		CU_ASSERT_EQUAL(errors, 0);
+		if (mixed[i]) {
+			CU_ASSERT_EQUAL(outs[i]->b_datap->db_ref, 1);
+		} else {
+			if (full == NULL) full = outs[i]->b_datap;
+			CU_ASSERT_TRUE(outs[i]->b_datap == full);
+		}
+	}
+	for (i = 0; i < SPEAKER_MEMBERS; i++) freemsg(outs[i]);
+}
+
+/*only the loudest members above the noise floor are mixed, the listeners share the full mix*/
+static void audiomixer_active_speakers(void) {
+	static const int top3[SPEAKER_MEMBERS] = { 0, 1, 1, 1, 0, 0, 0, 0 };
+	static const int above_floor[SPEAKER_MEMBERS] = { 1, 1, 1, 1, 1, 0, 0, 1 };
+	MixerBench *obj = open_mixer(SPEAKER_MEMBERS, 1);
+	float noise_floor = -50;
+	int max_speakers = 3;
+	int ticks;
+
+	ms_filter_call_method(obj->f, MS_AUDIO_MIXER_SET_NOISE_FLOOR, &noise_floor);
+	ms_filter_call_method(obj->f, MS_AUDIO_MIXER_SET_ACTIVE_SPEAKERS, &max_speakers);
+	for (ticks = 0; ticks < 3; ticks++) {
+		feed_speakers(obj);
+		mixer_tick(obj);
+		check_speakers(obj, top3);
+	}
+	/*everybody who talks loud enough*/
+	max_speakers = 0;
+	ms_filter_call_method(obj->f, MS_AUDIO_MIXER_SET_ACTIVE_SPEAKERS, &max_speakers);
+	for (ticks = 0; ticks < 3; ticks++) {
+		feed_speakers(obj);
+		mixer_tick(obj);
+		check_speakers(obj, above_floor);
+	}
+	close_mixer(obj);
+}
+
+
+typedef enum _StretchSignal {
+	StretchSine,
+	StretchNoise,
+	StretchSilence
+} StretchSignal;
+
+/*
+ * The jitter buffer of a receiving session that got no packets targets its nominal size: shifting the current
+ * compensation by -shift leaves an error of shift for the time stretcher to apply.
+ */
+static RtpSession *create_stretched_session(int shift) {
+	RtpSession *session = rtp_session_new(RTP_SESSION_RECVONLY);
+	JBParameters jbp;
+	memset(&jbp, 0, sizeof(jbp));
+	jbp.min_size = 20;
+	jbp.nom_size = 60;
+	jbp.max_size = 200;
+	jbp.adaptive = TRUE;
+	jbp.max_packets = 100;
+	rtp_session_set_profile(session, &av_profile);
+	rtp_session_set_payload_type(session, 0);
+	rtp_session_set_jitter_buffer_params(session, &jbp);
+	rtp_session_set_jitter_buffer_target_percentile(session, 95);
+	rtp_session_shift_jitter_compensation(session, -shift);
+	return session;
+}
+
+static void make_stretch_block(StretchSignal signal, int16_t *samples, int pos) {
+	int i;
+	switch (signal) {
+		case StretchSine:
+			/*200 Hz: a pitch period of 40 samples*/
+			for (i = 0; i < BLOCK_SAMPLES; i++) samples[i] = (int16_t)(8000 * sin(2 * M_PI * 200 * (pos + i) / 8000.0));
+			break;
+		case StretchNoise:
+			make_test_signal(samples, BLOCK_SAMPLES, 8000);
+			break;
+		case StretchSilence:
+			memset(samples, 0, BLOCK_SAMPLES * 2);
+			break;
+	}
+}
+
+/*
+ * Runs the time stretcher for nticks blocks of signal against an error of shift timestamp units, checks each block
+ * and returns the number of samples added (positive) or removed (negative).
+ */
+static int run_time_stretch(StretchSignal signal, int nchannels, int shift, int nticks, MSTimeStretchStats *stats) {
+	RtpSession *session = create_stretched_session(shift);
+	MSFilter *f = ms_filter_new(MS_TIME_STRETCH_ID);
+	int16_t samples[BLOCK_SAMPLES];
+	OfflineFilter obj;
+	int last_stretch = -nticks;
+	int stretched = 0;
+	int total = 0;
+	int t;
+
+	CU_ASSERT_TRUE_FATAL(f != NULL);
+	ms_filter_call_method(f, MS_FILTER_SET_NCHANNELS, &nchannels);
+	ms_filter_call_method(f, MS_TIME_STRETCH_SET_SESSION, session);
+	offline_filter_init(&obj, f);
+	for (t = 0; t < nticks; t++) {
+		mblk_t *o;
+		int delta;
+		make_stretch_block(signal, samples, t * BLOCK_SAMPLES);
+		o = offline_filter_tick(&obj, make_block(samples, BLOCK_SAMPLES));
+		CU_ASSERT_TRUE_FATAL(o != NULL);
+		delta = (int)(o->b_wptr - o->b_rptr) / 2 - BLOCK_SAMPLES;
+		freemsg(o);
+		if (delta == 0) continue;
+		/*one pitch period, between 2.5 and 10 ms since the block holds two of them, at least 40 ms apart*/
+		CU_ASSERT_TRUE(abs(delta) >= 8000 / 400 && abs(delta) <= BLOCK_SAMPLES / 2);
+		CU_ASSERT_TRUE((t - last_stretch) * obj.ticker.interval >= 40);
+		last_stretch = t;
+		stretched++;
+		total += delta;
+		/*never beyond the error*/
+		CU_ASSERT_TRUE(shift > 0 ? (total > 0 && total <= shift) : (total < 0 && total >= shift));
+		/*what was applied is reported to the jitter buffer*/
+		CU_ASSERT_EQUAL(rtp_session_get_jitter_compensation_error(session), shift - total);
+	}
+	ms_filter_call_method(f, MS_TIME_STRETCH_GET_STATS, stats);
+	CU_ASSERT_EQUAL(stats->expanded + stats->compressed, stretched);
+	offline_filter_uninit(&obj);
+	ms_filter_destroy(f);
+	rtp_session_destroy(session);
+	return total;
+}
+
+/*a growing target is reached by repeating pitch periods, up to the error and no more*/
+static void timestretch_expand(void) {
+	MSTimeStretchStats stats;
+	int total = run_time_stretch(StretchSine, 1, 400, 50, &stats);
+	/*the stretcher stops once the error is below the shortest period*/
+	CU_ASSERT_TRUE(total > 400 - 8000 / 400 && total <= 400);
+	CU_ASSERT_TRUE(stats.expanded > 0);
+	CU_ASSERT_EQUAL(stats.compressed, 0);
+}
+
+/*a shrinking target is reached by removing pitch periods*/
+static void timestretch_compress(void) {
+	MSTimeStretchStats stats;
+	int total = run_time_stretch(StretchSine, 1, -400, 50, &stats);
+	CU_ASSERT_TRUE(total < -400 + 8000 / 400 && total >= -400);
+	CU_ASSERT_EQUAL(stats.expanded, 0);
+	CU_ASSERT_TRUE(stats.compressed > 0);
+}
+
+/*silence is stretched by the longest period, signals without pitch and stereo signals are left untouched*/
+static void timestretch_signal_bounds(void) {
+	MSTimeStretchStats stats;
+	CU_ASSERT_EQUAL(run_time_stretch(StretchSilence, 1, -400, 50, &stats), -400);
+	CU_ASSERT_EQUAL(stats.compressed, 5);
+	CU_ASSERT_EQUAL(run_time_stretch(StretchNoise, 1, 400, 50, &stats), 0);
+	CU_ASSERT_EQUAL(stats.expanded, 0);
+	CU_ASSERT_EQUAL(run_time_stretch(StretchSine, 2, 400, 50, &stats), 0);
+	CU_ASSERT_EQUAL(stats.expanded, 0);
+}
+
+
+test_t audio_processing_tests[] = {
+	{ "fir-direct-form", fir_direct_form },
+	{ "fir-fft-overlap-save", fir_fft_overlap_save },
+	{ "equalizer-flat", equalizer_flat },
+	{ "equalizer-notch", equalizer_notch },
+	{ "dtmfgen-long-tone", dtmfgen_long_tone },
+	{ "dtmfgen-idle-passthrough", dtmfgen_idle_passthrough },
+	{ "tonedet-low-level-dtmf", tonedet_low_level_dtmf },
+	{ "fileplay-shared-prompt-gain", fileplay_shared_prompt_gain },
+	{ "fileplay-cached-rate", fileplay_cached_rate },
+	{ "encoded-prompt-round-trip", encoded_prompt_round_trip },
+	{ "encoded-prompt-degenerate", encoded_prompt_degenerate },
+	{ "audiomixer-conference-many-members", audiomixer_conference_many_members },
+	{ "audiomixer-active-speakers", audiomixer_active_speakers },
+	{ "timestretch-expand", timestretch_expand },
+	{ "timestretch-compress", timestretch_compress },
+	{ "timestretch-signal-bounds", timestretch_signal_bounds }
+};
+
+test_suite_t audio_processing_test_suite = {
+	"Audio Processing",
+	audio_processing_tester_init,
+	audio_processing_tester_cleanup,
+	sizeof(audio_processing_tests) / sizeof(audio_processing_tests[0]),
+	audio_processing_tests
+};
@@ -28,6 +28,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2_tester_private.h"
 
 #include <stdio.h>
+#include <sys/stat.h>
 #include "CUnit/Basic.h"
 
 
@@ -191,7 +192,7 @@ static void dtmfgen_enc_rtp_dec_tonedet(void) {
 
 #define DTMFGEN_FILE_NAME "dtmfgen_file.raw"
 
-static void dtmfgen_filerec_fileplay_tonedet(void) {
+static void dtmfgen_filerec_fileplay_tonedet_with_params(const MSFileRecAsyncParams *params) {
 	MSConnectionHelper h;
 	unsigned int filter_mask = FILTER_MASK_VOIDSOURCE | FILTER_MASK_DTMFGEN | FILTER_MASK_FILEREC
 		| FILTER_MASK_FILEPLAY | FILTER_MASK_TONEDET | FILTER_MASK_VOIDSINK;
@@ -203,6 +204,9 @@ static void dtmfgen_filerec_fileplay_tonedet(void) {
 
 	// Generate tones and save them to a file
 	ms_filter_call_method_noarg(ms_tester_filerec, MS_FILE_REC_CLOSE);
+	if (params != NULL) {
+		CU_ASSERT_EQUAL(ms_filter_call_method(ms_tester_filerec, MS_FILE_REC_SET_ASYNC_PARAMS, (void *)params), 0);
+	}
 	ms_filter_call_method(ms_tester_filerec, MS_FILE_REC_OPEN, DTMFGEN_FILE_NAME);
 	ms_filter_call_method_noarg(ms_tester_filerec, MS_FILE_REC_START);
 	ms_connection_helper_start(&h);
@@ -212,6 +216,16 @@ static void dtmfgen_filerec_fileplay_tonedet(void) {
 	ms_ticker_attach(ms_tester_ticker, ms_tester_voidsource);
 	ms_tester_tone_generation_loop();
 	ms_filter_call_method_noarg(ms_tester_filerec, MS_FILE_REC_CLOSE);
+	if (params != NULL) {
+		MSFileRecStats stats;
+		struct stat st;
+		ms_filter_call_method(ms_tester_filerec, MS_FILE_REC_GET_STATS, &stats);
+		CU_ASSERT_TRUE(stats.batches_written > 0);
+		CU_ASSERT_EQUAL(stats.bytes_dropped, 0);
+		// all the batches must have reached the disk before the close returned
+		CU_ASSERT_EQUAL(stat(DTMFGEN_FILE_NAME, &st), 0);
+		CU_ASSERT_EQUAL((uint64_t)st.st_size, stats.bytes_written + 44); // 44 bytes of wav header
+	}
 	ms_ticker_detach(ms_tester_ticker, ms_tester_voidsource);
 	ms_connection_helper_start(&h);
 	ms_connection_helper_unlink(&h, ms_tester_voidsource, -1, 0);
@@ -240,13 +254,40 @@ static void dtmfgen_filerec_fileplay_tonedet(void) {
 	unlink(DTMFGEN_FILE_NAME);
 }
 
+static void dtmfgen_filerec_fileplay_tonedet(void) {
+	dtmfgen_filerec_fileplay_tonedet_with_params(NULL);
+}
+
+static void dtmfgen_filerec_async_fileplay_tonedet(void) {
+	MSFileRecAsyncParams params = { 0 };
+	MSFilter *rec;
+	int i;
+
+	params.buffer_size = 3200;
+	params.max_pending = 64;
+	params.fsync_policy = MSFileRecFsyncOnClose;
+	dtmfgen_filerec_fileplay_tonedet_with_params(&params);
+
+	// the shared writer thread is stopped and started again by each close and open
+	rec = ms_filter_new(MS_FILE_REC_ID);
+	ms_filter_call_method(rec, MS_FILE_REC_SET_ASYNC_PARAMS, &params);
+	for (i = 0; i < 20; i++) {
+		CU_ASSERT_EQUAL(ms_filter_call_method(rec, MS_FILE_REC_OPEN, DTMFGEN_FILE_NAME), 0);
+		ms_filter_call_method_noarg(rec, MS_FILE_REC_START);
+		ms_filter_call_method_noarg(rec, MS_FILE_REC_CLOSE);
+	}
+	ms_filter_destroy(rec);
+	unlink(DTMFGEN_FILE_NAME);
+}
+
 
 test_t basic_audio_tests[] = {
 	{ "dtmfgen-tonedet", dtmfgen_tonedet },
 	{ "dtmfgen-enc-dec-tonedet-pcmu", dtmfgen_enc_dec_tonedet_pcmu },
 	{ "dtmfgen-enc-dec-tonedet-opus", dtmfgen_enc_dec_tonedet_opus },
 	{ "dtmfgen-enc-rtp-dec-tonedet", dtmfgen_enc_rtp_dec_tonedet },
-	{ "dtmfgen-filerec-fileplay-tonedet", dtmfgen_filerec_fileplay_tonedet }
+	{ "dtmfgen-filerec-fileplay-tonedet", dtmfgen_filerec_fileplay_tonedet },
+	{ "dtmfgen-filerec-async-fileplay-tonedet", dtmfgen_filerec_async_fileplay_tonedet }
 };
 
 test_suite_t basic_audio_test_suite = {
@@ -0,0 +1,741 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006-2013 Belledonne Communications, Grenoble
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "mediastreamer2/mediastream.h"
+#include "mediastreamer2/msfilerec.h"
+#include "mediastreamer2_tester.h"
+#include "mediastreamer2_tester_private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "CUnit/Basic.h"
+
+#define PACKET_SAMPLES 160 /*20 ms of PCMU*/
+
+
+static int rtp_tester_init(void) {
+	ms_init();
+	ortp_init();
+	return 0;
+}
+
+static int rtp_tester_cleanup(void) {
+	ms_exit();
+	return 0;
+}
+
+/*
+ * The sessions do not use their sockets: a transport feeds them with packets queued by the test, so that the
+ * arrival time of each packet is exactly the local timestamp passed to rtp_session_recvm_with_ts(), and keeps the
+ * RTP packets they send, STUN requests aside. Streams run it from their ticker thread, hence the lock.
+ */
+typedef struct _QueueTransport {
+	RtpTransport tr;
+	ms_mutex_t lock;
+	queue_t q;
+	queue_t sent;
+} QueueTransport;
+
+static ortp_socket_t queue_transport_getsocket(RtpTransport *t) {
+	return (ortp_socket_t)-1;
+}
+
+static int queue_transport_sendto(RtpTransport *t, mblk_t *msg, int flags, const struct sockaddr *to, socklen_t tolen) {
+	QueueTransport *qt = (QueueTransport *)t->data;
+	mblk_t *copy;
+	if (((rtp_header_t *)msg->b_rptr)->version != 2) return (int)msgdsize(msg);
+	copy = copymsg(msg);
+	msgpullup(copy, -1);
+	ms_mutex_lock(&qt->lock);
+	putq(&qt->sent, copy);
+	ms_mutex_unlock(&qt->lock);
+	return (int)msgdsize(msg);
+}
+
+static int queue_transport_recvfrom(RtpTransport *t, mblk_t *msg, int flags, struct sockaddr *from, socklen_t *fromlen) {
+	QueueTransport *qt = (QueueTransport *)t->data;
+	mblk_t *m;
+	int len;
+	ms_mutex_lock(&qt->lock);
+	m = getq(&qt->q);
+	ms_mutex_unlock(&qt->lock);
+	if (m == NULL) return 0;
+	len = (int)(m->b_wptr - m->b_rptr);
+	memcpy(msg->b_wptr, m->b_rptr, len);
+	freemsg(m);
+	return len;
+}
+
+static void queue_transport_init(QueueTransport *qt) {
+	memset(qt, 0, sizeof(*qt));
+	ms_mutex_init(&qt->lock, NULL);
+	qinit(&qt->q);
+	qinit(&qt->sent);
+	qt->tr.data = qt;
+	qt->tr.t_getsocket = queue_transport_getsocket;
+	qt->tr.t_sendto = queue_transport_sendto;
+	qt->tr.t_recvfrom = queue_transport_recvfrom;
+}
+
+static void queue_transport_put(QueueTransport *qt, mblk_t *m) {
+	ms_mutex_lock(&qt->lock);
+	putq(&qt->q, m);
+	ms_mutex_unlock(&qt->lock);
+}
+
+static int queue_transport_sent_count(QueueTransport *qt) {
+	int count;
+	ms_mutex_lock(&qt->lock);
+	count = qt->sent.q_mcount;
+	ms_mutex_unlock(&qt->lock);
+	return count;
+}
+
+static void queue_transport_uninit(QueueTransport *qt) {
+	flushq(&qt->q, 0);
+	flushq(&qt->sent, 0);
+	ms_mutex_destroy(&qt->lock);
+}
+
+/*the payload bytes are all set to the low bits of the sequence number*/
+static mblk_t *make_rtp_packet(int payload_type, uint16_t seq, uint32_t ts, uint32_t ssrc, int payload_size) {
+	mblk_t *m = allocb(RTP_FIXED_HEADER_SIZE + payload_size, 0);
+	rtp_header_t *rtp = (rtp_header_t *)m->b_wptr;
+	memset(m->b_wptr, 0, RTP_FIXED_HEADER_SIZE);
+	memset(m->b_wptr + RTP_FIXED_HEADER_SIZE, seq & 0xFF, payload_size);
+	rtp->version = 2;
+	rtp->paytype = payload_type;
+	rtp->seq_number = htons(seq);
+	rtp->timestamp = htonl(ts);
+	rtp->ssrc = htonl(ssrc);
+	m->b_wptr += RTP_FIXED_HEADER_SIZE + payload_size;
+	return m;
+}
+
+static void make_jitter_buffer_params(JBParameters *jbp, int min_size, int nom_size, int max_size) {
+	memset(jbp, 0, sizeof(*jbp));
+	jbp->min_size = min_size;
+	jbp->nom_size = nom_size;
+	jbp->max_size = max_size;
+	jbp->adaptive = TRUE;
+	jbp->max_packets = 100;
+}
+
+static RtpSession *create_receiving_session(QueueTransport *qt, const JBParameters *jbp) {
+	RtpSession *session = rtp_session_new(RTP_SESSION_RECVONLY);
+	rtp_session_set_profile(session, &av_profile);
+	rtp_session_set_payload_type(session, 0);
+	rtp_session_set_jitter_buffer_params(session, jbp);
+	rtp_session_set_transports(session, &qt->tr, NULL);
+	return session;
+}
+
+/*
+ * Feeds the session with nticks packets of 20 ms. One packet out of ten is delayed by late_ticks ticks, the others
+ * arrive on time. The packets are read back every tick like an audio stream does.
+ */
+static void run_late_packets(RtpSession *session, QueueTransport *qt, int nticks, int late_ticks) {
+	int t;
+	for (t = 0; t < nticks; t++) {
+		mblk_t *m;
+		if (t % 10 != 5) putq(&qt->q, make_rtp_packet(0, (uint16_t)t, t * PACKET_SAMPLES, 0x1234, PACKET_SAMPLES));
+		if (t >= late_ticks && (t - late_ticks) % 10 == 5)
+			putq(&qt->q, make_rtp_packet(0, (uint16_t)(t - late_ticks), (t - late_ticks) * PACKET_SAMPLES, 0x1234, PACKET_SAMPLES));
+		while ((m = rtp_session_recvm_with_ts(session, t * PACKET_SAMPLES)) != NULL) freemsg(m);
+	}
+}
+
+/*the compensation aimed at, the error is only reported in the delay targeting mode*/
+static int jitter_target_ts(RtpSession *session) {
+	return rtp_session_get_jitter_compensation_error(session) + session->rtp.jittctl.adapt_jitt_comp_ts;
+}
+
+/*setting a nominal size alone keeps the legacy bounds: min_size is the nominal size and max_size is unset*/
+static void jitter_buffer_legacy_params(void) {
+	JBParameters jbp;
+	JBParameters got;
+	RtpSession *session = rtp_session_new(RTP_SESSION_RECVONLY);
+
+	make_jitter_buffer_params(&jbp, 20, 20, 200);
+	rtp_session_get_jitter_buffer_params(session, &got);
+	CU_ASSERT_EQUAL(got.min_size, got.nom_size);
+	CU_ASSERT_EQUAL(got.max_size, -1);
+
+	rtp_session_set_jitter_buffer_params(session, &jbp);
+	rtp_session_get_jitter_buffer_params(session, &got);
+	CU_ASSERT_EQUAL(got.min_size, 20);
+	CU_ASSERT_EQUAL(got.nom_size, 20);
+	CU_ASSERT_EQUAL(got.max_size, 200);
+	CU_ASSERT_EQUAL(got.max_packets, 100);
+	CU_ASSERT_TRUE(got.adaptive);
+
+	/*a resynchronisation does not change the bounds*/
+	rtp_session_resync(session);
+	rtp_session_get_jitter_buffer_params(session, &got);
+	CU_ASSERT_EQUAL(got.min_size, 20);
+	CU_ASSERT_EQUAL(got.max_size, 200);
+
+	rtp_session_set_jitter_compensation(session, 60);
+	rtp_session_get_jitter_buffer_params(session, &got);
+	CU_ASSERT_EQUAL(got.nom_size, 60);
+	CU_ASSERT_EQUAL(got.min_size, 60);
+	CU_ASSERT_EQUAL(got.max_size, -1);
+	rtp_session_destroy(session);
+}
+
+/*one packet out of ten 60 ms late: the 95th percentile covers it, the 80th does not*/
+static void jitter_buffer_target_percentile(void) {
+	JBParameters jbp;
+	QueueTransport qt;
+	RtpSession *session;
+	int target;
+
+	make_jitter_buffer_params(&jbp, 20, 20, 200);
+	queue_transport_init(&qt);
+	session = create_receiving_session(&qt, &jbp);
+	rtp_session_set_jitter_buffer_target_percentile(session, 95);
+	rtp_session_enable_jitter_buffer_time_stretching(session, TRUE);
+	run_late_packets(session, &qt, 500, 3);
+	/*time stretching alone moves the compensation, which stays at the nominal size*/
+	CU_ASSERT_EQUAL(session->rtp.jittctl.adapt_jitt_comp_ts, 20 * 8);
+	target = jitter_target_ts(session);
+	/*60 ms late, minus the 6 ms the late packets pull the mean down, plus one bin and half a corrective step*/
+	CU_ASSERT_TRUE(target >= 54 * 8 && target <= 70 * 8);
+
+	rtp_session_set_jitter_buffer_target_percentile(session, 80);
+	run_late_packets(session, &qt, 500, 3);
+	/*the on time packets alone are covered: the target falls back to min_size*/
+	CU_ASSERT_EQUAL(jitter_target_ts(session), 20 * 8);
+	rtp_session_destroy(session);
+	queue_transport_uninit(&qt);
+}
+
+/*the target never goes past max_size, and without time stretching the compensation moves towards it by corrective steps*/
+static void jitter_buffer_target_bounds(void) {
+	JBParameters jbp;
+	QueueTransport qt;
+	RtpSession *session;
+
+	make_jitter_buffer_params(&jbp, 20, 20, 40);
+	queue_transport_init(&qt);
+	session = create_receiving_session(&qt, &jbp);
+	rtp_session_set_jitter_buffer_target_percentile(session, 95);
+	run_late_packets(session, &qt, 500, 3);
+	CU_ASSERT_EQUAL(jitter_target_ts(session), 40 * 8);
+	CU_ASSERT_TRUE(session->rtp.jittctl.adapt_jitt_comp_ts > 20 * 8);
+	CU_ASSERT_TRUE(abs(rtp_session_get_jitter_compensation_error(session)) <= session->rtp.jittctl.corrective_step);
+	rtp_session_destroy(session);
+	queue_transport_uninit(&qt);
+}
+
+
+#define RELAY_CALLER_SSRC 0xCA11E4
+#define RELAY_PACKETS 20
+
+typedef struct _RelayPacket {
+	int payload_type;
+	uint16_t seq;
+	uint32_t ts;
+} RelayPacket;
+
+static uint64_t wall_clock_ms(void) {
+	MSTimeSpec ts;
+	ms_get_cur_time(&ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static AudioStream *start_relay_leg(RtpProfile *profile, int port, QueueTransport *qt) {
+	AudioStream *st = audio_stream_new(port, port + 1, FALSE);
+	rtp_session_set_transports(st->ms.session, &qt->tr, NULL);
+	CU_ASSERT_EQUAL(audio_stream_start_relay(st, profile, "127.0.0.1", port + 2, NULL, 0, 0), 0);
+	return st;
+}
+
+/*
+ * The caller sends 20 ms PCMU packets with a PCMA burst in the middle and a GSM packet that the callee did not
+ * negotiate, in real time as the relay streams run on their ticker: its timestamps follow the wall clock.
+ */
+static void send_to_relay(QueueTransport *qt, RelayPacket *sent, int first, int count, uint64_t start_time) {
+	int i;
+	for (i = first; i < first + count; i++) {
+		int pt = (i % RELAY_PACKETS >= 10 && i % RELAY_PACKETS < 13) ? 8 : (i % RELAY_PACKETS == 13 ? 3 : 0);
+		sent[i].payload_type = pt;
+		sent[i].seq = (uint16_t)(65530 + i);
+		sent[i].ts = 0xFFFFF000 + (uint32_t)((wall_clock_ms() - start_time) * 8);
+		queue_transport_put(qt, make_rtp_packet(pt, sent[i].seq, sent[i].ts, RELAY_CALLER_SSRC, PACKET_SAMPLES));
+		ms_usleep(20000);
+	}
+}
+
+static int wait_for_relayed(QueueTransport *qt, int count) {
+	int i;
+	for (i = 0; i < 200 && queue_transport_sent_count(qt) < count; i++) ms_usleep(10000);
+	return queue_transport_sent_count(qt);
+}
+
+/*
+ * Checks what the callee got: its own SSRC, continuous sequence numbers, the caller's timestamp spacing, its own
+ * payload type numbers and the payloads untouched, without the packets it cannot decode.
+ */
+static void check_relayed(QueueTransport *qt, const RelayPacket *sent, int nsent, uint32_t ssrc) {
+	const RelayPacket *prev = NULL;
+	uint16_t prev_seq = 0;
+	uint32_t prev_ts = 0;
+	mblk_t *m;
+	int i;
+
+	for (i = 0; i < nsent; i++) {
+		rtp_header_t *rtp;
+		int expected_pt, k, errors = 0;
+		if (sent[i].payload_type == 3) continue;
+		m = getq(&qt->sent);
+		CU_ASSERT_TRUE_FATAL(m != NULL);
+		rtp = (rtp_header_t *)m->b_rptr;
+		CU_ASSERT_EQUAL_FATAL((int)(m->b_wptr - m->b_rptr), RTP_FIXED_HEADER_SIZE + PACKET_SAMPLES);
+		CU_ASSERT_EQUAL(ntohl(rtp->ssrc), ssrc);
+		expected_pt = sent[i].payload_type == 8 ? 98 : 0;
+		CU_ASSERT_EQUAL(rtp->paytype, expected_pt);
+		if (prev != NULL) {
+			CU_ASSERT_EQUAL((uint16_t)(ntohs(rtp->seq_number) - prev_seq), 1);
+			CU_ASSERT_EQUAL(ntohl(rtp->timestamp) - prev_ts, sent[i].ts - prev->ts);
+		}
+		for (k = RTP_FIXED_HEADER_SIZE; k < RTP_FIXED_HEADER_SIZE + PACKET_SAMPLES; k++)
+			if (m->b_rptr[k] != (sent[i].seq & 0xFF)) errors++;
+		CU_ASSERT_EQUAL(errors, 0);
+		prev = &sent[i];
+		prev_seq = ntohs(rtp->seq_number);
+		prev_ts = ntohl(rtp->timestamp);
+		freemsg(m);
+	}
+	CU_ASSERT_TRUE(qempty(&qt->sent));
+}
+
+/*a call bridged through two relay legs, the caller's audio being decoded only while a tap is set*/
+static void audio_relay_loopback(void) {
+	RtpProfile *caller_profile = rtp_profile_new("caller");
+	RtpProfile *callee_profile = rtp_profile_new("callee");
+	RelayPacket sent[3 * RELAY_PACKETS];
+	QueueTransport caller, callee;
+	AudioStream *caller_leg, *callee_leg;
+	struct stat st;
+	MSFilter *tap;
+	uint64_t start_time = wall_clock_ms();
+	int rate = 8000;
+	uint32_t ssrc;
+
+	rtp_profile_set_payload(caller_profile, 0, &payload_type_pcmu8000);
+	rtp_profile_set_payload(caller_profile, 3, &payload_type_gsm);
+	rtp_profile_set_payload(caller_profile, 8, &payload_type_pcma8000);
+	rtp_profile_set_payload(callee_profile, 0, &payload_type_pcmu8000);
+	rtp_profile_set_payload(callee_profile, 98, &payload_type_pcma8000);
+	queue_transport_init(&caller);
+	queue_transport_init(&callee);
+	caller_leg = start_relay_leg(caller_profile, 50070, &caller);
+	callee_leg = start_relay_leg(callee_profile, 50080, &callee);
+	audio_stream_relay_link(caller_leg, callee_leg);
+	ssrc = rtp_session_get_send_ssrc(callee_leg->ms.session);
+	CU_ASSERT_NOT_EQUAL(ssrc, RELAY_CALLER_SSRC);
+	/*let the receivers flush their sockets before anything is sent*/
+	ms_usleep(100000);
+
+	send_to_relay(&caller, sent, 0, RELAY_PACKETS, start_time);
+	CU_ASSERT_EQUAL(wait_for_relayed(&callee, RELAY_PACKETS - 1), RELAY_PACKETS - 1);
+	/*nothing was decoded so far*/
+	CU_ASSERT_PTR_NULL(caller_leg->ms.decoder);
+	CU_ASSERT_PTR_NULL(callee_leg->ms.decoder);
+
+	tap = ms_filter_new(MS_FILE_REC_ID);
+	ms_filter_call_method(tap, MS_FILTER_SET_SAMPLE_RATE, &rate);
+	ms_filter_call_method(tap, MS_FILE_REC_OPEN, "relay_tap.wav");
+	ms_filter_call_method_noarg(tap, MS_FILE_REC_START);
+	CU_ASSERT_EQUAL(audio_stream_relay_set_tap(caller_leg, tap), 0);
+	CU_ASSERT_PTR_NOT_NULL(caller_leg->ms.decoder);
+	CU_ASSERT_PTR_NULL(callee_leg->ms.decoder);
+	/*packets waiting when the graph changes are flushed, as when the stream starts*/
+	ms_usleep(100000);
+	/*the decoder follows the switch to PCMA*/
+	send_to_relay(&caller, sent, RELAY_PACKETS, 13, start_time);
+	CU_ASSERT_EQUAL(wait_for_relayed(&callee, RELAY_PACKETS - 1 + 13), RELAY_PACKETS - 1 + 13);
+	ms_usleep(100000);
+	CU_ASSERT_EQUAL(audio_stream_relay_set_tap(caller_leg, NULL), 0);
+	CU_ASSERT_PTR_NULL(caller_leg->ms.decoder);
+	ms_filter_call_method_noarg(tap, MS_FILE_REC_CLOSE);
+	ms_filter_destroy(tap);
+	CU_ASSERT_EQUAL(stat("relay_tap.wav", &st), 0);
+	CU_ASSERT_EQUAL((int)st.st_size, 13 * PACKET_SAMPLES * 2 + 44); /*44 bytes of wav header*/
+	unlink("relay_tap.wav");
+	ms_usleep(100000);
+
+	/*forwarding goes on once the tap is removed, through payload type changes*/
+	send_to_relay(&caller, sent, RELAY_PACKETS + 13, 5, start_time);
+	CU_ASSERT_EQUAL(wait_for_relayed(&callee, RELAY_PACKETS - 1 + 17), RELAY_PACKETS - 1 + 17);
+
+	audio_stream_relay_unlink(caller_leg, callee_leg);
+	audio_stream_stop(caller_leg);
+	audio_stream_stop(callee_leg);
+	check_relayed(&callee, sent, RELAY_PACKETS + 18, ssrc);
+	queue_transport_uninit(&caller);
+	queue_transport_uninit(&callee);
+	rtp_profile_destroy(caller_profile);
+	rtp_profile_destroy(callee_profile);
+}
+
+#define RTCP_REMOTE_SSRC 0x5E4D
+#define RTCP_RR_SIZE 32 /*with one report block*/
+#define RTCP_XR_RRT_BLOCK_SIZE 12 /*receiver reference time block, that the parser must skip*/
+#define RTCP_XR_TEST_SIZE (RTCP_XR_HEADER_SIZE + RTCP_XR_RRT_BLOCK_SIZE + RTCP_XR_VOIP_METRICS_BLOCK_SIZE)
+
+static uint8_t *put_u16(uint8_t *p, uint16_t val) {
+	p[0] = val >> 8;
+	p[1] = val & 0xFF;
+	return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t val) {
+	p = put_u16(p, val >> 16);
+	return put_u16(p, val & 0xFFFF);
+}
+
+static uint8_t *put_rtcp_header(uint8_t *p, int count, int packet_type, int size) {
+	p[0] = 0x80 | count;
+	p[1] = packet_type;
+	return put_u16(p + 2, size / 4 - 1);
+}
+
+/*
+ * A compound RR and XR from the remote end about the stream of source_ssrc. The report block counters are all set
+ * to k, the XR has a receiver reference time block before the VoIP metrics one.
+ */
+static mblk_t *make_rtcp_rr_xr(uint32_t source_ssrc, uint32_t k) {
+	mblk_t *m = allocb(RTCP_RR_SIZE + RTCP_XR_TEST_SIZE, 0);
+	uint8_t *p = m->b_wptr;
+
+	p = put_rtcp_header(p, 1, RTCP_RR, RTCP_RR_SIZE);
+	p = put_u32(p, RTCP_REMOTE_SSRC);
+	p = put_u32(p, source_ssrc);
+	p = put_u32(p, ((k & 0xFF) << 24) | (k & 0xFFFFFF)); /*fraction lost and cumulative loss*/
+	p = put_u32(p, k); /*extended highest sequence number*/
+	p = put_u32(p, k); /*interarrival jitter*/
+	p = put_u32(p, 0); /*no SR received: no round trip time*/
+	p = put_u32(p, 0);
+
+	p = put_rtcp_header(p, 0, RTCP_XR, RTCP_XR_TEST_SIZE);
+	p = put_u32(p, RTCP_REMOTE_SSRC);
+	p[0] = 4;
+	p[1] = 0;
+	p = put_u16(p + 2, RTCP_XR_RRT_BLOCK_SIZE / 4 - 1);
+	p = put_u32(p, 0xDEADBEEF);
+	p = put_u32(p, 0xDEADBEEF);
+	p[0] = RTCP_XR_VOIP_METRICS_BLOCK;
+	p[1] = 0;
+	p = put_u16(p + 2, RTCP_XR_VOIP_METRICS_BLOCK_SIZE / 4 - 1);
+	p = put_u32(p, source_ssrc);
+	p[0] = 5; /*loss rate*/
+	p[1] = 6; /*discard rate*/
+	p[2] = 213; /*burst density*/
+	p[3] = 2; /*gap density*/
+	p = put_u16(p + 4, 60); /*burst duration*/
+	p = put_u16(p, 1050); /*gap duration*/
+	p = put_u16(p, 42); /*round trip delay*/
+	p = put_u16(p, 80); /*end system delay*/
+	p[0] = RTCP_XR_UNAVAILABLE; /*signal level*/
+	p[1] = (uint8_t)-60; /*noise level*/
+	p[2] = RTCP_XR_UNAVAILABLE; /*RERL*/
+	p[3] = 16; /*Gmin*/
+	p[4] = 93; /*R factor*/
+	p[5] = RTCP_XR_UNAVAILABLE; /*external R factor*/
+	p[6] = 42; /*MOS-LQ*/
+	p[7] = 41; /*MOS-CQ*/
+	p[8] = 0x30; /*receiver configuration*/
+	p[9] = 0;
+	p = put_u16(p + 10, 60); /*jitter buffer nominal delay*/
+	p = put_u16(p, 200); /*maximum*/
+	p = put_u16(p, 200); /*absolute maximum*/
+	m->b_wptr = p;
+	return m;
+}
+
+static void check_voip_metrics(const rtcp_voip_metrics_t *metrics, uint32_t source_ssrc) {
+	CU_ASSERT_EQUAL(metrics->ssrc, source_ssrc);
+	CU_ASSERT_EQUAL(metrics->loss_rate, 5);
+	CU_ASSERT_EQUAL(metrics->discard_rate, 6);
+	CU_ASSERT_EQUAL(metrics->burst_density, 213);
+	CU_ASSERT_EQUAL(metrics->gap_density, 2);
+	CU_ASSERT_EQUAL(metrics->burst_duration, 60);
+	CU_ASSERT_EQUAL(metrics->gap_duration, 1050);
+	CU_ASSERT_EQUAL(metrics->round_trip_delay, 42);
+	CU_ASSERT_EQUAL(metrics->end_system_delay, 80);
+	CU_ASSERT_EQUAL(metrics->signal_level, RTCP_XR_UNAVAILABLE);
+	CU_ASSERT_EQUAL(metrics->noise_level, -60);
+	CU_ASSERT_EQUAL(metrics->gmin, 16);
+	CU_ASSERT_EQUAL(metrics->r_factor, 93);
+	CU_ASSERT_EQUAL(metrics->mos_lq, 42);
+	CU_ASSERT_EQUAL(metrics->mos_cq, 41);
+	CU_ASSERT_EQUAL(metrics->rx_config, 0x30);
+	CU_ASSERT_EQUAL(metrics->jb_nominal, 60);
+	CU_ASSERT_EQUAL(metrics->jb_maximum, 200);
+	CU_ASSERT_EQUAL(metrics->jb_abs_max, 200);
+}
+
+/*the VoIP metrics block is found after the blocks that are not parsed*/
+static void rtcp_xr_voip_metrics_parse(void) {
+	mblk_t *m = make_rtcp_rr_xr(0x1234, 7);
+	rtcp_voip_metrics_t metrics;
+	const report_block_t *rb;
+
+	CU_ASSERT_TRUE_FATAL(rtcp_is_RR(m));
+	CU_ASSERT_FALSE(rtcp_is_XR(m));
+	rb = rtcp_RR_get_report_block(m, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(rb);
+	CU_ASSERT_EQUAL(report_block_get_ssrc(rb), 0x1234);
+	CU_ASSERT_EQUAL(report_block_get_fraction_lost(rb), 7);
+	CU_ASSERT_EQUAL(report_block_get_cum_packet_loss(rb), 7);
+	CU_ASSERT_TRUE_FATAL(rtcp_next_packet(m));
+	CU_ASSERT_TRUE_FATAL(rtcp_is_XR(m));
+	CU_ASSERT_EQUAL(rtcp_XR_get_ssrc(m), RTCP_REMOTE_SSRC);
+	memset(&metrics, 0, sizeof(metrics));
+	CU_ASSERT_TRUE_FATAL(rtcp_XR_get_voip_metrics(m, &metrics));
+	check_voip_metrics(&metrics, 0x1234);
+	CU_ASSERT_FALSE(rtcp_next_packet(m));
+
+	/*a block running past the end of the packet is not read*/
+	rtcp_rewind(m);
+	rtcp_next_packet(m);
+	m->b_rptr[RTCP_XR_HEADER_SIZE + 3] = 0x20;
+	CU_ASSERT_FALSE(rtcp_XR_get_voip_metrics(m, &metrics));
+	freemsg(m);
+}
+
+/*
+ * The received reports go to the RTCP summary. As long as no event queue wants the packets, the session keeps its
+ * reception buffer, which is the case of an audio stream without bitrate controller.
+ */
+static void rtcp_summary_buffer_reuse(void) {
+	JBParameters jbp;
+	QueueTransport qt, rtcp_qt;
+	RtpSession *session;
+	OrtpEvQueue *evq = ortp_ev_queue_new();
+	AudioStream *stream;
+	rtcp_summary_t summary;
+	mblk_t *buffer;
+	OrtpEvent *ev;
+	uint32_t ssrc;
+
+	make_jitter_buffer_params(&jbp, 20, 20, 200);
+	queue_transport_init(&qt);
+	queue_transport_init(&rtcp_qt);
+	session = create_receiving_session(&qt, &jbp);
+	rtp_session_set_transports(session, &qt.tr, &rtcp_qt.tr);
+	ssrc = rtp_session_get_send_ssrc(session);
+	ortp_ev_queue_ignore_type(evq, ORTP_EVENT_RTCP_PACKET_RECEIVED, TRUE);
+	rtp_session_register_event_queue(session, evq);
+
+	queue_transport_put(&rtcp_qt, make_rtcp_rr_xr(ssrc, 1));
+	rtp_session_recvm_with_ts(session, 0);
+	rtp_session_get_rtcp_summary(session, &summary);
+	CU_ASSERT_EQUAL(summary.received_packets, 1);
+	CU_ASSERT_TRUE(summary.has_remote_report);
+	CU_ASSERT_EQUAL(summary.remote_fraction_lost, 1);
+	CU_ASSERT_EQUAL(summary.remote_jitter, 1);
+	CU_ASSERT_TRUE_FATAL(summary.has_remote_voip_metrics);
+	check_voip_metrics(&summary.remote_voip_metrics, ssrc);
+	CU_ASSERT_PTR_NULL(ortp_ev_queue_get(evq));
+	buffer = session->rtcp.cached_mp;
+	CU_ASSERT_PTR_NOT_NULL(buffer);
+
+	queue_transport_put(&rtcp_qt, make_rtcp_rr_xr(ssrc, 2));
+	rtp_session_recvm_with_ts(session, PACKET_SAMPLES);
+	rtp_session_get_rtcp_summary(session, &summary);
+	CU_ASSERT_EQUAL(summary.received_packets, 2);
+	CU_ASSERT_EQUAL(summary.remote_cum_packet_loss, 2);
+	CU_ASSERT_PTR_EQUAL(session->rtcp.cached_mp, buffer);
+
+	/*a report about another stream is counted, but does not replace the last one about ours*/
+	queue_transport_put(&rtcp_qt, make_rtcp_rr_xr(ssrc + 1, 3));
+	rtp_session_recvm_with_ts(session, 2 * PACKET_SAMPLES);
+	rtp_session_get_rtcp_summary(session, &summary);
+	CU_ASSERT_EQUAL(summary.received_packets, 3);
+	CU_ASSERT_EQUAL(summary.remote_cum_packet_loss, 2);
+	CU_ASSERT_EQUAL(summary.remote_voip_metrics.ssrc, ssrc);
+
+	/*once a queue wants them, the packets are handed over in events*/
+	ortp_ev_queue_ignore_type(evq, ORTP_EVENT_RTCP_PACKET_RECEIVED, FALSE);
+	queue_transport_put(&rtcp_qt, make_rtcp_rr_xr(ssrc, 4));
+	rtp_session_recvm_with_ts(session, 3 * PACKET_SAMPLES);
+	ev = ortp_ev_queue_get(evq);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ev);
+	CU_ASSERT_EQUAL(ortp_event_get_type(ev), ORTP_EVENT_RTCP_PACKET_RECEIVED);
+	CU_ASSERT_PTR_EQUAL(ortp_event_get_data(ev)->packet, buffer);
+	CU_ASSERT_TRUE(rtcp_is_RR(ortp_event_get_data(ev)->packet));
+	CU_ASSERT_PTR_NOT_EQUAL(session->rtcp.cached_mp, buffer);
+	ortp_event_destroy(ev);
+
+	rtp_session_unregister_event_queue(session, evq);
+	ortp_ev_queue_destroy(evq);
+	rtp_session_destroy(session);
+	queue_transport_uninit(&qt);
+	queue_transport_uninit(&rtcp_qt);
+
+	stream = audio_stream_new(50090, 50091, FALSE);
+	CU_ASSERT_FALSE(ortp_ev_queue_wants_type(stream->ms.evq, ORTP_EVENT_RTCP_PACKET_RECEIVED));
+	CU_ASSERT_TRUE(ortp_ev_queue_wants_type(stream->ms.evq, ORTP_EVENT_STUN_PACKET_RECEIVED));
+	audio_stream_stop(stream);
+}
+
+/*
+ * RFC 3611 4.7.2 with Gmin=16: 40 packets received, 1 lost, 31 received, a burst of 2 lost, 1 received and 2 lost,
+ * then 31 received, 1 lost and the rest received. The isolated losses are in the gap, the burst has 4 lost packets
+ * out of 5. Computed by the RFC algorithm: c11=102, c13=2, c14=1, c22=0, c23=1, c33=2.
+ */
+static void rtcp_xr_burst_gap(void) {
+	static const int lost[] = { 40, 72, 73, 75, 76, 108 };
+	JBParameters jbp;
+	QueueTransport qt, rtcp_qt;
+	RtpSession *session;
+	rtcp_summary_t summary;
+	rtcp_voip_metrics_t metrics;
+	mblk_t *m, *report = NULL;
+	int i, j;
+
+	make_jitter_buffer_params(&jbp, 20, 20, 200);
+	queue_transport_init(&qt);
+	queue_transport_init(&rtcp_qt);
+	session = create_receiving_session(&qt, &jbp);
+	rtp_session_set_transports(session, &qt.tr, &rtcp_qt.tr);
+	rtp_session_enable_rtcp_xr_voip_metrics(session, TRUE);
+
+	/*the first report is sent once 5 s of stream are received*/
+	for (i = 0, j = 0; i < 300; i++) {
+		if (j < (int)(sizeof(lost) / sizeof(lost[0])) && lost[j] == i) j++;
+		else putq(&qt.q, make_rtp_packet(0, (uint16_t)i, i * PACKET_SAMPLES, 0x1234, PACKET_SAMPLES));
+		while ((m = rtp_session_recvm_with_ts(session, i * PACKET_SAMPLES)) != NULL) freemsg(m);
+	}
+	while ((m = getq(&rtcp_qt.sent)) != NULL) {
+		if (report) freemsg(report);
+		report = m;
+	}
+	CU_ASSERT_PTR_NOT_NULL_FATAL(report);
+	CU_ASSERT_TRUE(rtcp_is_RR(report));
+	while (!rtcp_is_XR(report) && rtcp_next_packet(report));
+	CU_ASSERT_TRUE_FATAL(rtcp_is_XR(report));
+	CU_ASSERT_EQUAL(rtcp_XR_get_ssrc(report), rtp_session_get_send_ssrc(session));
+	CU_ASSERT_TRUE_FATAL(rtcp_XR_get_voip_metrics(report, &metrics));
+	CU_ASSERT_EQUAL(metrics.ssrc, 0x1234);
+	/*the loss rate follows the cumulative loss of the report block*/
+	CU_ASSERT_TRUE(metrics.loss_rate > 0);
+	CU_ASSERT_EQUAL(metrics.gmin, 16);
+	/*p32=c32/(c31+c32+c33)=0.2, p23=1-c22/(c22+c23)=1, burst density=256*p23/(p23+p32)*/
+	CU_ASSERT_EQUAL(metrics.burst_density, 213);
+	/*c14/(c11+c14)*/
+	CU_ASSERT_EQUAL(metrics.gap_density, 2);
+	/*(c11+c14+c13)/c13 packets of 20 ms*/
+	CU_ASSERT_EQUAL(metrics.gap_duration, 1050);
+	/*ctotal/c13 packets minus the gap duration*/
+	CU_ASSERT_EQUAL(metrics.burst_duration, 60);
+
+	/*what is sent is kept in the summary*/
+	rtp_session_get_rtcp_summary(session, &summary);
+	CU_ASSERT_TRUE(summary.has_local_voip_metrics);
+	CU_ASSERT_EQUAL(memcmp(&summary.local_voip_metrics, &metrics, sizeof(metrics)), 0);
+	freemsg(report);
+	rtp_session_destroy(session);
+	queue_transport_uninit(&qt);
+	queue_transport_uninit(&rtcp_qt);
+}
+
+#define SUMMARY_REPORTS 20000
+
+typedef struct _SummaryWriter {
+	RtpSession *session;
+	QueueTransport *rtcp_qt;
+	uint32_t ssrc;
+} SummaryWriter;
+
+/*the k-th report sets all the counters of the summary to k, as a stream thread does it*/
+static void *summary_writer_run(void *data) {
+	SummaryWriter *w = (SummaryWriter *)data;
+	uint32_t k;
+	for (k = 1; k <= SUMMARY_REPORTS; k++) {
+		queue_transport_put(w->rtcp_qt, make_rtcp_rr_xr(w->ssrc, k));
+		rtp_session_recvm_with_ts(w->session, k * PACKET_SAMPLES);
+	}
+	return NULL;
+}
+
+/*copies taken while the reports are processed in another thread are never half updated*/
+static void rtcp_summary_concurrent_copy(void) {
+	JBParameters jbp;
+	QueueTransport qt, rtcp_qt;
+	SummaryWriter writer;
+	ms_thread_t thread;
+	rtcp_summary_t summary;
+	uint64_t last = 0;
+	int copies = 0, torn = 0;
+
+	make_jitter_buffer_params(&jbp, 20, 20, 200);
+	queue_transport_init(&qt);
+	queue_transport_init(&rtcp_qt);
+	writer.session = create_receiving_session(&qt, &jbp);
+	rtp_session_set_transports(writer.session, &qt.tr, &rtcp_qt.tr);
+	writer.rtcp_qt = &rtcp_qt;
+	writer.ssrc = rtp_session_get_send_ssrc(writer.session);
+
+	ms_thread_create(&thread, NULL, summary_writer_run, &writer);
+	do {
+		rtp_session_get_rtcp_summary(writer.session, &summary);
+		copies++;
+		if (summary.received_packets == 0) continue;
+		if (summary.remote_cum_packet_loss != summary.received_packets
+			|| summary.remote_jitter != summary.received_packets
+			|| summary.remote_ext_high_seq != summary.received_packets
+			|| summary.remote_fraction_lost != (summary.received_packets & 0xFF)
+			|| summary.received_packets < last)
+			torn++;
+		last = summary.received_packets;
+	} while (last < SUMMARY_REPORTS);
+	ms_thread_join(thread, NULL);
+	CU_ASSERT_EQUAL(torn, 0);
+	CU_ASSERT_TRUE(copies > 1);
+	rtp_session_get_rtcp_summary(writer.session, &summary);
+	CU_ASSERT_EQUAL(summary.received_packets, SUMMARY_REPORTS);
+	rtp_session_destroy(writer.session);
+	queue_transport_uninit(&qt);
+	queue_transport_uninit(&rtcp_qt);
+}
+
+
+test_t rtp_tests[] = {
+	{ "jitter-buffer-legacy-params", jitter_buffer_legacy_params },
+	{ "jitter-buffer-target-percentile", jitter_buffer_target_percentile },
+	{ "jitter-buffer-target-bounds", jitter_buffer_target_bounds },
+	{ "audio-relay-loopback", audio_relay_loopback },
+	{ "rtcp-xr-voip-metrics-parse", rtcp_xr_voip_metrics_parse },
+	{ "rtcp-summary-buffer-reuse", rtcp_summary_buffer_reuse },
+	{ "rtcp-xr-burst-gap", rtcp_xr_burst_gap },
+	{ "rtcp-summary-concurrent-copy", rtcp_summary_concurrent_copy }
+};
+
+test_suite_t rtp_test_suite = {
+	"RTP",
+	rtp_tester_init,
+	rtp_tester_cleanup,
+	sizeof(rtp_tests) / sizeof(rtp_tests[0]),
+	rtp_tests
+};
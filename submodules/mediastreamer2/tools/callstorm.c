@@ -0,0 +1,157 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006  Simon MORLAT (simon.morlat@linphone.org)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+/*
+ * Call storm benchmark: sets up and tears down audio streams back to back, in batches
+ * of concurrent calls, and reports the calls per second and the mean setup time with the
+ * streams allocated from the heap, from a pool of per-stream arenas, and instantiated from
+ * a graph template filled between batches.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/mediastream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct storm_config {
+	int calls;
+	int concurrent;
+	int port_origin;
+	int payload;
+	size_t arena_size;
+};
+
+struct storm_result {
+	double calls_per_sec;
+	double setup_ms;
+	size_t max_arena_used;
+	int overflows;
+};
+
+static double elapsed_ms(const ortpTimeSpec *begin, const ortpTimeSpec *end){
+	return (end->tv_sec-begin->tv_sec)*1000.0+(end->tv_nsec-begin->tv_nsec)/1000000.0;
+}
+
+static int start_call(const struct storm_config *cfg, AudioStreamTemplate *tpl, int port, AudioStream **stream){
+	if (tpl!=NULL){
+		*stream=audio_stream_template_instantiate(tpl,port,port+1,FALSE);
+		if (*stream==NULL) return -1;
+		return audio_stream_template_start(*stream,"127.0.0.1",port+1000,"127.0.0.1",port+1001);
+	}
+	*stream=audio_stream_new(port,port+1,FALSE);
+	return audio_stream_start_full(*stream,&av_profile,"127.0.0.1",port+1000,"127.0.0.1",port+1001,
+		cfg->payload,60,NULL,NULL,NULL,NULL,FALSE);
+}
+
+static int run_storm(const struct storm_config *cfg, AudioStreamTemplate *tpl, struct storm_result *res){
+	AudioStream **streams=ms_new0(AudioStream*,cfg->concurrent);
+	ortpTimeSpec begin,end,setup_begin,setup_end;
+	double setup_ms=0;
+	int done=0;
+	int i;
+
+	memset(res,0,sizeof(*res));
+	ortp_get_cur_time(&begin);
+	while(done<cfg->calls){
+		int batch=cfg->calls-done<cfg->concurrent ? cfg->calls-done : cfg->concurrent;
+		if (tpl!=NULL) audio_stream_template_fill(tpl,batch);
+		for(i=0;i<batch;i++){
+			int err;
+			ortp_get_cur_time(&setup_begin);
+			err=start_call(cfg,tpl,cfg->port_origin+2*i,&streams[i]);
+			ortp_get_cur_time(&setup_end);
+			setup_ms+=elapsed_ms(&setup_begin,&setup_end);
+			if (err!=0){
+				fprintf(stderr,"Could not start stream %i\n",done+i);
+				ms_free(streams);
+				return -1;
+			}
+		}
+		for(i=0;i<batch;i++){
+			if (streams[i]->arena){
+				size_t used=ortp_arena_get_used(streams[i]->arena);
+				if (used>res->max_arena_used) res->max_arena_used=used;
+				res->overflows+=ortp_arena_get_overflows(streams[i]->arena);
+			}
+			audio_stream_stop(streams[i]);
+		}
+		done+=batch;
+	}
+	ortp_get_cur_time(&end);
+	res->calls_per_sec=done*1000.0/elapsed_ms(&begin,&end);
+	res->setup_ms=setup_ms/done;
+	ms_free(streams);
+	return 0;
+}
+
+static void usage(const char *prog){
+	fprintf(stderr,"Usage: %s [--calls <n>] [--concurrent <n>] [--port <first local port>] [--payload <pt>] [--arena-size <KB>]\n",prog);
+	exit(-1);
+}
+
+int main(int argc, char *argv[]){
+	struct storm_config cfg={2000,50,20000,0,256*1024};
+	struct storm_config warmup;
+	struct storm_result heap,arena,templ;
+	AudioStreamTemplate *tpl;
+	int i;
+
+	for(i=1;i<argc;i++){
+		if (i+1==argc) usage(argv[0]);
+		if (strcmp(argv[i],"--calls")==0) cfg.calls=atoi(argv[++i]);
+		else if (strcmp(argv[i],"--concurrent")==0) cfg.concurrent=atoi(argv[++i]);
+		else if (strcmp(argv[i],"--port")==0) cfg.port_origin=atoi(argv[++i]);
+		else if (strcmp(argv[i],"--payload")==0) cfg.payload=atoi(argv[++i]);
+		else if (strcmp(argv[i],"--arena-size")==0) cfg.arena_size=atoi(argv[++i])*1024;
+		else usage(argv[0]);
+	}
+	if (cfg.calls<=0 || cfg.concurrent<=0) usage(argv[0]);
+
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_ERROR|ORTP_FATAL);
+	ms_init();
+
+	/*warm up: first use of each codec and of the sockets*/
+	warmup=cfg;
+	warmup.calls=cfg.concurrent;
+	if (run_storm(&warmup,NULL,&heap)!=0) return -1;
+
+	if (run_storm(&cfg,NULL,&heap)!=0) return -1;
+	tpl=audio_stream_template_new(&av_profile,cfg.payload,60,NULL,NULL,FALSE,AUDIO_STREAM_FEATURE_ALL);
+	if (tpl==NULL || run_storm(&cfg,tpl,&templ)!=0) return -1;
+	audio_stream_template_destroy(tpl);
+	if (ortp_arena_pool_init(cfg.concurrent,cfg.arena_size)!=0) return -1;
+	if (run_storm(&cfg,NULL,&arena)!=0) return -1;
+	ortp_arena_pool_uninit();
+
+	printf("%i calls, %i concurrent\n",cfg.calls,cfg.concurrent);
+	printf("heap:     %8.1f calls/s, %6.3f ms per setup\n",heap.calls_per_sec,heap.setup_ms);
+	printf("template: %8.1f calls/s, %6.3f ms per setup\n",templ.calls_per_sec,templ.setup_ms);
+	printf("arenas:   %8.1f calls/s, %6.3f ms per setup, %u KB used at most per stream, %i allocations overflowed to the heap\n",
+		arena.calls_per_sec,arena.setup_ms,(unsigned int)(arena.max_arena_used/1024),arena.overflows);
+
+	ms_exit();
+	ortp_exit();
+	return 0;
+}
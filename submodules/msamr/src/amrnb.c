@@ -61,8 +61,15 @@ static const int amr_frame_sizes[] = {
 
 #define OUT_MAX_SIZE 32
 
+extern bool_t msamr_codec_load(void);
+
 static void dec_init(MSFilter *f) {
-    f->data = Decoder_Interface_init();
+    f->data = msamr_codec_load() ? Decoder_Interface_init() : NULL;
+}
+
+static void dec_preprocess(MSFilter *f) {
+    if (f->data == NULL)
+        ms_error("MSAmrDec: no AMR codec available, incoming audio is discarded");
 }
 
 #define toc_get_f(toc) ((toc) >> 7)
@@ -87,6 +94,10 @@ static void dec_process(MSFilter *f) {
     int toclen;
     uint8_t tmp[32];
 
+    if (f->data == NULL) {
+        ms_queue_flush(f->inputs[0]);
+        return;
+    }
     while ((im = ms_queue_get(f->inputs[0])) != NULL) {
         int sz = msgdsize(im);
         int i;
@@ -132,7 +143,8 @@ static void dec_process(MSFilter *f) {
 }
 
 static void dec_uninit(MSFilter *f) {
-    Decoder_Interface_exit(f->data);
+    if (f->data != NULL)
+        Decoder_Interface_exit(f->data);
 }
 
 MSFilterDesc amrnb_dec_desc = {
@@ -144,6 +156,7 @@ MSFilterDesc amrnb_dec_desc = {
     .ninputs = 1,
     .noutputs = 1,
     .init = dec_init,
+    .preprocess = dec_preprocess,
     .process = dec_process,
     .uninit = dec_uninit
 };
@@ -175,7 +188,9 @@ static void enc_uninit(MSFilter *f) {
 
 static void enc_preprocess(MSFilter *f) {
     EncState *s = (EncState*) f->data;
-    s->enc = Encoder_Interface_init(s->dtx);
+    s->enc = msamr_codec_load() ? Encoder_Interface_init(s->dtx) : NULL;
+    if (s->enc == NULL)
+        ms_error("MSAmrEnc: no AMR codec available, outgoing audio is discarded");
 }
 
 static void enc_process(MSFilter *f) {
@@ -186,6 +201,10 @@ static void enc_process(MSFilter *f) {
     uint8_t tmp[OUT_MAX_SIZE];
     int16_t samples[buff_size];
 
+    if (s->enc == NULL) {
+        ms_queue_flush(f->inputs[0]);
+        return;
+    }
     while ((im = ms_queue_get(f->inputs[0])) != NULL) {
         ms_bufferizer_put(s->mb, im);
     }
@@ -220,7 +239,8 @@ static void enc_process(MSFilter *f) {
 
 static void enc_postprocess(MSFilter *f) {
     EncState *s = (EncState*) f->data;
-    Encoder_Interface_exit(s->enc);
+    if (s->enc != NULL)
+        Encoder_Interface_exit(s->enc);
     s->enc = NULL;
     ms_bufferizer_flush(s->mb);
 }
@@ -32,20 +32,66 @@ extern MSFilterDesc amrwb_enc_desc;
 #endif
 
 #ifdef USE_ANDROID_AMR
+#include <pthread.h>
+#include <unistd.h>
+
 int opencore_amr_wrapper_init(const char **missing);
-#endif
 
-void libmsamr_init(){
-#ifdef HAVE_AMRNB
-#ifdef USE_ANDROID_AMR
+static pthread_once_t android_amr_once=PTHREAD_ONCE_INIT;
+static bool_t android_amr_loaded=FALSE;
+
+static void android_amr_load(void){
 	const char *missing=NULL;
 	if (opencore_amr_wrapper_init(&missing)==-1){
 		ms_error("Could not find AMR codec of android, no AMR support possible (missing symbol=%s)",missing);
 		return;
 	}
+	android_amr_loaded=TRUE;
+}
+
+#ifdef __LP64__
+#define ANDROID_AMR_LIBRARY "/system/lib64/libstagefright.so"
+#else
+#define ANDROID_AMR_LIBRARY "/system/lib/libstagefright.so"
+#endif
+
+/*
+ * Tells at registration whether the AMR filters can work, without paying for the loading of the library: the AMR
+ * codec is not advertised, nor created, when the library is not there.
+ */
+static bool_t android_amr_available(void){
+	if (access(ANDROID_AMR_LIBRARY,R_OK)!=0){
+		ms_error("Could not find AMR codec of android (%s), no AMR support possible",ANDROID_AMR_LIBRARY);
+		return FALSE;
+	}
+	return TRUE;
+}
 #endif
-        ms_filter_register(&amrnb_dec_desc);
-	ms_filter_register(&amrnb_enc_desc);
+
+/*
+ * Android's AMR codec is in libstagefright, whose loading is a large part of the startup time: it is only
+ * loaded when the first AMR filter needs it, the filters being registered only if the library is present. If it
+ * could not be loaded anyway (a symbol missing), every AMR filter reports an error when its graph starts and
+ * outputs nothing.
+ */
+bool_t msamr_codec_load(void){
+#ifdef USE_ANDROID_AMR
+	pthread_once(&android_amr_once,android_amr_load);
+	return android_amr_loaded;
+#else
+	return TRUE;
+#endif
+}
+
+void libmsamr_init(){
+#ifdef HAVE_AMRNB
+#ifdef USE_ANDROID_AMR
+	if (android_amr_available())
+#endif
+	{
+		ms_filter_register(&amrnb_dec_desc);
+		ms_filter_register(&amrnb_enc_desc);
+	}
 #endif
 #ifdef HAVE_AMRWB
         ms_filter_register(&amrwb_dec_desc);
@@ -79,6 +79,14 @@ LOCAL_STATIC_LIBRARIES += libsrtp-static
 endif
 LOCAL_C_INCLUDES += $(SRTP_C_INCLUDE)
 LOCAL_CFLAGS += -DHAVE_SRTP -DHAVE_SRTP_SHUTDOWN
+ifeq ($(BUILD_SRTP_OPENSSL), 1)
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SHARED_LIBRARIES += liblincrypto
+else
+LOCAL_STATIC_LIBRARIES += libcrypto-static
+endif
+LOCAL_CFLAGS += -DHAVE_SRTP_OPENSSL
+endif
 endif #SRTP
 
 LOCAL_C_INCLUDES += \
@@ -92,12 +92,15 @@ ORTP_PUBLIC OrtpEvent *ortp_event_dup(OrtpEvent *ev);
 typedef struct OrtpEvQueue{
 	queue_t q;
 	ortp_mutex_t mutex;
+	unsigned long ignored_types; /* bit mask of the event types not queued */
 } OrtpEvQueue;
 
 ORTP_PUBLIC OrtpEvQueue * ortp_ev_queue_new(void);
 ORTP_PUBLIC void ortp_ev_queue_destroy(OrtpEvQueue *q);
 ORTP_PUBLIC OrtpEvent * ortp_ev_queue_get(OrtpEvQueue *q);
 ORTP_PUBLIC void ortp_ev_queue_flush(OrtpEvQueue * qp);
+ORTP_PUBLIC void ortp_ev_queue_ignore_type(OrtpEvQueue *q, OrtpEventType type, bool_t yesno);
+#define ortp_ev_queue_wants_type(q,type) (((q)->ignored_types & (1UL<<(type)))==0)
 
 #ifdef __cplusplus
 }
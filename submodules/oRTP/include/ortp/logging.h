@@ -67,6 +67,27 @@ ORTP_PUBLIC void ortp_logv(int level, const char *fmt, va_list args);
 ORTP_PUBLIC void ortp_set_log_level_mask(int levelmask);
 ORTP_PUBLIC int ortp_get_log_level_mask(void);
 
+/*
+ * Asynchronous logging: messages are formatted into fixed size records of a lock-free queue
+ * and a background thread hands them over to the log handler (or the log file). Logging threads
+ * never allocate nor wait for the output; when the queue is full, messages are dropped and counted.
+ * Fatal messages are still output synchronously.
+ */
+ORTP_PUBLIC int ortp_async_logging_start(void);
+/*outputs the messages still queued, and goes back to synchronous logging*/
+ORTP_PUBLIC void ortp_async_logging_stop(void);
+
+/*maximum number of messages per second from a given call site (format string) in asynchronous mode, 0 for no limit*/
+ORTP_PUBLIC void ortp_set_log_rate_limit(int max_per_second);
+
+typedef struct _OrtpLogStats{
+	unsigned int queued; /*messages output by the background thread*/
+	unsigned int dropped; /*messages lost because the queue was full*/
+	unsigned int rate_limited; /*messages discarded by the per call site rate limit*/
+}OrtpLogStats;
+
+ORTP_PUBLIC void ortp_get_log_stats(OrtpLogStats *stats);
+
 #ifdef __GNUC__
 #define CHECK_FORMAT_ARGS(m,n) __attribute__((format(printf,m,n)))
 #else
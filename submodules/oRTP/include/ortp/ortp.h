@@ -82,10 +82,16 @@ ORTP_PUBLIC void ortp_exit(void);
 /*statistics api*/
 /****************/
 
+/*
+ * The global statistics are kept in per thread shards, so that sessions running in different threads
+ * do not write to the same counters. ortp_get_global_stats_snapshot() adds them up.
+ * ortp_global_stats is only updated by ortp_get_global_stats().
+ */
 extern rtp_stats_t ortp_global_stats;
 
 ORTP_PUBLIC void ortp_global_stats_reset(void);
 ORTP_PUBLIC rtp_stats_t *ortp_get_global_stats(void);
+ORTP_PUBLIC void ortp_get_global_stats_snapshot(rtp_stats_t *stats);
 
 ORTP_PUBLIC void ortp_global_stats_display(void);
 ORTP_PUBLIC void rtp_stats_display(const rtp_stats_t *stats, const char *header);
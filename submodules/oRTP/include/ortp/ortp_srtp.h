@@ -55,6 +55,11 @@ enum ortp_srtp_crypto_suite_t {
 	NO_CIPHER_SHA1_80
 };
 
+enum ortp_srtp_crypto_backend_t {
+	ORTP_SRTP_BACKEND_BUILTIN, /*libsrtp's portable C code*/
+	ORTP_SRTP_BACKEND_OPENSSL /*OpenSSL's AES and SHA1, selected by ortp_srtp_init() when compiled with HAVE_SRTP_OPENSSL*/
+};
+
 ORTP_PUBLIC err_status_t ortp_srtp_init(void);
 ORTP_PUBLIC err_status_t ortp_srtp_create(srtp_t *session, const srtp_policy_t *policy);
 ORTP_PUBLIC err_status_t ortp_srtp_dealloc(srtp_t session);
@@ -68,6 +73,8 @@ ORTP_PUBLIC srtp_t ortp_srtp_create_configure_session(enum ortp_srtp_crypto_suit
 
 ORTP_PUBLIC void ortp_srtp_shutdown(void);
 
+ORTP_PUBLIC err_status_t ortp_srtp_set_crypto_backend(enum ortp_srtp_crypto_backend_t backend);
+
 #ifdef __cplusplus
 }
 #endif
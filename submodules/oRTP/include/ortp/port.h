@@ -279,6 +279,28 @@ typedef struct _OrtpMemoryFunctions{
 
 void ortp_set_memory_functions(OrtpMemoryFunctions *functions);
 
+/*
+ * Arenas: a pool of fixed size regions, allocated a few at a time when all the existing ones are in use
+ * and kept until the pool is uninitialized.
+ * While an arena is the calling thread's current one, ortp_malloc() bump allocates
+ * from it and ortp_free() of arena memory does nothing: everything is given back at
+ * once by ortp_arena_release(). When the arena is full ortp_malloc() falls back to the heap.
+ * Memory taken from an arena must not outlive its release.
+ */
+typedef struct _OrtpArena OrtpArena;
+
+/*to be called before any arena is used, count is the most arenas the pool grows to, returns -1 on allocation failure*/
+ORTP_PUBLIC int ortp_arena_pool_init(int count, size_t arena_size);
+ORTP_PUBLIC void ortp_arena_pool_uninit(void);
+/*returns NULL if the pool is not initialized or all its arenas are in use*/
+ORTP_PUBLIC OrtpArena *ortp_arena_get(void);
+ORTP_PUBLIC void ortp_arena_release(OrtpArena *arena);
+/*sets the calling thread's current arena (NULL for the heap), returns the previous one*/
+ORTP_PUBLIC OrtpArena *ortp_arena_set_current(OrtpArena *arena);
+/*bytes bump allocated so far, and number of allocations that did not fit and went to the heap*/
+ORTP_PUBLIC size_t ortp_arena_get_used(const OrtpArena *arena);
+ORTP_PUBLIC int ortp_arena_get_overflows(const OrtpArena *arena);
+
 #define ortp_new(type,count)	(type*)ortp_malloc(sizeof(type)*(count))
 #define ortp_new0(type,count)	(type*)ortp_malloc0(sizeof(type)*(count))
 
@@ -293,6 +315,15 @@ ORTP_PUBLIC int ortp_file_exist(const char *pathname);
 
 ORTP_PUBLIC void ortp_get_cur_time(ortpTimeSpec *ret);
 
+/*
+ * Tick time: a thread processing packets periodically samples the time of day once at the beginning of
+ * each cycle with ortp_tick_time_update(), and the packet processing reads it with ortp_get_tick_timeofday()
+ * instead of the clock. In threads without a tick time, ortp_get_tick_timeofday() reads the clock.
+ */
+ORTP_PUBLIC void ortp_tick_time_update(void);
+ORTP_PUBLIC void ortp_tick_time_disable(void);
+ORTP_PUBLIC void ortp_get_tick_timeofday(struct timeval *tv);
+
 /* portable named pipes  and shared memory*/
 #if !defined(_WIN32_WCE)
 #ifdef WIN32
@@ -41,7 +41,8 @@ typedef enum {
     RTCP_RR	= 201,
     RTCP_SDES	= 202,
     RTCP_BYE	= 203,
-    RTCP_APP	= 204
+    RTCP_APP	= 204,
+    RTCP_XR	= 207
 } rtcp_type_t;
  
  
@@ -196,6 +197,71 @@ typedef struct rtcp_app{
 	char name[4];
 } rtcp_app_t;
 
+/* RTCP extended reports (RFC 3611) */
+
+#define RTCP_XR_VOIP_METRICS_BLOCK 7
+#define RTCP_XR_HEADER_SIZE 8 /* common header and SSRC of the sender */
+#define RTCP_XR_VOIP_METRICS_BLOCK_SIZE 36
+#define RTCP_XR_UNAVAILABLE 127 /* for signal and noise levels, RERL, R factors and MOS */
+
+/* VoIP metrics report block, in host byte order */
+typedef struct rtcp_voip_metrics
+{
+	uint32_t ssrc; /* the source these metrics are about */
+	uint8_t loss_rate; /* fraction of the packets lost since the beginning of the reception, in 1/256 */
+	uint8_t discard_rate; /* fraction of the packets discarded for arriving too late, in 1/256 */
+	uint8_t burst_density; /* fraction of the packets lost or discarded within bursts, in 1/256 */
+	uint8_t gap_density; /* fraction of the packets lost or discarded within gaps, in 1/256 */
+	uint16_t burst_duration; /* mean duration of the bursts, in ms */
+	uint16_t gap_duration; /* mean duration of the gaps, in ms */
+	uint16_t round_trip_delay; /* in ms */
+	uint16_t end_system_delay; /* in ms */
+	int8_t signal_level; /* in dBm */
+	int8_t noise_level; /* in dBm */
+	uint8_t rerl; /* residual echo return loss, in dB */
+	uint8_t gmin; /* minimum number of packets received between two losses for them to be in a gap */
+	uint8_t r_factor;
+	uint8_t ext_r_factor;
+	uint8_t mos_lq; /* in tenths */
+	uint8_t mos_cq; /* in tenths */
+	uint8_t rx_config; /* packet loss concealment and jitter buffer type */
+	uint16_t jb_nominal; /* in ms */
+	uint16_t jb_maximum; /* in ms */
+	uint16_t jb_abs_max; /* in ms */
+} rtcp_voip_metrics_t;
+
+/*
+ * Summary of the RTCP traffic of a session, updated in place by the thread processing the session as reports
+ * are sent and received. The application gets a copy with rtp_session_get_rtcp_summary().
+ */
+typedef struct rtcp_summary
+{
+	uint64_t received_packets; /* compound RTCP packets received */
+	struct timeval last_received; /* reception date of the last one */
+	/* the remote sender, from its last SR */
+	uint32_t remote_ssrc;
+	uint32_t remote_packet_count;
+	uint32_t remote_octet_count;
+	/* the reception of our stream by the remote end, from the last report block about it */
+	bool_t has_remote_report;
+	uint8_t remote_fraction_lost; /* in 1/256 */
+	uint32_t remote_cum_packet_loss;
+	uint32_t remote_ext_high_seq;
+	uint32_t remote_jitter; /* in stream clock units */
+	float rtt; /* round trip time in seconds, 0 while unknown */
+	/* the reception of the remote stream, from the last report block sent */
+	bool_t has_local_report;
+	uint8_t local_fraction_lost;
+	uint32_t local_cum_packet_loss;
+	uint32_t local_ext_high_seq;
+	uint32_t local_jitter;
+	/* VoIP metrics received from the remote end about our stream, and sent about the remote stream */
+	bool_t has_remote_voip_metrics;
+	rtcp_voip_metrics_t remote_voip_metrics;
+	bool_t has_local_voip_metrics;
+	rtcp_voip_metrics_t local_voip_metrics;
+} rtcp_summary_t;
+
 struct _RtpSession;
 ORTP_PUBLIC void rtp_session_rtcp_process_send(struct _RtpSession *s);
 ORTP_PUBLIC void rtp_session_rtcp_process_recv(struct _RtpSession *s);
@@ -245,6 +311,12 @@ ORTP_PUBLIC void rtcp_APP_get_name(const mblk_t *m, char *name);
 /* retrieve the data. when returning, data points directly into the mblk_t */
 ORTP_PUBLIC void rtcp_APP_get_data(const mblk_t *m, uint8_t **data, int *len);
 
+/*XR accessors */
+ORTP_PUBLIC bool_t rtcp_is_XR(const mblk_t *m);
+ORTP_PUBLIC uint32_t rtcp_XR_get_ssrc(const mblk_t *m);
+/* finds the VoIP metrics block of the extended report, returns FALSE if there is none */
+ORTP_PUBLIC bool_t rtcp_XR_get_voip_metrics(const mblk_t *m, rtcp_voip_metrics_t *metrics);
+
 
 #ifdef __cplusplus
 }
@@ -61,6 +61,8 @@ typedef struct _JBParameters{
 	int max_packets; /**< max number of packets allowed to be queued in the jitter buffer */
 } JBParameters;
 
+#define ORTP_JC_HISTOGRAM_BINS 64 /* number of bins of the delay histogram used by the delay targeting mode */
+
 typedef struct _JitterControl
 {
 	unsigned int count;
@@ -77,10 +79,33 @@ typedef struct _JitterControl
 	uint64_t cum_jitter_buffer_size; /*in timestamp units*/
 	unsigned int cum_jitter_buffer_count; /*used for computation of jitter buffer size*/
 	int clock_rate;
+	int min_size; /* lowest jitt_comp allowed by the delay targeting mode, in miliseconds */
+	int max_size; /* highest jitt_comp allowed by the delay targeting mode, in miliseconds, -1 for no limit */
+	int min_size_ts;
+	int max_size_ts;
+	int target_percentile; /* percentile of late packets to be covered by the jitter buffer, 0 to disable delay targeting */
+	int target_jitt_comp_ts; /* jitt_comp computed from the delay histogram, in timestamp unit */
+	int histogram_step_ts; /* width of a bin of the delay histogram, in timestamp unit */
+	unsigned int histogram_total;
+	unsigned int histogram[ORTP_JC_HISTOGRAM_BINS];
 	bool_t adaptive;
 	bool_t enabled;
+	bool_t time_stretching; /* adapt_jitt_comp_ts is only moved by rtp_session_shift_jitter_compensation() */
 } JitterControl;
 
+/*
+ * Loss and discard events of the received stream, in the form used by the RTCP XR VoIP metrics
+ * to compute the burst and gap densities and durations (RFC 3611 section 4.7.2).
+ */
+typedef struct _RtcpXrBurstStats
+{
+	uint32_t c11,c13,c14,c22,c23,c33; /* transitions between the states of the Markov model */
+	uint32_t pkt; /* packets received since the last loss or discard */
+	uint32_t lost; /* losses and discards in the current burst */
+	uint32_t packet_duration_ts; /* timestamp increment between two consecutive packets */
+	uint32_t last_ts; /* timestamp of the highest sequence number received */
+} RtcpXrBurstStats;
+
 typedef struct _WaitPoint
 {
 	ortp_mutex_t lock;
@@ -97,6 +122,7 @@ typedef struct _RtpTransport
 	int  (*t_recvfrom)(struct _RtpTransport *t, mblk_t *msg, int flags, struct sockaddr *from, socklen_t *fromlen);
 	struct _RtpSession *session;//<back pointer to the owning session, set by oRTP
 	void  (*t_close)(struct _RtpTransport *transport, void *userData);
+	int tailroom; /*bytes the transport appends to the packets it sends, reserved by rtp_session_create_packet()*/
 }  RtpTransport;
 
 typedef struct _OrtpNetworkSimulatorParams{
@@ -163,6 +189,7 @@ typedef struct _RtpStream
 	int rcv_socket_size;
 	int ssrc_changed_thres;
 	jitter_stats_t jitter_stats;
+	RtcpXrBurstStats xr_burst;
 }RtpStream;
 
 typedef struct _RtcpStream
@@ -171,6 +198,7 @@ typedef struct _RtcpStream
 	int sockfamily;
 	struct _RtpTransport *tr; 
 	mblk_t *cached_mp;
+	mblk_t *report_mp; /* reused for the compound reports sent automatically */
 	int loc_port;
 #ifdef ORTP_INET6
 	struct sockaddr_storage rem_addr;
@@ -238,6 +266,9 @@ struct _RtpSession
 	mblk_t *current_tev;		/* the pending telephony events */
 	mblk_t *sd;
 	queue_t contributing_sources;
+	mblk_t *sdes_packet; /* SDES packet made of sd and the contributing sources, built again when they change */
+	rtcp_summary_t rtcp_summary;
+	volatile unsigned int rtcp_summary_seq; /* odd while rtcp_summary is being updated */
 	unsigned int lost_packets_test_vector;
 	unsigned int interarrival_jitter_test_vector;
 	unsigned int delay_test_vector;
@@ -282,6 +313,11 @@ ORTP_PUBLIC bool_t rtp_session_jitter_buffer_enabled(const RtpSession *session);
 ORTP_PUBLIC void rtp_session_set_jitter_buffer_params(RtpSession *session, const JBParameters *par);
 ORTP_PUBLIC void rtp_session_get_jitter_buffer_params(RtpSession *session, JBParameters *par);
 
+ORTP_PUBLIC void rtp_session_set_jitter_buffer_target_percentile(RtpSession *session, int percentile);
+ORTP_PUBLIC void rtp_session_enable_jitter_buffer_time_stretching(RtpSession *session, bool_t enabled);
+ORTP_PUBLIC int rtp_session_get_jitter_compensation_error(const RtpSession *session);
+ORTP_PUBLIC void rtp_session_shift_jitter_compensation(RtpSession *session, int ts_shift);
+
 /*deprecated jitter control functions*/
 ORTP_PUBLIC void rtp_session_set_jitter_compensation(RtpSession *session, int milisec);
 ORTP_PUBLIC void rtp_session_enable_adaptive_jitter_compensation(RtpSession *session, bool_t val);
@@ -339,6 +375,12 @@ ORTP_PUBLIC void rtp_session_enable_rtcp(RtpSession *session, bool_t yesno);
 
 ORTP_PUBLIC void rtp_session_set_rtcp_report_interval(RtpSession *session, int value_ms);
 
+ORTP_PUBLIC void rtp_session_enable_rtcp_emitted_events(RtpSession *session, bool_t yesno);
+
+ORTP_PUBLIC void rtp_session_enable_rtcp_xr_voip_metrics(RtpSession *session, bool_t yesno);
+
+ORTP_PUBLIC void rtp_session_get_rtcp_summary(const RtpSession *session, rtcp_summary_t *summary);
+
 ORTP_PUBLIC void rtp_session_set_ssrc_changed_threshold(RtpSession *session, int numpackets);
 
 /*low level recv and send functions */
@@ -346,6 +388,7 @@ ORTP_PUBLIC mblk_t * rtp_session_recvm_with_ts (RtpSession * session, uint32_t u
 ORTP_PUBLIC mblk_t * rtp_session_create_packet(RtpSession *session,int header_size, const uint8_t *payload, int payload_size);
 ORTP_PUBLIC mblk_t * rtp_session_create_packet_with_data(RtpSession *session, uint8_t *payload, int payload_size, void (*freefn)(void*));
 ORTP_PUBLIC mblk_t * rtp_session_create_packet_in_place(RtpSession *session,uint8_t *buffer, int size, void (*freefn)(void*) );
+ORTP_PUBLIC int rtp_session_get_send_tailroom(const RtpSession *session);
 ORTP_PUBLIC int rtp_session_sendm_with_ts (RtpSession * session, mblk_t *mp, uint32_t userts);
 /* high level recv and send functions */
 ORTP_PUBLIC int rtp_session_recv_with_ts(RtpSession *session, uint8_t *buffer, int len, uint32_t ts, int *have_more);
@@ -399,6 +442,15 @@ ORTP_PUBLIC void rtp_session_add_contributing_source(RtpSession *session, uint32
 ORTP_PUBLIC void rtp_session_remove_contributing_sources(RtpSession *session, uint32_t csrc);
 ORTP_PUBLIC mblk_t* rtp_session_create_rtcp_sdes_packet(RtpSession *session);
 
+/*
+ * RTCP send batching: a thread processing many sessions periodically enables it once, then the RTCP packets
+ * its sessions send on their sockets are queued and sent together by ortp_rtcp_batch_flush(), which must be
+ * called before any of these sessions is destroyed.
+ */
+ORTP_PUBLIC void ortp_rtcp_batch_enable(void);
+ORTP_PUBLIC void ortp_rtcp_batch_flush(void);
+ORTP_PUBLIC void ortp_rtcp_batch_disable(void);
+
 ORTP_PUBLIC void rtp_session_get_last_recv_time(RtpSession *session, struct timeval *tv);
 ORTP_PUBLIC int rtp_session_bye(RtpSession *session, const char *reason);
 
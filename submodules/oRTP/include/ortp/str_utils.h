@@ -128,6 +128,10 @@ ORTP_PUBLIC int msgdsize(const mblk_t *mp);
 /* concatenates all fragment of a complex message*/
 ORTP_PUBLIC void msgpullup(mblk_t *mp,int len);
 
+/* returns the number of bytes that can be written in place after the data of a message: 0 unless it
+is a single fragment that owns its buffer and does not share it */
+ORTP_PUBLIC int msgtailroom(const mblk_t *mp);
+
 /* duplicates a single message, but with buffer included */
 ORTP_PUBLIC mblk_t *copyb(mblk_t *mp);
 
@@ -82,9 +82,18 @@ OrtpEvQueue * ortp_ev_queue_new(){
 	OrtpEvQueue *q=ortp_new(OrtpEvQueue,1);
 	qinit(&q->q);
 	ortp_mutex_init(&q->mutex,NULL);
+	q->ignored_types=0;
 	return q;
 }
 
+/**
+ * Events of the given type are not put in the queue, the sessions do not copy them for it.
+**/
+void ortp_ev_queue_ignore_type(OrtpEvQueue *q, OrtpEventType type, bool_t yesno){
+	if (yesno) q->ignored_types|=(1UL<<type);
+	else q->ignored_types&=~(1UL<<type);
+}
+
 void ortp_ev_queue_flush(OrtpEvQueue * qp){
 	OrtpEvent *ev;
 	while((ev=ortp_ev_queue_get(qp))!=NULL){
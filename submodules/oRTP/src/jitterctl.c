@@ -34,6 +34,12 @@
 #define JC_BETA 0.01
 #define JC_GAMMA (JC_BETA)
 
+/* delay targeting: each packet adds JC_HISTOGRAM_UNIT to its bin, and every JC_HISTOGRAM_DECAY_PERIOD packets all
+ bins are scaled by 15/16, which gives a memory of about 256 packets (5 seconds at 20ms ptime)*/
+#define JC_HISTOGRAM_UNIT 1024
+#define JC_HISTOGRAM_DECAY_PERIOD 16
+#define JC_HISTOGRAM_STEP_MS 4
+
 #include "jitterctl.h"
 
 void jitter_control_init(JitterControl *ctl, int base_jiitt_time, PayloadType *payload){
@@ -45,14 +51,23 @@ void jitter_control_init(JitterControl *ctl, int base_jiitt_time, PayloadType *p
 	ctl->slide=0;
 	ctl->cum_jitter_buffer_count=0;
 	ctl->cum_jitter_buffer_size=0;
-	if (base_jiitt_time!=-1) ctl->jitt_comp = base_jiitt_time;
+	if (base_jiitt_time!=-1){
+		ctl->jitt_comp = base_jiitt_time;
+		/*a new nominal size brings back the legacy bounds, rtp_session_set_jitter_buffer_params() may change them*/
+		ctl->min_size=base_jiitt_time;
+		ctl->max_size=-1;
+	}
 	ctl->clock_rate=8000;
 	/* convert in timestamp unit: */
 	if (payload!=NULL){
 		jitter_control_set_payload(ctl,payload);
 	}
 	ctl->adapt_jitt_comp_ts=ctl->jitt_comp_ts;
+	ctl->target_jitt_comp_ts=ctl->jitt_comp_ts;
 	ctl->corrective_slide=0;
+	memset(ctl->histogram,0,sizeof(ctl->histogram));
+	ctl->histogram_total=0;
+	jitter_control_update_limits(ctl);
 }
 
 void jitter_control_enable_adaptive(JitterControl *ctl, bool_t val){
@@ -65,7 +80,19 @@ void jitter_control_set_payload(JitterControl *ctl, PayloadType *pt){
 	/*make correction by not less than 10ms */
 	ctl->corrective_step=(int) (0.01 * (float)pt->clock_rate);
 	ctl->adapt_jitt_comp_ts=ctl->jitt_comp_ts;
+	ctl->target_jitt_comp_ts=ctl->jitt_comp_ts;
 	ctl->clock_rate=pt->clock_rate;
+	jitter_control_update_limits(ctl);
+}
+
+void jitter_control_update_limits(JitterControl *ctl){
+	int min_size=MIN(ctl->min_size,ctl->jitt_comp);
+	ctl->min_size_ts=(int) (((double) min_size / 1000.0) * (ctl->clock_rate));
+	if (ctl->max_size>0)
+		ctl->max_size_ts=MAX(ctl->min_size_ts,(int) (((double) ctl->max_size / 1000.0) * (ctl->clock_rate)));
+	else ctl->max_size_ts=-1;
+	ctl->histogram_step_ts=(JC_HISTOGRAM_STEP_MS*ctl->clock_rate)/1000;
+	if (ctl->histogram_step_ts<=0) ctl->histogram_step_ts=1;
 }
 
 
@@ -100,6 +127,38 @@ void jitter_control_update_size(JitterControl *ctl, queue_t *q){
 	ctl->cum_jitter_buffer_size+=(uint32_t)(newest_ts-oldest_ts);
 }
 
+/*
+ Delay targeting: the lateness of each packet (relative to slide) is accumulated in an exponentially
+ forgetting histogram. The target jitter compensation is the lateness that covers target_percentile % of the
+ packets, bounded by min_size and max_size. Unlike the legacy algorithm it can go below jitt_comp.
+*/
+static void jitter_control_update_target(JitterControl *ctl, double late){
+	int bin=(int)(late/(double)ctl->histogram_step_ts);
+	unsigned int threshold,cum=0;
+	int i,target;
+
+	if (bin>=ORTP_JC_HISTOGRAM_BINS) bin=ORTP_JC_HISTOGRAM_BINS-1;
+	ctl->histogram[bin]+=JC_HISTOGRAM_UNIT;
+	ctl->histogram_total+=JC_HISTOGRAM_UNIT;
+	if (ctl->count%JC_HISTOGRAM_DECAY_PERIOD!=0) return;
+
+	ctl->histogram_total=0;
+	for(i=0;i<ORTP_JC_HISTOGRAM_BINS;++i){
+		ctl->histogram[i]-=ctl->histogram[i]>>4;
+		ctl->histogram_total+=ctl->histogram[i];
+	}
+	threshold=(unsigned int)(((uint64_t)ctl->histogram_total*ctl->target_percentile)/100);
+	for(i=0;i<ORTP_JC_HISTOGRAM_BINS-1;++i){
+		cum+=ctl->histogram[i];
+		if (cum>=threshold) break;
+	}
+	/*upper edge of the bin, plus half a corrective step to absorb the granularity of the caller's ticks*/
+	target=(i+1)*ctl->histogram_step_ts+ctl->corrective_step/2;
+	if (target<ctl->min_size_ts) target=ctl->min_size_ts;
+	if (ctl->max_size_ts>0 && target>ctl->max_size_ts) target=ctl->max_size_ts;
+	ctl->target_jitt_comp_ts=target;
+}
+
 /*
  The algorithm computes two values:
 	slide: an average of difference between the expected and the socket-received timestamp
@@ -128,7 +187,15 @@ void jitter_control_new_packet(JitterControl *ctl, uint32_t packet_ts, uint32_t
 	ctl->olddiff=diff;
 	ctl->count++;
 	if (ctl->adaptive){
-		if (ctl->count%50==0) {
+		if (ctl->target_percentile>0){
+			jitter_control_update_target(ctl,gap);
+			if (!ctl->time_stretching && ctl->count%50==0){
+				/*no one to smooth the changes: move by one corrective step, packets are skipped or held*/
+				int err=ctl->target_jitt_comp_ts-ctl->adapt_jitt_comp_ts;
+				if (err>ctl->corrective_step) ctl->adapt_jitt_comp_ts+=ctl->corrective_step;
+				else if (err<-ctl->corrective_step) ctl->adapt_jitt_comp_ts-=ctl->corrective_step;
+			}
+		}else if (ctl->count%50==0) {
 			ctl->adapt_jitt_comp_ts=(int) MAX(ctl->jitt_comp_ts,2*ctl->jitter);
 			//jitter_control_dump_stats(ctl);
 		}
@@ -188,18 +255,69 @@ bool_t rtp_session_jitter_buffer_enabled(const RtpSession *session){
 }
 
 void rtp_session_set_jitter_buffer_params(RtpSession *session, const JBParameters *par){
-	/* FIXME min_size and max_size to be implemented */
 	rtp_session_set_jitter_compensation(session,par->nom_size);
+	/* min_size and max_size are only used by the delay targeting mode, see rtp_session_set_jitter_buffer_target_percentile()*/
+	session->rtp.jittctl.min_size=par->min_size;
+	session->rtp.jittctl.max_size=par->max_size;
+	jitter_control_update_limits(&session->rtp.jittctl);
 	jitter_control_enable_adaptive(&session->rtp.jittctl,par->adaptive);
 	session->rtp.max_rq_size=par->max_packets;
 }
 
 void rtp_session_get_jitter_buffer_params(RtpSession *session, JBParameters *par){
 	int nom_size=session->rtp.jittctl.jitt_comp;
-	par->min_size=nom_size;
+	par->min_size=session->rtp.jittctl.min_size;
 	par->nom_size=nom_size;
-	par->max_size=-1;
+	par->max_size=session->rtp.jittctl.max_size;
 	par->adaptive=session->rtp.jittctl.adaptive;
 	par->max_packets=session->rtp.max_rq_size;
 }
 
+/**
+ * Enables the delay targeting mode of the adaptive jitter buffer.
+ * Instead of growing with the measured jitter only, the jitter compensation follows the lateness that
+ * covers the given percentage of received packets, within the min_size and max_size given by
+ * rtp_session_set_jitter_buffer_params(). The adaptive mode must be enabled too.
+ *
+ * @param session a RtpSession
+ * @param percentile the percentage of packets that shall arrive in time (typically 95), 0 to disable.
+**/
+void rtp_session_set_jitter_buffer_target_percentile(RtpSession *session, int percentile){
+	JitterControl *ctl=&session->rtp.jittctl;
+	if (percentile<0) percentile=0;
+	if (percentile>100) percentile=100;
+	ctl->target_percentile=percentile;
+	memset(ctl->histogram,0,sizeof(ctl->histogram));
+	ctl->histogram_total=0;
+	jitter_control_update_limits(ctl);
+}
+
+/**
+ * Tells the jitter buffer that the application compensates delay changes by time stretching the decoded
+ * signal. The jitter compensation is then no longer changed by skipping or holding packets: the
+ * application reads rtp_session_get_jitter_compensation_error() and reports the number of samples it
+ * added or removed with rtp_session_shift_jitter_compensation().
+**/
+void rtp_session_enable_jitter_buffer_time_stretching(RtpSession *session, bool_t enabled){
+	session->rtp.jittctl.time_stretching=enabled;
+}
+
+/**
+ * Returns the difference between the targeted and the current jitter compensation, in timestamp unit.
+ * A positive value means that the playout delay shall grow.
+ * It is always 0 when the delay targeting mode is not active.
+**/
+int rtp_session_get_jitter_compensation_error(const RtpSession *session){
+	const JitterControl *ctl=&session->rtp.jittctl;
+	if (!ctl->adaptive || ctl->target_percentile==0) return 0;
+	return ctl->target_jitt_comp_ts-ctl->adapt_jitt_comp_ts;
+}
+
+/**
+ * Moves the current jitter compensation by ts_shift timestamp units, positive to increase the playout delay.
+ * To be called when the application has inserted (positive) or removed (negative) this amount of
+ * signal after decoding.
+**/
+void rtp_session_shift_jitter_compensation(RtpSession *session, int ts_shift){
+	session->rtp.jittctl.adapt_jitt_comp_ts+=ts_shift;
+}
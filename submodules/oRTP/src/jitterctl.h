@@ -33,6 +33,7 @@ void jitter_control_enable_adaptive(JitterControl *ctl, bool_t val);
 void jitter_control_new_packet(JitterControl *ctl, uint32_t packet_ts, uint32_t cur_str_ts);
 #define jitter_control_adaptive_enabled(ctl) ((ctl)->adaptive)
 void jitter_control_set_payload(JitterControl *ctl, PayloadType *pt);
+void jitter_control_update_limits(JitterControl *ctl);
 void jitter_control_update_corrective_slide(JitterControl *ctl);
 void jitter_control_update_size(JitterControl *ctl, queue_t *q);
 float jitter_control_compute_mean_size(JitterControl *ctl);
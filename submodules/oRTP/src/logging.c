@@ -19,6 +19,7 @@
 
 
 #include "ortp/logging.h"
+#include <time.h>
 
 
 static FILE *__log_file=0;
@@ -36,11 +37,19 @@ static void __ortp_logv_out(OrtpLogLevel lev, const char *fmt, va_list args);
 
 OrtpLogFunc ortp_logv_out=__ortp_logv_out;
 
+static bool_t async_log_running=FALSE;
+static OrtpLogFunc async_log_sink=NULL;
+
 /**
  *@param func: your logging function, compatible with the OrtpLogFunc prototype.
  *
 **/
 void ortp_set_log_handler(OrtpLogFunc func){
+	if (async_log_running){
+		/*the background thread will output to the new handler*/
+		async_log_sink=func;
+		return;
+	}
 	ortp_logv_out=func;
 }
 
@@ -159,3 +168,208 @@ static void __ortp_logv_out(OrtpLogLevel lev, const char *fmt, va_list args){
 	fflush(__log_file);
 	ortp_free(msg);
 }
+
+/*
+ * Asynchronous logging.
+ * The queue is a bounded multiple producers / single consumer array of fixed size records
+ * (Dmitry Vyukov's algorithm): each record has a sequence number telling whether it is free for the
+ * producer at a given position or ready for the consumer. Producers reserve a position with a compare
+ * and swap and format the message in place, the background thread outputs the records in order.
+ */
+
+#define LOG_QUEUE_SIZE 512 /*must be a power of two*/
+#define LOG_RECORD_SIZE 256
+#define LOG_RATE_SLOTS 256
+#define LOG_DRAIN_INTERVAL 10 /*ms*/
+
+#if defined(_MSC_VER)
+#define log_cas(ptr,oldval,newval) (InterlockedCompareExchange((volatile LONG*)(ptr),(LONG)(newval),(LONG)(oldval))==(LONG)(oldval))
+#define log_inc(ptr) InterlockedIncrement((volatile LONG*)(ptr))
+#define log_barrier() MemoryBarrier()
+#define log_sleep(ms) Sleep(ms)
+#else
+#define log_cas(ptr,oldval,newval) __sync_bool_compare_and_swap((ptr),(oldval),(newval))
+#define log_inc(ptr) __sync_fetch_and_add((ptr),1)
+#define log_barrier() __sync_synchronize()
+#define log_sleep(ms) usleep((ms)*1000)
+#endif
+
+typedef struct _LogRecord{
+	volatile unsigned int seq;
+	OrtpLogLevel level;
+	char msg[LOG_RECORD_SIZE];
+}LogRecord;
+
+/*
+ * Per call site counters, the call site being identified by its format string.
+ * They are updated without synchronization: concurrent updates may lose a count, which only makes
+ * the limit approximate.
+ */
+typedef struct _LogRateSlot{
+	const char *fmt;
+	time_t window;
+	unsigned int count;
+	unsigned int suppressed;
+}LogRateSlot;
+
+static LogRecord log_queue[LOG_QUEUE_SIZE];
+static volatile unsigned int log_enqueue_pos=0;
+static unsigned int log_dequeue_pos=0;
+static LogRateSlot log_rate_slots[LOG_RATE_SLOTS];
+static int log_rate_limit=0;
+static volatile unsigned int log_queued=0;
+static volatile unsigned int log_dropped=0;
+static volatile unsigned int log_rate_limited=0;
+static volatile bool_t async_log_thread_running=FALSE;
+static ortp_thread_t async_log_thread;
+
+/*returns the number of messages suppressed since the previous one let through, or -1 to drop this one*/
+static int log_rate_check(const char *fmt){
+	LogRateSlot *slot;
+	time_t now;
+	int suppressed;
+
+	if (log_rate_limit<=0) return 0;
+	slot=&log_rate_slots[(((intptr_t)fmt)>>4)&(LOG_RATE_SLOTS-1)];
+	now=time(NULL);
+	if (slot->fmt!=fmt || slot->window!=now){
+		suppressed=(slot->fmt==fmt) ? (int)slot->suppressed : 0;
+		slot->fmt=fmt;
+		slot->window=now;
+		slot->count=1;
+		slot->suppressed=0;
+		return suppressed;
+	}
+	if (++slot->count>(unsigned int)log_rate_limit){
+		slot->suppressed++;
+		log_inc(&log_rate_limited);
+		return -1;
+	}
+	return 0;
+}
+
+static LogRecord *log_queue_reserve(unsigned int *pos){
+	LogRecord *rec;
+	unsigned int p=log_enqueue_pos;
+	for(;;){
+		int diff;
+		rec=&log_queue[p&(LOG_QUEUE_SIZE-1)];
+		diff=(int)(rec->seq-p);
+		if (diff==0){
+			if (log_cas(&log_enqueue_pos,p,p+1)) break;
+			p=log_enqueue_pos;
+		}else if (diff<0){
+			/*the record is still owned by the consumer: the queue is full*/
+			return NULL;
+		}else p=log_enqueue_pos;
+	}
+	*pos=p;
+	return rec;
+}
+
+static void log_queue_commit(LogRecord *rec, unsigned int pos){
+	log_barrier();
+	rec->seq=pos+1;
+}
+
+static void call_log_sink(OrtpLogFunc sink, OrtpLogLevel lev, const char *fmt, ...){
+	va_list args;
+	va_start(args,fmt);
+	sink(lev,fmt,args);
+	va_end(args);
+}
+
+static void async_logv_out(OrtpLogLevel lev, const char *fmt, va_list args){
+	LogRecord *rec;
+	unsigned int pos;
+	int suppressed;
+	int len;
+
+	if (lev==ORTP_FATAL){
+		/*the process is about to abort, the queue would never be output*/
+		if (async_log_sink) async_log_sink(lev,fmt,args);
+		return;
+	}
+	suppressed=log_rate_check(fmt);
+	if (suppressed<0) return;
+	rec=log_queue_reserve(&pos);
+	if (rec==NULL){
+		log_inc(&log_dropped);
+		return;
+	}
+	rec->level=lev;
+	len=vsnprintf(rec->msg,sizeof(rec->msg),fmt,args);
+	if (len<0 || len>=(int)sizeof(rec->msg)) len=sizeof(rec->msg)-1;
+	rec->msg[len]='\0';
+	if (suppressed>0)
+		snprintf(rec->msg+len,sizeof(rec->msg)-len," [%i similar messages suppressed]",suppressed);
+	log_queue_commit(rec,pos);
+}
+
+/*called from the background thread only, or once it is stopped*/
+static int async_log_drain(void){
+	int count=0;
+	for(;;){
+		LogRecord *rec=&log_queue[log_dequeue_pos&(LOG_QUEUE_SIZE-1)];
+		if ((int)(rec->seq-(log_dequeue_pos+1))<0) break;
+		log_barrier();
+		if (async_log_sink) call_log_sink(async_log_sink,rec->level,"%s",rec->msg);
+		log_barrier();
+		rec->seq=log_dequeue_pos+LOG_QUEUE_SIZE;
+		log_dequeue_pos++;
+		log_inc(&log_queued);
+		count++;
+	}
+	return count;
+}
+
+static void *async_log_thread_func(void *unused){
+	while(async_log_thread_running){
+		if (async_log_drain()==0) log_sleep(LOG_DRAIN_INTERVAL);
+	}
+	return NULL;
+}
+
+/**
+ * Starts the background logging thread: from now on, messages are output asynchronously to the current
+ * log handler.
+ * @return 0 on success, -1 if it could not be started.
+**/
+int ortp_async_logging_start(void){
+	unsigned int i;
+	if (async_log_running) return 0;
+	log_enqueue_pos=0;
+	log_dequeue_pos=0;
+	for(i=0;i<LOG_QUEUE_SIZE;i++) log_queue[i].seq=i;
+	memset(log_rate_slots,0,sizeof(log_rate_slots));
+	async_log_sink=ortp_logv_out;
+	async_log_thread_running=TRUE;
+	if (ortp_thread_create(&async_log_thread,NULL,async_log_thread_func,NULL)!=0){
+		async_log_thread_running=FALSE;
+		ortp_error("Could not start the logging thread, logging synchronously.");
+		return -1;
+	}
+	async_log_running=TRUE;
+	log_barrier();
+	ortp_logv_out=async_logv_out;
+	return 0;
+}
+
+void ortp_async_logging_stop(void){
+	if (!async_log_running) return;
+	ortp_logv_out=async_log_sink;
+	async_log_running=FALSE;
+	async_log_thread_running=FALSE;
+	ortp_thread_join(async_log_thread,NULL);
+	async_log_drain();
+}
+
+void ortp_set_log_rate_limit(int max_per_second){
+	log_rate_limit=max_per_second;
+}
+
+void ortp_get_log_stats(OrtpLogStats *stats){
+	stats->queued=log_queued;
+	stats->dropped=log_dropped;
+	stats->rate_limited=log_rate_limited;
+}
@@ -26,9 +26,36 @@
 #include "ortp/ortp.h"
 #include <inttypes.h>
 #include "scheduler.h"
+#include "utils.h"
 
 rtp_stats_t ortp_global_stats;
 
+/*
+ * Global statistics shards: a thread takes a free shard the first time it updates the global statistics,
+ * and gives it back when it exits, with its counts, for the next thread. Shards are never freed, there
+ * are as many as threads ever updating statistics at the same time.
+ */
+#define STATS_CACHE_LINE 64
+
+typedef struct _StatsShard{
+	struct _StatsShard *next;
+	bool_t owned;
+	char pad_before[STATS_CACHE_LINE];
+	rtp_stats_t stats;
+	char pad_after[STATS_CACHE_LINE];
+}StatsShard;
+
+static StatsShard *stats_shards=NULL;
+static ortp_mutex_t stats_shards_lock;
+static bool_t stats_shards_initialized=FALSE;
+#ifdef WIN32
+static DWORD stats_shard_key=FLS_OUT_OF_INDEXES;
+#else
+static pthread_key_t stats_shard_key;
+#endif
+
+ORTP_THREAD_LOCAL rtp_stats_t *ortp_thread_stats=NULL;
+
 #ifdef ENABLE_MEMCHECK
 int ortp_allocations=0;
 #endif
@@ -71,6 +98,54 @@ static bool_t win32_init_sockets(void){
 }
 #endif
 
+#ifdef WIN32
+static VOID WINAPI stats_shard_release(PVOID data){
+#else
+static void stats_shard_release(void *data){
+#endif
+	StatsShard *shard=(StatsShard*)data;
+	if (shard==NULL) return;
+	ortp_mutex_lock(&stats_shards_lock);
+	shard->owned=FALSE;
+	ortp_mutex_unlock(&stats_shards_lock);
+}
+
+static void stats_shards_init(void){
+	if (stats_shards_initialized) return;
+	ortp_mutex_init(&stats_shards_lock,NULL);
+#ifdef WIN32
+	stats_shard_key=FlsAlloc(stats_shard_release);
+#else
+	pthread_key_create(&stats_shard_key,stats_shard_release);
+#endif
+	stats_shards_initialized=TRUE;
+}
+
+rtp_stats_t *ortp_thread_stats_acquire(void){
+	StatsShard *shard;
+	ortp_mutex_lock(&stats_shards_lock);
+	for(shard=stats_shards;shard!=NULL;shard=shard->next){
+		if (!shard->owned) break;
+	}
+	if (shard==NULL){
+		/*the shard outlives the stream being set up, if any*/
+		OrtpArena *arena=ortp_arena_set_current(NULL);
+		shard=ortp_new0(StatsShard,1);
+		ortp_arena_set_current(arena);
+		shard->next=stats_shards;
+		stats_shards=shard;
+	}
+	shard->owned=TRUE;
+	ortp_mutex_unlock(&stats_shards_lock);
+#ifdef WIN32
+	if (stats_shard_key!=FLS_OUT_OF_INDEXES) FlsSetValue(stats_shard_key,shard);
+#else
+	pthread_setspecific(stats_shard_key,shard);
+#endif
+	ortp_thread_stats=&shard->stats;
+	return ortp_thread_stats;
+}
+
 static int ortp_initialized=0;
 
 /**
@@ -86,6 +161,7 @@ void ortp_init()
 #endif
 
 	av_profile_init(&av_profile);
+	stats_shards_init();
 	ortp_global_stats_reset();
 	init_random_number_generator();
 
@@ -154,7 +230,9 @@ RtpScheduler * ortp_get_scheduler()
 **/
 void ortp_global_stats_display()
 {
-	rtp_stats_display(&ortp_global_stats,"Global statistics");
+	rtp_stats_t stats;
+	ortp_get_global_stats_snapshot(&stats);
+	rtp_stats_display(&stats,"Global statistics");
 #ifdef ENABLE_MEMCHECK	
 	printf("Unfreed allocations: %i\n",ortp_allocations);
 #endif
@@ -180,10 +258,41 @@ void rtp_stats_display(const rtp_stats_t *stats, const char *header) {
 }
 
 void ortp_global_stats_reset(){
+	StatsShard *shard;
+	ortp_mutex_lock(&stats_shards_lock);
+	for(shard=stats_shards;shard!=NULL;shard=shard->next)
+		memset(&shard->stats,0,sizeof(rtp_stats_t));
+	ortp_mutex_unlock(&stats_shards_lock);
 	memset(&ortp_global_stats,0,sizeof(rtp_stats_t));
 }
 
+/**
+ * Adds up the statistics of all threads.
+ * The shards are read while their threads may be updating them: each counter is exact
+ * up to the packets being processed at that time.
+**/
+void ortp_get_global_stats_snapshot(rtp_stats_t *stats){
+	StatsShard *shard;
+	memset(stats,0,sizeof(rtp_stats_t));
+	ortp_mutex_lock(&stats_shards_lock);
+	for(shard=stats_shards;shard!=NULL;shard=shard->next){
+		const rtp_stats_t *s=&shard->stats;
+		stats->packet_sent+=s->packet_sent;
+		stats->sent+=s->sent;
+		stats->recv+=s->recv;
+		stats->hw_recv+=s->hw_recv;
+		stats->packet_recv+=s->packet_recv;
+		stats->outoftime+=s->outoftime;
+		stats->cum_packet_loss+=s->cum_packet_loss;
+		stats->bad+=s->bad;
+		stats->discarded+=s->discarded;
+		stats->sent_rtcp_packets+=s->sent_rtcp_packets;
+	}
+	ortp_mutex_unlock(&stats_shards_lock);
+}
+
 rtp_stats_t *ortp_get_global_stats(){
+	ortp_get_global_stats_snapshot(&ortp_global_stats);
 	return &ortp_global_stats;
 }
 
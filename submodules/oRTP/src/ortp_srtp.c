@@ -37,13 +37,22 @@
 
 #define SRTP_PAD_BYTES (SRTP_MAX_TRAILER_LEN + 4)
 
+/*
+ * srtp writes its trailer after the data: packets built with room for it (see rtp_session_create_packet())
+ * are protected in place, others are first copied into a large enough buffer.
+ */
+static int srtp_prepare_packet(mblk_t *m){
+	int slen=msgdsize(m);
+	if (msgtailroom(m)<SRTP_PAD_BYTES)
+		msgpullup(m,slen+SRTP_PAD_BYTES);
+	return slen;
+}
+
 static int  srtp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
 	srtp_t srtp=(srtp_t)t->data;
 	int slen;
 	err_status_t err;
-	/* enlarge the buffer for srtp to write its data */
-	slen=msgdsize(m);
-	msgpullup(m,slen+SRTP_PAD_BYTES);
+	slen=srtp_prepare_packet(m);
 	err=srtp_protect(srtp,m->b_rptr,&slen);
 	if (err==err_status_ok){
 		return sendto(t->session->rtp.socket,(void*)m->b_rptr,slen,flags,to,tolen);
@@ -86,9 +95,7 @@ static int  srtcp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct soc
 	srtp_t srtp=(srtp_t)t->data;
 	int slen;
 	err_status_t srtp_err;
-	slen=msgdsize(m);
-	/* enlarge the buffer for srtp to write its data */
-	msgpullup(m,slen+SRTP_PAD_BYTES);
+	slen=srtp_prepare_packet(m);
 	srtp_err=srtp_protect_rtcp(srtp,m->b_rptr,&slen);
 	if (srtp_err==err_status_ok){
 		return sendto(t->session->rtcp.socket,(void*)m->b_rptr,slen,flags,to,tolen);
@@ -154,6 +161,7 @@ int srtp_transport_new(srtp_t srtp, RtpTransport **rtpt, RtpTransport **rtcpt ){
 		(*rtpt)->t_getsocket=srtp_getsocket;
 		(*rtpt)->t_sendto=srtp_sendto;
 		(*rtpt)->t_recvfrom=srtp_recvfrom;
+		(*rtpt)->tailroom=SRTP_PAD_BYTES;
 	}
 	if (rtcpt) {
 		(*rtcpt)=ortp_new0(RtpTransport,1);
@@ -161,10 +169,304 @@ int srtp_transport_new(srtp_t srtp, RtpTransport **rtpt, RtpTransport **rtcpt ){
 		(*rtcpt)->t_getsocket=srtcp_getsocket;
 		(*rtcpt)->t_sendto=srtcp_sendto;
 		(*rtcpt)->t_recvfrom=srtcp_recvfrom;
+		(*rtcpt)->tailroom=SRTP_PAD_BYTES;
 	}
 	return 0;
 }
 
+/*libsrtp's portable implementations*/
+extern cipher_type_t aes_icm;
+extern auth_type_t hmac;
+
+#ifdef HAVE_SRTP_OPENSSL
+/*
+ * AES-ICM and HMAC-SHA1 backed by OpenSSL, registered in place of libsrtp's portable C implementations:
+ * OpenSSL's AES is assembly (and uses AES-NI/ARMv8 crypto instructions when the version in use supports them),
+ * its SHA1 as well. libsrtp checks both against its own test vectors before accepting them.
+ */
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+static HMAC_CTX *HMAC_CTX_new(void){
+	HMAC_CTX *ctx=(HMAC_CTX*)crypto_alloc(sizeof(HMAC_CTX));
+	if (ctx) HMAC_CTX_init(ctx);
+	return ctx;
+}
+
+static void HMAC_CTX_free(HMAC_CTX *ctx){
+	HMAC_CTX_cleanup(ctx);
+	crypto_free(ctx);
+}
+#endif
+
+/*number of counter blocks encrypted at once*/
+#define OSSL_ICM_BLOCKS 32
+
+typedef struct ossl_aes_icm_ctx{
+	v128_t counter; /*next counter block*/
+	v128_t offset; /*salt*/
+	EVP_CIPHER_CTX *evp;
+	uint8_t keystream[OSSL_ICM_BLOCKS*16];
+	int keystream_len; /*valid bytes in keystream*/
+	int bytes_left; /*unused bytes at the end of keystream*/
+}ossl_aes_icm_ctx_t;
+
+typedef struct ossl_hmac_ctx{
+	HMAC_CTX *ctx;
+}ossl_hmac_ctx_t;
+
+static cipher_type_t ossl_aes_icm;
+static auth_type_t ossl_hmac;
+
+static debug_module_t mod_ossl_aes_icm={0,"aes icm (openssl)"};
+static debug_module_t mod_ossl_hmac={0,"hmac sha-1 (openssl)"};
+
+static err_status_t ossl_aes_icm_alloc(cipher_t **c, int key_len){
+	ossl_aes_icm_ctx_t *icm;
+	/*16, 24 or 32 bytes of key followed by 14 bytes of salt*/
+	if (key_len!=30 && key_len!=38 && key_len!=46)
+		return err_status_bad_param;
+	*c=(cipher_t*)crypto_alloc(sizeof(cipher_t)+sizeof(ossl_aes_icm_ctx_t));
+	if (*c==NULL)
+		return err_status_alloc_fail;
+	memset(*c,0,sizeof(cipher_t)+sizeof(ossl_aes_icm_ctx_t));
+	icm=(ossl_aes_icm_ctx_t*)(*c+1);
+	icm->evp=EVP_CIPHER_CTX_new();
+	if (icm->evp==NULL){
+		crypto_free(*c);
+		*c=NULL;
+		return err_status_alloc_fail;
+	}
+	(*c)->type=&ossl_aes_icm;
+	(*c)->state=icm;
+	(*c)->key_len=key_len;
+	ossl_aes_icm.ref_count++;
+	return err_status_ok;
+}
+
+static err_status_t ossl_aes_icm_dealloc(cipher_t *c){
+	ossl_aes_icm_ctx_t *icm=(ossl_aes_icm_ctx_t*)c->state;
+	EVP_CIPHER_CTX_free(icm->evp);
+	octet_string_set_to_zero((uint8_t*)c,sizeof(cipher_t)+sizeof(ossl_aes_icm_ctx_t));
+	crypto_free(c);
+	ossl_aes_icm.ref_count--;
+	return err_status_ok;
+}
+
+static err_status_t ossl_aes_icm_init(ossl_aes_icm_ctx_t *icm, const uint8_t *key, int key_len, cipher_direction_t dir){
+	const EVP_CIPHER *evp_cipher;
+	int base_key_len=key_len-14;
+
+	switch(base_key_len){
+		case 16: evp_cipher=EVP_aes_128_ecb(); break;
+		case 24: evp_cipher=EVP_aes_192_ecb(); break;
+		case 32: evp_cipher=EVP_aes_256_ecb(); break;
+		default: return err_status_bad_param;
+	}
+	v128_set_to_zero(&icm->counter);
+	v128_set_to_zero(&icm->offset);
+	memcpy(&icm->offset,key+base_key_len,14);
+	memcpy(&icm->counter,key+base_key_len,14);
+	icm->keystream_len=0;
+	icm->bytes_left=0;
+	/*counter mode only ever encrypts the counter blocks, whatever the direction*/
+	if (EVP_EncryptInit_ex(icm->evp,evp_cipher,NULL,key,NULL)!=1)
+		return err_status_init_fail;
+	EVP_CIPHER_CTX_set_padding(icm->evp,0);
+	return err_status_ok;
+}
+
+static err_status_t ossl_aes_icm_set_iv(ossl_aes_icm_ctx_t *icm, void *iv){
+	v128_t *nonce=(v128_t*)iv;
+	v128_xor(&icm->counter,&icm->offset,nonce);
+	icm->keystream_len=0;
+	icm->bytes_left=0;
+	return err_status_ok;
+}
+
+/*fills the keystream with the next blocks, enough for len bytes*/
+static err_status_t ossl_aes_icm_refill(ossl_aes_icm_ctx_t *icm, unsigned int len){
+	int blocks=(len+15)/16;
+	int outl=0;
+	int i;
+
+	if (blocks>OSSL_ICM_BLOCKS) blocks=OSSL_ICM_BLOCKS;
+	for(i=0;i<blocks;i++){
+		memcpy(icm->keystream+i*16,&icm->counter,16);
+		/*the block index is the last 16 bits of the counter*/
+		if (++icm->counter.v8[15]==0) ++icm->counter.v8[14];
+	}
+	if (EVP_EncryptUpdate(icm->evp,icm->keystream,&outl,icm->keystream,blocks*16)!=1 || outl!=blocks*16)
+		return err_status_cipher_fail;
+	icm->keystream_len=outl;
+	icm->bytes_left=outl;
+	return err_status_ok;
+}
+
+static err_status_t ossl_aes_icm_encrypt(ossl_aes_icm_ctx_t *icm, unsigned char *buf, unsigned int *enc_len){
+	unsigned int len=*enc_len;
+	unsigned int blocks_needed;
+	uint8_t *ks;
+	unsigned int n,i;
+
+	/*each iv gives a segment of 2^16 blocks*/
+	blocks_needed=(len>(unsigned int)icm->bytes_left) ? (len-icm->bytes_left+15)/16 : 0;
+	if (blocks_needed+ntohs(icm->counter.v16[7])>0xffff)
+		return err_status_terminus;
+
+	while(len>0){
+		if (icm->bytes_left==0){
+			err_status_t err=ossl_aes_icm_refill(icm,len);
+			if (err!=err_status_ok) return err;
+		}
+		ks=icm->keystream+icm->keystream_len-icm->bytes_left;
+		n=len<(unsigned int)icm->bytes_left ? len : (unsigned int)icm->bytes_left;
+		for(i=0;i+4<=n;i+=4){
+			uint32_t b,k;
+			memcpy(&b,buf+i,4);
+			memcpy(&k,ks+i,4);
+			b^=k;
+			memcpy(buf+i,&b,4);
+		}
+		for(;i<n;i++) buf[i]^=ks[i];
+		buf+=n;
+		len-=n;
+		icm->bytes_left-=n;
+	}
+	return err_status_ok;
+}
+
+static err_status_t ossl_hmac_alloc(auth_t **a, int key_len, int out_len){
+	ossl_hmac_ctx_t *h;
+	if (key_len>20 || out_len>20)
+		return err_status_bad_param;
+	*a=(auth_t*)crypto_alloc(sizeof(auth_t)+sizeof(ossl_hmac_ctx_t));
+	if (*a==NULL)
+		return err_status_alloc_fail;
+	h=(ossl_hmac_ctx_t*)(*a+1);
+	h->ctx=HMAC_CTX_new();
+	if (h->ctx==NULL){
+		crypto_free(*a);
+		*a=NULL;
+		return err_status_alloc_fail;
+	}
+	(*a)->type=&ossl_hmac;
+	(*a)->state=h;
+	(*a)->out_len=out_len;
+	(*a)->key_len=key_len;
+	(*a)->prefix_len=0;
+	ossl_hmac.ref_count++;
+	return err_status_ok;
+}
+
+static err_status_t ossl_hmac_dealloc(auth_t *a){
+	ossl_hmac_ctx_t *h=(ossl_hmac_ctx_t*)a->state;
+	HMAC_CTX_free(h->ctx);
+	octet_string_set_to_zero((uint8_t*)a,sizeof(auth_t)+sizeof(ossl_hmac_ctx_t));
+	crypto_free(a);
+	ossl_hmac.ref_count--;
+	return err_status_ok;
+}
+
+static err_status_t ossl_hmac_init(ossl_hmac_ctx_t *h, const uint8_t *key, int key_len){
+	if (key_len>20)
+		return err_status_bad_param;
+	if (HMAC_Init_ex(h->ctx,key,key_len,EVP_sha1(),NULL)!=1)
+		return err_status_auth_fail;
+	return err_status_ok;
+}
+
+static err_status_t ossl_hmac_start(ossl_hmac_ctx_t *h){
+	/*keeps the key, restarts the digest*/
+	if (HMAC_Init_ex(h->ctx,NULL,0,NULL,NULL)!=1)
+		return err_status_auth_fail;
+	return err_status_ok;
+}
+
+static err_status_t ossl_hmac_update(ossl_hmac_ctx_t *h, const uint8_t *message, int msg_octets){
+	if (HMAC_Update(h->ctx,message,msg_octets)!=1)
+		return err_status_auth_fail;
+	return err_status_ok;
+}
+
+static err_status_t ossl_hmac_compute(ossl_hmac_ctx_t *h, const uint8_t *message, int msg_octets, int tag_len, uint8_t *result){
+	uint8_t digest[EVP_MAX_MD_SIZE];
+	unsigned int len=0;
+
+	if (tag_len>20)
+		return err_status_bad_param;
+	if (HMAC_Update(h->ctx,message,msg_octets)!=1 || HMAC_Final(h->ctx,digest,&len)!=1)
+		return err_status_auth_fail;
+	memcpy(result,digest,tag_len);
+	return err_status_ok;
+}
+
+static cipher_type_t ossl_aes_icm={
+	(cipher_alloc_func_t) ossl_aes_icm_alloc,
+	(cipher_dealloc_func_t) ossl_aes_icm_dealloc,
+	(cipher_init_func_t) ossl_aes_icm_init,
+	(cipher_encrypt_func_t) ossl_aes_icm_encrypt,
+	(cipher_encrypt_func_t) ossl_aes_icm_encrypt,
+	(cipher_set_iv_func_t) ossl_aes_icm_set_iv,
+	"aes integer counter mode (openssl)",
+	0,
+	NULL, /*libsrtp's aes_icm test cases, set at registration*/
+	&mod_ossl_aes_icm,
+	AES_ICM
+};
+
+static auth_type_t ossl_hmac={
+	(auth_alloc_func) ossl_hmac_alloc,
+	(auth_dealloc_func) ossl_hmac_dealloc,
+	(auth_init_func) ossl_hmac_init,
+	(auth_compute_func) ossl_hmac_compute,
+	(auth_update_func) ossl_hmac_update,
+	(auth_start_func) ossl_hmac_start,
+	"hmac sha-1 authentication function (openssl)",
+	0,
+	NULL, /*libsrtp's hmac test cases, set at registration*/
+	&mod_ossl_hmac,
+	HMAC_SHA1
+};
+
+#endif /*HAVE_SRTP_OPENSSL*/
+
+/*
+ * Selects the AES-ICM and HMAC-SHA1 implementations used by the sessions created from now on,
+ * the existing ones keep theirs.
+ */
+err_status_t ortp_srtp_set_crypto_backend(enum ortp_srtp_crypto_backend_t backend){
+	err_status_t err;
+	cipher_type_t *cipher=&aes_icm;
+	auth_type_t *auth=&hmac;
+
+	if (backend==ORTP_SRTP_BACKEND_OPENSSL){
+#ifdef HAVE_SRTP_OPENSSL
+		ossl_aes_icm.test_data=aes_icm.test_data;
+		ossl_hmac.test_data=hmac.test_data;
+		cipher=&ossl_aes_icm;
+		auth=&ossl_hmac;
+#else
+		ortp_error("oRTP has not been compiled with the OpenSSL SRTP backend.");
+		return err_status_bad_param;
+#endif
+	}
+	err=crypto_kernel_replace_cipher_type(cipher,AES_ICM);
+	if (err==err_status_ok)
+		err=crypto_kernel_replace_auth_type(auth,HMAC_SHA1);
+	if (err!=err_status_ok){
+		ortp_error("Could not select the %s SRTP crypto backend (%d).",backend==ORTP_SRTP_BACKEND_OPENSSL ? "OpenSSL" : "builtin",err);
+		if (backend!=ORTP_SRTP_BACKEND_BUILTIN){
+			crypto_kernel_replace_cipher_type(&aes_icm,AES_ICM);
+			crypto_kernel_replace_auth_type(&hmac,HMAC_SHA1);
+		}
+		return err;
+	}
+	ortp_message("SRTP uses the %s AES-ICM and HMAC-SHA1.",backend==ORTP_SRTP_BACKEND_OPENSSL ? "OpenSSL" : "builtin");
+	return err_status_ok;
+}
+
 static int srtp_init_done=0;
 
 err_status_t ortp_srtp_init(void)
@@ -176,6 +478,9 @@ err_status_t ortp_srtp_init(void)
 		st=srtp_init();
 		if (st==0) {
 			srtp_init_done++;
+#ifdef HAVE_SRTP_OPENSSL
+			ortp_srtp_set_crypto_backend(ORTP_SRTP_BACKEND_OPENSSL);
+#endif
 		}else{
 			ortp_fatal("Couldn't initialize SRTP library.");
 			err_reporting_init("oRTP");
@@ -361,5 +666,9 @@ srtp_t ortp_srtp_create_configure_session(enum ortp_srtp_crypto_suite_t suite, u
 void ortp_srtp_shutdown(void){
 }
 
+err_status_t ortp_srtp_set_crypto_backend(enum ortp_srtp_crypto_backend_t backend){
+	return -1;
+}
+
 #endif
 
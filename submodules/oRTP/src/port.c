@@ -66,17 +66,196 @@ void ortp_set_memory_functions(OrtpMemoryFunctions *functions){
 	ortp_allocator=*functions;
 }
 
+/*every arena block is preceded by its size, so that ortp_realloc() knows how much to copy*/
+#define ARENA_ALIGN 16
+#define ARENA_HEADER ARENA_ALIGN
+#define ARENA_ROUND(sz) (((sz)+ARENA_ALIGN-1) & ~((size_t)ARENA_ALIGN-1))
+
+struct _OrtpArena{
+	uint8_t *base;
+	size_t used;
+	int overflows;
+	int next_free;
+};
+
+/*arena memory is allocated on demand, this many arenas at a time*/
+#define ARENA_CHUNK 8
+
+typedef struct _OrtpArenaPool{
+	ortp_mutex_t lock;
+	uint8_t **chunks;
+	int nchunks;
+	size_t arena_size;
+	OrtpArena *arenas;
+	int count;
+	int nallocated;
+	int first_free;
+	int nused;
+}OrtpArenaPool;
+
+static OrtpArenaPool arena_pool={0};
+static ORTP_THREAD_LOCAL OrtpArena *current_arena=NULL;
+
+static bool_t is_arena_memory(const void *ptr){
+	/*a chunk is published before any of its arenas is handed out, so a stale count only misses chunks ptr is not in*/
+	int nchunks=arena_pool.nchunks;
+	size_t chunk_size=arena_pool.arena_size*ARENA_CHUNK;
+	int i;
+	for(i=0;i<nchunks;i++){
+		const uint8_t *chunk=arena_pool.chunks[i];
+		if ((const uint8_t*)ptr>=chunk && (const uint8_t*)ptr<chunk+chunk_size) return TRUE;
+	}
+	return FALSE;
+}
+
+static void *arena_alloc(OrtpArena *arena, size_t sz){
+	size_t needed=ARENA_HEADER+ARENA_ROUND(sz);
+	uint8_t *block;
+	if (arena->used+needed>arena_pool.arena_size){
+		arena->overflows++;
+		return NULL;
+	}
+	block=arena->base+arena->used;
+	arena->used+=needed;
+	*(size_t*)block=sz;
+	return block+ARENA_HEADER;
+}
+
+/*called with the pool lock held when no arena is free, returns -1 if the pool is at its size or out of memory*/
+static int arena_pool_grow(void){
+	int first=arena_pool.nallocated;
+	int n=arena_pool.count-first<ARENA_CHUNK ? arena_pool.count-first : ARENA_CHUNK;
+	uint8_t *chunk;
+	int i;
+	if (n<=0) return -1;
+	/*plain libc allocation: the pool must not come from itself nor from a custom allocator that could be unset*/
+	chunk=(uint8_t*)malloc(arena_pool.arena_size*ARENA_CHUNK);
+	if (chunk==NULL){
+		ortp_error("ortp_arena_pool: cannot allocate %i arenas of %u bytes.",ARENA_CHUNK,(unsigned int)arena_pool.arena_size);
+		return -1;
+	}
+	for(i=0;i<n;i++){
+		arena_pool.arenas[first+i].base=chunk+i*arena_pool.arena_size;
+		arena_pool.arenas[first+i].next_free=i+1<n ? first+i+1 : -1;
+	}
+	arena_pool.chunks[arena_pool.nchunks]=chunk;
+	arena_pool.nchunks++;
+	arena_pool.nallocated+=n;
+	arena_pool.first_free=first;
+	return 0;
+}
+
+int ortp_arena_pool_init(int count, size_t arena_size){
+	int maxchunks;
+	if (arena_pool.arenas!=NULL){
+		ortp_warning("ortp_arena_pool_init(): pool already initialized.");
+		return 0;
+	}
+	if (count<=0 || arena_size==0) return -1;
+	arena_size=ARENA_ROUND(arena_size);
+	maxchunks=(count+ARENA_CHUNK-1)/ARENA_CHUNK;
+	arena_pool.arenas=(OrtpArena*)calloc(count,sizeof(OrtpArena));
+	arena_pool.chunks=(uint8_t**)calloc(maxchunks,sizeof(uint8_t*));
+	if (arena_pool.arenas==NULL || arena_pool.chunks==NULL){
+		free(arena_pool.arenas);
+		free(arena_pool.chunks);
+		memset(&arena_pool,0,sizeof(arena_pool));
+		ortp_error("ortp_arena_pool_init(): cannot allocate a pool of %i arenas.",count);
+		return -1;
+	}
+	ortp_mutex_init(&arena_pool.lock,NULL);
+	arena_pool.arena_size=arena_size;
+	arena_pool.count=count;
+	arena_pool.nchunks=0;
+	arena_pool.nallocated=0;
+	arena_pool.first_free=-1;
+	arena_pool.nused=0;
+	return 0;
+}
+
+void ortp_arena_pool_uninit(void){
+	int i;
+	if (arena_pool.arenas==NULL) return;
+	if (arena_pool.nused>0){
+		ortp_error("ortp_arena_pool_uninit(): %i arenas are still in use, pool is leaked.",arena_pool.nused);
+		return;
+	}
+	ortp_mutex_destroy(&arena_pool.lock);
+	for(i=0;i<arena_pool.nchunks;i++) free(arena_pool.chunks[i]);
+	free(arena_pool.chunks);
+	free(arena_pool.arenas);
+	memset(&arena_pool,0,sizeof(arena_pool));
+}
+
+OrtpArena *ortp_arena_get(void){
+	OrtpArena *arena=NULL;
+	if (arena_pool.arenas==NULL) return NULL;
+	ortp_mutex_lock(&arena_pool.lock);
+	if (arena_pool.first_free!=-1 || arena_pool_grow()==0){
+		arena=&arena_pool.arenas[arena_pool.first_free];
+		arena_pool.first_free=arena->next_free;
+		arena_pool.nused++;
+	}
+	ortp_mutex_unlock(&arena_pool.lock);
+	if (arena==NULL){
+		/*a pool smaller than the number of streams is expected, those are on the heap*/
+		ortp_message("ortp_arena_get(): all %i arenas are in use.",arena_pool.count);
+		return NULL;
+	}
+	arena->used=0;
+	arena->overflows=0;
+	return arena;
+}
+
+void ortp_arena_release(OrtpArena *arena){
+	if (arena==NULL) return;
+	if (current_arena==arena) current_arena=NULL;
+	ortp_mutex_lock(&arena_pool.lock);
+	arena->next_free=arena_pool.first_free;
+	arena_pool.first_free=(int)(arena-arena_pool.arenas);
+	arena_pool.nused--;
+	ortp_mutex_unlock(&arena_pool.lock);
+}
+
+OrtpArena *ortp_arena_set_current(OrtpArena *arena){
+	OrtpArena *prev=current_arena;
+	current_arena=arena;
+	return prev;
+}
+
+size_t ortp_arena_get_used(const OrtpArena *arena){
+	return arena->used;
+}
+
+int ortp_arena_get_overflows(const OrtpArena *arena){
+	return arena->overflows;
+}
+
 void* ortp_malloc(size_t sz){
 	allocator_used=TRUE;
+	if (current_arena!=NULL){
+		void *ret=arena_alloc(current_arena,sz);
+		if (ret!=NULL) return ret;
+	}
 	return ortp_allocator.malloc_fun(sz);
 }
 
 void* ortp_realloc(void *ptr, size_t sz){
 	allocator_used=TRUE;
+	if (ptr==NULL) return ortp_malloc(sz);
+	if (is_arena_memory(ptr)){
+		/*arena blocks never grow in place: move to wherever ortp_malloc() puts it now*/
+		size_t oldsz=*(size_t*)((uint8_t*)ptr-ARENA_HEADER);
+		void *ret=ortp_malloc(sz);
+		if (ret!=NULL) memcpy(ret,ptr,oldsz<sz ? oldsz : sz);
+		return ret;
+	}
 	return ortp_allocator.realloc_fun(ptr,sz);
 }
 
 void ortp_free(void* ptr){
+	/*arena memory is given back all at once by ortp_arena_release()*/
+	if (is_arena_memory(ptr)) return;
 	ortp_allocator.free_fun(ptr);
 }
 
@@ -736,6 +915,23 @@ void ortp_get_cur_time(ortpTimeSpec *ret){
 #endif
 }
 
+static ORTP_THREAD_LOCAL struct timeval tick_time;
+static ORTP_THREAD_LOCAL bool_t tick_time_enabled=FALSE;
+
+void ortp_tick_time_update(void){
+	gettimeofday(&tick_time,NULL);
+	tick_time_enabled=TRUE;
+}
+
+void ortp_tick_time_disable(void){
+	tick_time_enabled=FALSE;
+}
+
+void ortp_get_tick_timeofday(struct timeval *tv){
+	if (tick_time_enabled) *tv=tick_time;
+	else gettimeofday(tv,NULL);
+}
+
 #if defined(_WIN32) && !defined(_MSC_VER)
 char* strtok_r(char *str, const char *delim, char **nextp){
     char *ret;
@@ -74,11 +74,19 @@ static void sdes_chunk_set_ssrc(mblk_t *m, uint32_t ssrc){
 }
 
 #define sdes_chunk_get_ssrc(m) ntohl(((sdes_chunk_t*)((m)->b_rptr))->csrc)
+#define sdes_chunk_get_ssrc_at(m,offset) ntohl(((sdes_chunk_t*)((m)->b_rptr+(offset)))->csrc)
 
 static mblk_t * sdes_chunk_pad(mblk_t *m){
 	return appendb(m,"",1,TRUE);
 }
 
+static void rtp_session_invalidate_sdes_packet(RtpSession *session){
+	if (session->sdes_packet!=NULL){
+		freemsg(session->sdes_packet);
+		session->sdes_packet=NULL;
+	}
+}
+
 /**
  * Set session's SDES item for automatic sending of RTCP compound packets.
  * If some items are not specified, use NULL.
@@ -103,6 +111,7 @@ void rtp_session_set_source_description(RtpSession *session,
 	chunk=sdes_chunk_pad(chunk);
 	if (session->sd!=NULL) freemsg(session->sd);
 	session->sd=m;
+	rtp_session_invalidate_sdes_packet(session);
 }
 
 void
@@ -126,6 +135,7 @@ rtp_session_add_contributing_source(RtpSession *session, uint32_t csrc,
 	chunk=sdes_chunk_append_item(chunk, RTCP_SDES_NOTE, note);
 	chunk=sdes_chunk_pad(chunk);
 	putq(&session->contributing_sources,m);
+	rtp_session_invalidate_sdes_packet(session);
 }
 
 
@@ -146,7 +156,7 @@ mblk_t* rtp_session_create_rtcp_sdes_packet(RtpSession *session)
 	rc++;
 	
 	q=&session->contributing_sources;
-    for (tmp=qbegin(q); !qend(q,tmp); tmp=qnext(q,mp)){
+    for (tmp=qbegin(q); !qend(q,tmp); tmp=qnext(q,tmp)){
 		m=concatb(m,dupmsg(tmp));
 		rc++;
 	}
@@ -197,6 +207,8 @@ void rtp_session_remove_contributing_sources(RtpSession *session, uint32_t ssrc)
 		uint32_t csrc=sdes_chunk_get_ssrc(tmp);
 		if (csrc==ssrc) {
 			remq(q,tmp);
+			freemsg(tmp);
+			rtp_session_invalidate_sdes_packet(session);
 			break;
 		}
 	}
@@ -295,6 +307,13 @@ static void report_block_init(report_block_t *b, RtpSession *session){
 		/* Normal mode */
 		b->lsr = htonl( stream->last_rcv_SR_ts );
 	}
+	rtcp_summary_update_begin(session);
+	session->rtcp_summary.has_local_report=TRUE;
+	session->rtcp_summary.local_fraction_lost=(uint8_t)(fl_cnpl>>24);
+	session->rtcp_summary.local_cum_packet_loss=fl_cnpl & 0xFFFFFF;
+	session->rtcp_summary.local_ext_high_seq=stream->hwrcv_extseq;
+	session->rtcp_summary.local_jitter=ntohl(b->interarrival_jitter);
+	rtcp_summary_update_end(session);
 }
 
 static void extended_statistics( RtpSession *session, report_block_t * rb ) {
@@ -309,7 +328,7 @@ static void extended_statistics( RtpSession *session, report_block_t * rb ) {
 
 		session->rtp.jitter_stats.max_jitter = jitter ;
 
-		gettimeofday( &now, NULL );
+		ortp_get_tick_timeofday( &now );
 		session->rtp.jitter_stats.max_jitter_ts = ( now.tv_sec * 1000LL ) + ( now.tv_usec / 1000LL );
 	}
 	/* compute mean jitter buffer size */
@@ -353,36 +372,222 @@ static int rtcp_app_init(RtpSession *session, uint8_t *buf, uint8_t subtype, con
 	return sizeof(rtcp_app_t);
 }
 
-static mblk_t * make_rr(RtpSession *session){
-	mblk_t *cm=NULL;
-	mblk_t *sdes=NULL;
-	
-	cm=allocb(sizeof(rtcp_sr_t),0);
-	cm->b_wptr+=rtcp_rr_init(session,cm->b_wptr,sizeof(rtcp_rr_t));
-	/* make a SDES packet */
-	if (session->sd!=NULL)
-		sdes=rtp_session_create_rtcp_sdes_packet(session);
-	/* link them */
-	cm->b_cont=sdes;
-	return cm;
+#define RTCP_XR_GMIN 16
+#define RTCP_XR_SIZE (RTCP_XR_HEADER_SIZE+RTCP_XR_VOIP_METRICS_BLOCK_SIZE)
+
+/* RFC 3611 section 4.7.2: a loss following at least gmin received packets starts a new burst */
+void rtcp_xr_burst_update(RtcpXrBurstStats *b, int lost, bool_t received){
+	int i;
+	for(i=0;i<lost;i++){
+		if (b->pkt>=RTCP_XR_GMIN){
+			if (b->lost==1) b->c14++;
+			else b->c13++;
+			b->lost=1;
+			b->c11+=b->pkt;
+		}else{
+			b->lost++;
+			if (b->pkt==0) b->c33++;
+			else{
+				b->c23++;
+				b->c22+=b->pkt-1;
+			}
+		}
+		b->pkt=0;
+	}
+	if (received) b->pkt++;
 }
 
-static mblk_t * make_sr(RtpSession *session){
-	mblk_t *cm=NULL;
-	mblk_t *sdes=NULL;
-	
-	cm=allocb(sizeof(rtcp_sr_t),0);
-	cm->b_wptr+=rtcp_sr_init(session,cm->b_wptr,sizeof(rtcp_sr_t));
-	/* make a SDES packet */
-	if (session->sd!=NULL)
-		sdes=rtp_session_create_rtcp_sdes_packet(session);
-	/* link them */
-	cm->b_cont=sdes;
+static uint8_t rtcp_xr_rate(uint64_t count, uint64_t total){
+	if (total==0) return 0;
+	return (uint8_t)MIN(255,count*256/total);
+}
+
+static uint16_t rtcp_xr_ms(double ms){
+	if (ms<0) return 0;
+	return (uint16_t)MIN(65535,ms);
+}
+
+static void rtcp_xr_voip_metrics_init(RtpSession *session, rtcp_voip_metrics_t *m){
+	RtpStream *stream=&session->rtp;
+	RtcpXrBurstStats *b=&stream->xr_burst;
+	JitterControl *jc=&stream->jittctl;
+	uint64_t expected=stream->stats.packet_recv+stream->stats.cum_packet_loss;
+	int clock_rate=jc->clock_rate>0 ? jc->clock_rate : 8000;
+	double c31=b->c13, c32=b->c23;
+	double ctotal=b->c11+b->c14+b->c13+b->c22+b->c23+c31+c32+b->c33;
+	double packet_ms=b->packet_duration_ts*1000.0/clock_rate;
+	double jb_nominal=jc->adapt_jitt_comp_ts*1000.0/clock_rate;
+
+	memset(m,0,sizeof(*m));
+	m->ssrc=session->rcv.ssrc;
+	m->loss_rate=rtcp_xr_rate(stream->stats.cum_packet_loss,expected);
+	m->discard_rate=rtcp_xr_rate(stream->stats.outoftime,expected);
+	if (c31+c32+b->c33>0){
+		double p32=c32/(c31+c32+b->c33);
+		double p23=(b->c22+b->c23<1) ? 1 : 1-(double)b->c22/(b->c22+b->c23);
+		m->burst_density=(uint8_t)MIN(255,256*p23/(p23+p32));
+	}
+	m->gap_density=rtcp_xr_rate(b->c14,(uint64_t)b->c11+b->c14);
+	if (b->c13>0){
+		double gap=(b->c11+b->c14+b->c13)*packet_ms/b->c13;
+		m->gap_duration=rtcp_xr_ms(gap);
+		m->burst_duration=rtcp_xr_ms(ctotal*packet_ms/b->c13-gap);
+	}
+	m->round_trip_delay=rtcp_xr_ms(session->rtt*1000);
+	/* what we know of the end system delay is the time spent in the jitter buffer */
+	m->end_system_delay=rtcp_xr_ms(stream->jitter_stats.jitter_buffer_size_ms);
+	m->signal_level=RTCP_XR_UNAVAILABLE;
+	m->noise_level=RTCP_XR_UNAVAILABLE;
+	m->rerl=RTCP_XR_UNAVAILABLE;
+	m->gmin=RTCP_XR_GMIN;
+	m->r_factor=RTCP_XR_UNAVAILABLE;
+	m->ext_r_factor=RTCP_XR_UNAVAILABLE;
+	m->mos_lq=RTCP_XR_UNAVAILABLE;
+	m->mos_cq=RTCP_XR_UNAVAILABLE;
+	/* packet loss concealment unspecified, adaptive or non-adaptive jitter buffer */
+	m->rx_config=jc->adaptive ? 0x30 : 0x20;
+	m->jb_nominal=rtcp_xr_ms(jb_nominal);
+	m->jb_maximum=(jc->adaptive && jc->max_size>0) ? rtcp_xr_ms(jc->max_size) : m->jb_nominal;
+	m->jb_abs_max=m->jb_maximum;
+}
+
+static void write_u16(uint8_t *p, uint16_t val){
+	p[0]=val>>8;
+	p[1]=val&0xff;
+}
+
+static int rtcp_xr_init(RtpSession *session, uint8_t *buf, int size){
+	rtcp_voip_metrics_t m;
+	uint8_t *p;
+	if (size<RTCP_XR_SIZE) return 0;
+	rtcp_xr_voip_metrics_init(session,&m);
+	rtcp_common_header_init((rtcp_common_header_t*)buf,session,RTCP_XR,0,RTCP_XR_SIZE);
+	*(uint32_t*)(buf+RTCP_COMMON_HEADER_SIZE)=htonl(session->snd.ssrc);
+	p=buf+RTCP_XR_HEADER_SIZE;
+	p[0]=RTCP_XR_VOIP_METRICS_BLOCK;
+	p[1]=0;
+	write_u16(p+2,RTCP_XR_VOIP_METRICS_BLOCK_SIZE/4-1);
+	p+=4;
+	*(uint32_t*)p=htonl(m.ssrc);
+	p[4]=m.loss_rate;
+	p[5]=m.discard_rate;
+	p[6]=m.burst_density;
+	p[7]=m.gap_density;
+	write_u16(p+8,m.burst_duration);
+	write_u16(p+10,m.gap_duration);
+	write_u16(p+12,m.round_trip_delay);
+	write_u16(p+14,m.end_system_delay);
+	p[16]=(uint8_t)m.signal_level;
+	p[17]=(uint8_t)m.noise_level;
+	p[18]=m.rerl;
+	p[19]=m.gmin;
+	p[20]=m.r_factor;
+	p[21]=m.ext_r_factor;
+	p[22]=m.mos_lq;
+	p[23]=m.mos_cq;
+	p[24]=m.rx_config;
+	p[25]=0;
+	write_u16(p+26,m.jb_nominal);
+	write_u16(p+28,m.jb_maximum);
+	write_u16(p+30,m.jb_abs_max);
+
+	rtcp_summary_update_begin(session);
+	session->rtcp_summary.has_local_voip_metrics=TRUE;
+	session->rtcp_summary.local_voip_metrics=m;
+	rtcp_summary_update_end(session);
+	return RTCP_XR_SIZE;
+}
+
+/* the SDES packet does not change as long as the SSRC and the source descriptions do not */
+static mblk_t *rtp_session_get_sdes_packet(RtpSession *session){
+	mblk_t *m=session->sdes_packet;
+	if (session->sd==NULL) return NULL;
+	if (m!=NULL && sdes_chunk_get_ssrc_at(m,sizeof(rtcp_common_header_t))!=session->snd.ssrc){
+		rtp_session_invalidate_sdes_packet(session);
+		m=NULL;
+	}
+	if (m==NULL){
+		m=rtp_session_create_rtcp_sdes_packet(session);
+		msgpullup(m,-1);
+		session->sdes_packet=m;
+	}
+	return m;
+}
+
+/*
+ * The compound reports are written in a buffer kept by the session, reused once the previous report is sent
+ * and no longer referenced by an event. Packets sent through a transport get a new buffer with room for its
+ * trailer, so that it can process them in place.
+ */
+static mblk_t *rtcp_report_buffer(RtpSession *session, int size){
+	mblk_t *m=session->rtcp.report_mp;
+	if (rtp_session_using_transport(session,rtcp))
+		return allocb(size+session->rtcp.tr->tailroom,0);
+	if (m==NULL || m->b_datap->db_ref>1 || m->b_datap->db_lim-m->b_datap->db_base<size){
+		if (m!=NULL) freemsg(m);
+		m=allocb(size,0);
+		session->rtcp.report_mp=m;
+	}
+	m->b_rptr=m->b_wptr=m->b_datap->db_base;
+	return dupb(m);
+}
+
+static mblk_t * make_report(RtpSession *session, bool_t sr){
+	mblk_t *sdes=rtp_session_get_sdes_packet(session);
+	int sdes_size=sdes!=NULL ? (int)(sdes->b_wptr-sdes->b_rptr) : 0;
+	/* nothing to report in the VoIP metrics until packets are received */
+	bool_t xr=(session->flags & RTCP_XR_VOIP_METRICS) && session->rtp.stats.packet_recv>0;
+	mblk_t *cm=rtcp_report_buffer(session,sizeof(rtcp_sr_t)+sdes_size+(xr ? RTCP_XR_SIZE : 0));
+
+	if (sr) cm->b_wptr+=rtcp_sr_init(session,cm->b_wptr,sizeof(rtcp_sr_t));
+	else cm->b_wptr+=rtcp_rr_init(session,cm->b_wptr,sizeof(rtcp_rr_t));
+	if (xr) cm->b_wptr+=rtcp_xr_init(session,cm->b_wptr,RTCP_XR_SIZE);
+	/* append the SDES packet */
+	if (sdes!=NULL){
+		memcpy(cm->b_wptr,sdes->b_rptr,sdes_size);
+		cm->b_wptr+=sdes_size;
+	}
 	return cm;
 }
 
+#define make_rr(session) make_report(session,FALSE)
+#define make_sr(session) make_report(session,TRUE)
+
+/**
+ * By default, the RTCP reports sent automatically are not notified to the application.
+ * If yesno is TRUE, a copy of each one is dispatched to the session's event queues in an
+ * ORTP_EVENT_RTCP_PACKET_EMITTED event.
+**/
+void rtp_session_enable_rtcp_emitted_events(RtpSession *session, bool_t yesno){
+	if (yesno) rtp_session_set_flag(session,RTCP_EMITTED_EVENTS);
+	else rtp_session_unset_flag(session,RTCP_EMITTED_EVENTS);
+}
+
+/**
+ * When enabled, the reports sent automatically include an RTCP extended report (RFC 3611) with the VoIP
+ * metrics block about the stream received.
+**/
+void rtp_session_enable_rtcp_xr_voip_metrics(RtpSession *session, bool_t yesno){
+	if (yesno) rtp_session_set_flag(session,RTCP_XR_VOIP_METRICS);
+	else rtp_session_unset_flag(session,RTCP_XR_VOIP_METRICS);
+}
+
+/**
+ * Copies the summary of the RTCP reports sent and received by the session. It can be called from any thread
+ * without locking: the copy is made again if the session was updated meanwhile.
+**/
+void rtp_session_get_rtcp_summary(const RtpSession *session, rtcp_summary_t *summary){
+	unsigned int seq;
+	do{
+		seq=session->rtcp_summary_seq;
+		ortp_memory_barrier();
+		*summary=session->rtcp_summary;
+		ortp_memory_barrier();
+	}while((seq & 1) || seq!=session->rtcp_summary_seq);
+}
+
 static void notify_sent_rtcp(RtpSession *session, mblk_t *rtcp){
-	if (session->eventqs!=NULL){
+	if (session->eventqs!=NULL && (session->flags & RTCP_EMITTED_EVENTS)){
 		OrtpEvent *ev;
 		OrtpEventData *evd;
 		ev=ortp_event_new(ORTP_EVENT_RTCP_PACKET_EMITTED);
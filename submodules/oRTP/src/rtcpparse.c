@@ -283,3 +283,62 @@ void rtcp_APP_get_data(const mblk_t *m, uint8_t **data, int *len){
 		*data=NULL;
 	}
 }
+
+/*XR accessors */
+bool_t rtcp_is_XR(const mblk_t *m){
+	const rtcp_common_header_t *ch=rtcp_get_common_header(m);
+	if (ch!=NULL && rtcp_common_header_get_packet_type(ch)==RTCP_XR){
+		if (msgdsize(m)<RTCP_XR_HEADER_SIZE || msgdsize(m)<rtcp_get_size(m)){
+			ortp_warning("Too short RTCP XR packet.");
+			return FALSE;
+		}
+		return TRUE;
+	}
+	return FALSE;
+}
+
+uint32_t rtcp_XR_get_ssrc(const mblk_t *m){
+	return ntohl(*(uint32_t*)(m->b_rptr+RTCP_COMMON_HEADER_SIZE));
+}
+
+static uint16_t read_u16(const uint8_t *p){
+	return (uint16_t)((p[0]<<8) | p[1]);
+}
+
+bool_t rtcp_XR_get_voip_metrics(const mblk_t *m, rtcp_voip_metrics_t *metrics){
+	const uint8_t *block=m->b_rptr+RTCP_XR_HEADER_SIZE;
+	const uint8_t *end=m->b_rptr+rtcp_get_size(m);
+
+	/*each block starts with its type, a type specific byte and its length in 32 bits words, minus one*/
+	while(block+4<=end){
+		int block_size=(read_u16(block+2)+1)*4;
+		if (block+block_size>end) break;
+		if (block[0]==RTCP_XR_VOIP_METRICS_BLOCK && block_size==RTCP_XR_VOIP_METRICS_BLOCK_SIZE){
+			const uint8_t *p=block+4;
+			metrics->ssrc=ntohl(*(uint32_t*)p);
+			metrics->loss_rate=p[4];
+			metrics->discard_rate=p[5];
+			metrics->burst_density=p[6];
+			metrics->gap_density=p[7];
+			metrics->burst_duration=read_u16(p+8);
+			metrics->gap_duration=read_u16(p+10);
+			metrics->round_trip_delay=read_u16(p+12);
+			metrics->end_system_delay=read_u16(p+14);
+			metrics->signal_level=(int8_t)p[16];
+			metrics->noise_level=(int8_t)p[17];
+			metrics->rerl=p[18];
+			metrics->gmin=p[19];
+			metrics->r_factor=p[20];
+			metrics->ext_r_factor=p[21];
+			metrics->mos_lq=p[22];
+			metrics->mos_cq=p[23];
+			metrics->rx_config=p[24];
+			metrics->jb_nominal=read_u16(p+26);
+			metrics->jb_maximum=read_u16(p+28);
+			metrics->jb_abs_max=read_u16(p+30);
+			return TRUE;
+		}
+		block+=block_size;
+	}
+	return FALSE;
+}
@@ -66,7 +66,7 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 	if (msgsize<RTP_FIXED_HEADER_SIZE){
 		ortp_warning("Packet too small to be a rtp packet (%i)!",msgsize);
 		rtpstream->stats.bad++;
-		ortp_global_stats.bad++;
+		ortp_global_stats_shard()->bad++;
 		freemsg(mp);
 		return;
 	}
@@ -91,15 +91,15 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 		/* discard in two case: the packet is not stun OR nobody is interested by STUN (no eventqs) */
 		ortp_debug("Receiving rtp packet with version number !=2...discarded");
 		stats->bad++;
-		ortp_global_stats.bad++;
+		ortp_global_stats_shard()->bad++;
 		freemsg(mp);
 		return;
 	}
 
 	/* only count non-stun packets. */
-	ortp_global_stats.packet_recv++;
+	ortp_global_stats_shard()->packet_recv++;
 	stats->packet_recv++;
-	ortp_global_stats.hw_recv+=msgsize;
+	ortp_global_stats_shard()->hw_recv+=msgsize;
 	stats->hw_recv+=msgsize;
 	session->rtp.hwrcv_since_last_SR++;
 
@@ -112,14 +112,18 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 	if (rtp->cc*sizeof(uint32_t) > (uint32_t) (msgsize-RTP_FIXED_HEADER_SIZE)){
 		ortp_message("Receiving too short rtp packet.");
 		stats->bad++;
-		ortp_global_stats.bad++;
+		ortp_global_stats_shard()->bad++;
 		freemsg(mp);
 		return;
 	}
 
 #ifndef PERF
 	/* Write down the last RTP/RTCP packet reception time. */
-	gettimeofday(&session->last_recv_time, NULL);
+#if defined(ORTP_TIMESTAMP)
+	if (mp->timestamp.tv_sec!=0) session->last_recv_time=mp->timestamp;
+	else
+#endif
+	ortp_get_tick_timeofday(&session->last_recv_time);
 #endif
 
 	for (i=0;i<rtp->cc;i++)
@@ -152,7 +156,7 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 				/*discard the packet*/
 				ortp_warning("Receiving packet with unknown ssrc.");
 				stats->bad++;
-				ortp_global_stats.bad++;
+				ortp_global_stats_shard()->bad++;
 				freemsg(mp);
 				return;
 			}
@@ -179,13 +183,26 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 	/* update some statistics */
 	{
 		poly32_t *extseq=(poly32_t*)&rtpstream->hwrcv_extseq;
+		int gap=-1;
 		if (rtp->seq_number>extseq->split.lo){
+			gap=rtp->seq_number-extseq->split.lo-1;
 			extseq->split.lo=rtp->seq_number;
 		}else if (rtp->seq_number<200 && extseq->split.lo>((1<<16) - 200)){
 			/* this is a check for sequence number looping */
+			gap=rtp->seq_number+(1<<16)-extseq->split.lo-1;
 			extseq->split.lo=rtp->seq_number;
 			extseq->split.hi++;
 		}
+		if (gap>=0 && stats->packet_recv>1){
+			RtcpXrBurstStats *b=&rtpstream->xr_burst;
+			if (gap==0 && rtp->timestamp-b->last_ts<(uint32_t)session->rtp.ts_jump)
+				b->packet_duration_ts=rtp->timestamp-b->last_ts;
+			/* a sender restarting its sequence numbers is not a loss burst of thousands of packets */
+			rtcp_xr_burst_update(b,MIN(gap,RTCP_XR_MAX_GAP),TRUE);
+		}else if (stats->packet_recv==1){
+			rtcp_xr_burst_update(&rtpstream->xr_burst,0,TRUE);
+		}
+		if (gap>=0 || stats->packet_recv==1) rtpstream->xr_burst.last_ts=rtp->timestamp;
 		/* the first sequence number received should be initialized at the beginning, so that the first receiver reports contains valid loss rate*/
 		if (stats->packet_recv==1){
 			rtpstream->hwrcv_seq_at_last_SR=rtp->seq_number;
@@ -196,7 +213,7 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 	if (rtp->paytype==session->rcv.telephone_events_pt){
 		queue_packet(&session->rtp.tev_rq,session->rtp.max_rq_size,mp,rtp,&i);
 		stats->discarded+=i;
-		ortp_global_stats.discarded+=i;
+		ortp_global_stats_shard()->discarded+=i;
 		return;
 	}
 	
@@ -227,8 +244,9 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 			}
 			ortp_message("rtp_parse: discarding too old packet (ts=%i)",rtp->timestamp);
 			freemsg(mp);
+			rtcp_xr_burst_update(&session->rtp.xr_burst,1,FALSE);
 			stats->outoftime++;
-			ortp_global_stats.outoftime++;
+			ortp_global_stats_shard()->outoftime++;
 			return;
 		}
 	}
@@ -236,6 +254,6 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 	if (queue_packet(&session->rtp.rq,session->rtp.max_rq_size,mp,rtp,&i))
 		jitter_control_update_size(&session->rtp.jittctl,&session->rtp.rq);
 	stats->discarded+=i;
-	ortp_global_stats.discarded+=i;
+	ortp_global_stats_shard()->discarded+=i;
 }
 
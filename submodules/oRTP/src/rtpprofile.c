@@ -46,9 +46,10 @@ int rtp_profile_find_payload_number(RtpProfile*profile,const char *mime,int rate
 		pt=rtp_profile_get_payload(profile,i);
 		if (pt!=NULL)
 		{
-			if (strcasecmp(pt->mime_type,mime)==0 &&
-			    pt->clock_rate==rate &&
-			    (pt->channels==channels || channels<=0 || pt->channels<=0)) {
+			/*the integers first, most payload types are discarded without comparing the mime types*/
+			if (pt->clock_rate==rate &&
+			    (pt->channels==channels || channels<=0 || pt->channels<=0) &&
+			    strcasecmp(pt->mime_type,mime)==0) {
 				/*we don't look at channels if it is undefined
 				ie a negative or zero value*/
 				return i;
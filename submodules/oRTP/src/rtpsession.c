@@ -774,7 +774,8 @@ mblk_t * rtp_session_create_packet(RtpSession *session,int header_size, const ui
 	int msglen=header_size+payload_size;
 	rtp_header_t *rtp;
 	
-	mp=allocb(msglen,BPRI_MED);
+	/*leave room for the transport trailer, so that it can process the packet in place*/
+	mp=allocb(msglen+rtp_session_get_send_tailroom(session),BPRI_MED);
 	rtp=(rtp_header_t*)mp->b_rptr;
 	rtp_header_init_from_session(rtp,session);
 	/*copy the payload, if any */
@@ -786,6 +787,15 @@ mblk_t * rtp_session_create_packet(RtpSession *session,int header_size, const ui
 	return mp;
 }
 
+/**
+ * Returns the number of bytes the RTP transport of the session appends to the packets it sends (SRTP
+ * authentication tag), 0 without transport. Packets built with this room after their data, in a single
+ * buffer, are processed in place by the transport.
+**/
+int rtp_session_get_send_tailroom(const RtpSession *session){
+	return session->rtp.tr ? session->rtp.tr->tailroom : 0;
+}
+
 /**
  *	Creates a new rtp packet using the given payload buffer (no copy). The header will be allocated separetely.
  *  In the header, ssrc and payload_type according to the session's
@@ -917,10 +927,10 @@ __rtp_session_sendm_with_ts (RtpSession * session, mblk_t *mp, uint32_t packet_t
 			session->rtp.snd_seq=rtp->seq_number+1;
 		session->rtp.snd_last_ts = packet_ts;
 
-		ortp_global_stats.sent += packsize;
+		ortp_global_stats_shard()->sent += packsize;
 		stream->sent_payload_bytes+=packsize-RTP_FIXED_HEADER_SIZE;
 		stream->stats.sent += packsize;
-		ortp_global_stats.packet_sent++;
+		ortp_global_stats_shard()->packet_sent++;
 		stream->stats.packet_sent++;
 	}
 
@@ -1092,7 +1102,7 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 	mp=getq(&session->rtp.tev_rq);
 	if (mp!=NULL){
 		int msgsize=msgdsize(mp);
-		ortp_global_stats.recv += msgsize;
+		ortp_global_stats_shard()->recv += msgsize;
 		stream->stats.recv += msgsize;
 		rtp_signal_table_emit2(&session->on_telephone_event_packet,(long)mp);
 		rtp_session_check_telephone_events(session,mp);
@@ -1131,7 +1141,7 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 	}else mp=getq(&session->rtp.rq);/*no jitter buffer at all*/
 	
 	stream->stats.outoftime+=rejected;
-	ortp_global_stats.outoftime+=rejected;
+	ortp_global_stats_shard()->outoftime+=rejected;
 
 	goto end;
 
@@ -1140,7 +1150,7 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 	{
 		int msgsize = msgdsize (mp);	/* evaluate how much bytes (including header) is received by app */
 		uint32_t packet_ts;
-		ortp_global_stats.recv += msgsize;
+		ortp_global_stats_shard()->recv += msgsize;
 		stream->stats.recv += msgsize;
 		rtp = (rtp_header_t *) mp->b_rptr;
 		packet_ts=rtp->timestamp;
@@ -1392,11 +1402,17 @@ void rtp_session_unregister_event_queue(RtpSession *session, OrtpEvQueue *q){
 
 void rtp_session_dispatch_event(RtpSession *session, OrtpEvent *ev){
 	OList *it;
-	int i;
-	for(i=0,it=session->eventqs;it!=NULL;it=it->next,++i){
-		ortp_ev_queue_put((OrtpEvQueue*)it->data,ortp_event_dup(ev));
-	}	
-	ortp_event_destroy(ev);
+	OrtpEvQueue *last=NULL;
+	OrtpEventType type=ortp_event_get_type(ev);
+	/*the last queue interested gets the event itself, the others a copy*/
+	for(it=session->eventqs;it!=NULL;it=it->next){
+		OrtpEvQueue *q=(OrtpEvQueue*)it->data;
+		if (!ortp_ev_queue_wants_type(q,type)) continue;
+		if (last!=NULL) ortp_ev_queue_put(last,ortp_event_dup(ev));
+		last=q;
+	}
+	if (last!=NULL) ortp_ev_queue_put(last,ev);
+	else ortp_event_destroy(ev);
 }
 
 
@@ -1420,7 +1436,9 @@ void rtp_session_uninit (RtpSession * session)
 	if (session->current_tev!=NULL) freemsg(session->current_tev);
 	if (session->rtp.cached_mp!=NULL) freemsg(session->rtp.cached_mp);
 	if (session->rtcp.cached_mp!=NULL) freemsg(session->rtcp.cached_mp);
+	if (session->rtcp.report_mp!=NULL) freemsg(session->rtcp.report_mp);
 	if (session->sd!=NULL) freemsg(session->sd);
+	if (session->sdes_packet!=NULL) freemsg(session->sdes_packet);
 
 	session->signal_tables = o_list_free(session->signal_tables);
 	msgb_allocator_uninit(&session->allocator);
@@ -1516,6 +1534,7 @@ void rtp_session_reset (RtpSession * session)
 	rtp_session_clear_send_error_code(session);
 	rtp_session_clear_recv_error_code(session);
 	rtp_stats_reset(&session->rtp.stats);
+	memset(&session->rtp.xr_burst,0,sizeof(session->rtp.xr_burst));
 	rtp_session_resync(session);
 	session->ssrc_set=FALSE;
 }
@@ -1643,7 +1662,7 @@ static float compute_bw(struct timeval *orig, unsigned int bytes){
 	float bw;
 	float time;
 	if (bytes==0) return 0;
-	gettimeofday(&current,NULL);
+	ortp_get_tick_timeofday(&current);
 	time=(float)(current.tv_sec - orig->tv_sec) +
 		((float)(current.tv_usec - orig->tv_usec)*1e-6);
 	bw=((float)bytes)*8/(time+0.001); 
@@ -980,7 +980,7 @@ static void update_sent_bytes(RtpSession*s, int nbytes){
 	int overhead=IP_UDP_OVERHEAD;
 #endif
 	if (s->rtp.sent_bytes==0){
-		gettimeofday(&s->rtp.send_bw_start,NULL);
+		ortp_get_tick_timeofday(&s->rtp.send_bw_start);
 	}
 	s->rtp.sent_bytes+=nbytes+overhead;
 }
@@ -992,7 +992,7 @@ static void update_recv_bytes(RtpSession*s, int nbytes){
 	int overhead=IP_UDP_OVERHEAD;
 #endif
 	if (s->rtp.recv_bytes==0){
-		gettimeofday(&s->rtp.recv_bw_start,NULL);
+		ortp_get_tick_timeofday(&s->rtp.recv_bw_start);
 	}
 	s->rtp.recv_bytes+=nbytes+overhead;
 }
@@ -1048,6 +1048,161 @@ rtp_session_rtp_send (RtpSession * session, mblk_t * m)
 	return error;
 }
 
+static void rtcp_send_error(RtpSession *session){
+	char host[65];
+	if (session->on_network_error.count>0){
+		rtp_signal_table_emit3(&session->on_network_error,(long)"Error sending RTCP packet",INT_TO_POINTER(getSocketErrorCode()));
+	}else ortp_warning ("Error sending rtcp packet: %s ; socket=%i; addr=%s", getSocketError(), session->rtcp.socket, ortp_inet_ntoa((struct sockaddr*)&session->rtcp.rem_addr,session->rtcp.rem_addrlen,host,sizeof(host)) );
+}
+
+/*
+ * RTCP send batching.
+ * The packets queued by a thread are sent by ortp_rtcp_batch_flush(), with one sendmmsg() per socket where
+ * the kernel supports it, with one sendmsg() per packet otherwise.
+ */
+#define RTCP_BATCH_SIZE 64
+
+typedef struct _RtcpBatchEntry{
+	RtpSession *session;
+	ortp_socket_t sockfd;
+	mblk_t *m;
+#ifdef ORTP_INET6
+	struct sockaddr_storage addr;
+#else
+	struct sockaddr_in addr;
+#endif
+	socklen_t addrlen;
+	bool_t sent;
+}RtcpBatchEntry;
+
+typedef struct _RtcpBatch{
+	RtcpBatchEntry entries[RTCP_BATCH_SIZE];
+	int count;
+}RtcpBatch;
+
+static ORTP_THREAD_LOCAL RtcpBatch *rtcp_batch=NULL;
+
+#if defined(USE_SENDMSG) && defined(__linux__)
+#include <sys/syscall.h>
+#ifdef __NR_sendmmsg
+/*through syscall() as the C library may not wrap it*/
+#define USE_SENDMMSG 1
+struct ortp_mmsghdr{
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+};
+static bool_t sendmmsg_unsupported=FALSE;
+#endif
+#endif
+
+void ortp_rtcp_batch_enable(void){
+	if (rtcp_batch==NULL){
+		OrtpArena *arena=ortp_arena_set_current(NULL);
+		rtcp_batch=(RtcpBatch*)ortp_malloc0(sizeof(RtcpBatch));
+		ortp_arena_set_current(arena);
+	}
+}
+
+void ortp_rtcp_batch_disable(void){
+	if (rtcp_batch!=NULL){
+		ortp_rtcp_batch_flush();
+		ortp_free(rtcp_batch);
+		rtcp_batch=NULL;
+	}
+}
+
+static int rtcp_batch_send_one(RtcpBatchEntry *e){
+	struct sockaddr *to=e->addrlen>0 ? (struct sockaddr*)&e->addr : NULL;
+#ifdef USE_SENDMSG
+	return rtp_sendmsg(e->sockfd,e->m,to,e->addrlen);
+#else
+	return sendto(e->sockfd,(char*)e->m->b_rptr,(int)(e->m->b_wptr-e->m->b_rptr),0,to,e->addrlen);
+#endif
+}
+
+#ifdef USE_SENDMMSG
+/*sends the packets of entries[first..count[ going to the socket of entries[first]*/
+static void rtcp_batch_send_socket(RtcpBatchEntry *entries, int first, int count){
+	struct ortp_mmsghdr msgs[RTCP_BATCH_SIZE];
+	struct iovec iov[RTCP_BATCH_SIZE];
+	RtcpBatchEntry *sent_entries[RTCP_BATCH_SIZE];
+	ortp_socket_t sockfd=entries[first].sockfd;
+	int n=0,done=0;
+	int i;
+
+	for(i=first;i<count;i++){
+		RtcpBatchEntry *e=&entries[i];
+		if (e->sent || e->sockfd!=sockfd) continue;
+		if (e->m->b_cont!=NULL) msgpullup(e->m,-1);
+		iov[n].iov_base=e->m->b_rptr;
+		iov[n].iov_len=e->m->b_wptr-e->m->b_rptr;
+		memset(&msgs[n],0,sizeof(msgs[n]));
+		msgs[n].msg_hdr.msg_name=e->addrlen>0 ? (void*)&e->addr : NULL;
+		msgs[n].msg_hdr.msg_namelen=e->addrlen;
+		msgs[n].msg_hdr.msg_iov=&iov[n];
+		msgs[n].msg_hdr.msg_iovlen=1;
+		sent_entries[n]=e;
+		e->sent=TRUE;
+		n++;
+	}
+	while(done<n){
+		int ret=syscall(__NR_sendmmsg,sockfd,&msgs[done],n-done,0);
+		if (ret<0 && errno==ENOSYS){
+			sendmmsg_unsupported=TRUE;
+			for(;done<n;done++){
+				if (rtcp_batch_send_one(sent_entries[done])<0) rtcp_send_error(sent_entries[done]->session);
+			}
+			break;
+		}
+		if (ret<=0){
+			/*the first remaining packet failed, skip it*/
+			rtcp_send_error(sent_entries[done]->session);
+			done++;
+		}else done+=ret;
+	}
+}
+#endif
+
+void ortp_rtcp_batch_flush(void){
+	RtcpBatch *b=rtcp_batch;
+	int i;
+
+	if (b==NULL || b->count==0) return;
+	for(i=0;i<b->count;i++){
+		RtcpBatchEntry *e=&b->entries[i];
+		if (e->sent) continue;
+#ifdef USE_SENDMMSG
+		if (!sendmmsg_unsupported){
+			rtcp_batch_send_socket(b->entries,i,b->count);
+			continue;
+		}
+#endif
+		if (rtcp_batch_send_one(e)<0) rtcp_send_error(e->session);
+		e->sent=TRUE;
+	}
+	for(i=0;i<b->count;i++){
+		freemsg(b->entries[i].m);
+		b->entries[i].m=NULL;
+	}
+	b->count=0;
+}
+
+static int rtcp_batch_queue(RtpSession *session, ortp_socket_t sockfd, mblk_t *m, const struct sockaddr *destaddr, socklen_t destlen){
+	RtcpBatchEntry *e;
+	int size=msgdsize(m);
+
+	if (rtcp_batch->count==RTCP_BATCH_SIZE)
+		ortp_rtcp_batch_flush();
+	e=&rtcp_batch->entries[rtcp_batch->count++];
+	e->session=session;
+	e->sockfd=sockfd;
+	e->m=m;
+	e->addrlen=destlen;
+	if (destlen>0) memcpy(&e->addr,destaddr,destlen);
+	e->sent=FALSE;
+	return size;
+}
+
 int
 rtp_session_rtcp_send (RtpSession * session, mblk_t * m)
 {
@@ -1069,6 +1224,10 @@ rtp_session_rtcp_send (RtpSession * session, mblk_t * m)
 			error = (session->rtcp.tr->t_sendto) (session->rtcp.tr, m, 0,
 			destaddr, destlen);
 		}
+		else if (rtcp_batch!=NULL){
+			/*the batch owns the packet until it is sent*/
+			return rtcp_batch_queue(session,sockfd,m,destaddr,destlen);
+		}
 		else{
 #ifdef USE_SENDMSG
 			error=rtp_sendmsg(sockfd,m,destaddr, destlen);
@@ -1082,10 +1241,7 @@ rtp_session_rtcp_send (RtpSession * session, mblk_t * m)
 #endif
 		}
 		if (error < 0){
-			char host[65];
-			if (session->on_network_error.count>0){
-				rtp_signal_table_emit3(&session->on_network_error,(long)"Error sending RTCP packet",INT_TO_POINTER(getSocketErrorCode()));
-			}else ortp_warning ("Error sending rtcp packet: %s ; socket=%i; addr=%s", getSocketError(), session->rtcp.socket, ortp_inet_ntoa((struct sockaddr*)&session->rtcp.rem_addr,session->rtcp.rem_addrlen,host,sizeof(host)) );
+			rtcp_send_error(session);
 		}
 	}else ortp_message("Not sending rtcp report: sockfd=%i, rem_addrlen=%i, connected=%i",sockfd,session->rtcp.rem_addrlen,using_connected_socket);
 	freemsg (m);
@@ -1301,10 +1457,21 @@ static void compute_rtt(RtpSession *session, const struct timeval *now, const re
 			rtt_frac+=sim_delay;
 		}
 		session->rtt=rtt_frac;
+		session->rtcp_summary.rtt=rtt_frac;
 		/*ortp_message("rtt estimated to %f ms",session->rtt);*/
 	}
 }
 
+/* keeps the report block of the remote end about our stream in the RTCP summary */
+static void summarize_report_block(RtpSession *session, const report_block_t *rb){
+	if (report_block_get_ssrc(rb)!=session->snd.ssrc) return;
+	session->rtcp_summary.has_remote_report=TRUE;
+	session->rtcp_summary.remote_fraction_lost=report_block_get_fraction_lost(rb);
+	session->rtcp_summary.remote_cum_packet_loss=report_block_get_cum_packet_loss(rb);
+	session->rtcp_summary.remote_ext_high_seq=report_block_get_high_ext_seq(rb);
+	session->rtcp_summary.remote_jitter=report_block_get_interarrival_jitter(rb);
+}
+
 /*
  * @brief : for SR packets, retrieves their timestamp, gets the date, and stores these information into the session descriptor. The date values may be used for setting some fields of the report block of the next RTCP packet to be sent.
  * @param session : the current session descriptor.
@@ -1345,13 +1512,20 @@ static int process_rtcp_packet( RtpSession *session, mblk_t *block, struct socka
 		ortp_message("Receiving rtcp packet with version number !=2...discarded");
 		return 0;
 	}
+	rtcp_summary_update_begin(session);
+	session->rtcp_summary.received_packets++;
 	/* compound rtcp packet can be composed by more than one rtcp message */
 	do{
 		struct timeval reception_date;
 		const report_block_t *rb;
 		
-		/* Getting the reception date from the main clock */	
+		/* Getting the reception date from the kernel, or else from the main clock: it is used to compute the round trip time */
+#if defined(ORTP_TIMESTAMP)
+		if (block->timestamp.tv_sec!=0) reception_date=block->timestamp;
+		else
+#endif
 		gettimeofday( &reception_date, NULL );
+		session->rtcp_summary.last_received=reception_date;
 
 		if (rtcp_is_SR(block) ) {
 			rtcp_sr_t *sr = (rtcp_sr_t *) rtcp;
@@ -1364,12 +1538,12 @@ static int process_rtcp_packet( RtpSession *session, mblk_t *block, struct socka
 			
 			if ( ntohl( sr->ssrc ) != session->rcv.ssrc ) {
 				ortp_message( "Receiving a RTCP SR packet from an unknown ssrc" );
-				return 0;
+				break;
 			}
 
 			if ( msgsize < RTCP_COMMON_HEADER_SIZE + RTCP_SSRC_FIELD_SIZE + RTCP_SENDER_INFO_SIZE + ( RTCP_REPORT_BLOCK_SIZE * sr->ch.rc ) ) {
 				ortp_message( "Receiving a too short RTCP SR packet" );
-				return 0;
+				break;
 			}
 
 			/* Saving the data to fill LSR and DLSR field in next RTCP report to be transmitted */
@@ -1378,17 +1552,41 @@ static int process_rtcp_packet( RtpSession *session, mblk_t *block, struct socka
 			/* This value will help in processing the DLSR of the next RTCP report ( see report_block_init() in rtcp.cc ) */
 			rtpstream->last_rcv_SR_time.tv_usec = reception_date.tv_usec;
 			rtpstream->last_rcv_SR_time.tv_sec = reception_date.tv_sec;
+			session->rtcp_summary.remote_ssrc=ntohl(sr->ssrc);
+			session->rtcp_summary.remote_packet_count=ntohl(sr->si.senders_packet_count);
+			session->rtcp_summary.remote_octet_count=ntohl(sr->si.senders_octet_count);
 			rb=rtcp_SR_get_report_block(block,0);
-			if (rb) compute_rtt(session,&reception_date,rb);
+			if (rb){
+				compute_rtt(session,&reception_date,rb);
+				summarize_report_block(session,rb);
+			}
 		}else if ( rtcp_is_RR(block)){
 			rb=rtcp_RR_get_report_block(block,0);
-			if (rb) compute_rtt(session,&reception_date,rb);
+			if (rb){
+				compute_rtt(session,&reception_date,rb);
+				summarize_report_block(session,rb);
+			}
+		}else if (rtcp_is_XR(block)){
+			rtcp_voip_metrics_t metrics;
+			if (rtcp_XR_get_voip_metrics(block,&metrics) && metrics.ssrc==session->snd.ssrc){
+				session->rtcp_summary.has_remote_voip_metrics=TRUE;
+				session->rtcp_summary.remote_voip_metrics=metrics;
+			}
 		}
 	}while (rtcp_next_packet(block));
+	rtcp_summary_update_end(session);
 	rtcp_rewind(block);
 	return 0;
 }
 
+static bool_t rtp_session_wants_event(RtpSession *session, OrtpEventType type){
+	OList *it;
+	for(it=session->eventqs;it!=NULL;it=it->next){
+		if (ortp_ev_queue_wants_type((OrtpEvQueue*)it->data,type)) return TRUE;
+	}
+	return FALSE;
+}
+
 
 int
 rtp_session_rtcp_recv (RtpSession * session)
@@ -1429,12 +1627,17 @@ rtp_session_rtcp_recv (RtpSession * session)
 		if (error > 0)
 		{
 			mp->b_wptr += error;
-			if (process_rtcp_packet( session, mp, (struct sockaddr*)&remaddr, addrlen) >= 0)
-			/* post an event to notify the application*/
-			{
+			if (process_rtcp_packet( session, mp, (struct sockaddr*)&remaddr, addrlen) < 0){
+				/* handed over in a STUN event */
+				session->rtcp.cached_mp=NULL;
+			}else if (rtp_session_wants_event(session,ORTP_EVENT_RTCP_PACKET_RECEIVED)){
+				/* post an event to notify the application*/
 				rtp_session_notify_inc_rtcp(session,mp);
+				session->rtcp.cached_mp=NULL;
+			}else{
+				/* the summary has what the application needs, the buffer is reused for the next packet */
+				mp->b_rptr=mp->b_wptr=mp->b_datap->db_base;
 			}
-			session->rtcp.cached_mp=NULL;
 			if (session->symmetric_rtp && !sock_connected){
 				/* store the sender rtp address to do symmetric RTP */
 				memcpy(&session->rtcp.rem_addr,&remaddr,addrlen);
@@ -36,11 +36,21 @@ typedef enum {
 	RTP_SESSION_USING_TRANSPORT=1<<10,
 	RTCP_OVERRIDE_LOST_PACKETS=1<11,
 	RTCP_OVERRIDE_JITTER=1<<12,
-	RTCP_OVERRIDE_DELAY=1<<13
+	RTCP_OVERRIDE_DELAY=1<<13,
+	RTCP_EMITTED_EVENTS=1<<14, /* ORTP_EVENT_RTCP_PACKET_EMITTED is dispatched for the reports sent */
+	RTCP_XR_VOIP_METRICS=1<<15 /* the reports sent include the RTCP XR VoIP metrics */
 }RtpSessionFlags;
 
 #define rtp_session_using_transport(s, stream) (((s)->flags & RTP_SESSION_USING_TRANSPORT) && (s->stream.tr != 0))
 
+/* the thread processing the session updates its RTCP summary between these, see rtp_session_get_rtcp_summary() */
+#define rtcp_summary_update_begin(s) do{ (s)->rtcp_summary_seq++; ortp_memory_barrier(); }while(0)
+#define rtcp_summary_update_end(s) do{ ortp_memory_barrier(); (s)->rtcp_summary_seq++; }while(0)
+
+/* records lost (or discarded) packets followed by a received one, for the RTCP XR VoIP metrics */
+#define RTCP_XR_MAX_GAP 1000
+void rtcp_xr_burst_update(RtcpXrBurstStats *b, int lost, bool_t received);
+
 int rtp_session_rtp_recv_abstract(ortp_socket_t socket, mblk_t *msg, int flags, struct sockaddr *from, socklen_t *fromlen);
 
 void rtp_session_update_payload_type(RtpSession * session, int pt);
@@ -232,6 +232,15 @@ int msgdsize(const mblk_t *mp)
 	return msgsize;
 }
 
+int msgtailroom(const mblk_t *mp)
+{
+	const dblk_t *db=mp->b_datap;
+	if (mp->b_cont!=NULL || db->db_ref!=1) return 0;
+	/*buffers given to esballoc() belong to the application*/
+	if (db->db_base!=(const uint8_t*)db+sizeof(dblk_t)) return 0;
+	return (int) (db->db_lim-mp->b_wptr);
+}
+
 void msgpullup(mblk_t *mp,int len)
 {
 	mblk_t *firstm=mp;
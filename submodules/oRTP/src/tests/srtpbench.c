@@ -0,0 +1,140 @@
+  /*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * SRTP send throughput on one core, AES_128_SHA1_80: packets are sent to a local port as fast as possible,
+ * in clear, through SRTP with header and payload in separate buffers (as mediastreamer2 used to send them,
+ * srtp copies them into a new buffer), and through SRTP with packets built with room for the trailer
+ * (protected in place), with libsrtp's builtin AES and SHA1 and, when compiled in, with OpenSSL's.
+ */
+
+#include <ortp/ortp.h>
+#include <ortp/ortp_srtp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/*base64 of 30 bytes: 128 bits key and 112 bits salt*/
+static const char *key="MTIzNDU2Nzg5MDEyMzQ1Njc4OTAxMjM0NTY3ODkw";
+
+static const char *help="usage: srtpbench [--packets <count>] [--payload <bytes>] [--port <destination port>]\n";
+
+enum bench_mode{
+	BENCH_CLEAR,
+	BENCH_SRTP_COPY,
+	BENCH_SRTP_IN_PLACE
+};
+
+static double run_bench(enum bench_mode mode, int packets, int payload_size, int port){
+	RtpSession *session;
+	RtpTransport *rtpt=NULL,*rtcpt=NULL;
+	srtp_t srtp=NULL;
+	uint8_t *payload;
+	ortpTimeSpec begin,end;
+	double elapsed;
+	int i;
+
+	session=rtp_session_new(RTP_SESSION_SENDONLY);
+	rtp_session_set_payload_type(session,0);
+	rtp_session_set_remote_addr(session,"127.0.0.1",port);
+	rtp_session_enable_rtcp(session,FALSE);
+	if (mode!=BENCH_CLEAR){
+		srtp=ortp_srtp_create_configure_session(AES_128_SHA1_80,rtp_session_get_send_ssrc(session),key,key);
+		if (srtp==NULL){
+			rtp_session_destroy(session);
+			return -1;
+		}
+		srtp_transport_new(srtp,&rtpt,&rtcpt);
+		rtp_session_set_transports(session,rtpt,rtcpt);
+	}
+	payload=(uint8_t*)ortp_malloc(payload_size);
+	memset(payload,0x55,payload_size);
+
+	ortp_get_cur_time(&begin);
+	for(i=0;i<packets;i++){
+		mblk_t *packet;
+		if (mode==BENCH_SRTP_IN_PLACE){
+			packet=rtp_session_create_packet(session,RTP_FIXED_HEADER_SIZE,payload,payload_size);
+		}else{
+			/*the way the codecs output arrives to the RTP sender: a separate buffer behind the header*/
+			mblk_t *data=allocb(payload_size,0);
+			memcpy(data->b_wptr,payload,payload_size);
+			data->b_wptr+=payload_size;
+			packet=rtp_session_create_packet(session,RTP_FIXED_HEADER_SIZE,NULL,0);
+			packet->b_cont=data;
+		}
+		rtp_session_sendm_with_ts(session,packet,i*payload_size);
+	}
+	ortp_get_cur_time(&end);
+	elapsed=(end.tv_sec-begin.tv_sec)+(end.tv_nsec-begin.tv_nsec)*1e-9;
+
+	ortp_free(payload);
+	rtp_session_set_transports(session,NULL,NULL);
+	rtp_session_destroy(session);
+	if (rtpt) ortp_free(rtpt);
+	if (rtcpt) ortp_free(rtcpt);
+	if (srtp) ortp_srtp_dealloc(srtp);
+	return packets/elapsed;
+}
+
+int main(int argc, char *argv[]){
+	int packets=200000;
+	int payload_size=160;
+	int port=9;
+	double clear,copy,in_place,in_place_openssl=0;
+	int i;
+
+	for(i=1;i<argc;i++){
+		if (i+1>=argc){
+			printf("%s",help);
+			return -1;
+		}
+		if (strcmp(argv[i],"--packets")==0) packets=atoi(argv[++i]);
+		else if (strcmp(argv[i],"--payload")==0) payload_size=atoi(argv[++i]);
+		else if (strcmp(argv[i],"--port")==0) port=atoi(argv[++i]);
+		else{
+			printf("%s",help);
+			return -1;
+		}
+	}
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_ERROR|ORTP_FATAL);
+	if (!ortp_srtp_supported()){
+		printf("oRTP is compiled without SRTP support.\n");
+		return -1;
+	}
+	clear=run_bench(BENCH_CLEAR,packets,payload_size,port);
+	ortp_srtp_set_crypto_backend(ORTP_SRTP_BACKEND_BUILTIN);
+	copy=run_bench(BENCH_SRTP_COPY,packets,payload_size,port);
+	in_place=run_bench(BENCH_SRTP_IN_PLACE,packets,payload_size,port);
+	if (ortp_srtp_set_crypto_backend(ORTP_SRTP_BACKEND_OPENSSL)==0)
+		in_place_openssl=run_bench(BENCH_SRTP_IN_PLACE,packets,payload_size,port);
+	if (copy<0 || in_place<0 || in_place_openssl<0){
+		printf("Could not create the SRTP session.\n");
+		return -1;
+	}
+	printf("%i packets of %i bytes of payload\n",packets,payload_size);
+	printf("clear:          %10.0f packets/s, %6.3f us per packet\n",clear,1e6/clear);
+	printf("srtp, copy:     %10.0f packets/s, %6.3f us per packet (%6.3f us for srtp)\n",copy,1e6/copy,1e6/copy-1e6/clear);
+	printf("srtp, in place: %10.0f packets/s, %6.3f us per packet (%6.3f us for srtp)\n",in_place,1e6/in_place,1e6/in_place-1e6/clear);
+	if (in_place_openssl>0)
+		printf("srtp, openssl:  %10.0f packets/s, %6.3f us per packet (%6.3f us for srtp)\n",in_place_openssl,1e6/in_place_openssl,1e6/in_place_openssl-1e6/clear);
+	ortp_exit();
+	return 0;
+}
@@ -28,6 +28,7 @@
 #define UTILS_H
 
 #include "ortp/event.h"
+#include "ortp/rtp.h"
 
 struct _OList {
 	struct _OList *next;
@@ -77,8 +78,21 @@ typedef union{
 #define is_would_block_error(errnum)	(errnum==EWOULDBLOCK || errnum==EAGAIN)
 #endif
 
+#ifdef _MSC_VER
+#define ORTP_THREAD_LOCAL __declspec(thread)
+#define ortp_memory_barrier() MemoryBarrier()
+#else
+#define ORTP_THREAD_LOCAL __thread
+#define ortp_memory_barrier() __sync_synchronize()
+#endif
+
 void ortp_ev_queue_put(OrtpEvQueue *q, OrtpEvent *ev);
 
+/*the calling thread's shard of the global statistics, see ortp_get_global_stats_snapshot()*/
+extern ORTP_THREAD_LOCAL rtp_stats_t *ortp_thread_stats;
+rtp_stats_t *ortp_thread_stats_acquire(void);
+#define ortp_global_stats_shard() (ortp_thread_stats!=NULL ? ortp_thread_stats : ortp_thread_stats_acquire())
+
 uint64_t ortp_timeval_to_ntp(const struct timeval *tv);
 
 #endif
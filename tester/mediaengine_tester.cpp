@@ -0,0 +1,303 @@
+/*
+ * Tests of the MediaEngine session bookkeeping: RTP port pool, session handles and shutdown.
+ *
+ * Built on a host against mediastreamer2, oRTP and CUnit:
+ *   g++ -I../src -I<mediastreamer2>/include -I<oRTP>/include mediaengine_tester.cpp ../src/MediaEngine.cpp
+ *       -lmediastreamer_voip -lmediastreamer_base -lortp -lcunit -lpthread
+ * It binds RTP ports of the engine's range on the loopback host.
+ */
+
+#include "MediaEngine.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+
+typedef void (*test_function_t)(void);
+
+typedef struct {
+	const char *name;
+	test_function_t func;
+} test_t;
+
+
+static MediaEngine* engine_new(void) {
+	MediaEngine *engine = new MediaEngine();
+	engine->Initialize();
+	CU_ASSERT_TRUE_FATAL(engine->isInitialized());
+	return engine;
+}
+
+// waits for the background binding to bring the warm pairs to count, returns the last stats
+static MediaEngine::ME_RtpPortStats wait_warm_ports(MediaEngine *engine, int count) {
+	MediaEngine::ME_RtpPortStats stats;
+	int i;
+
+	for (i = 0; i < 200; i++) {
+		engine->GetRtpPortStats(&stats);
+		if (stats.warm == count && stats.binding == 0) break;
+		ms_usleep(10000);
+	}
+	return stats;
+}
+
+static void port_pool_warm_at_init(void) {
+	MediaEngine *engine = engine_new();
+	MediaEngine::ME_RtpPortStats stats;
+
+	// the first call finds its session bound by Initialize(), the others are bound in the background
+	engine->GetRtpPortStats(&stats);
+	CU_ASSERT_TRUE(stats.warm >= 1);
+	stats = wait_warm_ports(engine, ME_MAX_NB_SESSIONS);
+	CU_ASSERT_EQUAL(stats.warm, ME_MAX_NB_SESSIONS);
+	CU_ASSERT_EQUAL(stats.used, 0);
+	CU_ASSERT_EQUAL(stats.binding, 0);
+	CU_ASSERT_TRUE(stats.free > 0);
+	delete engine;
+}
+
+static void port_pool_free_warm_used(void) {
+	MediaEngine *engine = engine_new();
+	MediaEngine::ME_RtpPortStats before, stats;
+	MediaEngine::MediaSession *any, *explicit_free, *explicit_warm;
+	int warm_port;
+
+	before = wait_warm_ports(engine, ME_MAX_NB_SESSIONS);
+
+	// any port: a warm pair becomes used
+	any = engine->CreateSession();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(any);
+	engine->InitStreams(any, -1);
+	CU_ASSERT_TRUE(any->audio_port_pooled);
+	CU_ASSERT_EQUAL(any->audio_port & 1, 0);
+	engine->GetRtpPortStats(&stats);
+	CU_ASSERT_EQUAL(stats.warm, before.warm - 1);
+	CU_ASSERT_EQUAL(stats.used, 1);
+	CU_ASSERT_EQUAL(stats.free, before.free);
+
+	// the next warm pair follows the one just taken
+	warm_port = any->audio_port + 2;
+	explicit_warm = engine->CreateSession();
+	engine->InitStreams(explicit_warm, warm_port);
+	CU_ASSERT_TRUE(explicit_warm->audio_port_pooled);
+	CU_ASSERT_EQUAL(explicit_warm->audio_port, warm_port);
+	engine->GetRtpPortStats(&stats);
+	CU_ASSERT_EQUAL(stats.warm, before.warm - 2);
+	CU_ASSERT_EQUAL(stats.used, 2);
+
+	// a free pair is bound on demand
+	explicit_free = engine->CreateSession();
+	engine->InitStreams(explicit_free, 19000);
+	CU_ASSERT_TRUE(explicit_free->audio_port_pooled);
+	CU_ASSERT_EQUAL(explicit_free->audio_port, 19000);
+	engine->GetRtpPortStats(&stats);
+	CU_ASSERT_EQUAL(stats.free, before.free - 1);
+	CU_ASSERT_EQUAL(stats.used, 3);
+	CU_ASSERT_EQUAL(stats.binding, 0);
+
+	CU_ASSERT_EQUAL(engine->DeleteSession(any->handle), 0);
+	CU_ASSERT_EQUAL(engine->DeleteSession(explicit_warm->handle), 0);
+	CU_ASSERT_EQUAL(engine->DeleteSession(explicit_free->handle), 0);
+	stats = wait_warm_ports(engine, ME_MAX_NB_SESSIONS);
+	CU_ASSERT_EQUAL(stats.used, 0);
+	CU_ASSERT_EQUAL(stats.warm, ME_MAX_NB_SESSIONS);
+	CU_ASSERT_EQUAL(stats.free + stats.warm, before.free + before.warm);
+	delete engine;
+}
+
+static void port_pool_used_or_out_of_range(void) {
+	MediaEngine *engine = engine_new();
+	MediaEngine::ME_RtpPortStats stats;
+	MediaEngine::MediaSession *owner, *other, *outside;
+
+	wait_warm_ports(engine, ME_MAX_NB_SESSIONS);
+	owner = engine->CreateSession();
+	engine->InitStreams(owner, -1);
+
+	// a pair used by a call is not taken from the pool, nor given back by the session that asked for it
+	other = engine->CreateSession();
+	engine->InitStreams(other, owner->audio_port);
+	CU_ASSERT_FALSE(other->audio_port_pooled);
+	CU_ASSERT_EQUAL(engine->DeleteSession(other->handle), 0);
+	engine->GetRtpPortStats(&stats);
+	CU_ASSERT_EQUAL(stats.used, 1);
+
+	// out of the range, the port is bound as requested
+	outside = engine->CreateSession();
+	engine->InitStreams(outside, 30000);
+	CU_ASSERT_FALSE(outside->audio_port_pooled);
+	CU_ASSERT_EQUAL(outside->audio_port, 30000);
+	engine->GetRtpPortStats(&stats);
+	CU_ASSERT_EQUAL(stats.used, 1);
+
+	CU_ASSERT_EQUAL(engine->DeleteSession(outside->handle), 0);
+	CU_ASSERT_EQUAL(engine->DeleteSession(owner->handle), 0);
+	delete engine;
+}
+
+static void port_pool_recycled_on_delete(void) {
+	MediaEngine *engine = engine_new();
+	MediaEngine::ME_RtpPortStats stats;
+	MediaEngine::MediaSession *first, *second, *again;
+	int port;
+
+	wait_warm_ports(engine, ME_MAX_NB_SESSIONS);
+	first = engine->CreateSession();
+	engine->InitStreams(first, -1);
+	port = first->audio_port;
+	CU_ASSERT_EQUAL(engine->DeleteSession(first->handle), 0);
+
+	// the pair rests at the end of the free list: the next call gets another one
+	stats = wait_warm_ports(engine, ME_MAX_NB_SESSIONS);
+	CU_ASSERT_EQUAL(stats.used, 0);
+	second = engine->CreateSession();
+	engine->InitStreams(second, -1);
+	CU_ASSERT_NOT_EQUAL(second->audio_port, port);
+
+	// but it can be asked for again, its sockets being closed
+	again = engine->CreateSession();
+	engine->InitStreams(again, port);
+	CU_ASSERT_TRUE(again->audio_port_pooled);
+	CU_ASSERT_EQUAL(again->audio_port, port);
+	engine->GetRtpPortStats(&stats);
+	CU_ASSERT_EQUAL(stats.used, 2);
+
+	CU_ASSERT_EQUAL(engine->DeleteSession(second->handle), 0);
+	CU_ASSERT_EQUAL(engine->DeleteSession(again->handle), 0);
+	engine->GetRtpPortStats(&stats);
+	CU_ASSERT_EQUAL(stats.used, 0);
+	delete engine;
+}
+
+// the handle of a deleted session matches no other session, nor the one taking its slot
+static void session_stale_handle(void) {
+	MediaEngine *engine = engine_new();
+	MediaEngine::MediaSession *first, *second;
+	MediaEngine::ME_SessionHandle handle;
+
+	first = engine->CreateSession();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(first);
+	handle = first->handle;
+	CU_ASSERT_NOT_EQUAL(handle, ME_INVALID_SESSION_HANDLE);
+	CU_ASSERT_PTR_EQUAL(engine->FindSession(handle), first);
+	CU_ASSERT_EQUAL(engine->DeleteSession(handle), 0);
+	CU_ASSERT_PTR_NULL(engine->FindSession(handle));
+	CU_ASSERT_EQUAL(engine->DeleteSession(handle), -1);
+
+	second = engine->CreateSession();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(second);
+	CU_ASSERT_EQUAL(second->handle & ME_SESSION_SLOT_MASK, handle & ME_SESSION_SLOT_MASK);
+	CU_ASSERT_NOT_EQUAL(second->handle, handle);
+	CU_ASSERT_PTR_NULL(engine->FindSession(handle));
+	CU_ASSERT_EQUAL(engine->DeleteSession(handle), -1);
+	CU_ASSERT_PTR_EQUAL(engine->FindSession(second->handle), second);
+	CU_ASSERT_EQUAL(engine->GetSessionCount(), 1);
+
+	// a slot out of the registry, and no session at all
+	CU_ASSERT_PTR_NULL(engine->FindSession((1 << ME_SESSION_SLOT_BITS) | ME_SESSION_SLOT_MASK));
+	CU_ASSERT_PTR_NULL(engine->FindSession(ME_INVALID_SESSION_HANDLE));
+	CU_ASSERT_EQUAL(engine->DeleteSession(ME_INVALID_SESSION_HANDLE), -1);
+
+	CU_ASSERT_EQUAL(engine->DeleteSession(second->handle), 0);
+	CU_ASSERT_EQUAL(engine->GetSessionCount(), 0);
+	delete engine;
+}
+
+// the 16 bits generation of a slot skips 0 when it wraps, so that no handle is ME_INVALID_SESSION_HANDLE
+static void session_handle_generation_wrap(void) {
+	MediaEngine *engine = engine_new();
+	MediaEngine::MediaSession *session;
+	MediaEngine::ME_SessionHandle first, handle;
+	int i, zero_generations = 0;
+
+	session = engine->CreateSession();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(session);
+	first = session->handle;
+	CU_ASSERT_EQUAL(engine->DeleteSession(first), 0);
+	// the slot is taken again each time, until its generation comes back to the first one
+	for (i = 1; i <= 0xFFFF; i++) {
+		session = engine->CreateSession();
+		CU_ASSERT_PTR_NOT_NULL_FATAL(session);
+		handle = session->handle;
+		if ((handle >> ME_SESSION_SLOT_BITS) == 0) zero_generations++;
+		if (handle == first) break;
+		CU_ASSERT_EQUAL(engine->DeleteSession(handle), 0);
+	}
+	CU_ASSERT_EQUAL(zero_generations, 0);
+	CU_ASSERT_EQUAL(i, 0xFFFF);
+	CU_ASSERT_EQUAL(handle, first);
+	CU_ASSERT_PTR_EQUAL(engine->FindSession(first), session);
+	CU_ASSERT_EQUAL(engine->DeleteSession(first), 0);
+	delete engine;
+}
+
+// Uninitialize() stops the streams of the open sessions in parallel and gives their ports back, once
+static void session_shutdown(void) {
+	MediaEngine *engine = engine_new();
+	MediaEngine::MediaSession *sessions[ME_MAX_NB_SESSIONS];
+	MediaEngine::ME_SessionHandle handles[ME_MAX_NB_SESSIONS];
+	MediaEngine::ME_RtpPortStats stats;
+	int i;
+
+	wait_warm_ports(engine, ME_MAX_NB_SESSIONS);
+	for (i = 0; i < ME_MAX_NB_SESSIONS; i++) {
+		sessions[i] = engine->CreateSession();
+		CU_ASSERT_PTR_NOT_NULL_FATAL(sessions[i]);
+		engine->InitStreams(sessions[i], -1);
+		CU_ASSERT_PTR_NOT_NULL(sessions[i]->as->audiostream);
+		handles[i] = sessions[i]->handle;
+	}
+	CU_ASSERT_PTR_NULL(engine->CreateSession());
+	engine->GetRtpPortStats(&stats);
+	CU_ASSERT_EQUAL(stats.used, ME_MAX_NB_SESSIONS);
+
+	engine->Uninitialize();
+	CU_ASSERT_FALSE(engine->isInitialized());
+	engine->Uninitialize();
+
+	// a new start knows none of the previous sessions, and has all the pairs back
+	engine->Initialize();
+	CU_ASSERT_TRUE_FATAL(engine->isInitialized());
+	CU_ASSERT_EQUAL(engine->GetSessionCount(), 0);
+	for (i = 0; i < ME_MAX_NB_SESSIONS; i++) {
+		CU_ASSERT_PTR_NULL(engine->FindSession(handles[i]));
+	}
+	stats = wait_warm_ports(engine, ME_MAX_NB_SESSIONS);
+	CU_ASSERT_EQUAL(stats.used, 0);
+	CU_ASSERT_EQUAL(stats.warm, ME_MAX_NB_SESSIONS);
+	delete engine;
+}
+
+static test_t tests[] = {
+	{ "Port pool warm at init", port_pool_warm_at_init },
+	{ "Port pool free, warm and used pairs", port_pool_free_warm_used },
+	{ "Port pool used or out of range port", port_pool_used_or_out_of_range },
+	{ "Port pool recycled on delete", port_pool_recycled_on_delete },
+	{ "Session stale handle", session_stale_handle },
+	{ "Session handle generation wrap", session_handle_generation_wrap },
+	{ "Session shutdown", session_shutdown },
+};
+
+int main(int argc, char *argv[]) {
+	CU_pSuite suite;
+	unsigned int i;
+	int failures;
+
+	if (argc > 1 && strcmp(argv[1], "--verbose") == 0) {
+		ortp_set_log_level_mask(ORTP_MESSAGE|ORTP_WARNING|ORTP_ERROR|ORTP_FATAL);
+	} else {
+		ortp_set_log_level_mask(ORTP_ERROR|ORTP_FATAL);
+	}
+	if (CUE_SUCCESS != CU_initialize_registry())
+		return CU_get_error();
+	suite = CU_add_suite("MediaEngine", NULL, NULL);
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		if (NULL == CU_add_test(suite, tests[i].name, tests[i].func))
+			return CU_get_error();
+	}
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+	return failures != 0;
+}